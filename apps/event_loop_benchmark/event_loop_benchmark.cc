@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chre.h>
+#include <cinttypes>
+
+#include "chre/util/nanoapp/log.h"
+#include "chre/util/time.h"
+
+#define LOG_TAG "[EventLoopBenchmark]"
+
+/**
+ * @file
+ *
+ * This nanoapp measures event delivery latency and throughput through the
+ * event loop under bursty load. It periodically posts a burst of events to
+ * itself, timestamped at the time they are sent, and reports the time each one
+ * took to be delivered. Running it against builds with different
+ * CHRE_EVENT_LOOP_INBOUND_BATCH_SIZE and CHRE_EVENT_LOOP_NANOAPP_BATCH_SIZE
+ * values shows the effect of batched event delivery.
+ */
+
+using chre::Milliseconds;
+using chre::Nanoseconds;
+
+namespace {
+
+//! The event type of the benchmark events posted by this nanoapp.
+constexpr uint16_t kBenchmarkEvent = CHRE_EVENT_FIRST_USER_VALUE;
+
+//! The number of events posted in each burst. Kept well below the event pool
+//! size, as the events sent by nanoapps are low priority.
+constexpr size_t kBurstSize = 32;
+
+//! The number of bursts to run before reporting the results.
+constexpr uint32_t kBurstCount = 100;
+
+//! The interval between two bursts.
+constexpr Milliseconds kBurstInterval = Milliseconds(50);
+
+//! The time each event of the current burst was sent at, referenced by the
+//! event data.
+uint64_t gSendTimes[kBurstSize];
+
+//! The number of events of the current burst that are yet to be received.
+size_t gPendingCount = 0;
+
+//! The total number of events received.
+uint64_t gReceivedCount = 0;
+
+//! The number of bursts completed so far.
+uint32_t gCompletedBurstCount = 0;
+
+//! The handle of the timer that starts a new burst.
+uint32_t gTimerHandle = CHRE_TIMER_INVALID;
+
+//! Latency statistics accumulated across all events, in nanoseconds.
+uint64_t gTotalLatencyNs = 0;
+uint64_t gMinLatencyNs = UINT64_MAX;
+uint64_t gMaxLatencyNs = 0;
+
+//! The total time from the first event sent to the last event received,
+//! accumulated across all bursts.
+uint64_t gTotalBurstDurationNs = 0;
+
+void sendBurst() {
+  if (gPendingCount != 0) {
+    LOGW("Previous burst not complete after %" PRIu64 " ms",
+         kBurstInterval.getMilliseconds());
+    return;
+  }
+
+  for (size_t i = 0; i < kBurstSize; i++) {
+    gSendTimes[i] = chreGetTime();
+    if (chreSendEvent(kBenchmarkEvent, &gSendTimes[i], nullptr /* freeCb */,
+                      chreGetInstanceId())) {
+      gPendingCount++;
+    } else {
+      LOGE("Failed to send event %zu of burst %" PRIu32, i,
+           gCompletedBurstCount);
+    }
+  }
+}
+
+void reportResults() {
+  if (gReceivedCount == 0) {
+    LOGE("No events received");
+    return;
+  }
+
+  LOGI("%" PRIu32 " bursts of %zu events: latency min %" PRIu64
+       " us, avg %" PRIu64 " us, max %" PRIu64 " us",
+       kBurstCount, kBurstSize,
+       gMinLatencyNs / chre::kOneMicrosecondInNanoseconds,
+       gTotalLatencyNs / gReceivedCount / chre::kOneMicrosecondInNanoseconds,
+       gMaxLatencyNs / chre::kOneMicrosecondInNanoseconds);
+  if (gTotalBurstDurationNs > 0) {
+    LOGI("Throughput %" PRIu64 " events/s",
+         gReceivedCount * chre::kOneSecondInNanoseconds /
+             gTotalBurstDurationNs);
+  }
+}
+
+void handleBenchmarkEvent(const uint64_t *sendTime) {
+  uint64_t now = chreGetTime();
+  uint64_t latencyNs = now - *sendTime;
+  gTotalLatencyNs += latencyNs;
+  if (latencyNs < gMinLatencyNs) {
+    gMinLatencyNs = latencyNs;
+  }
+  if (latencyNs > gMaxLatencyNs) {
+    gMaxLatencyNs = latencyNs;
+  }
+
+  gReceivedCount++;
+  if (--gPendingCount == 0) {
+    gTotalBurstDurationNs += now - gSendTimes[0];
+
+    if (++gCompletedBurstCount == kBurstCount) {
+      chreTimerCancel(gTimerHandle);
+      gTimerHandle = CHRE_TIMER_INVALID;
+      reportResults();
+    }
+  }
+}
+
+}  // namespace
+
+bool nanoappStart() {
+  LOGI("start");
+  gTimerHandle = chreTimerSet(Nanoseconds(kBurstInterval).toRawNanoseconds(),
+                              nullptr /* cookie */, false /* oneShot */);
+  return (gTimerHandle != CHRE_TIMER_INVALID);
+}
+
+void nanoappHandleEvent(uint32_t senderInstanceId, uint16_t eventType,
+                        const void *eventData) {
+  switch (eventType) {
+    case CHRE_EVENT_TIMER:
+      sendBurst();
+      break;
+
+    case kBenchmarkEvent:
+      handleBenchmarkEvent(static_cast<const uint64_t *>(eventData));
+      break;
+
+    default:
+      LOGW("Unexpected event %" PRIu16, eventType);
+      break;
+  }
+}
+
+void nanoappEnd() {
+  LOGI("stop");
+}
@@ -28,7 +28,13 @@ extern "C" {
  * Calculates IEEE CRC-32, initialized to (~crc), on an input data buffer.
  *
  * It is expected that the implementation be optimized based on individual
- * platforms, e.g. by reusing HW/SW optimized CRC functionality.
+ * platforms, e.g. by reusing HW/SW optimized CRC functionality. The shared
+ * implementation trades code size for speed based on these build flags:
+ * - (default): 16-entry nibble table (64 bytes), 4 bits per lookup.
+ * - CHPP_CRC32_BYTE_TABLE: 256-entry table (1 KiB), 8 bits per lookup.
+ * - CHPP_CRC32_SLICING_BY_8: 8 tables (8 KiB), 8 bytes per step.
+ * - CHPP_CRC32_HW: ARMv8 CRC32 instructions where available (i.e.
+ *   __ARM_FEATURE_CRC32 is defined), otherwise one of the above.
  *
  * @param crc CRC initialization value. This may be used to calculate a CRC on
  * daisy-chained input data. Otherwise, it can be set to zero to initialize to
@@ -64,6 +64,14 @@ enum ChppLinkErrorCode {
  */
 struct ChppPlatformLinkParameters;
 
+/**
+ * A contiguous part of the data to be sent by chppPlatformLinkSendVectored().
+ */
+struct ChppLinkTxSegment {
+  const uint8_t *buf;
+  size_t len;
+};
+
 /**
  * Platform-specific function to initialize the link layer.
  *
@@ -96,6 +104,29 @@ void chppPlatformLinkDeinit(struct ChppPlatformLinkParameters *params);
 enum ChppLinkErrorCode chppPlatformLinkSend(
     struct ChppPlatformLinkParameters *params, uint8_t *buf, size_t len);
 
+/*
+ * Optional platform-specific function to send Tx data that is split over
+ * several buffers (e.g. the preamble and header, the payload within the
+ * datagram being sent, and the footer) over to the link layer, for links that
+ * support vectored (scatter-gather) writes. This avoids copying the payload of
+ * each packet into a contiguous buffer beforehand.
+ *
+ * This function is only used, and only needs to be implemented, if
+ * CHPP_LINK_TX_VECTORED is defined. Otherwise, chppPlatformLinkSend() is used
+ * for every packet.
+ *
+ * @param params Platform-specific struct with link details / parameters.
+ * @param segments Data to be sent, in order.
+ * @param numSegments Number of entries in segments.
+ *
+ * @return Same as chppPlatformLinkSend(). The segments array itself is only
+ * valid during the call, but if CHPP_LINK_ERROR_NONE_QUEUED is returned, the
+ * buffers it points to remain valid until chppLinkSendDoneCb() is called.
+ */
+enum ChppLinkErrorCode chppPlatformLinkSendVectored(
+    struct ChppPlatformLinkParameters *params,
+    const struct ChppLinkTxSegment *segments, size_t numSegments);
+
 /**
  * Platform-specific function to perform a task from the main CHPP transport
  * work thread. The task can be specified by the signal argument, which is
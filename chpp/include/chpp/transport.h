@@ -78,6 +78,24 @@ extern "C" {
 #define CHPP_TRANSPORT_MAX_RESET UINT16_C(3)
 #endif
 
+/**
+ * CHPP Transport layer maximum number of outstanding (i.e. sent but not yet
+ * ACKed) payload-bearing packets. A window size of 1 results in stop-and-wait
+ * operation. Larger windows allow the packets of a fragmented datagram (or of
+ * consecutive datagrams) to be sent without waiting for a round trip each, and
+ * are ACKed cumulatively by the ackSeq of the remote endpoint.
+ *
+ * The window can be changed at runtime through
+ * ChppTransportState.txWindowSize, which is initialized to this value.
+ */
+#ifndef CHPP_TRANSPORT_TX_WINDOW_SIZE
+#define CHPP_TRANSPORT_TX_WINDOW_SIZE UINT8_C(1)
+#endif
+
+#if CHPP_TRANSPORT_TX_WINDOW_SIZE < 1 || CHPP_TRANSPORT_TX_WINDOW_SIZE > 127
+#error "CHPP_TRANSPORT_TX_WINDOW_SIZE must be between 1 and 127"
+#endif
+
 /**
  * CHPP Transport layer predefined timeout values.
  */
@@ -307,7 +325,7 @@ struct ChppTransportConfiguration {
   //! Receive MTU size.
   uint16_t rxMtu;
 
-  //! Max outstanding packet window size (1 for current implementation).
+  //! Max outstanding packet window size (CHPP_TRANSPORT_TX_WINDOW_SIZE).
   uint16_t windowSize;
 
   //! Transport layer timeout in milliseconds (i.e. to receive ACK).
@@ -339,6 +357,18 @@ struct ChppRxStatus {
   //! Location counter in bytes within the current Rx datagram.
   size_t locInDatagram;
 
+  //! Number of bytes allocated for the current Rx datagram payload. This may
+  //! exceed rxDatagram.length, so that the payload doesn't need to be
+  //! reallocated for every packet of a fragmented datagram.
+  size_t datagramCapacity;
+
+  //! The number of Rx datagram payload (re)allocations.
+  size_t numDatagramAllocs;
+
+  //! The number of bytes of partial Rx datagrams carried over by
+  //! reallocations (i.e. potentially copied).
+  size_t numDatagramReallocBytes;
+
   //! The total number of data received in chppRxDataCb.
   size_t numTotalDataBytes;
 
@@ -355,9 +385,15 @@ struct ChppTxStatus {
   uint8_t sentAckSeq;
 
   //! Last sent sequence number (irrespective of whether it has been received /
-  //! ACKed or not)
+  //! ACKed or not). Moves back to the last ACKed sequence number when
+  //! retransmitting.
   uint8_t sentSeq;
 
+  //! Sequence number of the first packet that has never been sent. The
+  //! packets from rxStatus.receivedAckSeq up to (not including) this one are
+  //! outstanding, i.e. sent but not yet ACKed.
+  uint8_t nextNewSeq;
+
   //! Does the transport layer have any packets (with or without payload) it
   //! needs to send out?
   bool hasPacketsToSend;
@@ -365,23 +401,42 @@ struct ChppTxStatus {
   //! Error code, if any, of the next packet the transport layer will send out.
   uint8_t packetCodeToSend;
 
-  //! How many times the last sent sequence number has been (re-)sent.
+  //! How many times the oldest outstanding sequence number has been
+  //! (re-)sent.
   size_t txAttempts;
 
   //! Time when the last packet was sent to the link layer.
   uint64_t lastTxTimeNs;
 
-  //! How many bytes of the front-of-queue datagram has been sent out
-  size_t sentLocInDatagram;
+  //! Time when the oldest outstanding packet was last (re-)sent, which the ACK
+  //! timeout is measured from. Unlike lastTxTimeNs, it is not refreshed by
+  //! packets that do not carry the oldest outstanding payload (e.g. ACKs). As
+  //! the send times of later packets are not kept, a received ACK sets it to
+  //! the time of the ACK instead.
+  uint64_t oldestTxTimeNs;
 
-  //! Note: For a future ACK window >1, sentLocInDatagram doesn't always apply
-  //! to the front-of-queue datagram. Instead, we need to track the queue
-  //! position the datagram being sent as well (relative to the front-of-queue).
-  //! e.g. uint8_t datagramBeingSent
+  //! Queue position (relative to the front-of-queue) of the datagram the next
+  //! payload will be taken from.
+  uint8_t datagramBeingSent;
+
+  //! How many bytes of the datagram being sent have been sent out
+  size_t sentLocInDatagram;
 
   //! How many bytes of the front-of-queue datagram has been acked
   size_t ackedLocInDatagram;
 
+  //! The number of datagram payload bytes copied into pendingTxPacket, which
+  //! remains 0 with CHPP_LINK_TX_VECTORED.
+  size_t numPayloadCopyBytes;
+
+  //! Whether a NACK has been received, so the outstanding packets need to be
+  //! sent again.
+  bool resendPending;
+
+  //! Whether the outstanding packets have been resent since the last ACK,
+  //! which is used to ignore repeated NACKs for the same sequence number.
+  bool resentSinceLastAck;
+
   //! Whether the link layer is still processing pendingTxPacket
   bool linkBusy;
 };
@@ -392,6 +447,12 @@ struct PendingTxPacket {
 
   //! Payload of outgoing packet to the Link Layer
   uint8_t payload[CHPP_LINK_TX_MTU_BYTES];
+
+  //! With CHPP_LINK_TX_VECTORED, the packet payload within the datagram being
+  //! sent, if any. In this case, it is not copied into payload, which then
+  //! only holds the preamble and header followed by the footer (and length
+  //! excludes the packet payload).
+  const uint8_t *datagramPayload;
 };
 
 struct ChppDatagram {
@@ -441,6 +502,7 @@ struct ChppTransportState {
   enum ChppResetState resetState;  // Maintains state of a reset
   uint16_t resetCount;             // (Unsuccessful) reset attempts
   uint64_t resetTimeNs;            // Time of last reset
+  uint8_t txWindowSize;            // Max outstanding Tx packets (1 to 127)
 
   struct ChppConditionVariable
       resetCondVar;  // Condvar specifically to wait for resetState
@@ -20,6 +20,7 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "chpp/mutex.h"
 #include "chpp/notifier.h"
@@ -33,9 +34,21 @@ extern "C" {
 
 #define CHPP_PLATFORM_TRANSPORT_TIMEOUT_MS 1000
 
+//! Maximum number of packets in flight on a link with simulated latency.
+#define CHPP_PLATFORM_LINK_MAX_DELAYED_PACKETS 16
+
 // Forward declaration
 struct ChppTransportState;
 
+//! A packet in flight on a link with simulated latency.
+struct ChppPlatformLinkDelayedPacket {
+  //! Time at which the packet is delivered to the remote endpoint.
+  uint64_t deliveryTimeNs;
+
+  uint8_t buf[CHPP_PLATFORM_LINK_TX_MTU_BYTES];
+  size_t len;
+};
+
 struct ChppPlatformLinkParameters {
   //! Indicates that the link to the remote endpoint has been established.
   //! This simulates the establishment of the physical link, so
@@ -63,6 +76,19 @@ struct ChppPlatformLinkParameters {
 
   //! The string name of the CHPP work thread.
   const char *workThreadName;
+
+  //! Simulated one-way latency of the link. If non-zero, a sent packet is
+  //! delivered to the remote endpoint after this delay, and the link accepts
+  //! the next packet in the meantime (up to
+  //! CHPP_PLATFORM_LINK_MAX_DELAYED_PACKETS in flight).
+  uint64_t latencyNs;
+
+  //! Ring buffer of packets in flight when latencyNs is non-zero, protected by
+  //! mutex.
+  struct ChppPlatformLinkDelayedPacket
+      delayedPackets[CHPP_PLATFORM_LINK_MAX_DELAYED_PACKETS];
+  size_t delayedPacketsFront;
+  size_t delayedPacketsCount;
 };
 
 #ifdef __cplusplus
@@ -23,8 +23,34 @@
 extern "C" {
 #endif
 
+/**
+ * Statistics of one size class of the slab allocator, which backs chppMalloc()
+ * when CHPP_LINUX_MEMORY_SLAB is defined.
+ */
+struct ChppMemorySlabStats {
+  //! Size of each block in bytes.
+  size_t blockSize;
+
+  //! Number of blocks in the slab.
+  size_t numBlocks;
+
+  //! Number of blocks currently allocated.
+  size_t numUsed;
+
+  //! Highest number of blocks allocated at once.
+  size_t peakUsed;
+
+  //! Number of allocations that found the slab full and fell back to malloc().
+  size_t numFailures;
+
+  //! Number of bytes requested by the currently allocated blocks.
+  size_t usedBytes;
+};
+
 /**
  * Clears the amount of memory allocation tracked by chppGetTotalAllocBytes().
+ * With the slab allocator, also resets the peak and failure counts of each
+ * size class.
  */
 void chppClearTotalAllocBytes(void);
 
@@ -33,6 +59,19 @@ void chppClearTotalAllocBytes(void);
  */
 size_t chppGetTotalAllocBytes(void);
 
+/**
+ * Retrieves the statistics of each size class of the slab allocator, from the
+ * smallest block size up.
+ *
+ * @param stats Output array, with room for maxClasses entries.
+ * @param maxClasses Maximum number of size classes to retrieve.
+ *
+ * @return The number of size classes of the slab allocator, or 0 if
+ * CHPP_LINUX_MEMORY_SLAB is not defined.
+ */
+size_t chppGetMemorySlabStats(struct ChppMemorySlabStats *stats,
+                              size_t maxClasses);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,30 +23,106 @@
 
 #include "chpp/log.h"
 #include "chpp/macros.h"
+#include "chpp/time.h"
 #include "chpp/transport.h"
 
 // The set of signals to use for the linkSendThread.
 #define SIGNAL_EXIT UINT32_C(1 << 0)
 #define SIGNAL_DATA UINT32_C(1 << 1)
 
+/**
+ * Delivers the packets in flight whose simulated latency has elapsed to the
+ * remote endpoint, in the order they were sent. Must be called with
+ * params->mutex held.
+ *
+ * @return Time in nanoseconds until the next packet in flight is due, or
+ * CHPP_TIME_MAX if there is none.
+ */
+static uint64_t deliverDelayedPackets(
+    struct ChppPlatformLinkParameters *params) {
+  uint64_t now = chppGetCurrentTimeNs();
+
+  while (params->delayedPacketsCount > 0) {
+    struct ChppPlatformLinkDelayedPacket *packet =
+        &params->delayedPackets[params->delayedPacketsFront];
+    if (packet->deliveryTimeNs > now) {
+      return packet->deliveryTimeNs - now;
+    }
+
+    if (params->remoteTransportContext != NULL && params->linkEstablished) {
+      chppRxDataCb(params->remoteTransportContext, packet->buf, packet->len);
+    }
+    params->delayedPacketsFront =
+        (params->delayedPacketsFront + 1) %
+        CHPP_PLATFORM_LINK_MAX_DELAYED_PACKETS;
+    params->delayedPacketsCount--;
+  }
+
+  return CHPP_TIME_MAX;
+}
+
+/**
+ * Puts the packet in params->buf in flight on a link with simulated latency,
+ * if there is room. Must be called with params->mutex held.
+ *
+ * @return True if the packet was put in flight.
+ */
+static bool delayPacket(struct ChppPlatformLinkParameters *params) {
+  if (params->delayedPacketsCount == CHPP_PLATFORM_LINK_MAX_DELAYED_PACKETS) {
+    return false;
+  }
+
+  size_t end =
+      (params->delayedPacketsFront + params->delayedPacketsCount) %
+      CHPP_PLATFORM_LINK_MAX_DELAYED_PACKETS;
+  struct ChppPlatformLinkDelayedPacket *packet = &params->delayedPackets[end];
+  packet->deliveryTimeNs = chppGetCurrentTimeNs() + params->latencyNs;
+  memcpy(packet->buf, params->buf, params->bufLen);
+  packet->len = params->bufLen;
+  params->delayedPacketsCount++;
+
+  return true;
+}
+
 /**
  * This thread is used to "send" TX data to the remote endpoint. The remote
  * endpoint is defined by the ChppTransportState pointer, so a loopback link
  * with a single CHPP instance can be supported.
+ *
+ * If params->latencyNs is non-zero, the data is delivered to the remote
+ * endpoint after that delay, while the transport layer is told right away that
+ * the link can accept more data.
  */
 static void *linkSendThread(void *arg) {
   struct ChppPlatformLinkParameters *params =
       (struct ChppPlatformLinkParameters *)arg;
+  uint64_t timeoutNs = CHPP_TIME_MAX;
   while (true) {
-    uint32_t signal = chppNotifierTimedWait(&params->notifier, CHPP_TIME_MAX);
+    uint32_t signal = chppNotifierTimedWait(&params->notifier, timeoutNs);
 
     if (signal & SIGNAL_EXIT) {
       break;
     }
-    if (signal & SIGNAL_DATA) {
-      enum ChppLinkErrorCode error;
 
-      chppMutexLock(&params->mutex);
+    chppMutexLock(&params->mutex);
+    deliverDelayedPackets(params);
+
+    if (params->bufLen == 0) {
+      // Woken up to deliver delayed packets only
+
+    } else if (params->latencyNs != 0) {
+      if (!params->linkEstablished) {
+        CHPP_LOGE("No (fake) link");
+        params->bufLen = 0;
+        chppLinkSendDoneCb(params, CHPP_LINK_ERROR_NO_LINK);
+
+      } else if (delayPacket(params)) {
+        params->bufLen = 0;
+        chppLinkSendDoneCb(params, CHPP_LINK_ERROR_NONE_SENT);
+      }  // else {too many packets in flight, retried once one is delivered}
+
+    } else {
+      enum ChppLinkErrorCode error;
 
       if (params->remoteTransportContext == NULL) {
         CHPP_LOGW("remoteTransportContext is NULL");
@@ -67,9 +143,10 @@ static void *linkSendThread(void *arg) {
 
       params->bufLen = 0;
       chppLinkSendDoneCb(params, error);
-
-      chppMutexUnlock(&params->mutex);
     }
+
+    timeoutNs = deliverDelayedPackets(params);
+    chppMutexUnlock(&params->mutex);
   }
 
   return NULL;
@@ -77,6 +154,8 @@ static void *linkSendThread(void *arg) {
 
 void chppPlatformLinkInit(struct ChppPlatformLinkParameters *params) {
   params->bufLen = 0;
+  params->delayedPacketsFront = 0;
+  params->delayedPacketsCount = 0;
   chppMutexInit(&params->mutex);
   chppNotifierInit(&params->notifier);
   pthread_create(&params->linkSendThread, NULL /* attr */, linkSendThread,
@@ -96,14 +175,26 @@ void chppPlatformLinkDeinit(struct ChppPlatformLinkParameters *params) {
 
 enum ChppLinkErrorCode chppPlatformLinkSend(
     struct ChppPlatformLinkParameters *params, uint8_t *buf, size_t len) {
+  struct ChppLinkTxSegment segment = {.buf = buf, .len = len};
+  return chppPlatformLinkSendVectored(params, &segment, 1);
+}
+
+enum ChppLinkErrorCode chppPlatformLinkSendVectored(
+    struct ChppPlatformLinkParameters *params,
+    const struct ChppLinkTxSegment *segments, size_t numSegments) {
   bool success = false;
   chppMutexLock(&params->mutex);
   if (params->bufLen != 0) {
     CHPP_LOGE("Failed to send data - link layer busy");
   } else {
+    // Gather the segments straight into the (fake) link buffer, as writev()
+    // would into the kernel buffer of a physical link
     success = true;
-    memcpy(params->buf, buf, len);
-    params->bufLen = len;
+    for (size_t i = 0; i < numSegments; i++) {
+      CHPP_ASSERT(params->bufLen + segments[i].len <= sizeof(params->buf));
+      memcpy(&params->buf[params->bufLen], segments[i].buf, segments[i].len);
+      params->bufLen += segments[i].len;
+    }
   }
   chppMutexUnlock(&params->mutex);
 
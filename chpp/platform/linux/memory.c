@@ -19,6 +19,11 @@
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdlib.h>
+#ifdef CHPP_LINUX_MEMORY_SLAB
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#endif  // CHPP_LINUX_MEMORY_SLAB
 
 #ifdef CHPP_LINUX_MEMORY_DEBUG
 #include "chpp/log.h"
@@ -29,10 +34,259 @@
 //! A header used to track the amount of allocated memory.
 struct ChppAllocHeader {
   size_t bytes;
+#ifdef CHPP_LINUX_MEMORY_SLAB
+  //! Index of the slab the block belongs to, or CHPP_LINUX_MEMORY_SLAB_CLASSES
+  //! if it was allocated through malloc().
+  size_t sizeClass;
+#endif  // CHPP_LINUX_MEMORY_SLAB
 };
 
 static atomic_size_t gTotalAllocBytes = 0;
 
+#ifdef CHPP_LINUX_MEMORY_SLAB
+
+/**
+ * Number of blocks in the slab of each size class. Allocations that find their
+ * slab full, or that are larger than the largest size class, fall back to
+ * malloc().
+ */
+#ifndef CHPP_LINUX_MEMORY_SLAB_BLOCKS
+#define CHPP_LINUX_MEMORY_SLAB_BLOCKS 64
+#endif
+
+//! Block sizes of the slab size classes in bytes, excluding the header.
+static const size_t kSlabBlockSizes[] = {16, 32, 64, 128, 256, 512, 1024, 2048};
+
+#define CHPP_LINUX_MEMORY_SLAB_CLASSES ARRAY_SIZE(kSlabBlockSizes)
+
+//! A free block of a slab, linked into the slab's free list.
+struct ChppSlabFreeBlock {
+  struct ChppAllocHeader header;
+  struct ChppSlabFreeBlock *next;
+};
+
+//! The blocks of a size class and their statistics, protected by mutex.
+struct ChppSlab {
+  pthread_mutex_t mutex;
+  uint8_t *storage;
+  struct ChppSlabFreeBlock *freeList;
+  size_t numUsed;
+  size_t peakUsed;
+  size_t numFailures;
+  size_t usedBytes;
+};
+
+static struct ChppSlab gSlabs[CHPP_LINUX_MEMORY_SLAB_CLASSES];
+static pthread_once_t gSlabsInitOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Allocates the storage of every slab and links its blocks into the free list.
+ * A slab whose storage cannot be allocated stays empty, so that its
+ * allocations fall back to malloc().
+ */
+static void chppSlabInit(void) {
+  for (size_t i = 0; i < CHPP_LINUX_MEMORY_SLAB_CLASSES; i++) {
+    struct ChppSlab *slab = &gSlabs[i];
+    size_t stride = sizeof(struct ChppAllocHeader) + kSlabBlockSizes[i];
+
+    pthread_mutex_init(&slab->mutex, NULL);
+    slab->storage = malloc(stride * CHPP_LINUX_MEMORY_SLAB_BLOCKS);
+    slab->freeList = NULL;
+
+    if (slab->storage != NULL) {
+      for (size_t j = CHPP_LINUX_MEMORY_SLAB_BLOCKS; j > 0; j--) {
+        void *blockStorage = &slab->storage[(j - 1) * stride];
+        struct ChppSlabFreeBlock *block =
+            (struct ChppSlabFreeBlock *)blockStorage;
+        block->header.sizeClass = i;
+        block->next = slab->freeList;
+        slab->freeList = block;
+      }
+    }
+  }
+}
+
+/**
+ * @return The index of the smallest size class that fits size bytes, or
+ * CHPP_LINUX_MEMORY_SLAB_CLASSES if there is none.
+ */
+static size_t chppSlabSizeClass(size_t size) {
+  size_t i = 0;
+  while (i < CHPP_LINUX_MEMORY_SLAB_CLASSES && kSlabBlockSizes[i] < size) {
+    i++;
+  }
+  return i;
+}
+
+/**
+ * Allocates a block of size bytes from the slab of the matching size class.
+ *
+ * @return The header of the block, or NULL if size exceeds the largest size
+ * class or its slab is full.
+ */
+static struct ChppAllocHeader *chppSlabAlloc(size_t size) {
+  struct ChppAllocHeader *header = NULL;
+  size_t sizeClass = chppSlabSizeClass(size);
+
+  if (sizeClass < CHPP_LINUX_MEMORY_SLAB_CLASSES) {
+    struct ChppSlab *slab = &gSlabs[sizeClass];
+
+    pthread_once(&gSlabsInitOnce, chppSlabInit);
+    pthread_mutex_lock(&slab->mutex);
+    struct ChppSlabFreeBlock *block = slab->freeList;
+    if (block == NULL) {
+      slab->numFailures++;
+    } else {
+      slab->freeList = block->next;
+      slab->numUsed++;
+      slab->peakUsed = MAX(slab->peakUsed, slab->numUsed);
+      slab->usedBytes += size;
+      header = &block->header;
+    }
+    pthread_mutex_unlock(&slab->mutex);
+  }
+
+  return header;
+}
+
+/**
+ * Returns a block allocated by chppSlabAlloc() to its slab.
+ */
+static void chppSlabFree(struct ChppAllocHeader *header) {
+  struct ChppSlab *slab = &gSlabs[header->sizeClass];
+  struct ChppSlabFreeBlock *block = (struct ChppSlabFreeBlock *)header;
+
+  pthread_mutex_lock(&slab->mutex);
+  slab->usedBytes -= header->bytes;
+  slab->numUsed--;
+  block->next = slab->freeList;
+  slab->freeList = block;
+  pthread_mutex_unlock(&slab->mutex);
+}
+
+void *chppMalloc(const size_t size) {
+  void *ptr = NULL;
+  if (size != 0) {
+    struct ChppAllocHeader *header = chppSlabAlloc(size);
+    if (header == NULL) {
+      header = malloc(sizeof(struct ChppAllocHeader) + size);
+      if (header != NULL) {
+        header->sizeClass = CHPP_LINUX_MEMORY_SLAB_CLASSES;
+      }
+    }
+
+    if (header != NULL) {
+      header->bytes = size;
+      ptr = header + 1;
+
+      gTotalAllocBytes += size;
+    }
+  }
+
+#ifdef CHPP_LINUX_MEMORY_DEBUG
+  CHPP_LOGI("%s: size %zu total (after malloc) %zu", __func__, size,
+            gTotalAllocBytes);
+#endif  // CHPP_LINUX_MEMORY_DEBUG
+
+  return ptr;
+}
+
+void chppFree(void *ptr) {
+  if (ptr != NULL) {
+    struct ChppAllocHeader *header = (struct ChppAllocHeader *)ptr;
+    header--;
+    size_t size = header->bytes;
+    gTotalAllocBytes -= size;
+
+#ifdef CHPP_LINUX_MEMORY_DEBUG
+    CHPP_LOGI("%s: size %zu total (after free) %zu", __func__, size,
+              gTotalAllocBytes);
+#endif  // CHPP_LINUX_MEMORY_DEBUG
+
+    if (header->sizeClass < CHPP_LINUX_MEMORY_SLAB_CLASSES) {
+      chppSlabFree(header);
+    } else {
+      free(header);
+    }
+  }
+}
+
+void *chppRealloc(void *oldPtr, const size_t newSize, const size_t oldSize) {
+  UNUSED_VAR(oldSize);
+  void *ptr = NULL;
+  struct ChppAllocHeader *oldHeader = (struct ChppAllocHeader *)oldPtr;
+  oldHeader--;
+  size_t sizeClass = oldHeader->sizeClass;
+  size_t oldBytes = oldHeader->bytes;
+
+  if (newSize == 0) {
+    // Not supported, as with realloc()
+
+  } else if (sizeClass < CHPP_LINUX_MEMORY_SLAB_CLASSES &&
+             newSize <= kSlabBlockSizes[sizeClass]) {
+    // Still fits in its block
+    struct ChppSlab *slab = &gSlabs[sizeClass];
+    pthread_mutex_lock(&slab->mutex);
+    slab->usedBytes = slab->usedBytes - oldBytes + newSize;
+    pthread_mutex_unlock(&slab->mutex);
+
+    oldHeader->bytes = newSize;
+    ptr = oldPtr;
+    gTotalAllocBytes += newSize;
+    gTotalAllocBytes -= oldBytes;
+
+  } else if (sizeClass == CHPP_LINUX_MEMORY_SLAB_CLASSES &&
+             chppSlabSizeClass(newSize) == CHPP_LINUX_MEMORY_SLAB_CLASSES) {
+    // Too large for the slabs before and after
+    struct ChppAllocHeader *newHeader =
+        realloc(oldHeader, sizeof(struct ChppAllocHeader) + newSize);
+    if (newHeader != NULL) {
+      newHeader->bytes = newSize;
+      ptr = newHeader + 1;
+      gTotalAllocBytes += newSize;
+      gTotalAllocBytes -= oldBytes;
+    }
+
+  } else {
+    // Moves between a slab and malloc(), or between slabs
+    ptr = chppMalloc(newSize);
+    if (ptr != NULL) {
+      memcpy(ptr, oldPtr, MIN(oldBytes, newSize));
+      chppFree(oldPtr);
+    }
+  }
+
+#ifdef CHPP_LINUX_MEMORY_DEBUG
+  CHPP_LOGI("%s: size %zu total (after realloc) %zu", __func__, newSize,
+            gTotalAllocBytes);
+#endif  // CHPP_LINUX_MEMORY_DEBUG
+
+  return ptr;
+}
+
+size_t chppGetMemorySlabStats(struct ChppMemorySlabStats *stats,
+                              size_t maxClasses) {
+  pthread_once(&gSlabsInitOnce, chppSlabInit);
+
+  for (size_t i = 0; i < MIN(maxClasses, CHPP_LINUX_MEMORY_SLAB_CLASSES);
+       i++) {
+    struct ChppSlab *slab = &gSlabs[i];
+    pthread_mutex_lock(&slab->mutex);
+    stats[i].blockSize = kSlabBlockSizes[i];
+    stats[i].numBlocks =
+        (slab->storage == NULL) ? 0 : CHPP_LINUX_MEMORY_SLAB_BLOCKS;
+    stats[i].numUsed = slab->numUsed;
+    stats[i].peakUsed = slab->peakUsed;
+    stats[i].numFailures = slab->numFailures;
+    stats[i].usedBytes = slab->usedBytes;
+    pthread_mutex_unlock(&slab->mutex);
+  }
+
+  return CHPP_LINUX_MEMORY_SLAB_CLASSES;
+}
+
+#else  // CHPP_LINUX_MEMORY_SLAB
+
 void *chppMalloc(const size_t size) {
   void *ptr = NULL;
   if (size != 0) {
@@ -103,8 +357,27 @@ void *chppRealloc(void *oldPtr, const size_t newSize, const size_t oldSize) {
   return ptr;
 }
 
+size_t chppGetMemorySlabStats(struct ChppMemorySlabStats *stats,
+                              size_t maxClasses) {
+  UNUSED_VAR(stats);
+  UNUSED_VAR(maxClasses);
+  return 0;
+}
+
+#endif  // CHPP_LINUX_MEMORY_SLAB
+
 void chppClearTotalAllocBytes() {
   gTotalAllocBytes = 0;
+
+#ifdef CHPP_LINUX_MEMORY_SLAB
+  pthread_once(&gSlabsInitOnce, chppSlabInit);
+  for (size_t i = 0; i < CHPP_LINUX_MEMORY_SLAB_CLASSES; i++) {
+    pthread_mutex_lock(&gSlabs[i].mutex);
+    gSlabs[i].peakUsed = gSlabs[i].numUsed;
+    gSlabs[i].numFailures = 0;
+    pthread_mutex_unlock(&gSlabs[i].mutex);
+  }
+#endif  // CHPP_LINUX_MEMORY_SLAB
 }
 
 size_t chppGetTotalAllocBytes() {
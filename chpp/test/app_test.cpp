@@ -16,9 +16,11 @@
 
 #include <gtest/gtest.h>
 
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <thread>
 
 #include "app_test_base.h"
@@ -26,6 +28,8 @@
 #include "chpp/clients/discovery.h"
 #include "chpp/clients/loopback.h"
 #include "chpp/clients/timesync.h"
+#include "chpp/common/gnss_types.h"
+#include "chpp/common/wifi_types.h"
 #include "chpp/log.h"
 #include "chpp/transport.h"
 
@@ -137,6 +141,90 @@ TEST_F(AppTestBase, FragmentedLoopback) {
   EXPECT_EQ(result.error, CHPP_APP_ERROR_NONE);
 }
 
+TEST_F(AppTestBase, FragmentedReassemblyAllocations) {
+  // Datagram sizes of a WiFi scan event with the maximum number of results and
+  // a GNSS data event with the maximum number of measurements
+  constexpr size_t kTestLens[] = {
+      sizeof(ChppWifiScanEventWithHeader) +
+          UINT8_MAX * sizeof(ChppWifiScanResult),
+      sizeof(ChppGnssDataEventWithHeader) +
+          CHRE_GNSS_MAX_MEASUREMENT * sizeof(ChppGnssMeasurement),
+  };
+  uint8_t buf[MAX(kTestLens[0], kTestLens[1])];
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = (uint8_t)((i % 251) + 64);
+  }
+
+  for (size_t testLen : kTestLens) {
+    ChppRxStatus *rxStatus = &mServiceTransportContext.rxStatus;
+    chppMutexLock(&mServiceTransportContext.mutex);
+    rxStatus->numDatagramAllocs = 0;
+    rxStatus->numDatagramReallocBytes = 0;
+    chppMutexUnlock(&mServiceTransportContext.mutex);
+
+    struct ChppLoopbackTestResult result = chppRunLoopbackTest(
+        &mClientAppContext, buf, testLen - CHPP_LOOPBACK_HEADER_LEN);
+    EXPECT_EQ(result.error, CHPP_APP_ERROR_NONE);
+
+    // Reallocating for every packet would copy O(n^2) bytes for n packets
+    size_t numPackets = (testLen + CHPP_TRANSPORT_TX_MTU_BYTES - 1) /
+                        CHPP_TRANSPORT_TX_MTU_BYTES;
+    size_t perPacketReallocBytes =
+        (numPackets - 1) * numPackets / 2 * CHPP_TRANSPORT_TX_MTU_BYTES;
+
+    chppMutexLock(&mServiceTransportContext.mutex);
+    CHPP_LOGI("Datagram len=%zu (%zu packets): %zu allocs, %zu bytes "
+              "reallocated (per-packet realloc: %zu allocs, %zu bytes)",
+              testLen, numPackets, rxStatus->numDatagramAllocs,
+              rxStatus->numDatagramReallocBytes, numPackets,
+              perPacketReallocBytes);
+    EXPECT_LT(rxStatus->numDatagramAllocs, numPackets);
+    EXPECT_LT(rxStatus->numDatagramReallocBytes, 2 * testLen);
+    chppMutexUnlock(&mServiceTransportContext.mutex);
+  }
+}
+
+TEST_F(AppTestBase, TxCpuPerMegabyte) {
+  constexpr size_t kTestLen = 50000;
+  constexpr size_t kNumIterations = 20;
+  uint8_t buf[kTestLen];
+  for (size_t i = 0; i < kTestLen; i++) {
+    buf[i] = (uint8_t)((i % 251) + 64);
+  }
+
+  chppMutexLock(&mClientTransportContext.mutex);
+  mClientTransportContext.txStatus.numPayloadCopyBytes = 0;
+  chppMutexUnlock(&mClientTransportContext.mutex);
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+  for (size_t i = 0; i < kNumIterations; i++) {
+    struct ChppLoopbackTestResult result =
+        chppRunLoopbackTest(&mClientAppContext, buf, kTestLen);
+    ASSERT_EQ(result.error, CHPP_APP_ERROR_NONE);
+  }
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+
+  // Each loopback test sends the datagram in both directions
+  uint64_t cpuNs = (uint64_t)(end.tv_sec - start.tv_sec) * CHPP_NSEC_PER_SEC +
+                   (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+  size_t txBytes = 2 * kTestLen * kNumIterations;
+  CHPP_LOGI("%" PRIu64 " us of CPU per MB transmitted",
+            cpuNs * 1000 / txBytes);
+
+  // Packet payloads are only copied out of the datagrams without vectored
+  // writes, in which case every request payload is copied at least once
+  chppMutexLock(&mClientTransportContext.mutex);
+#ifdef CHPP_LINK_TX_VECTORED
+  EXPECT_EQ(mClientTransportContext.txStatus.numPayloadCopyBytes, 0);
+#else
+  EXPECT_GE(mClientTransportContext.txStatus.numPayloadCopyBytes,
+            kTestLen * kNumIterations);
+#endif
+  chppMutexUnlock(&mClientTransportContext.mutex);
+}
+
 TEST_F(AppTestBase, Timesync) {
   constexpr uint64_t kMaxRtt = 2 * CHPP_NSEC_PER_MSEC;    // in ms
   constexpr int64_t kMaxOffset = 1 * CHPP_NSEC_PER_MSEC;  // in ms
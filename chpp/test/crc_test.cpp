@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include "chpp/crc.h"
+#include "chpp/log.h"
+#include "chpp/transport.h"
+
+// Each implementation of chppCrc32() that can be selected at build time is
+// compiled into its own namespace, so that all of them are tested regardless
+// of the one that the CHPP library was built with.
+#undef CHPP_CRC32_BYTE_TABLE
+#undef CHPP_CRC32_SLICING_BY_8
+#undef CHPP_CRC32_HW
+
+namespace nibble_table {
+#include "../platform/shared/crc.c"
+}  // namespace nibble_table
+
+#define CHPP_CRC32_BYTE_TABLE
+namespace byte_table {
+#include "../platform/shared/crc.c"
+}  // namespace byte_table
+#undef CHPP_CRC32_BYTE_TABLE
+#undef CHPP_CRC32_USE_BYTE_TABLES
+#undef CHPP_CRC32_NUM_TABLES
+
+#define CHPP_CRC32_SLICING_BY_8
+namespace slicing_by_8 {
+#include "../platform/shared/crc.c"
+}  // namespace slicing_by_8
+#undef CHPP_CRC32_SLICING_BY_8
+#undef CHPP_CRC32_USE_BYTE_TABLES
+#undef CHPP_CRC32_NUM_TABLES
+
+#ifdef __ARM_FEATURE_CRC32
+#define CHPP_CRC32_HW
+namespace hw {
+#include "../platform/shared/crc.c"
+}  // namespace hw
+#undef CHPP_CRC32_HW
+#undef CHPP_CRC32_USE_ARM_HW
+#endif  // __ARM_FEATURE_CRC32
+
+namespace {
+
+typedef uint32_t(CrcFunction)(uint32_t crc, const uint8_t *buf, size_t len);
+
+struct CrcImplementation {
+  const char *name;
+  CrcFunction *function;
+};
+
+const CrcImplementation kImplementations[] = {
+    {"chppCrc32", chppCrc32},
+    {"nibble table", nibble_table::chppCrc32},
+    {"byte table", byte_table::chppCrc32},
+    {"slicing-by-8", slicing_by_8::chppCrc32},
+#ifdef __ARM_FEATURE_CRC32
+    {"ARMv8 CRC32", hw::chppCrc32},
+#endif  // __ARM_FEATURE_CRC32
+};
+
+/**
+ * A bitwise implementation of the reflected IEEE CRC-32, which every
+ * implementation is checked against.
+ */
+uint32_t referenceCrc32(uint32_t crc, const uint8_t *buf, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+    }
+  }
+  return ~crc;
+}
+
+std::vector<uint8_t> makeRandomBuffer(size_t len) {
+  std::vector<uint8_t> buf(len);
+  for (size_t i = 0; i < len; i++) {
+    buf[i] = static_cast<uint8_t>(rand());
+  }
+  return buf;
+}
+
+}  // namespace
+
+/**
+ * The check value of CRC-32 is the CRC of the ASCII string "123456789".
+ */
+TEST(CrcTest, CheckValue) {
+  const uint8_t kCheckInput[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  ASSERT_EQ(referenceCrc32(0, kCheckInput, sizeof(kCheckInput)), 0xCBF43926);
+
+  for (const CrcImplementation &impl : kImplementations) {
+    EXPECT_EQ(impl.function(0, kCheckInput, sizeof(kCheckInput)), 0xCBF43926)
+        << impl.name;
+  }
+}
+
+/**
+ * Every length and start alignment around the 8-byte blocks of the faster
+ * implementations must match the reference.
+ */
+TEST(CrcTest, MatchesReferenceForAllLengthsAndAlignments) {
+  srand(0xc4c);
+  std::vector<uint8_t> buf = makeRandomBuffer(128);
+
+  for (const CrcImplementation &impl : kImplementations) {
+    for (size_t offset = 0; offset < 8; offset++) {
+      for (size_t len = 0; len + offset <= buf.size(); len++) {
+        ASSERT_EQ(impl.function(0, &buf[offset], len),
+                  referenceCrc32(0, &buf[offset], len))
+            << impl.name << " offset " << offset << " len " << len;
+      }
+    }
+  }
+}
+
+/**
+ * Calculating the CRC in pieces, as chppRxChecksumIsOk() does for the header
+ * and payload, must give the same result as a single pass.
+ */
+TEST(CrcTest, DaisyChained) {
+  srand(0xda15);
+  std::vector<uint8_t> buf = makeRandomBuffer(CHPP_TRANSPORT_TX_MTU_BYTES);
+  uint32_t expected = referenceCrc32(0, buf.data(), buf.size());
+
+  for (const CrcImplementation &impl : kImplementations) {
+    for (size_t split : {1, 3, 8, 13, 100}) {
+      uint32_t crc = impl.function(0, buf.data(), split);
+      crc = impl.function(crc, &buf[split], buf.size() - split);
+      EXPECT_EQ(crc, expected) << impl.name << " split " << split;
+    }
+  }
+}
+
+/**
+ * Compares the throughput of the implementations for packets of the maximum
+ * transport payload size.
+ */
+TEST(CrcTest, ThroughputBenchmark) {
+  constexpr size_t kIterations = 2000;
+  srand(0xbe7c);
+  std::vector<uint8_t> buf = makeRandomBuffer(CHPP_TRANSPORT_TX_MTU_BYTES);
+  double totalMb =
+      static_cast<double>(kIterations * buf.size()) / (1024 * 1024);
+
+  for (const CrcImplementation &impl : kImplementations) {
+    // Chain the results so that the calculations aren't optimized out
+    uint32_t crc = 0;
+    uint32_t expectedCrc = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kIterations; i++) {
+      crc = impl.function(crc, buf.data(), buf.size());
+    }
+    auto end = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kIterations; i++) {
+      expectedCrc = referenceCrc32(expectedCrc, buf.data(), buf.size());
+    }
+    EXPECT_EQ(crc, expectedCrc) << impl.name;
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    CHPP_LOGI("CRC-32 of %u byte packets: %s %.1f MB/s",
+              static_cast<unsigned>(buf.size()), impl.name,
+              totalMb / seconds);
+  }
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "chpp/log.h"
+#include "chpp/macros.h"
+#include "chpp/memory.h"
+#include "chpp/platform/utils.h"
+#include "chpp/transport.h"
+
+namespace {
+
+constexpr size_t kMaxSlabClasses = 16;
+
+/**
+ * Picks an allocation size resembling CHPP traffic: mostly small app-layer
+ * requests and responses, some packet-sized buffers and a few large datagrams.
+ */
+size_t randomAllocSize(std::minstd_rand &rng) {
+  uint32_t pick = rng() % 100;
+  if (pick < 70) {
+    return 1 + rng() % 128;
+  } else if (pick < 95) {
+    return 1 + rng() % CHPP_TRANSPORT_TX_MTU_BYTES;
+  } else {
+    return 1 + rng() % (8 * CHPP_TRANSPORT_TX_MTU_BYTES);
+  }
+}
+
+/**
+ * Randomly allocates, reallocates and frees buffers in a set of slots, checking
+ * that the contents of each buffer are preserved.
+ *
+ * @return The number of allocator operations performed.
+ */
+size_t runAllocStress(unsigned int seed, size_t numIterations,
+                      size_t numSlots) {
+  struct Slot {
+    uint8_t *ptr;
+    size_t len;
+    uint8_t fill;
+  };
+  std::vector<Slot> slots(numSlots, Slot{nullptr, 0, 0});
+  std::minstd_rand rng(seed);
+  size_t numOps = 0;
+
+  for (size_t i = 0; i < numIterations; i++) {
+    Slot &slot = slots[rng() % numSlots];
+
+    if (slot.ptr == nullptr) {
+      slot.len = randomAllocSize(rng);
+      slot.ptr = static_cast<uint8_t *>(chppMalloc(slot.len));
+      EXPECT_NE(slot.ptr, nullptr);
+      slot.fill = static_cast<uint8_t>(rng());
+      memset(slot.ptr, slot.fill, slot.len);
+
+    } else {
+      EXPECT_EQ(slot.ptr[0], slot.fill);
+      EXPECT_EQ(slot.ptr[slot.len - 1], slot.fill);
+
+      if (rng() % 4 == 0) {
+        size_t newLen = randomAllocSize(rng);
+        uint8_t *newPtr =
+            static_cast<uint8_t *>(chppRealloc(slot.ptr, newLen, slot.len));
+        if (newPtr != nullptr || newLen == slot.len) {
+          if (newPtr != nullptr) {
+            slot.ptr = newPtr;
+          }
+          EXPECT_EQ(slot.ptr[MIN(slot.len, newLen) - 1], slot.fill);
+          slot.len = newLen;
+          memset(slot.ptr, slot.fill, slot.len);
+        }
+      } else {
+        CHPP_FREE_AND_NULLIFY(slot.ptr);
+      }
+    }
+    numOps++;
+  }
+
+  for (Slot &slot : slots) {
+    CHPP_FREE_AND_NULLIFY(slot.ptr);
+  }
+  return numOps;
+}
+
+}  // namespace
+
+TEST(MemoryTest, ReallocPreservesContents) {
+  chppClearTotalAllocBytes();
+
+  // Grows through every slab size class and beyond
+  size_t len = 1;
+  uint8_t *buf = static_cast<uint8_t *>(chppMalloc(len));
+  ASSERT_NE(buf, nullptr);
+  buf[0] = 0;
+  while (len < 4 * CHPP_TRANSPORT_TX_MTU_BYTES) {
+    size_t newLen = len * 3 / 2 + 1;
+    buf = static_cast<uint8_t *>(chppRealloc(buf, newLen, len));
+    ASSERT_NE(buf, nullptr);
+    for (size_t i = 0; i < len; i++) {
+      ASSERT_EQ(buf[i], static_cast<uint8_t>(i));
+    }
+    for (size_t i = len; i < newLen; i++) {
+      buf[i] = static_cast<uint8_t>(i);
+    }
+    len = newLen;
+    EXPECT_EQ(chppGetTotalAllocBytes(), len);
+  }
+
+  CHPP_FREE_AND_NULLIFY(buf);
+  EXPECT_EQ(chppGetTotalAllocBytes(), 0);
+}
+
+TEST(MemoryTest, SlabStatistics) {
+  struct ChppMemorySlabStats stats[kMaxSlabClasses];
+  size_t numClasses = chppGetMemorySlabStats(stats, kMaxSlabClasses);
+  if (numClasses == 0) {
+    GTEST_SKIP() << "CHPP_LINUX_MEMORY_SLAB is not defined";
+  }
+  ASSERT_LE(numClasses, kMaxSlabClasses);
+  chppClearTotalAllocBytes();
+
+  // Exhaust the smallest size class, so that the last allocation falls back
+  // to malloc()
+  size_t smallestSize = stats[0].blockSize;
+  size_t numUsed = stats[0].numUsed;
+  std::vector<void *> ptrs;
+  for (size_t i = numUsed; i <= stats[0].numBlocks; i++) {
+    ptrs.push_back(chppMalloc(smallestSize));
+    ASSERT_NE(ptrs.back(), nullptr);
+  }
+
+  chppGetMemorySlabStats(stats, kMaxSlabClasses);
+  EXPECT_EQ(stats[0].numUsed, stats[0].numBlocks);
+  EXPECT_EQ(stats[0].peakUsed, stats[0].numBlocks);
+  EXPECT_EQ(stats[0].numFailures, 1);
+
+  for (void *ptr : ptrs) {
+    chppFree(ptr);
+  }
+  chppGetMemorySlabStats(stats, kMaxSlabClasses);
+  EXPECT_EQ(stats[0].numUsed, numUsed);
+  EXPECT_EQ(stats[0].peakUsed, stats[0].numBlocks);
+  EXPECT_EQ(chppGetTotalAllocBytes(), 0);
+}
+
+/**
+ * Allocation-heavy stress test from several threads, reporting the allocator
+ * throughput and the fragmentation of the slabs.
+ */
+TEST(MemoryTest, AllocStress) {
+  constexpr size_t kNumThreads = 4;
+  constexpr size_t kNumIterations = 200000;
+  constexpr size_t kNumSlots = 64;
+  chppClearTotalAllocBytes();
+
+  std::vector<std::thread> threads;
+  std::vector<size_t> numOps(kNumThreads);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([i, &numOps] {
+      numOps[i] = runAllocStress(static_cast<unsigned int>(i + 1),
+                                 kNumIterations, kNumSlots);
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  size_t totalOps = 0;
+  for (size_t ops : numOps) {
+    totalOps += ops;
+  }
+  double seconds = std::chrono::duration<double>(end - start).count();
+  CHPP_LOGI("%zu threads: %.0f alloc ops/sec", kNumThreads,
+            static_cast<double>(totalOps) / seconds);
+  EXPECT_EQ(chppGetTotalAllocBytes(), 0);
+
+  // A single thread's worth of live buffers, to measure internal fragmentation
+  // (the unused part of the allocated blocks)
+  std::minstd_rand rng(1);
+  std::vector<void *> ptrs;
+  for (size_t i = 0; i < kNumSlots; i++) {
+    ptrs.push_back(chppMalloc(randomAllocSize(rng)));
+  }
+
+  struct ChppMemorySlabStats stats[kMaxSlabClasses];
+  size_t numClasses =
+      MIN(chppGetMemorySlabStats(stats, kMaxSlabClasses), kMaxSlabClasses);
+  size_t blockBytes = 0;
+  size_t usedBytes = 0;
+  for (size_t i = 0; i < numClasses; i++) {
+    CHPP_LOGI("Slab %5zu bytes: used %2zu/%zu, peak %zu, failures %zu",
+              stats[i].blockSize, stats[i].numUsed, stats[i].numBlocks,
+              stats[i].peakUsed, stats[i].numFailures);
+    EXPECT_LE(stats[i].peakUsed, stats[i].numBlocks);
+    blockBytes += stats[i].numUsed * stats[i].blockSize;
+    usedBytes += stats[i].usedBytes;
+  }
+  if (blockBytes > 0) {
+    CHPP_LOGI("Slab internal fragmentation: %.1f%%",
+              100.0 * static_cast<double>(blockBytes - usedBytes) /
+                  static_cast<double>(blockBytes));
+  }
+
+  for (void *ptr : ptrs) {
+    chppFree(ptr);
+  }
+  EXPECT_EQ(chppGetTotalAllocBytes(), 0);
+}
@@ -22,6 +22,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <chrono>
 #include <thread>
 
 #include "chpp/app.h"
@@ -94,34 +95,76 @@ class TransportTests : public testing::TestWithParam<int> {
 };
 
 /**
- * Wait for chppTransportDoWork() to finish after it is notified by
- * chppEnqueueTxPacket to run.
+ * Determines whether the work thread has sent out everything it currently can,
+ * i.e. it has no pending signal, the link layer is done with the last packet,
+ * and there is neither an ACK nor a payload that could be sent.
  *
- * TODO: (b/177616847) Improve test robustness / synchronization without adding
- * overhead to CHPP
+ * @param transportContext Transport layer context.
+ *
+ * @return True if the transport layer is idle.
+ */
+bool isTransportIdle(struct ChppTransportState *transportContext) {
+  chppMutexLock(&transportContext->mutex);
+
+  struct ChppTxStatus *txStatus = &transportContext->txStatus;
+  struct ChppTxDatagramQueue *queue = &transportContext->txDatagramQueue;
+  uint8_t numInFlight = static_cast<uint8_t>(
+      txStatus->sentSeq + 1 - transportContext->rxStatus.receivedAckSeq);
+  bool canSendPayload = (txStatus->datagramBeingSent < queue->pending &&
+                         numInFlight < transportContext->txWindowSize);
+  bool isAckPending =
+      (transportContext->rxStatus.expectedSeq != txStatus->sentAckSeq ||
+       CHPP_TRANSPORT_GET_ERROR(txStatus->packetCodeToSend) !=
+           CHPP_TRANSPORT_ERROR_NONE);
+  bool idle = !txStatus->linkBusy && !canSendPayload && !isAckPending &&
+              !(txStatus->hasPacketsToSend && queue->pending == 0);
+
+  chppMutexLock(&transportContext->notifier.mutex);
+  idle = idle && transportContext->notifier.signal == 0;
+  chppMutexUnlock(&transportContext->notifier.mutex);
+
+  chppMutexUnlock(&transportContext->mutex);
+  return idle;
+}
+
+/**
+ * Waits for the work thread to send out the packets it has been notified of
+ * (e.g. the response to a packet that has just been received), and for the
+ * link layer to finish sending them.
+ *
+ * The transport layer needs to be seen idle at two consecutive polls, as the
+ * work thread briefly looks idle between taking a signal and acting on it.
  */
 void WaitForTransport(struct ChppTransportState *transportContext) {
-  // Wait for linkParams.notifier.signal to be triggered and processed
-  volatile uint32_t k = 1;
-  while (transportContext->linkParams.notifier.signal == 0 && k > 0) {
-    k++;
-  }
-  while (transportContext->linkParams.notifier.signal != 0 && k > 0) {
-    k++;
-  }
-  ASSERT_FALSE(k == 0);
-  while (k < UINT16_MAX) {
-    k++;
-  }
-  while (k > 0) {
-    k--;
+  constexpr auto kPollInterval = std::chrono::milliseconds(1);
+  constexpr int kMaxPolls = 1000;
+
+  int numIdlePolls = 0;
+  for (int i = 0; i < kMaxPolls && numIdlePolls < 2; i++) {
+    std::this_thread::sleep_for(kPollInterval);
+    numIdlePolls = isTransportIdle(transportContext) ? numIdlePolls + 1 : 0;
   }
+  ASSERT_EQ(numIdlePolls, 2);
 
   // Should have reset loc and length for next packet / datagram
   EXPECT_EQ(transportContext->rxStatus.locInDatagram, 0);
   EXPECT_EQ(transportContext->rxDatagram.length, 0);
 }
 
+/**
+ * Returns the last packet sent by the transport layer, as gathered into the
+ * (fake) link layer buffer. Unlike pendingTxPacket, this includes the packet
+ * payload when it is sent straight from the datagram with
+ * CHPP_LINK_TX_VECTORED.
+ *
+ * @param transportContext Transport layer context.
+ *
+ * @return The last packet sent to the link layer.
+ */
+uint8_t *getSentPacket(struct ChppTransportState *transportContext) {
+  return transportContext->linkParams.buf;
+}
+
 /**
  * Validates a ChppTestResponse. Since the error field within the
  * ChppAppHeader struct is optional (and not used for common services), this
@@ -298,16 +341,26 @@ void openService(ChppTransportState *transportContext, uint8_t *buf,
   WaitForTransport(transportContext);
 
   // Validate common response fields
-  EXPECT_EQ(validateChppTestResponse(transportContext->pendingTxPacket.payload,
-                                     nextSeq, handle, transactionID),
+  EXPECT_EQ(validateChppTestResponse(getSentPacket(transportContext), nextSeq,
+                                     handle, transactionID),
             CHPP_APP_ERROR_NONE);
 
   // Check response length
   EXPECT_EQ(sizeof(ChppTestResponse), CHPP_PREAMBLE_LEN_BYTES +
                                           sizeof(ChppTransportHeader) +
                                           sizeof(ChppAppHeader));
+  struct ChppTestResponse *response =
+      (ChppTestResponse *)getSentPacket(transportContext);
+  EXPECT_EQ(response->transportHeader.length, sizeof(ChppAppHeader));
+#ifdef CHPP_LINK_TX_VECTORED
+  // The app header is sent straight from the datagram
+  EXPECT_EQ(transportContext->pendingTxPacket.length,
+            CHPP_PREAMBLE_LEN_BYTES + sizeof(ChppTransportHeader) +
+                sizeof(ChppTransportFooter));
+#else
   EXPECT_EQ(transportContext->pendingTxPacket.length,
             sizeof(ChppTestResponse) + sizeof(ChppTransportFooter));
+#endif
 }
 
 /**
@@ -351,8 +404,8 @@ void sendCommandToService(ChppTransportState *transportContext, uint8_t *buf,
   WaitForTransport(transportContext);
 
   // Validate common response fields
-  EXPECT_EQ(validateChppTestResponse(transportContext->pendingTxPacket.payload,
-                                     nextSeq, handle, transactionID),
+  EXPECT_EQ(validateChppTestResponse(getSentPacket(transportContext), nextSeq,
+                                     handle, transactionID),
             CHPP_APP_ERROR_NONE);
 }
 
@@ -862,7 +915,7 @@ TEST_F(TransportTests, WwanOpen) {
 
   // Validate capabilities
   uint32_t *capabilities =
-      (uint32_t *)&mTransportContext.pendingTxPacket.payload[responseLoc];
+      (uint32_t *)&getSentPacket(&mTransportContext)[responseLoc];
   responseLoc += sizeof(uint32_t);
 
   // Cleanup
@@ -905,7 +958,7 @@ TEST_F(TransportTests, WifiOpen) {
 
   // Validate capabilities
   uint32_t *capabilities =
-      (uint32_t *)&mTransportContext.pendingTxPacket.payload[responseLoc];
+      (uint32_t *)&getSentPacket(&mTransportContext)[responseLoc];
   responseLoc += sizeof(uint32_t);
 
   uint32_t capabilitySet = CHRE_WIFI_CAPABILITIES_SCAN_MONITORING |
@@ -950,7 +1003,7 @@ TEST_F(TransportTests, GnssOpen) {
 
   // Validate capabilities
   uint32_t *capabilities =
-      (uint32_t *)&mTransportContext.pendingTxPacket.payload[responseLoc];
+      (uint32_t *)&getSentPacket(&mTransportContext)[responseLoc];
   responseLoc += sizeof(uint32_t);
 
   uint32_t capabilitySet =
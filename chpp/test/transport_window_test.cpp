@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app_test_base.h"
+#include "chpp/app.h"
+#include "chpp/clients/loopback.h"
+#include "chpp/log.h"
+#include "chpp/macros.h"
+#include "chpp/transport.h"
+
+/*
+ * Tests of the CHPP transport layer with an ACK window > 1, measuring loopback
+ * throughput over the Linux link layer with simulated latency.
+ */
+namespace chpp {
+namespace {
+
+// Fragmented into 16 packets of CHPP_TRANSPORT_TX_MTU_BYTES each way, which
+// must complete within the 1s loopback test timeout even with a window of 1
+constexpr size_t kTestLen =
+    16 * CHPP_TRANSPORT_TX_MTU_BYTES - CHPP_LOOPBACK_HEADER_LEN;
+
+class TransportWindowTest : public AppTestBase {
+ protected:
+  void SetUp() override {
+    AppTestBase::SetUp();
+    for (size_t i = 0; i < kTestLen; i++) {
+      mBuf[i] = (uint8_t)((i % 251) + 64);
+    }
+  }
+
+  void configure(uint8_t windowSize, uint64_t latencyNs) {
+    for (ChppTransportState *context :
+         {&mClientTransportContext, &mServiceTransportContext}) {
+      chppMutexLock(&context->mutex);
+      context->txWindowSize = windowSize;
+      chppMutexUnlock(&context->mutex);
+
+      chppMutexLock(&context->linkParams.mutex);
+      context->linkParams.latencyNs = latencyNs;
+      chppMutexUnlock(&context->linkParams.mutex);
+    }
+  }
+
+  //! Runs a loopback test and returns the number of bytes carried per second
+  //! over the link (in both directions), or 0 on failure.
+  uint64_t runLoopback() {
+    struct ChppLoopbackTestResult result =
+        chppRunLoopbackTest(&mClientAppContext, mBuf, kTestLen);
+    EXPECT_EQ(result.error, CHPP_APP_ERROR_NONE);
+    EXPECT_EQ(result.responseLen, result.requestLen);
+    EXPECT_EQ(result.byteErrors, 0);
+    if (result.error != CHPP_APP_ERROR_NONE || result.rttNs == 0) {
+      return 0;
+    }
+    return 2 * result.requestLen * CHPP_NSEC_PER_SEC / result.rttNs;
+  }
+
+  uint8_t mBuf[kTestLen];
+};
+
+TEST_F(TransportWindowTest, FragmentedLoopbackWithWindow) {
+  for (uint8_t windowSize : {2, 4, 16}) {
+    configure(windowSize, 0 /* latencyNs */);
+    EXPECT_GT(runLoopback(), 0);
+  }
+}
+
+TEST_F(TransportWindowTest, FragmentedLoopbackWithWindowAndLatency) {
+  configure(8, 2 * CHPP_NSEC_PER_MSEC);
+  EXPECT_GT(runLoopback(), 0);
+
+  // Back to stop-and-wait
+  configure(1, 2 * CHPP_NSEC_PER_MSEC);
+  EXPECT_GT(runLoopback(), 0);
+}
+
+TEST_F(TransportWindowTest, ThroughputVsWindowAndLatency) {
+  constexpr uint8_t kWindowSizes[] = {1, 2, 4, 8};
+  constexpr uint64_t kLatenciesNs[] = {0, 1 * CHPP_NSEC_PER_MSEC,
+                                       5 * CHPP_NSEC_PER_MSEC};
+  uint64_t bytesPerSec[ARRAY_SIZE(kLatenciesNs)][ARRAY_SIZE(kWindowSizes)];
+
+  for (size_t i = 0; i < ARRAY_SIZE(kLatenciesNs); i++) {
+    for (size_t j = 0; j < ARRAY_SIZE(kWindowSizes); j++) {
+      configure(kWindowSizes[j], kLatenciesNs[i]);
+      bytesPerSec[i][j] = runLoopback();
+    }
+  }
+
+  for (size_t i = 0; i < ARRAY_SIZE(kLatenciesNs); i++) {
+    CHPP_LOGI("Latency %" PRIu64 " us: window 1/2/4/8 = %" PRIu64 " / %" PRIu64
+              " / %" PRIu64 " / %" PRIu64 " bytes/s",
+              kLatenciesNs[i] / CHPP_NSEC_PER_USEC, bytesPerSec[i][0],
+              bytesPerSec[i][1], bytesPerSec[i][2], bytesPerSec[i][3]);
+  }
+
+  // With latency, stop-and-wait pays a round trip per packet
+  EXPECT_GT(bytesPerSec[2][3], 2 * bytesPerSec[2][0]);
+}
+
+}  // namespace
+}  // namespace chpp
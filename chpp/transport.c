@@ -43,6 +43,8 @@ static size_t chppConsumePreamble(struct ChppTransportState *context,
                                   const uint8_t *buf, size_t len);
 static size_t chppConsumeHeader(struct ChppTransportState *context,
                                 const uint8_t *buf, size_t len);
+static bool chppReserveRxDatagram(struct ChppTransportState *context,
+                                  size_t length);
 static size_t chppConsumePayload(struct ChppTransportState *context,
                                  const uint8_t *buf, size_t len);
 static size_t chppConsumeFooter(struct ChppTransportState *context,
@@ -75,6 +77,8 @@ static void chppAddPayload(struct ChppTransportState *context);
 static void chppAddFooter(struct PendingTxPacket *packet);
 size_t chppDequeueTxDatagram(struct ChppTransportState *context);
 static void chppClearTxDatagramQueue(struct ChppTransportState *context);
+static bool chppCanSendNewPayload(const struct ChppTransportState *context);
+static bool chppIsAckPending(const struct ChppTransportState *context);
 static void chppTransportDoWork(struct ChppTransportState *context);
 static void chppAppendToPendingTxPacket(struct PendingTxPacket *packet,
                                         const uint8_t *buf, size_t len);
@@ -202,25 +206,13 @@ static size_t chppConsumeHeader(struct ChppTransportState *context,
 
     } else {
       // Payload bearing packet
-      uint8_t *tempPayload;
-
-      if (context->rxDatagram.length == 0) {
-        // Packet is a new datagram
-        tempPayload = chppMalloc(context->rxHeader.length);
-      } else {
-        // Packet is a continuation of a fragmented datagram
-        tempPayload =
-            chppRealloc(context->rxDatagram.payload,
-                        context->rxDatagram.length + context->rxHeader.length,
-                        context->rxDatagram.length);
-      }
-
-      if (tempPayload == NULL) {
+      if (!chppReserveRxDatagram(
+              context,
+              context->rxDatagram.length + context->rxHeader.length)) {
         CHPP_LOG_OOM();
         chppEnqueueTxPacket(context, CHPP_TRANSPORT_ERROR_OOM);
         chppSetRxState(context, CHPP_STATE_PREAMBLE);
       } else {
-        context->rxDatagram.payload = tempPayload;
         context->rxDatagram.length += context->rxHeader.length;
         chppSetRxState(context, CHPP_STATE_PAYLOAD);
       }
@@ -230,6 +222,54 @@ static size_t chppConsumeHeader(struct ChppTransportState *context,
   return bytesToCopy;
 }
 
+/**
+ * Ensures that the Rx datagram payload can hold the given number of bytes.
+ *
+ * If more packets of the datagram are expected, the allocation is at least
+ * doubled, so that a datagram of n packets is reallocated O(log n) times
+ * rather than once per packet. Only a final packet that doesn't fit grows the
+ * allocation to the exact length; otherwise the completed datagram is handed
+ * to the app layer with its spare capacity, as shrinking it could copy it
+ * again. The allocation never exceeds twice the length.
+ *
+ * @param context Maintains status for each transport layer instance.
+ * @param length Required length of the Rx datagram payload in bytes.
+ *
+ * @return True if successful, false if out of memory.
+ */
+static bool chppReserveRxDatagram(struct ChppTransportState *context,
+                                  size_t length) {
+  size_t oldCapacity = context->rxStatus.datagramCapacity;
+  if (length <= oldCapacity) {
+    return true;
+  }
+
+  size_t capacity = length;
+  if (context->rxHeader.flags & CHPP_TRANSPORT_FLAG_UNFINISHED_DATAGRAM) {
+    capacity = MAX(length, 2 * oldCapacity);
+  }
+
+  uint8_t *tempPayload;
+  if (oldCapacity == 0) {
+    // Packet is a new datagram
+    tempPayload = chppMalloc(capacity);
+  } else {
+    // Packet is a continuation of a fragmented datagram
+    tempPayload =
+        chppRealloc(context->rxDatagram.payload, capacity, oldCapacity);
+    context->rxStatus.numDatagramReallocBytes += context->rxDatagram.length;
+  }
+
+  if (tempPayload == NULL) {
+    return false;
+  }
+
+  context->rxDatagram.payload = tempPayload;
+  context->rxStatus.datagramCapacity = capacity;
+  context->rxStatus.numDatagramAllocs++;
+  return true;
+}
+
 /**
  * Called by chppRxDataCb to copy the payload, the length of which is determined
  * by the header, from the incoming data stream.
@@ -401,19 +441,9 @@ static void chppAbortRxPacket(struct ChppTransportState *context) {
     if (context->rxDatagram.length == 0) {
       // Discarding this packet == discarding entire datagram
       CHPP_FREE_AND_NULLIFY(context->rxDatagram.payload);
+      context->rxStatus.datagramCapacity = 0;
 
-    } else {
-      // Discarding this packet == discarding part of datagram
-      uint8_t *tempPayload =
-          chppRealloc(context->rxDatagram.payload, context->rxDatagram.length,
-                      context->rxDatagram.length + undoLen);
-
-      if (tempPayload == NULL) {
-        CHPP_LOG_OOM();
-      } else {
-        context->rxDatagram.payload = tempPayload;
-      }
-    }
+    }  // else {Discarding part of datagram. Its allocation is kept for reuse}
   }
 
   chppSetRxState(context, CHPP_STATE_PREAMBLE);
@@ -587,8 +617,8 @@ static void chppProcessRxPacket(struct ChppTransportState *context) {
   if (context->txDatagramQueue.pending > 0 ||
       errorCode == CHPP_TRANSPORT_ERROR_ORDER) {
     // There are packets to send out (could be new or retx)
-    // Note: For a future ACK window > 1, makes more sense to cap the NACKs
-    // to one instead of flooding with out of order NACK errors.
+    // Note: With an ACK window > 1, consecutive out of order packets each
+    // trigger a NACK, but the remote endpoint only acts on the first one.
     chppEnqueueTxPacket(context, CHPP_ATTR_AND_ERROR_TO_PACKET_CODE(
                                      CHPP_TRANSPORT_ATTR_NONE, errorCode));
   }
@@ -660,6 +690,7 @@ static void chppProcessRxPayload(struct ChppTransportState *context) {
  */
 static void chppClearRxDatagram(struct ChppTransportState *context) {
   context->rxStatus.locInDatagram = 0;
+  context->rxStatus.datagramCapacity = 0;
   context->rxDatagram.length = 0;
   context->rxDatagram.payload = NULL;
 }
@@ -724,58 +755,96 @@ static enum ChppTransportErrorCode chppRxHeaderCheck(
 }
 
 /**
- * Registers a received ACK. If an outgoing datagram is fully ACKed, it is
- * popped from the Tx queue.
+ * Registers a received (cumulative) ACK. Every outgoing packet before the
+ * received ackSeq is considered ACKed, and fully ACKed datagrams are popped
+ * from the Tx queue. A received NACK (i.e. an ACK with an error code) marks
+ * the remaining outstanding packets for retransmission.
  *
  * @param context Maintains status for each transport layer instance.
  */
 static void chppRegisterRxAck(struct ChppTransportState *context) {
   uint8_t rxAckSeq = context->rxHeader.ackSeq;
+  uint8_t numAcked = (uint8_t)(rxAckSeq - context->rxStatus.receivedAckSeq);
+  uint8_t numOutstanding = (uint8_t)(context->txStatus.nextNewSeq -
+                                     context->rxStatus.receivedAckSeq);
+  uint8_t numInFlight = (uint8_t)(context->txStatus.sentSeq + 1 -
+                                  context->rxStatus.receivedAckSeq);
+
+  if (numAcked == 0) {
+    // Nothing was ACKed
+
+  } else if (numOutstanding == 0) {
+    // Nothing has been sent since the last ACK, so the remote endpoint is
+    // simply telling us which sequence number it expects next
+    CHPP_LOGD("ACK with nothing outstanding: last=%" PRIu8 " rx=%" PRIu8,
+              context->rxStatus.receivedAckSeq, rxAckSeq);
+    context->rxStatus.receivedAckSeq = rxAckSeq;
+    context->txStatus.sentSeq = (uint8_t)(rxAckSeq - 1);
+    context->txStatus.nextNewSeq = rxAckSeq;
+
+  } else if (numAcked > numOutstanding) {
+    CHPP_LOGE("Out of order ACK: last=%" PRIu8 " rx=%" PRIu8
+              " outstanding=%" PRIu8,
+              context->rxStatus.receivedAckSeq, rxAckSeq, numOutstanding);
 
-  if (context->rxStatus.receivedAckSeq != rxAckSeq) {
-    // A previously sent packet was actually ACKed
-    // Note: For a future ACK window >1, we should loop by # of ACKed packets
-    if ((uint8_t)(context->rxStatus.receivedAckSeq + 1) != rxAckSeq) {
-      CHPP_LOGE("Out of order ACK: last=%" PRIu8 " rx=%" PRIu8,
-                context->rxStatus.receivedAckSeq, rxAckSeq);
-    } else {
-      CHPP_LOGD(
-          "ACK received (last registered=%" PRIu8 ", received=%" PRIu8
-          "). Prior queue depth=%" PRIu8 ", front datagram=%" PRIu8
-          " at loc=%" PRIuSIZE " of len=%" PRIuSIZE,
-          context->rxStatus.receivedAckSeq, rxAckSeq,
-          context->txDatagramQueue.pending, context->txDatagramQueue.front,
-          context->txStatus.ackedLocInDatagram,
-          context->txDatagramQueue.datagram[context->txDatagramQueue.front]
-              .length);
-
-      context->rxStatus.receivedAckSeq = rxAckSeq;
-      if (context->txStatus.txAttempts > 1) {
-        CHPP_LOGW("Seq %" PRIu8 " ACK'd after %" PRIuSIZE " reTX",
-                  context->rxHeader.seq, context->txStatus.txAttempts - 1);
-      }
-      context->txStatus.txAttempts = 0;
+  } else {
+    CHPP_LOGD("ACK received (last registered=%" PRIu8 ", received=%" PRIu8
+              "). Prior queue depth=%" PRIu8 ", front datagram=%" PRIu8
+              " at loc=%" PRIuSIZE " of len=%" PRIuSIZE,
+              context->rxStatus.receivedAckSeq, rxAckSeq,
+              context->txDatagramQueue.pending, context->txDatagramQueue.front,
+              context->txStatus.ackedLocInDatagram,
+              context->txDatagramQueue.datagram[context->txDatagramQueue.front]
+                  .length);
 
-      // Process and if necessary pop from Tx datagram queue
+    context->rxStatus.receivedAckSeq = rxAckSeq;
+    if (context->txStatus.txAttempts > 1) {
+      CHPP_LOGW("Seq %" PRIu8 " ACK'd after %" PRIuSIZE " reTX",
+                context->rxHeader.seq, context->txStatus.txAttempts - 1);
+    }
+    // The next outstanding packet, if any, has already been sent once
+    context->txStatus.txAttempts = (numAcked < numOutstanding) ? 1 : 0;
+    context->txStatus.oldestTxTimeNs = chppGetCurrentTimeNs();
+    context->txStatus.resentSinceLastAck = false;
+
+    // Process and if necessary pop from Tx datagram queue. All but the last
+    // packet of a datagram carry CHPP_TRANSPORT_TX_MTU_BYTES of it.
+    for (uint8_t i = 0; i < numAcked && context->txDatagramQueue.pending > 0;
+         i++) {
       context->txStatus.ackedLocInDatagram += CHPP_TRANSPORT_TX_MTU_BYTES;
       if (context->txStatus.ackedLocInDatagram >=
           context->txDatagramQueue.datagram[context->txDatagramQueue.front]
               .length) {
         // We are done with datagram
-
         context->txStatus.ackedLocInDatagram = 0;
-        context->txStatus.sentLocInDatagram = 0;
-
-        // Note: For a future ACK window >1, we need to update the queue
-        // position of the datagram being sent as well (relative to the
-        // front-of-queue). e.g. context->txStatus.datagramBeingSent--;
+        if (context->txStatus.datagramBeingSent > 0) {
+          context->txStatus.datagramBeingSent--;
+        }
 
         if (chppDequeueTxDatagram(context) == 0) {
           context->txStatus.hasPacketsToSend = false;
         }
       }
     }
-  }  // else {nothing was ACKed}
+
+    if (numAcked > numInFlight) {
+      // We were retransmitting packets that the remote endpoint already had
+      // (e.g. the ACKs were delayed). Continue after the ACKed ones.
+      context->txStatus.sentSeq = (uint8_t)(rxAckSeq - 1);
+      context->txStatus.datagramBeingSent = 0;
+      context->txStatus.sentLocInDatagram =
+          context->txStatus.ackedLocInDatagram;
+    }
+  }
+
+  if (CHPP_TRANSPORT_GET_ERROR(context->rxHeader.packetCode) !=
+          CHPP_TRANSPORT_ERROR_NONE &&
+      context->txStatus.nextNewSeq != context->rxStatus.receivedAckSeq &&
+      !context->txStatus.resentSinceLastAck) {
+    // Explicit NACK. Further NACKs for the same ackSeq are ignored until the
+    // retransmission has had a chance to arrive.
+    context->txStatus.resendPending = true;
+  }
 }
 
 /**
@@ -847,7 +916,8 @@ static struct ChppTransportHeader *chppAddHeader(
 }
 
 /**
- * Adds the packet payload to pendingTxPacket.
+ * Adds the packet payload to pendingTxPacket, taking the next unsent part of
+ * the datagram being sent.
  *
  * @param context Maintains status for each transport layer instance.
  */
@@ -855,10 +925,14 @@ static void chppAddPayload(struct ChppTransportState *context) {
   struct ChppTransportHeader *txHeader =
       (struct ChppTransportHeader *)&context->pendingTxPacket
           .payload[CHPP_PREAMBLE_LEN_BYTES];
+  struct ChppDatagram *datagram =
+      &context->txDatagramQueue
+           .datagram[(context->txDatagramQueue.front +
+                      context->txStatus.datagramBeingSent) %
+                     CHPP_TX_DATAGRAM_QUEUE_LEN];
 
   size_t remainingBytes =
-      context->txDatagramQueue.datagram[context->txDatagramQueue.front].length -
-      context->txStatus.ackedLocInDatagram;
+      datagram->length - context->txStatus.sentLocInDatagram;
 
   CHPP_LOGD("Adding payload to seq=%" PRIu8 ", remainingBytes=%" PRIuSIZE
             " of pending datagrams=%" PRIu8,
@@ -874,16 +948,26 @@ static void chppAddPayload(struct ChppTransportState *context) {
     txHeader->length = (uint16_t)remainingBytes;
   }
 
+#ifdef CHPP_LINK_TX_VECTORED
+  // Reference payload, to be sent straight from the datagram
+  context->pendingTxPacket.datagramPayload =
+      datagram->payload + context->txStatus.sentLocInDatagram;
+#else
   // Copy payload
   chppAppendToPendingTxPacket(
       &context->pendingTxPacket,
-      context->txDatagramQueue.datagram[context->txDatagramQueue.front]
-              .payload +
-          context->txStatus.ackedLocInDatagram,
+      datagram->payload + context->txStatus.sentLocInDatagram,
       txHeader->length);
+  context->txStatus.numPayloadCopyBytes += txHeader->length;
+#endif
 
-  context->txStatus.sentLocInDatagram =
-      context->txStatus.ackedLocInDatagram + txHeader->length;
+  context->txStatus.sentLocInDatagram += txHeader->length;
+  if (context->txStatus.sentLocInDatagram >= datagram->length) {
+    // Continue with the next datagram, which may be sent before this one is
+    // ACKed if the window allows
+    context->txStatus.sentLocInDatagram = 0;
+    context->txStatus.datagramBeingSent++;
+  }
 }
 
 /**
@@ -896,6 +980,15 @@ static void chppAddFooter(struct PendingTxPacket *packet) {
   struct ChppTransportFooter footer;
   footer.checksum = chppCrc32(0, &packet->payload[CHPP_PREAMBLE_LEN_BYTES],
                               packet->length - CHPP_PREAMBLE_LEN_BYTES);
+#ifdef CHPP_LINK_TX_VECTORED
+  if (packet->datagramPayload != NULL) {
+    const struct ChppTransportHeader *txHeader =
+        (const struct ChppTransportHeader *)&packet
+            ->payload[CHPP_PREAMBLE_LEN_BYTES];
+    footer.checksum =
+        chppCrc32(footer.checksum, packet->datagramPayload, txHeader->length);
+  }
+#endif
 
   CHPP_LOGD("Adding transport footer. Checksum=0x%" PRIx32 ", len: %" PRIuSIZE
             " -> %" PRIuSIZE,
@@ -950,16 +1043,53 @@ static void chppClearTxDatagramQueue(struct ChppTransportState *context) {
   context->txStatus.hasPacketsToSend = false;
 }
 
+/**
+ * Determines whether the next unsent part of the pending Tx datagrams can be
+ * sent out, i.e. whether there is one and the transmit window has room for it.
+ *
+ * @param context Maintains status for each transport layer instance.
+ *
+ * @return True if a new payload-bearing packet can be sent.
+ */
+static bool chppCanSendNewPayload(const struct ChppTransportState *context) {
+  uint8_t numInFlight = (uint8_t)(context->txStatus.sentSeq + 1 -
+                                  context->rxStatus.receivedAckSeq);
+
+  return (context->txStatus.datagramBeingSent <
+              context->txDatagramQueue.pending &&
+          numInFlight < context->txWindowSize);
+}
+
+/**
+ * Determines whether the remote endpoint needs to be sent an ACK or NACK, i.e.
+ * whether a payload-bearing packet has been received since the last sent ACK
+ * or an error is to be reported.
+ *
+ * @param context Maintains status for each transport layer instance.
+ *
+ * @return True if an ACK or NACK needs to be sent.
+ */
+static bool chppIsAckPending(const struct ChppTransportState *context) {
+  return (context->rxStatus.expectedSeq != context->txStatus.sentAckSeq ||
+          CHPP_TRANSPORT_GET_ERROR(context->txStatus.packetCodeToSend) !=
+              CHPP_TRANSPORT_ERROR_NONE);
+}
+
 /**
  * Sends out a pending outgoing packet based on a notification from
  * chppEnqueueTxPacket().
  *
  * A payload may or may not be included be according the following:
- * No payload: If Tx datagram queue is empty OR we are waiting on a pending ACK.
- * New payload: If there is one or more pending Tx datagrams and we are not
- * waiting on a pending ACK.
- * Repeat payload: If we haven't received an ACK yet for our previous payload,
- * i.e. we have registered an explicit or implicit NACK.
+ * No payload: If Tx datagram queue is empty OR the transmit window is full.
+ * New payload: If there is one or more pending Tx datagrams with unsent data
+ * and the transmit window has room for another packet.
+ * Repeat payload: If we haven't received an ACK yet for our outstanding
+ * payloads and we have registered an explicit NACK or an ACK timeout, in which
+ * case transmission goes back to the oldest outstanding packet. With a window
+ * size of 1, any packet that doesn't ACK the outstanding payload is also
+ * considered an (implicit) NACK.
+ *
+ * With a full window and no ACK to send, no packet is sent.
  *
  * @param context Maintains status for each transport layer instance.
  */
@@ -968,57 +1098,87 @@ static void chppTransportDoWork(struct ChppTransportState *context) {
   struct ChppTransportHeader *txHeader;
   struct ChppAppHeader *timeoutResponse = NULL;
 
-  // Note: For a future ACK window >1, there needs to be a loop outside the lock
+  // Only one packet can be handed to the link layer at a time. Further packets
+  // within the window are sent after chppLinkSendDoneCb() signals the work
+  // thread again.
   chppMutexLock(&context->mutex);
 
   if (context->txStatus.hasPacketsToSend && !context->txStatus.linkBusy) {
-    // There are pending outgoing packets and the link isn't busy
-    havePacketForLinkLayer = true;
-    context->txStatus.linkBusy = true;
+    uint8_t numOutstanding = (uint8_t)(context->txStatus.nextNewSeq -
+                                       context->rxStatus.receivedAckSeq);
+    if (numOutstanding > 0 &&
+        (context->txWindowSize == 1 || context->txStatus.resendPending ||
+         chppGetCurrentTimeNs() - context->txStatus.oldestTxTimeNs >=
+             CHPP_TRANSPORT_TX_TIMEOUT_NS)) {
+      // Go back to the last ACKed location
+      context->txStatus.sentSeq =
+          (uint8_t)(context->rxStatus.receivedAckSeq - 1);
+      context->txStatus.datagramBeingSent = 0;
+      context->txStatus.sentLocInDatagram =
+          context->txStatus.ackedLocInDatagram;
+      context->txStatus.resendPending = false;
+      context->txStatus.resentSinceLastAck = true;
+    }
 
-    context->pendingTxPacket.length = 0;
-    memset(&context->pendingTxPacket.payload, 0, CHPP_LINK_TX_MTU_BYTES);
+    bool sendPayload = chppCanSendNewPayload(context);
+    if (sendPayload || context->txDatagramQueue.pending == 0 ||
+        chppIsAckPending(context)) {
+      havePacketForLinkLayer = true;
+      context->txStatus.linkBusy = true;
 
-    // Add preamble
-    context->pendingTxPacket.length +=
-        chppAddPreamble(&context->pendingTxPacket.payload[0]);
+      context->pendingTxPacket.length = 0;
+      memset(&context->pendingTxPacket.payload, 0, CHPP_LINK_TX_MTU_BYTES);
 
-    // Add header
-    txHeader = chppAddHeader(context);
+      // Add preamble
+      context->pendingTxPacket.length +=
+          chppAddPreamble(&context->pendingTxPacket.payload[0]);
 
-    // If applicable, add payload
-    if ((context->txDatagramQueue.pending > 0)) {
-      // Note: For a future ACK window >1, we need to rewrite this payload
-      // adding code to base the next packet on the sent location within the
-      // last sent datagram, except for the case of a NACK (explicit or
-      // timeout). For a NACK, we would need to base the next packet off the
-      // last ACKed location.
+      // Add header
+      txHeader = chppAddHeader(context);
 
-      txHeader->seq = context->rxStatus.receivedAckSeq;
-      context->txStatus.sentSeq = txHeader->seq;
+      // If applicable, add payload
+      if (sendPayload) {
+        txHeader->seq = (uint8_t)(context->txStatus.sentSeq + 1);
+        bool isOldestOutstanding =
+            (txHeader->seq == context->rxStatus.receivedAckSeq);
 
-      if (context->txStatus.txAttempts > CHPP_TRANSPORT_MAX_RETX &&
-          context->resetState != CHPP_RESET_STATE_RESETTING) {
-        CHPP_LOGE("Resetting after %d retries", CHPP_TRANSPORT_MAX_RETX);
-        havePacketForLinkLayer = false;
+        if (isOldestOutstanding &&
+            context->txStatus.txAttempts > CHPP_TRANSPORT_MAX_RETX &&
+            context->resetState != CHPP_RESET_STATE_RESETTING) {
+          CHPP_LOGE("Resetting after %d retries", CHPP_TRANSPORT_MAX_RETX);
+          havePacketForLinkLayer = false;
 
-        chppMutexUnlock(&context->mutex);
-        chppReset(context, CHPP_TRANSPORT_ATTR_RESET,
-                  CHPP_TRANSPORT_ERROR_MAX_RETRIES);
-        chppMutexLock(&context->mutex);
+          chppMutexUnlock(&context->mutex);
+          chppReset(context, CHPP_TRANSPORT_ATTR_RESET,
+                    CHPP_TRANSPORT_ERROR_MAX_RETRIES);
+          chppMutexLock(&context->mutex);
 
-      } else {
-        chppAddPayload(context);
-        context->txStatus.txAttempts++;
+        } else {
+          context->txStatus.sentSeq = txHeader->seq;
+          chppAddPayload(context);
+          if (isOldestOutstanding) {
+            context->txStatus.txAttempts++;
+            context->txStatus.oldestTxTimeNs = chppGetCurrentTimeNs();
+          }
+          if (txHeader->seq == context->txStatus.nextNewSeq) {
+            context->txStatus.nextNewSeq++;
+          }
+        }
+
+      } else if (context->txDatagramQueue.pending == 0) {
+        // No payload
+        context->txStatus.hasPacketsToSend = false;
       }
 
+      chppAddFooter(&context->pendingTxPacket);
+
     } else {
-      // No payload
-      context->txStatus.hasPacketsToSend = false;
+      CHPP_LOGD("DoWork nothing new to send. pending=%" PRIu8
+                ", Rx ACK=%" PRIu8 ", Tx seq=%" PRIu8,
+                context->txDatagramQueue.pending,
+                context->rxStatus.receivedAckSeq, context->txStatus.sentSeq);
     }
 
-    chppAddFooter(&context->pendingTxPacket);
-
   } else {
     CHPP_LOGW(
         "DoWork nothing to send. hasPackets=%d, linkBusy=%d, pending=%" PRIu8
@@ -1163,6 +1323,8 @@ static bool chppEnqueueTxDatagram(struct ChppTransportState *context,
 /**
  * Sends the pending outgoing packet (context->pendingTxPacket) over to the link
  * layer using chppPlatformLinkSend() and updates the last Tx packet time.
+ * With CHPP_LINK_TX_VECTORED, a packet whose payload is referenced within the
+ * datagram being sent is sent using chppPlatformLinkSendVectored() instead.
  *
  * @param context Maintains status for each transport layer instance.
  *
@@ -1170,9 +1332,36 @@ static bool chppEnqueueTxDatagram(struct ChppTransportState *context,
  */
 enum ChppLinkErrorCode chppSendPendingPacket(
     struct ChppTransportState *context) {
-  enum ChppLinkErrorCode error = chppPlatformLinkSend(
-      &context->linkParams, context->pendingTxPacket.payload,
-      context->pendingTxPacket.length);
+  enum ChppLinkErrorCode error;
+
+#ifdef CHPP_LINK_TX_VECTORED
+  struct PendingTxPacket *packet = &context->pendingTxPacket;
+  if (packet->datagramPayload != NULL) {
+    const size_t headerEnd =
+        CHPP_PREAMBLE_LEN_BYTES + sizeof(struct ChppTransportHeader);
+    const struct ChppTransportHeader *txHeader =
+        (const struct ChppTransportHeader *)&packet
+            ->payload[CHPP_PREAMBLE_LEN_BYTES];
+    struct ChppLinkTxSegment segments[] = {
+        {.buf = packet->payload, .len = headerEnd},
+        {.buf = packet->datagramPayload, .len = txHeader->length},
+        {.buf = &packet->payload[headerEnd],
+         .len = packet->length - headerEnd},
+    };
+
+    error = chppPlatformLinkSendVectored(&context->linkParams, segments,
+                                         ARRAY_SIZE(segments));
+    packet->datagramPayload = NULL;
+
+  } else {
+    error = chppPlatformLinkSend(&context->linkParams, packet->payload,
+                                 packet->length);
+  }
+#else
+  error = chppPlatformLinkSend(&context->linkParams,
+                               context->pendingTxPacket.payload,
+                               context->pendingTxPacket.length);
+#endif
 
   context->txStatus.lastTxTimeNs = chppGetCurrentTimeNs();
 
@@ -1355,6 +1544,7 @@ void chppTransportInit(struct ChppTransportState *transportContext,
 #endif
 
   transportContext->appContext = appContext;
+  transportContext->txWindowSize = CHPP_TRANSPORT_TX_WINDOW_SIZE;
   transportContext->initialized = true;
 
   chppPlatformLinkInit(&transportContext->linkParams);
@@ -1523,9 +1713,9 @@ uint64_t chppTransportGetTimeUntilNextDoWorkNs(
       context->resetState == CHPP_RESET_STATE_RESETTING) {
     nextDoWorkTime =
         MIN(nextDoWorkTime, CHPP_TRANSPORT_TX_TIMEOUT_NS +
-                                ((context->txStatus.lastTxTimeNs == 0)
+                                ((context->txStatus.oldestTxTimeNs == 0)
                                      ? currentTime
-                                     : context->txStatus.lastTxTimeNs));
+                                     : context->txStatus.oldestTxTimeNs));
   }
 
   CHPP_LOGD("NextDoWork=%" PRIu64 " currentTime=%" PRIu64 " delta=%" PRId64,
@@ -1580,10 +1770,10 @@ bool chppWorkThreadHandleSignal(struct ChppTransportState *context,
     if (signals == 0) {
       // Triggered by timeout
 
-      if (chppGetCurrentTimeNs() - context->txStatus.lastTxTimeNs >=
+      if (chppGetCurrentTimeNs() - context->txStatus.oldestTxTimeNs >=
           CHPP_TRANSPORT_TX_TIMEOUT_NS) {
         CHPP_LOGE("ACK timeout. Tx t=%" PRIu64,
-                  context->txStatus.lastTxTimeNs / CHPP_NSEC_PER_MSEC);
+                  context->txStatus.oldestTxTimeNs / CHPP_NSEC_PER_MSEC);
         chppTransportDoWork(context);
       }
 
@@ -1633,6 +1823,13 @@ void chppLinkSendDoneCb(struct ChppPlatformLinkParameters *params,
 
   context->txStatus.linkBusy = false;
 
+  // With an ACK window > 1, there may be more packets that can be sent right
+  // away. Also, any ACKs that were due while the link was busy are sent now.
+  if (context->txStatus.hasPacketsToSend &&
+      (chppCanSendNewPayload(context) || chppIsAckPending(context))) {
+    chppNotifierSignal(&context->notifier, CHPP_TRANSPORT_SIGNAL_EVENT);
+  }
+
   // No need to free anything as pendingTxPacket.payload is static. Likewise, we
   // keep pendingTxPacket.length to assist testing.
 
@@ -1742,9 +1939,8 @@ void chppTransportSendReset(struct ChppTransportState *context,
   // Rx MTU size
   config->rxMtu = CHPP_PLATFORM_LINK_RX_MTU_BYTES;
 
-  // Max Rx window size
-  // Note: current implementation does not support a window size >1
-  config->windowSize = 1;
+  // Max Tx window size
+  config->windowSize = context->txWindowSize;
 
   // Advertised transport layer (ACK) timeout
   config->timeoutInMs = CHPP_PLATFORM_TRANSPORT_TIMEOUT_MS;
@@ -719,6 +719,45 @@ struct chreSensorFlushCompleteEvent {
     const void *cookie;
 };
 
+/**
+ * A read-only view of the recent samples of a continuous sensor, as populated
+ * by chreSensorGetHistory().
+ *
+ * The samples are given in up to two runs of consecutive readings, in the
+ * format of the readings of the sensor's data event, e.g.
+ * struct chreSensorThreeAxisSampleData for an accelerometer. The timestamp of
+ * the first reading of the first run is baseTimestamp plus its
+ * timestampDelta, and the timestampDelta of each following reading, including
+ * the first reading of the second run, is relative to the reading before it.
+ *
+ * @note Part of the optional sensor history extension, which is not tied to a
+ * released version of the CHRE API. See chreSensorConfigureHistory().
+ */
+struct chreSensorHistory {
+    /**
+     * The timestamp the timestampDelta of the first reading is relative to, in
+     * nanoseconds; in the same time base as chreGetTime().
+     */
+    uint64_t baseTimestamp;
+
+    /**
+     * The readings of each run. Owned by the CHRE framework, and must not be
+     * modified.
+     */
+    const void *readings[2];
+
+    /**
+     * The number of readings in each run. The second run is empty unless the
+     * samples wrap around the end of the framework's buffer.
+     */
+    uint16_t readingCount[2];
+
+    /**
+     * Reserved for future use. Set to 0.
+     */
+    uint8_t reserved[4];
+};
+
 /**
  * Find the default sensor for a given sensor type.
  *
@@ -1104,6 +1143,61 @@ bool chreSensorGetThreeAxisBias(uint32_t sensorHandle,
  */
 bool chreSensorFlushAsync(uint32_t sensorHandle, const void *cookie);
 
+/**
+ * Requests the CHRE framework to retain the recent samples of a continuous
+ * sensor, so that they can be read through chreSensorGetHistory() instead of
+ * each nanoapp keeping its own copy. The nanoapp must be registered to the
+ * sensor through chreSensorConfigure. The framework retains the longest
+ * duration requested by the nanoapps registered to the sensor, and stops
+ * retaining samples for a nanoapp when its registration is removed.
+ *
+ * The history is held in a memory budget shared by all sensors, so it may
+ * cover less than the requested duration, e.g. if the sampling interval of the
+ * sensor is later shortened.
+ *
+ * Support for sensor history is an optional extension for CHRE
+ * implementations, which is not tied to a released version of the CHRE API.
+ * Nanoapps must not infer support from chreGetApiVersion(), and must instead
+ * treat a false return value as the history being unavailable; this is also
+ * the result on CHRE implementations that predate this method.
+ *
+ * @param sensorHandle  The handle to the sensor, as obtained from
+ *     chreSensorFindDefault().
+ * @param duration  The duration of recent samples to retain, in nanoseconds,
+ *     or 0 to cancel the nanoapp's request.
+ *
+ * @return true if the request was accepted, false if the sensor is not a
+ *     continuous sensor the nanoapp is registered to, or if the requested
+ *     duration doesn't fit in the memory budget, or if sensor history is not
+ *     supported.
+ */
+bool chreSensorConfigureHistory(uint32_t sensorHandle, uint64_t duration);
+
+/**
+ * Gets the retained samples of a sensor with a timestamp in a given range,
+ * without copying them. The samples are only valid until the nanoapp returns
+ * from the entry point it calls this method from, e.g. nanoappHandleEvent.
+ *
+ * The samples of a data event are added to the history before the event is
+ * delivered to nanoapps.
+ *
+ * Like chreSensorConfigureHistory(), this method is part of the optional
+ * sensor history extension, and returns false if it is not supported.
+ *
+ * @param sensorHandle  The handle to the sensor, as obtained from
+ *     chreSensorFindDefault().
+ * @param startTime  The timestamp of the oldest sample to get, in nanoseconds;
+ *     in the same time base as chreGetTime().
+ * @param endTime  The timestamp of the newest sample to get.
+ * @param history  A non-NULL pointer populated with the samples. Its reading
+ *     counts are 0 if no retained sample is in the range.
+ *
+ * @return true if the history of the sensor is retained, as requested through
+ *     chreSensorConfigureHistory().
+ */
+bool chreSensorGetHistory(uint32_t sensorHandle, uint64_t startTime,
+                          uint64_t endTime, struct chreSensorHistory *history);
+
 #ifdef __cplusplus
 }
 #endif
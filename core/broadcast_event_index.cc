@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/core/broadcast_event_index.h"
+
+#include "chre/platform/assert.h"
+
+namespace chre {
+
+bool BroadcastEventIndex::setSubscription(Nanoapp *nanoapp, uint16_t eventType,
+                                          uint16_t groupIdMask) {
+  CHRE_ASSERT(nanoapp != nullptr);
+  bool success = true;
+
+  auto entry = mSubscriptions.find(eventType);
+  if (entry == mSubscriptions.end()) {
+    if (groupIdMask != 0) {
+      entry = mSubscriptions.insertOrAssign(eventType, SubscriberList());
+      if (entry == mSubscriptions.end()) {
+        success = false;
+      } else if (!entry->value.emplace_back(nanoapp, groupIdMask)) {
+        mSubscriptions.erase(entry);
+        success = false;
+      }
+    }
+  } else {
+    SubscriberList &subscribers = entry->value;
+    size_t i = 0;
+    while (i < subscribers.size() && subscribers[i].nanoapp != nanoapp) {
+      i++;
+    }
+
+    if (i < subscribers.size()) {
+      if (groupIdMask != 0) {
+        subscribers[i].groupIdMask = groupIdMask;
+      } else {
+        subscribers.erase(i);
+        if (subscribers.empty()) {
+          mSubscriptions.erase(entry);
+        }
+      }
+    } else if (groupIdMask != 0) {
+      success = subscribers.emplace_back(nanoapp, groupIdMask);
+    }
+  }
+
+  return success;
+}
+
+void BroadcastEventIndex::removeNanoapp(const Nanoapp *nanoapp) {
+  auto entry = mSubscriptions.begin();
+  while (entry != mSubscriptions.end()) {
+    SubscriberList &subscribers = entry->value;
+    for (size_t i = 0; i < subscribers.size(); i++) {
+      if (subscribers[i].nanoapp == nanoapp) {
+        subscribers.erase(i);
+        break;
+      }
+    }
+
+    if (subscribers.empty()) {
+      // Erasing shifts the following entries down into this position
+      mSubscriptions.erase(entry);
+    } else {
+      ++entry;
+    }
+  }
+}
+
+const BroadcastEventIndex::SubscriberList *BroadcastEventIndex::getSubscribers(
+    uint16_t eventType) const {
+  auto entry = mSubscriptions.find(eventType);
+  return (entry != mSubscriptions.end()) ? &entry->value : nullptr;
+}
+
+}  // namespace chre
@@ -9,6 +9,7 @@ COMMON_CFLAGS += -Icore/include
 
 # Common Source Files ##########################################################
 
+COMMON_SRCS += core/broadcast_event_index.cc
 COMMON_SRCS += core/debug_dump_manager.cc
 COMMON_SRCS += core/event.cc
 COMMON_SRCS += core/event_loop.cc
@@ -34,7 +35,10 @@ endif
 # Optional sensors support.
 ifeq ($(CHRE_SENSORS_SUPPORT_ENABLED), true)
 COMMON_SRCS += core/sensor.cc
+COMMON_SRCS += core/sensor_data_decimator.cc
+COMMON_SRCS += core/sensor_history.cc
 COMMON_SRCS += core/sensor_request.cc
+COMMON_SRCS += core/sensor_request_aggregate.cc
 COMMON_SRCS += core/sensor_request_manager.cc
 COMMON_SRCS += core/sensor_request_multiplexer.cc
 COMMON_SRCS += core/sensor_type.cc
@@ -55,7 +59,10 @@ endif
 # GoogleTest Source Files ######################################################
 
 GOOGLETEST_SRCS += core/tests/audio_util_test.cc
+GOOGLETEST_SRCS += core/tests/broadcast_event_index_test.cc
 GOOGLETEST_SRCS += core/tests/memory_manager_test.cc
 GOOGLETEST_SRCS += core/tests/request_multiplexer_test.cc
+GOOGLETEST_SRCS += core/tests/sensor_data_decimator_test.cc
+GOOGLETEST_SRCS += core/tests/sensor_history_test.cc
 GOOGLETEST_SRCS += core/tests/sensor_request_test.cc
 GOOGLETEST_SRCS += core/tests/wifi_scan_request_test.cc
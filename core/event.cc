@@ -28,4 +28,10 @@ uint16_t Event::getTimeMillis() {
   return static_cast<uint16_t>(now.getMilliseconds());
 }
 
+#ifdef CHRE_EVENT_LATENCY_STATS_ENABLED
+uint64_t Event::getTimeNanos() {
+  return SystemTime::getMonotonicTime().toRawNanoseconds();
+}
+#endif  // CHRE_EVENT_LATENCY_STATS_ENABLED
+
 }  // namespace chre
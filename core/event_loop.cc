@@ -110,7 +110,9 @@ void EventLoop::run() {
     // this context these events are distributed to smaller event queues
     // associated with each Nanoapp that should receive the event. Once the
     // event is delivered to all interested Nanoapps, its free callback is
-    // invoked.
+    // invoked. Both stages work in batches of up to kInboundEventBatchSize and
+    // kNanoappEventBatchSize events, and the PowerControlManager is notified
+    // once per batch rather than once per event.
     if (!havePendingEvents || !mEvents.empty()) {
       if (mEvents.size() > mMaxEventPoolUsage) {
         mMaxEventPoolUsage = mEvents.size();
@@ -122,6 +124,12 @@ void EventLoop::run() {
       // removed.
       mPowerControlManager.preEventLoopProcess(mEvents.size() + 1);
       distributeEvent(event);
+
+      // Only take events that are already queued for the rest of the batch, so
+      // nanoapps with pending events aren't held up waiting for more.
+      for (size_t i = 1; i < kInboundEventBatchSize && !mEvents.empty(); i++) {
+        distributeEvent(mEvents.pop());
+      }
     }
 
     havePendingEvents = deliverEvents();
@@ -182,6 +190,7 @@ bool EventLoop::startNanoapp(UniquePtr<Nanoapp> &nanoapp) {
       // mNanoapps.back() - use newNanoapp to reference it
     }
 
+    newNanoapp->setBroadcastEventIndex(&mBroadcastEventIndex);
     mCurrentApp = newNanoapp;
     success = newNanoapp->start();
     mCurrentApp = nullptr;
@@ -289,6 +298,28 @@ bool EventLoop::postSystemEvent(uint16_t eventType, void *eventData,
   return false;
 }
 
+bool EventLoop::postLowPrioritySystemEvent(
+    uint16_t eventType, void *eventData, SystemEventCallbackFunction *callback,
+    void *extraData) {
+  bool eventPosted = false;
+
+  if (mRunning &&
+      mEventPool.getFreeBlockCount() > kMinReservedHighPriorityEventCount) {
+    Event *event =
+        mEventPool.allocate(eventType, eventData, callback, extraData);
+    if (event == nullptr) {
+      LOGE("Failed to allocate system event 0x%" PRIx16, eventType);
+    } else if (!mEvents.push(event)) {
+      LOGE("Failed to post system event 0x%" PRIx16, eventType);
+      mEventPool.deallocate(event);
+    } else {
+      eventPosted = true;
+    }
+  }
+
+  return eventPosted;
+}
+
 bool EventLoop::postLowPriorityEventOrFree(
     uint16_t eventType, void *eventData,
     chreEventCompleteFunction *freeCallback, uint32_t senderInstanceId,
@@ -366,6 +397,16 @@ void EventLoop::logStateToBuffer(DebugDumpWrapper &debugDump) const {
   debugDump.print("  Nanoapp host wakeup tracking: cycled %" PRIu64
                   "mins ago, bucketDuration=%" PRIu64 "mins\n",
                   timeSinceMins, durationMins);
+#ifdef CHRE_EVENT_LATENCY_STATS_ENABLED
+  debugDump.print("  Nanoapp event latency buckets (us): <");
+  for (size_t i = 0; i < LatencyHistogram::kNumBuckets - 1; i++) {
+    debugDump.print(" %" PRIu32,
+                    LatencyHistogram::getBucketUpperBoundMicros(i));
+  }
+  debugDump.print(" inf\n");
+#endif  // CHRE_EVENT_LATENCY_STATS_ENABLED
+
+  mTimerPool.logStateToBuffer(debugDump);
 
   debugDump.print("\nNanoapps:\n");
   for (const UniquePtr<Nanoapp> &app : mNanoapps) {
@@ -396,9 +437,11 @@ bool EventLoop::deliverEvents() {
   // Do one loop of round-robin. We might want to have some kind of priority or
   // time sharing in the future, but this should be good enough for now.
   for (const UniquePtr<Nanoapp> &app : mNanoapps) {
-    if (app->hasPendingEvent()) {
-      havePendingEvents |= deliverNextEvent(app);
+    bool appHasPendingEvent = app->hasPendingEvent();
+    for (size_t i = 0; appHasPendingEvent && i < kNanoappEventBatchSize; i++) {
+      appHasPendingEvent = deliverNextEvent(app);
     }
+    havePendingEvents |= appHasPendingEvent;
   }
 
   return havePendingEvents;
@@ -407,7 +450,16 @@ bool EventLoop::deliverEvents() {
 bool EventLoop::deliverNextEvent(const UniquePtr<Nanoapp> &app) {
   // TODO: cleaner way to set/clear this? RAII-style?
   mCurrentApp = app.get();
+#ifdef CHRE_EVENT_LATENCY_STATS_ENABLED
+  Nanoseconds handleStartTime = SystemTime::getMonotonicTime();
   Event *event = app->processNextEvent();
+  Nanoseconds handleEndTime = SystemTime::getMonotonicTime();
+  app->recordEventLatency(
+      handleStartTime - Nanoseconds(event->postedTimeNs),
+      handleEndTime - handleStartTime);
+#else
+  Event *event = app->processNextEvent();
+#endif  // CHRE_EVENT_LATENCY_STATS_ENABLED
   mCurrentApp = nullptr;
 
   if (event->isUnreferenced()) {
@@ -418,11 +470,21 @@ bool EventLoop::deliverNextEvent(const UniquePtr<Nanoapp> &app) {
 }
 
 void EventLoop::distributeEvent(Event *event) {
-  for (const UniquePtr<Nanoapp> &app : mNanoapps) {
-    if ((event->targetInstanceId == chre::kBroadcastInstanceId &&
-         app->isRegisteredForBroadcastEvent(event->eventType,
-                                            event->targetAppGroupMask)) ||
-        event->targetInstanceId == app->getInstanceId()) {
+  if (event->targetInstanceId == kBroadcastInstanceId) {
+    // Only visit the nanoapps that are registered for this event type, rather
+    // than checking the registrations of every nanoapp
+    const BroadcastEventIndex::SubscriberList *subscribers =
+        mBroadcastEventIndex.getSubscribers(event->eventType);
+    if (subscribers != nullptr) {
+      for (const BroadcastEventIndex::Subscriber &subscriber : *subscribers) {
+        if (subscriber.groupIdMask & event->targetAppGroupMask) {
+          subscriber.nanoapp->postEvent(event);
+        }
+      }
+    }
+  } else {
+    Nanoapp *app = lookupAppByInstanceId(event->targetInstanceId);
+    if (app != nullptr) {
       app->postEvent(event);
     }
   }
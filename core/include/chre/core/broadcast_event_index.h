@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_CORE_BROADCAST_EVENT_INDEX_H_
+#define CHRE_CORE_BROADCAST_EVENT_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chre/util/dynamic_vector.h"
+#include "chre/util/flat_map.h"
+#include "chre/util/non_copyable.h"
+
+namespace chre {
+
+class Nanoapp;
+
+/**
+ * Maps broadcast event types to the nanoapps that are registered to receive
+ * them, so that the EventLoop only needs to visit the nanoapps that are
+ * actually subscribed to a given event type when distributing a broadcast.
+ *
+ * The index is kept up to date by Nanoapp::registerForBroadcastEvent() and
+ * Nanoapp::unregisterForBroadcastEvent(). It is not thread-safe, and must only
+ * be accessed from the context of the EventLoop that owns it.
+ */
+class BroadcastEventIndex : public NonCopyable {
+ public:
+  //! A nanoapp registered for a given event type, along with the group ID mask
+  //! it registered with.
+  struct Subscriber {
+    Subscriber(Nanoapp *nanoapp_, uint16_t groupIdMask_)
+        : nanoapp(nanoapp_), groupIdMask(groupIdMask_) {}
+
+    Nanoapp *nanoapp;
+    uint16_t groupIdMask;
+  };
+
+  typedef DynamicVector<Subscriber> SubscriberList;
+
+  /**
+   * Sets the group ID mask that the given nanoapp is registered with for the
+   * given event type, replacing any previous value. A mask of 0 removes the
+   * nanoapp from the subscriber list of the event type.
+   *
+   * @param nanoapp The nanoapp whose registration has changed, must not be null
+   * @param eventType The broadcast event type
+   * @param groupIdMask The nanoapp's complete group ID mask for eventType
+   *
+   * @return false if memory allocation failed
+   */
+  bool setSubscription(Nanoapp *nanoapp, uint16_t eventType,
+                       uint16_t groupIdMask);
+
+  /**
+   * Removes all subscriptions held by the given nanoapp, e.g. as part of
+   * unloading it.
+   *
+   * @param nanoapp The nanoapp to remove
+   */
+  void removeNanoapp(const Nanoapp *nanoapp);
+
+  /**
+   * @param eventType The broadcast event type to look up
+   *
+   * @return The list of nanoapps subscribed to eventType, or nullptr if there
+   *         are none. The list is invalidated by any modification to the index.
+   */
+  const SubscriberList *getSubscribers(uint16_t eventType) const;
+
+  /**
+   * @return The number of distinct event types with at least one subscriber
+   */
+  size_t getEventTypeCount() const {
+    return mSubscriptions.size();
+  }
+
+ private:
+  //! Subscriber lists keyed by event type. Event types with no subscribers are
+  //! removed.
+  FlatMap<uint16_t, SubscriberList> mSubscriptions;
+};
+
+}  // namespace chre
+
+#endif  // CHRE_CORE_BROADCAST_EVENT_INDEX_H_
@@ -143,11 +143,22 @@ class Event : public NonCopyable {
   // all registered listeners.
   const uint16_t targetAppGroupMask;
 
+#ifdef CHRE_EVENT_LATENCY_STATS_ENABLED
+  //! The full-resolution monotonic time the event was posted at, used to
+  //! measure how long it waits before being delivered to each nanoapp.
+  const uint64_t postedTimeNs = getTimeNanos();
+#endif  // CHRE_EVENT_LATENCY_STATS_ENABLED
+
  private:
   uint16_t mRefCount = 0;
 
   //! @return Monotonic time reference for initializing receivedTimeMillis
   static uint16_t getTimeMillis();
+
+#ifdef CHRE_EVENT_LATENCY_STATS_ENABLED
+  //! @return Monotonic time reference for initializing postedTimeNs
+  static uint64_t getTimeNanos();
+#endif  // CHRE_EVENT_LATENCY_STATS_ENABLED
 };
 
 }  // namespace chre
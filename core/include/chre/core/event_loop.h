@@ -17,7 +17,9 @@
 #ifndef CHRE_CORE_EVENT_LOOP_H_
 #define CHRE_CORE_EVENT_LOOP_H_
 
+#include "chre/core/broadcast_event_index.h"
 #include "chre/core/event.h"
+#include "chre/core/event_ref_queue.h"
 #include "chre/core/nanoapp.h"
 #include "chre/core/timer_pool.h"
 #include "chre/platform/atomic.h"
@@ -27,6 +29,8 @@
 #include "chre/platform/system_time.h"
 #include "chre/util/dynamic_vector.h"
 #include "chre/util/fixed_size_blocking_queue.h"
+#include "chre/util/lock_free_memory_pool.h"
+#include "chre/util/lock_free_mpsc_queue.h"
 #include "chre/util/non_copyable.h"
 #include "chre/util/synchronized_memory_pool.h"
 #include "chre/util/system/debug_dump.h"
@@ -42,6 +46,18 @@
 #define CHRE_MAX_UNSCHEDULED_EVENT_COUNT 96
 #endif
 
+// The maximum number of events pulled from the inbound event queue per
+// iteration of the event loop.
+#ifndef CHRE_EVENT_LOOP_INBOUND_BATCH_SIZE
+#define CHRE_EVENT_LOOP_INBOUND_BATCH_SIZE 1
+#endif
+
+// The maximum number of events delivered to each nanoapp per iteration of the
+// event loop.
+#ifndef CHRE_EVENT_LOOP_NANOAPP_BATCH_SIZE
+#define CHRE_EVENT_LOOP_NANOAPP_BATCH_SIZE 1
+#endif
+
 namespace chre {
 
 /**
@@ -228,6 +244,30 @@ class EventLoop : public NonCopyable {
   bool postSystemEvent(uint16_t eventType, void *eventData,
                        SystemEventCallbackFunction *callback, void *extraData);
 
+  /**
+   * Posts an event for processing by the system from within the context of the
+   * CHRE thread, like postSystemEvent(), but without using the events reserved
+   * for high priority events. The event is dropped rather than raising a fatal
+   * error if it can't be posted, so the caller must be able to cope with the
+   * callback never being invoked.
+   *
+   * Safe to call from any thread.
+   *
+   * @param eventType Event type identifier, which is forwarded to the callback
+   * @param eventData Arbitrary data to pass to the callback
+   * @param callback Function to invoke from the context of the CHRE thread
+   * @param extraData Additional arbitrary data to provide to the callback
+   *
+   * @return true if successfully posted; false if the event loop is shutting
+   *         down or is running low on events - in this case, the callback will
+   *         not be invoked and any allocated memory must be cleaned up
+   *
+   * @see postLowPriorityEventOrFree
+   */
+  bool postLowPrioritySystemEvent(uint16_t eventType, void *eventData,
+                                  SystemEventCallbackFunction *callback,
+                                  void *extraData);
+
   /**
    * Returns a pointer to the currently executing Nanoapp, or nullptr if none is
    * currently executing. Must only be called from within the thread context
@@ -323,6 +363,27 @@ class EventLoop : public NonCopyable {
   static constexpr size_t kMaxUnscheduledEventCount =
       CHRE_MAX_UNSCHEDULED_EVENT_COUNT;
 
+  //! The maximum number of events distributed from mEvents per iteration of
+  //! run(). Only the first one is waited for, the rest are taken only if they
+  //! are already queued.
+  static constexpr size_t kInboundEventBatchSize =
+      CHRE_EVENT_LOOP_INBOUND_BATCH_SIZE;
+
+  //! The maximum number of events a nanoapp handles per iteration of run()
+  //! before the next nanoapp gets a turn.
+  static constexpr size_t kNanoappEventBatchSize =
+      CHRE_EVENT_LOOP_NANOAPP_BATCH_SIZE;
+
+  // Every nanoapp drains at least as many events per iteration as can be
+  // distributed to it, so its queue never grows across iterations and never
+  // holds more than one inbound batch.
+  static_assert(kInboundEventBatchSize > 0 && kNanoappEventBatchSize > 0,
+                "Event loop batch sizes must be non-zero");
+  static_assert(kInboundEventBatchSize <= kNanoappEventBatchSize,
+                "Inbound batch can't exceed the per-nanoapp batch");
+  static_assert(kInboundEventBatchSize <= EventRefQueue::kMaxPendingEvents,
+                "Inbound batch can't exceed a nanoapp's event queue capacity");
+
   //! The time interval of nanoapp wakeup buckets, adjust in conjuction with
   //! Nanoapp::kMaxSizeWakeupBuckets.
   static constexpr Nanoseconds kIntervalWakeupBucket =
@@ -332,11 +393,19 @@ class EventLoop : public NonCopyable {
   Nanoseconds mTimeLastWakeupBucketCycled;
 
   //! The memory pool to allocate incoming events from.
+#ifdef CHRE_LOCK_FREE_EVENT_POOL_ENABLED
+  LockFreeMemoryPool<Event, kMaxEventCount> mEventPool;
+#else
   SynchronizedMemoryPool<Event, kMaxEventCount> mEventPool;
+#endif  // CHRE_LOCK_FREE_EVENT_POOL_ENABLED
 
   //! The timer used schedule timed events for tasks running in this event loop.
   TimerPool mTimerPool;
 
+  //! Maps broadcast event types to the nanoapps registered for them. Declared
+  //! before mNanoapps as each Nanoapp removes itself from it on destruction.
+  BroadcastEventIndex mBroadcastEventIndex;
+
   //! The list of nanoapps managed by this event loop.
   DynamicVector<UniquePtr<Nanoapp>> mNanoapps;
 
@@ -348,9 +417,19 @@ class EventLoop : public NonCopyable {
   //! the thread context of this EventLoop.
   mutable Mutex mNanoappsLock;
 
+#ifdef CHRE_LOCK_FREE_EVENT_QUEUE_ENABLED
+  //! Posting threads push without taking a lock, and only wake the event loop
+  //! if it is idle. The lock-free queue requires a power of two capacity.
+  typedef LockFreeMpscQueue<Event *,
+                            roundUpToPowerOfTwo(kMaxUnscheduledEventCount)>
+      EventQueue;
+#else
+  typedef FixedSizeBlockingQueue<Event *, kMaxUnscheduledEventCount> EventQueue;
+#endif  // CHRE_LOCK_FREE_EVENT_QUEUE_ENABLED
+
   //! The blocking queue of incoming events from the system that have not been
   //! distributed out to apps yet.
-  FixedSizeBlockingQueue<Event *, kMaxUnscheduledEventCount> mEvents;
+  EventQueue mEvents;
 
   //! Indicates whether the event loop is running.
   AtomicBool mRunning;
@@ -390,7 +469,8 @@ class EventLoop : public NonCopyable {
 
   /**
    * Do one round of Nanoapp event delivery, only considering events in
-   * Nanoapps' own queues (not mEvents).
+   * Nanoapps' own queues (not mEvents). Each Nanoapp handles up to
+   * kNanoappEventBatchSize events in round-robin order.
    *
    * @return true if there are more events pending in Nanoapps' own queues
    */
@@ -57,6 +57,7 @@ enum class SystemCallbackType : uint16_t {
   DelayedFatalError,
   GnssRequestResyncEvent,
   SendBufferedLogMessage,
+  SensorHistoryUpdate,
 };
 
 //! Deferred/delayed callbacks use the event subsystem but are invariably sent
@@ -29,6 +29,9 @@ namespace chre {
  */
 class EventRefQueue {
  public:
+  //! The maximum number of events that can be outstanding for an app.
+  static constexpr size_t kMaxPendingEvents = 16;
+
   ~EventRefQueue();
 
   /**
@@ -57,9 +60,6 @@ class EventRefQueue {
   Event *pop();
 
  private:
-  //! The maximum number of events that can be outstanding for an app.
-  static constexpr size_t kMaxPendingEvents = 16;
-
   //! The queue of incoming events.
   ArrayQueue<Event *, kMaxPendingEvents> mQueue;
 };
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_CORE_INCREMENTAL_REQUEST_MULTIPLEXER_H_
+#define CHRE_CORE_INCREMENTAL_REQUEST_MULTIPLEXER_H_
+
+#include "chre/util/dynamic_vector.h"
+#include "chre/util/non_copyable.h"
+
+namespace chre {
+
+/**
+ * A variant of RequestMultiplexer that maintains the maximal request
+ * incrementally instead of merging every tracked request whenever a request is
+ * updated or removed. It has the same API and produces the same maximal
+ * requests as RequestMultiplexer.
+ *
+ * RequestType must implement the API required by RequestMultiplexer. The
+ * maximal request is tracked by an AggregateType, which summarizes the set of
+ * requests (for example with ordered counts of each attribute) and must
+ * implement the following API:
+ *
+ * 1. AggregateType();
+ *
+ *     Constructs an aggregate with no requests. The aggregate must be movable.
+ *
+ * 2. bool reserve(size_t numRequests);
+ *
+ *     Ensures that add() will succeed as long as the aggregate holds at most
+ *     numRequests requests. Returns false if memory could not be allocated.
+ *
+ * 3. void add(const RequestType& request);
+ *    void remove(const RequestType& request);
+ *    void clear();
+ *
+ *     Adds a request to or removes a request from the aggregate, or removes
+ *     all of them. remove() is only called with a request that is equal to
+ *     one that was previously added.
+ *
+ * 4. bool getMaximalRequest(RequestType *maximalRequest) const;
+ *
+ *     Populates the request that would be produced by merging all added
+ *     requests into a default constructed RequestType. Returns false if the
+ *     result depends on the order of the requests, in which case the
+ *     multiplexer falls back to merging all requests in order.
+ */
+template <typename RequestType, typename AggregateType>
+class IncrementalRequestMultiplexer : public NonCopyable {
+ public:
+  IncrementalRequestMultiplexer() = default;
+  IncrementalRequestMultiplexer(IncrementalRequestMultiplexer &&other) {
+    *this = std::move(other);
+  }
+
+  IncrementalRequestMultiplexer &operator=(
+      IncrementalRequestMultiplexer &&other) {
+    mRequests = std::move(other.mRequests);
+    mAggregate = std::move(other.mAggregate);
+    other.mAggregate.clear();
+
+    mCurrentMaximalRequest = other.mCurrentMaximalRequest;
+    other.mCurrentMaximalRequest = RequestType();
+
+    return *this;
+  }
+
+  /**
+   * Adds a request to the list of requests being managed by this multiplexer.
+   *
+   * @param request The request to add to the list.
+   * @param index A non-null pointer to an index that is populated with the
+   *              location that the request was added.
+   * @param maximalRequestChanged A non-null pointer to a bool that is set to
+   *        true if current maximal request has changed. The user of this API
+   *        must query the getCurrentMaximalRequest method to get the new
+   *        maximal request.
+   * @return Returns false if the request cannot be inserted into the
+   *         multiplexer.
+   */
+  bool addRequest(const RequestType &request, size_t *index,
+                  bool *maximalRequestChanged);
+
+  /**
+   * Updates a request in the list of requests being managed by this
+   * multiplexer.
+   *
+   * @param index The index of the request to be updated. This param must fall
+   *        in the range of indices provided by getRequests().
+   * @param request The request to update to.
+   * @param maximalRequestChanged A non-null pointer to a bool that is set to
+   *        true if the current maximal request has changed. The user of this
+   *        API must query the getCurrentMaximalRequest() method to get the new
+   *        maximal request.
+   */
+  void updateRequest(size_t index, const RequestType &request,
+                     bool *maximalRequestChanged);
+
+  /**
+   * Removes a request from the list of requests being managed by this
+   * multiplexer.
+   *
+   * @param index The index of the request to be removed. This index must fall
+   *        in the range of indices provided by getRequests().
+   * @param maximalRequestChanged A non-null pointer to a bool that is set to
+   *        true if the current maximal request has changed. The user of this
+   *        API must query the getCurrentMaximalRequest method to get the new
+   *        maximal request.
+   */
+  void removeRequest(size_t index, bool *maximalRequestChanged);
+
+  /*
+   * Removes all requests managed by this multiplexer. The maximal request will
+   * change if the multiplexer is not empty.
+   *
+   * @param maximalRequestChanged A non-null pointer to a bool that is set to
+   *        true if the current maximal request has changed.
+   */
+  void removeAllRequests(bool *maximalRequestChanged);
+
+  /**
+   * @return The list of requests managed by this multiplexer.
+   */
+  const DynamicVector<RequestType> &getRequests() const;
+
+  /**
+   * @return Returns the current maximal request.
+   */
+  const RequestType &getCurrentMaximalRequest() const;
+
+ private:
+  //! The list of requests to track.
+  DynamicVector<RequestType> mRequests;
+
+  //! The summary of mRequests used to derive the maximal request.
+  AggregateType mAggregate;
+
+  //! The current maximal request as generated by this multiplexer.
+  RequestType mCurrentMaximalRequest;
+
+  /**
+   * Obtains the maximal request from the aggregate, or by merging all tracked
+   * requests if the aggregate can't provide it, and updates the current
+   * maximal request if it has changed.
+   *
+   * @param maximalRequestChanged A non-null pointer to a bool that is set to
+   *        true if the current maximal request has changed.
+   */
+  void updateMaximalRequest(bool *maximalRequestChanged);
+};
+
+}  // namespace chre
+
+#include "chre/core/incremental_request_multiplexer_impl.h"
+
+#endif  // CHRE_CORE_INCREMENTAL_REQUEST_MULTIPLEXER_H_
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_CORE_INCREMENTAL_REQUEST_MULTIPLEXER_IMPL_H_
+#define CHRE_CORE_INCREMENTAL_REQUEST_MULTIPLEXER_IMPL_H_
+
+#include "chre/core/incremental_request_multiplexer.h"
+#include "chre/platform/assert.h"
+
+namespace chre {
+
+template <typename RequestType, typename AggregateType>
+bool IncrementalRequestMultiplexer<RequestType, AggregateType>::addRequest(
+    const RequestType &request, size_t *index, bool *maximalRequestChanged) {
+  CHRE_ASSERT(index);
+  CHRE_ASSERT(maximalRequestChanged);
+
+  // Reserving up front guarantees that updateRequest() never has to allocate.
+  bool requestStored = mAggregate.reserve(mRequests.size() + 1) &&
+                       mRequests.push_back(request);
+  if (requestStored) {
+    *index = (mRequests.size() - 1);
+    mAggregate.add(request);
+    updateMaximalRequest(maximalRequestChanged);
+  }
+
+  return requestStored;
+}
+
+template <typename RequestType, typename AggregateType>
+void IncrementalRequestMultiplexer<RequestType, AggregateType>::updateRequest(
+    size_t index, const RequestType &request, bool *maximalRequestChanged) {
+  CHRE_ASSERT(maximalRequestChanged);
+  CHRE_ASSERT(index < mRequests.size());
+
+  if (index < mRequests.size()) {
+    mAggregate.remove(mRequests[index]);
+    mAggregate.add(request);
+    mRequests[index] = request;
+    updateMaximalRequest(maximalRequestChanged);
+  }
+}
+
+template <typename RequestType, typename AggregateType>
+void IncrementalRequestMultiplexer<RequestType, AggregateType>::removeRequest(
+    size_t index, bool *maximalRequestChanged) {
+  CHRE_ASSERT(maximalRequestChanged);
+  CHRE_ASSERT(index < mRequests.size());
+
+  if (index < mRequests.size()) {
+    mAggregate.remove(mRequests[index]);
+    mRequests.erase(index);
+    updateMaximalRequest(maximalRequestChanged);
+  }
+}
+
+template <typename RequestType, typename AggregateType>
+void IncrementalRequestMultiplexer<RequestType,
+                                   AggregateType>::removeAllRequests(
+    bool *maximalRequestChanged) {
+  CHRE_ASSERT(maximalRequestChanged);
+
+  mRequests.clear();
+  mAggregate.clear();
+  updateMaximalRequest(maximalRequestChanged);
+}
+
+template <typename RequestType, typename AggregateType>
+const DynamicVector<RequestType>
+    &IncrementalRequestMultiplexer<RequestType, AggregateType>::getRequests()
+        const {
+  return mRequests;
+}
+
+template <typename RequestType, typename AggregateType>
+const RequestType &IncrementalRequestMultiplexer<
+    RequestType, AggregateType>::getCurrentMaximalRequest() const {
+  return mCurrentMaximalRequest;
+}
+
+template <typename RequestType, typename AggregateType>
+void IncrementalRequestMultiplexer<RequestType, AggregateType>::
+    updateMaximalRequest(bool *maximalRequestChanged) {
+  RequestType maximalRequest;
+  if (!mAggregate.getMaximalRequest(&maximalRequest)) {
+    maximalRequest = RequestType();
+    for (size_t i = 0; i < mRequests.size(); i++) {
+      maximalRequest.mergeWith(mRequests[i]);
+    }
+  }
+
+  *maximalRequestChanged =
+      !mCurrentMaximalRequest.isEquivalentTo(maximalRequest);
+  if (*maximalRequestChanged) {
+    mCurrentMaximalRequest = maximalRequest;
+  }
+}
+
+}  // namespace chre
+
+#endif  // CHRE_CORE_INCREMENTAL_REQUEST_MULTIPLEXER_IMPL_H_
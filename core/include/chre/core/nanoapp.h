@@ -19,14 +19,20 @@
 
 #include <cinttypes>
 
+#include "chre/core/broadcast_event_index.h"
 #include "chre/core/event.h"
 #include "chre/core/event_ref_queue.h"
 #include "chre/platform/platform_nanoapp.h"
 #include "chre/util/dynamic_vector.h"
 #include "chre/util/fixed_size_vector.h"
+#include "chre/util/flat_map.h"
 #include "chre/util/system/debug_dump.h"
 #include "chre/util/system/napp_permissions.h"
 
+#ifdef CHRE_EVENT_LATENCY_STATS_ENABLED
+#include "chre/util/system/latency_histogram.h"
+#endif  // CHRE_EVENT_LATENCY_STATS_ENABLED
+
 namespace chre {
 
 /**
@@ -60,6 +66,16 @@ class Nanoapp : public PlatformNanoapp {
     mInstanceId = instanceId;
   }
 
+  /**
+   * Associates this Nanoapp with the broadcast event index of the EventLoop
+   * that manages it. All subsequent changes to this Nanoapp's broadcast event
+   * registrations are mirrored into the index, and the Nanoapp is removed from
+   * it on destruction.
+   *
+   * @param index The index to keep up to date, or nullptr to stop tracking
+   */
+  void setBroadcastEventIndex(BroadcastEventIndex *index);
+
   /**
    * @return The current total number of bytes the nanoapp has allocated.
    */
@@ -193,6 +209,21 @@ class Nanoapp : public PlatformNanoapp {
    */
   void cycleWakeupBuckets(size_t numBuckets);
 
+#ifdef CHRE_EVENT_LATENCY_STATS_ENABLED
+  /**
+   * Records timing information about an event delivered to this nanoapp.
+   *
+   * @param queueLatency The time between the event being posted and this
+   *        nanoapp starting to handle it
+   * @param handleDuration The time this nanoapp spent handling the event
+   */
+  void recordEventLatency(Nanoseconds queueLatency,
+                          Nanoseconds handleDuration) {
+    mQueueLatencyHistogram.record(queueLatency);
+    mHandleDurationHistogram.record(handleDuration);
+  }
+#endif  // CHRE_EVENT_LATENCY_STATS_ENABLED
+
   /**
    * Prints state in a string buffer. Must only be called from the context of
    * the main CHRE thread.
@@ -223,27 +254,23 @@ class Nanoapp : public PlatformNanoapp {
   //! wakeups over time intervals.
   FixedSizeVector<uint16_t, kMaxSizeWakeupBuckets> mWakeupBuckets;
 
-  //! Metadata needed for keeping track of the registered events for this
-  //! nanoapp.
-  struct EventRegistration {
-    EventRegistration(uint16_t eventType_, uint16_t groupIdMask_)
-        : eventType(eventType_), groupIdMask(groupIdMask_) {}
+  //! The set of broadcast events that this app is registered for, mapping
+  //! each event type to the mask of group IDs it is registered with.
+  FlatMap<uint16_t, uint16_t> mRegisteredEvents;
 
-    uint16_t eventType;
-    uint16_t groupIdMask;
-  };
+  EventRefQueue mEventQueue;
 
-  //! The set of broadcast events that this app is registered for.
-  // TODO: Implement a set container and replace DynamicVector here. There may
-  // also be a better way of handling this (perhaps we map event type to apps
-  // who care about them).
-  DynamicVector<EventRegistration> mRegisteredEvents;
+#ifdef CHRE_EVENT_LATENCY_STATS_ENABLED
+  //! The time events waited between being posted and being handled.
+  LatencyHistogram mQueueLatencyHistogram;
 
-  EventRefQueue mEventQueue;
+  //! The time spent in nanoappHandleEvent() per event.
+  LatencyHistogram mHandleDurationHistogram;
+#endif  // CHRE_EVENT_LATENCY_STATS_ENABLED
 
-  //! @return index of event registration if found. mRegisteredEvents.size() if
-  //!     not.
-  size_t registrationIndex(uint16_t eventType) const;
+  //! The index of broadcast event subscribers owned by the EventLoop running
+  //! this nanoapp, if any.
+  BroadcastEventIndex *mBroadcastEventIndex = nullptr;
 
   /**
    * A special function to deliver GNSS measurement events to nanoapps and
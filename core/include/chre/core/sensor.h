@@ -17,6 +17,7 @@
 #ifndef CHRE_CORE_SENSOR_H_
 #define CHRE_CORE_SENSOR_H_
 
+#include "chre/core/sensor_history.h"
 #include "chre/core/sensor_request_multiplexer.h"
 #include "chre/core/sensor_type_helpers.h"
 #include "chre/core/timer_pool.h"
@@ -224,6 +225,32 @@ class Sensor : public PlatformSensor {
     return SensorTypeHelpers::getSensorTypeName(getSensorType());
   }
 
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+  /**
+   * @return A reference to the recent samples of this sensor retained for
+   *     nanoapps. Must only be used from the context of the CHRE thread.
+   */
+  SensorHistory &getHistory() {
+    return mHistory;
+  }
+
+  const SensorHistory &getHistory() const {
+    return mHistory;
+  }
+
+  /**
+   * @return true if the samples of this sensor are added to its history. Can
+   *     be called from any thread.
+   */
+  bool isHistoryEnabled() const {
+    return mHistoryEnabled;
+  }
+
+  void setHistoryEnabled(bool enabled) {
+    mHistoryEnabled = enabled;
+  }
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
+
  private:
   size_t getLastEventSize() {
     return SensorTypeHelpers::getLastEventSize(getSensorType());
@@ -254,6 +281,14 @@ class Sensor : public PlatformSensor {
 
   //! True if a flush request is pending for this sensor.
   AtomicBool mFlushRequestPending;
+
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+  //! The recent samples of this sensor, if requested by nanoapps.
+  SensorHistory mHistory;
+
+  //! True if the samples of this sensor are added to mHistory.
+  AtomicBool mHistoryEnabled{false};
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
 };
 
 }  // namespace chre
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_CORE_SENSOR_DATA_DECIMATOR_H_
+#define CHRE_CORE_SENSOR_DATA_DECIMATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chre/core/sensor_type.h"
+
+namespace chre {
+
+/**
+ * Selects the samples of a stream of sensor data events that a nanoapp needs
+ * at its requested interval, when the sensor samples faster on behalf of other
+ * nanoapps.
+ *
+ * A sample is selected if it is at least one interval, minus a tolerance,
+ * after the previously selected sample. The tolerance absorbs the jitter of
+ * the sensor's actual sampling times, and is typically half the interval the
+ * sensor samples at.
+ */
+class SensorDataDecimator {
+ public:
+  /**
+   * @param intervalNs The interval requested by the nanoapp.
+   * @param toleranceNs How much earlier than intervalNs a sample may be
+   *     selected, must be smaller than intervalNs.
+   */
+  SensorDataDecimator(uint64_t intervalNs, uint64_t toleranceNs);
+
+  /**
+   * Builds a data event holding the samples of the given event that are due.
+   * Only the selected samples are copied, so the cost is proportional to the
+   * number of samples delivered rather than to the size of the batch.
+   *
+   * @param event A non-null sensor data event of a sensor type whose samples
+   *     begin with a uint32_t timestamp delta.
+   * @param sampleSize The size of one element of the event's readings.
+   *
+   * @return An event allocated with memoryAlloc() that must be released with
+   *     memoryFree(), or nullptr if no sample of the event is due or the
+   *     allocation failed.
+   */
+  ChreSensorData *decimate(const ChreSensorData *event, size_t sampleSize);
+
+  /**
+   * Changes the interval of the nanoapp. The next selected sample is still
+   * relative to the previously selected one.
+   */
+  void setInterval(uint64_t intervalNs, uint64_t toleranceNs);
+
+  uint64_t getIntervalNs() const {
+    return mIntervalNs;
+  }
+
+ private:
+  /**
+   * Invokes callback(index, timestampNs) for each sample of the event that is
+   * due, starting from nextSampleTimeNs which is updated accordingly. Samples
+   * that are not due are also selected if skipping them would make the
+   * timestamp delta between two selected samples overflow.
+   */
+  template <typename Callback>
+  static void forEachDueSample(const ChreSensorData *event, size_t sampleSize,
+                               uint64_t spacingNs, uint64_t *nextSampleTimeNs,
+                               Callback callback);
+
+  //! The interval requested by the nanoapp.
+  uint64_t mIntervalNs;
+
+  //! The minimum spacing of selected samples, i.e. the interval minus the
+  //! tolerance.
+  uint64_t mSpacingNs;
+
+  //! The earliest timestamp of the next sample to select.
+  uint64_t mNextSampleTimeNs = 0;
+};
+
+}  // namespace chre
+
+#endif  // CHRE_CORE_SENSOR_DATA_DECIMATOR_H_
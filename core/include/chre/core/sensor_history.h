@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_CORE_SENSOR_HISTORY_H_
+#define CHRE_CORE_SENSOR_HISTORY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chre/core/sensor_type.h"
+#include "chre/util/non_copyable.h"
+
+namespace chre {
+
+/**
+ * A ring buffer holding the most recent samples of a sensor, which nanoapps
+ * can read without copying through chreSensorGetHistory().
+ *
+ * Samples are stored in the format of the readings of the sensor's data
+ * events. The timestamp delta of each stored sample is rewritten to be
+ * relative to the sample stored before it, so that any run of consecutive
+ * samples reads like the readings of a data event. When the ring wraps, the
+ * first sample of the buffer follows the last one.
+ *
+ * This class is not thread-safe. Samples must only be added from the context
+ * of the CHRE thread, so that the samples seen by a nanoapp don't change while
+ * it handles an event.
+ */
+class SensorHistory : public NonCopyable {
+ public:
+  SensorHistory() = default;
+  SensorHistory(SensorHistory &&other);
+  SensorHistory &operator=(SensorHistory &&other);
+  ~SensorHistory();
+
+  /**
+   * Changes the number of samples that can be held, keeping the most recent
+   * samples that fit. A capacity of 0 releases the memory of the history.
+   *
+   * @param capacity The number of samples to hold, at most UINT16_MAX.
+   * @param sampleSize The size of one element of the readings of the sensor's
+   *     data events. Changing it drops all samples.
+   * @return false if the memory couldn't be allocated, in which case the
+   *     history is left unchanged.
+   */
+  bool resize(size_t capacity, size_t sampleSize);
+
+  /**
+   * Appends the samples of a data event, overwriting the oldest samples if
+   * full. All samples are dropped first if the new ones are more than a
+   * timestamp delta away from them, e.g. after the sensor was turned off.
+   *
+   * @param event A non-null data event of the sensor.
+   */
+  void addSamples(const ChreSensorData *event);
+
+  /**
+   * Looks up the samples with a timestamp in [startTimeNs, endTimeNs]. The
+   * returned pointers are valid until samples are added or the history is
+   * resized.
+   *
+   * @param startTimeNs The timestamp of the oldest sample to include.
+   * @param endTimeNs The timestamp of the newest sample to include.
+   * @param history A non-null pointer to populate with the samples, in up to
+   *     two runs when the range wraps around the end of the buffer. The
+   *     reading counts are 0 if no sample is in the range.
+   */
+  void getRange(uint64_t startTimeNs, uint64_t endTimeNs,
+                struct chreSensorHistory *history) const;
+
+  /**
+   * Drops all samples, keeping the memory of the history.
+   */
+  void clear() {
+    mSize = 0;
+  }
+
+  size_t getCapacity() const {
+    return mCapacity;
+  }
+
+  size_t size() const {
+    return mSize;
+  }
+
+  /**
+   * @return The number of bytes of sample storage held by this history.
+   */
+  size_t getMemorySize() const {
+    return mCapacity * mSampleSize;
+  }
+
+  /**
+   * @return The timestamp of the oldest sample, only valid if size() > 0.
+   */
+  uint64_t getOldestTimestampNs() const;
+
+  /**
+   * @return The timestamp of the newest sample, only valid if size() > 0.
+   */
+  uint64_t getNewestTimestampNs() const {
+    return mNewestTimestampNs;
+  }
+
+ private:
+  /**
+   * @param index The position of a sample, 0 being the oldest.
+   * @return A pointer to the sample in mSamples.
+   */
+  uint8_t *getSample(size_t index) const {
+    return mSamples + ((mHead + index) % mCapacity) * mSampleSize;
+  }
+
+  /**
+   * @param index The position of a sample, 0 being the oldest.
+   * @return The time between the sample and the one stored before it.
+   */
+  uint32_t getTimestampDelta(size_t index) const;
+
+  /**
+   * Appends a sample, overwriting the oldest one if full.
+   *
+   * @param reading The sample, as found in the readings of a data event.
+   * @param timestampNs The timestamp of the sample.
+   */
+  void addSample(const uint8_t *reading, uint64_t timestampNs);
+
+  //! The storage of mCapacity samples of mSampleSize bytes.
+  uint8_t *mSamples = nullptr;
+  size_t mCapacity = 0;
+  size_t mSampleSize = 0;
+
+  //! The position of the oldest sample in mSamples, and the number of samples.
+  size_t mHead = 0;
+  size_t mSize = 0;
+
+  //! The timestamp of the newest sample, from which the timestamps of the
+  //! others are derived.
+  uint64_t mNewestTimestampNs = 0;
+};
+
+}  // namespace chre
+
+#endif  // CHRE_CORE_SENSOR_HISTORY_H_
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_CORE_SENSOR_REQUEST_AGGREGATE_H_
+#define CHRE_CORE_SENSOR_REQUEST_AGGREGATE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chre/core/sensor_request.h"
+#include "chre/util/flat_map.h"
+
+namespace chre {
+
+/**
+ * Summarizes a set of sensor requests so that the result of merging all of
+ * them can be obtained without visiting each request. This class implements
+ * the aggregate API set forth by the IncrementalRequestMultiplexer container.
+ *
+ * Each attribute is tracked as counts of its values, sorted by value, so adding
+ * or removing a request and finding the minimum interval, latency and batch
+ * interval takes O(log n) comparisons in the number of requests.
+ *
+ * SensorRequest::mergeWith() combines interval and latency in an order
+ * dependent way when one request only specifies an interval and another only
+ * specifies a latency. The maximal request is not provided in that case, and
+ * the requests must be merged in order instead.
+ */
+class SensorRequestAggregate {
+ public:
+  /**
+   * Ensures that add() will not need to allocate memory while the aggregate
+   * holds at most numRequests requests.
+   *
+   * @param numRequests The number of requests to reserve space for.
+   * @return false if memory allocation failed.
+   */
+  bool reserve(size_t numRequests);
+
+  /**
+   * Adds a request to the aggregate. Requests with SensorMode::Off don't
+   * contribute to the maximal request and are not tracked.
+   *
+   * @param request The request to add.
+   */
+  void add(const SensorRequest &request);
+
+  /**
+   * Removes a request that was previously added to the aggregate.
+   *
+   * @param request The request to remove.
+   */
+  void remove(const SensorRequest &request);
+
+  /**
+   * Removes all requests from the aggregate.
+   */
+  void clear();
+
+  /**
+   * Obtains the request that is produced by merging all added requests into a
+   * default constructed SensorRequest.
+   *
+   * @param maximalRequest A non-null pointer that is populated with the
+   *        maximal request.
+   * @return false if the maximal request depends on the order of the
+   *         requests, in which case maximalRequest is not modified.
+   */
+  bool getMaximalRequest(SensorRequest *maximalRequest) const;
+
+ private:
+  //! Maps a value of an attribute to the number of requests using it.
+  typedef FlatMap<uint64_t, size_t> ValueCounts;
+
+  //! The number of distinct SensorMode values.
+  static constexpr size_t kNumSensorModes =
+      static_cast<size_t>(SensorMode::PassiveOneShot) + 1;
+
+  //! The non-default intervals of the requests.
+  ValueCounts mIntervals;
+
+  //! The non-default latencies of the requests.
+  ValueCounts mLatencies;
+
+  //! The batch intervals (interval + latency) of the requests that specify
+  //! both an interval and a latency.
+  ValueCounts mBatchIntervals;
+
+  //! The number of requests using each mode.
+  size_t mModeCounts[kNumSensorModes] = {};
+
+  //! The number of requests that only specify an interval.
+  size_t mNumIntervalOnlyRequests = 0;
+
+  //! The number of requests that only specify a latency.
+  size_t mNumLatencyOnlyRequests = 0;
+
+  //! The number of requests that want bias updates.
+  size_t mNumBiasRequests = 0;
+
+  /**
+   * Adds or removes a request from the aggregate.
+   *
+   * @param request The request to add or remove.
+   * @param add true to add the request, false to remove it.
+   */
+  void update(const SensorRequest &request, bool add);
+};
+
+}  // namespace chre
+
+#endif  // CHRE_CORE_SENSOR_REQUEST_AGGREGATE_H_
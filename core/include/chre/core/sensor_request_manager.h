@@ -18,9 +18,11 @@
 #define CHRE_CORE_SENSOR_REQUEST_MANAGER_H_
 
 #include "chre/core/sensor.h"
+#include "chre/core/sensor_data_decimator.h"
 #include "chre/core/sensor_request.h"
 #include "chre/core/sensor_request_multiplexer.h"
 #include "chre/platform/fatal_error.h"
+#include "chre/platform/mutex.h"
 #include "chre/platform/platform_sensor_manager.h"
 #include "chre/platform/system_time.h"
 #include "chre/platform/system_timer.h"
@@ -28,6 +30,12 @@
 #include "chre/util/optional.h"
 #include "chre/util/system/debug_dump.h"
 
+#ifndef CHRE_SENSOR_HISTORY_MAX_BYTES
+//! The maximum number of bytes the histories of all sensors may hold, which
+//! can be overridden in the variant-specific makefile.
+#define CHRE_SENSOR_HISTORY_MAX_BYTES 16384
+#endif  // CHRE_SENSOR_HISTORY_MAX_BYTES
+
 namespace chre {
 
 /**
@@ -194,6 +202,42 @@ class SensorRequestManager : public NonCopyable {
    */
   bool flushAsync(Nanoapp *nanoapp, uint32_t sensorHandle, const void *cookie);
 
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+  /**
+   * Sets how far back a nanoapp needs the samples of a continuous sensor to
+   * be retained in its history. The history of a sensor covers the longest
+   * duration requested by the nanoapps with a request for it, within the
+   * memory budget of CHRE_SENSOR_HISTORY_MAX_BYTES shared by all sensors.
+   *
+   * @param nanoapp A non-null pointer to the nanoapp making this request.
+   * @param sensorHandle The handle of a sensor the nanoapp has a request for.
+   * @param duration The duration of samples to retain, or 0 to cancel the
+   *     nanoapp's previous configuration.
+   *
+   * @return false if the sensor handle is invalid, the nanoapp has no request
+   *     for the sensor, or the samples of the duration don't fit in the
+   *     memory budget.
+   */
+  bool configureHistory(Nanoapp *nanoapp, uint32_t sensorHandle,
+                        Nanoseconds duration);
+
+  /**
+   * Looks up the retained samples of a sensor in a time range, without
+   * copying them. Must only be called from the context of the main CHRE
+   * thread.
+   *
+   * @param sensorHandle The handle of the sensor.
+   * @param startTime The timestamp of the oldest sample to include.
+   * @param endTime The timestamp of the newest sample to include.
+   * @param history A non-null pointer to populate with the samples.
+   *
+   * @return false if the sensor handle is invalid or the samples of the
+   *     sensor aren't retained.
+   */
+  bool getHistory(uint32_t sensorHandle, Nanoseconds startTime,
+                  Nanoseconds endTime, struct chreSensorHistory *history) const;
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
+
   /**
    * Invoked by the PlatformSensorManager when a flush complete event is
    * received for a given sensor for a request done through flushAsync(). This
@@ -212,6 +256,15 @@ class SensorRequestManager : public NonCopyable {
    * Invoked by the PlatformSensorManager when a sensor event is received for a
    * given sensor. This method should be invoked from the same thread.
    *
+   * If CHRE_SENSOR_DATA_DECIMATION_ENABLED is defined and some nanoapps
+   * requested a longer interval than a continuous sensor samples at, those
+   * nanoapps receive only the samples due at their interval, and the others
+   * share the platform event.
+   *
+   * If CHRE_SENSOR_HISTORY_ENABLED is defined and the samples of the sensor
+   * are retained, the event is added to the sensor's history from the context
+   * of the main CHRE thread before it is posted to nanoapps.
+   *
    * @param sensorHandle The sensor handle this data event is from.
    * @param event the event data formatted as one of the chreSensorXXXData
    *     defined in the CHRE API, implicitly specified by sensorHandle.
@@ -320,6 +373,64 @@ class SensorRequestManager : public NonCopyable {
     SensorMode mode;
   };
 
+#ifdef CHRE_SENSOR_DATA_DECIMATION_ENABLED
+  //! A nanoapp with a request for a continuous sensor that samples faster than
+  //! some of the nanoapps requested.
+  struct SensorDataSubscriber {
+    SensorDataSubscriber(uint32_t handle, uint32_t id)
+        : sensorHandle(handle), instanceId(id) {}
+
+    uint32_t sensorHandle;
+    uint32_t instanceId;
+
+    //! Set if the nanoapp requested a longer interval than the sensor samples
+    //! at, in which case it receives a copy of the samples due at its interval
+    //! rather than the platform event.
+    Optional<SensorDataDecimator> decimator;
+  };
+
+  //! A platform data event posted to several nanoapps, released back to the
+  //! platform once all of them processed it.
+  struct SharedSensorDataEvent {
+    explicit SharedSensorDataEvent(void *eventData) : event(eventData) {}
+
+    void *event;
+    uint32_t refCount = 1;
+  };
+
+  //! The minimum ratio of a nanoapp's requested interval to the interval the
+  //! sensor samples at for the nanoapp to receive decimated data.
+  static constexpr uint64_t kMinDecimationFactor = 2;
+
+  //! The subscribers of the continuous sensors with at least one nanoapp
+  //! receiving decimated data. Updated in the context of the CHRE thread when
+  //! requests change, and used when data events are received.
+  DynamicVector<SensorDataSubscriber> mSensorDataSubscribers;
+  Mutex mSensorDataSubscribersMutex;
+
+  //! The platform data events currently posted to several nanoapps. If full,
+  //! new data events are broadcast without decimation.
+  static constexpr size_t kMaxSharedSensorDataEvents = 16;
+  FixedSizeVector<SharedSensorDataEvent, kMaxSharedSensorDataEvents>
+      mSharedSensorDataEvents;
+  Mutex mSharedSensorDataEventsMutex;
+#endif  // CHRE_SENSOR_DATA_DECIMATION_ENABLED
+
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+  //! A nanoapp's configuration of the history of a sensor.
+  struct SensorHistoryRequest {
+    SensorHistoryRequest(uint32_t handle, uint32_t id, Nanoseconds durationIn)
+        : sensorHandle(handle), instanceId(id), duration(durationIn) {}
+
+    uint32_t sensorHandle;
+    uint32_t instanceId;
+    Nanoseconds duration;
+  };
+
+  //! The history configurations of nanoapps with a request for the sensor.
+  DynamicVector<SensorHistoryRequest> mSensorHistoryRequests;
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
+
   //! The list of all sensors
   DynamicVector<Sensor> mSensors;
 
@@ -499,6 +610,81 @@ class SensorRequestManager : public NonCopyable {
    */
   uint16_t getActiveTargetGroupMask(uint32_t nanoappInstanceId,
                                     uint8_t sensorType);
+
+#ifdef CHRE_SENSOR_DATA_DECIMATION_ENABLED
+  /**
+   * Updates the subscribers of a sensor after its requests changed, keeping
+   * the decimation state of the nanoapps whose request is still decimated.
+   * Must be invoked from the context of the CHRE thread.
+   *
+   * @param sensorHandle The handle of the sensor whose requests changed.
+   */
+  void updateSensorDataSubscribers(uint32_t sensorHandle);
+
+  /**
+   * Posts a data event to each subscriber of a sensor, as a shared platform
+   * event or a decimated copy.
+   *
+   * @param sensorHandle The handle of the sensor the event is from.
+   * @param event The platform data event.
+   * @return false if the sensor has no decimated subscriber or too many events
+   *     are already shared, in which case the event must be broadcast instead.
+   */
+  bool postSensorDataToSubscribers(uint32_t sensorHandle, void *event);
+
+  /**
+   * Drops a reference to a shared platform data event.
+   *
+   * @param eventData The platform data event.
+   * @return true if the event must now be released back to the platform, i.e.
+   *     this was the last reference or the event isn't shared.
+   */
+  bool releaseSharedSensorDataEvent(void *eventData);
+#endif  // CHRE_SENSOR_DATA_DECIMATION_ENABLED
+
+  /**
+   * Posts a data event of a sensor to the nanoapps with a request for it.
+   *
+   * @param sensorHandle The handle of the sensor the event is from.
+   * @param event The platform data event.
+   */
+  void postSensorDataEvent(uint32_t sensorHandle, void *event);
+
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+  /**
+   * Resizes the history of a sensor after its history configurations or its
+   * requests changed, to hold the longest configured duration or as much of
+   * it as fits in the memory budget. Must be invoked from the context of the
+   * CHRE thread.
+   *
+   * @param sensorHandle The handle of the sensor.
+   */
+  void updateSensorHistory(uint32_t sensorHandle);
+
+  /**
+   * @param sensor The sensor.
+   * @param duration The duration of samples to retain.
+   * @return The number of samples the sensor produces in the duration at the
+   *     interval it samples at, or at its minimum interval if the interval
+   *     is chosen by the platform.
+   */
+  size_t getSensorHistoryCapacity(const Sensor &sensor,
+                                  Nanoseconds duration) const;
+
+  /**
+   * Removes the history configurations of a sensor.
+   *
+   * @param sensorHandle The handle of the sensor.
+   * @param instanceId The instance ID of the nanoapp whose configuration to
+   *     remove, or kBroadcastInstanceId to remove all of them.
+   */
+  void removeSensorHistoryRequests(uint32_t sensorHandle, uint32_t instanceId);
+
+  /**
+   * @return The number of bytes held by the histories of all sensors.
+   */
+  size_t getSensorHistoryMemorySize() const;
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
 };
 
 }  // namespace chre
@@ -17,16 +17,31 @@
 #ifndef CHRE_CORE_SENSOR_REQUEST_MULTIPLEXER_H_
 #define CHRE_CORE_SENSOR_REQUEST_MULTIPLEXER_H_
 
-#include "chre/core/request_multiplexer.h"
 #include "chre/core/sensor_request.h"
 
+#ifdef CHRE_INCREMENTAL_SENSOR_MULTIPLEXER_ENABLED
+#include "chre/core/incremental_request_multiplexer.h"
+#include "chre/core/sensor_request_aggregate.h"
+#else
+#include "chre/core/request_multiplexer.h"
+#endif  // CHRE_INCREMENTAL_SENSOR_MULTIPLEXER_ENABLED
+
 namespace chre {
 
+#ifdef CHRE_INCREMENTAL_SENSOR_MULTIPLEXER_ENABLED
+typedef IncrementalRequestMultiplexer<SensorRequest, SensorRequestAggregate>
+    SensorRequestMultiplexerBase;
+#else
+typedef RequestMultiplexer<SensorRequest> SensorRequestMultiplexerBase;
+#endif  // CHRE_INCREMENTAL_SENSOR_MULTIPLEXER_ENABLED
+
 /**
  * Provides methods on top of the RequestMultiplexer class specific for working
- * with SensorRequest objects.
+ * with SensorRequest objects. If CHRE_INCREMENTAL_SENSOR_MULTIPLEXER_ENABLED is
+ * defined, the maximal request is maintained incrementally by an
+ * IncrementalRequestMultiplexer instead.
  */
-class SensorRequestMultiplexer : public RequestMultiplexer<SensorRequest> {
+class SensorRequestMultiplexer : public SensorRequestMultiplexerBase {
  public:
   /**
    * Searches through the list of sensor requests for a request owned by the
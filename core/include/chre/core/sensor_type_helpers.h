@@ -92,6 +92,14 @@ class SensorTypeHelpers : public PlatformSensorTypeHelpers {
    */
   static size_t getLastEventSize(uint8_t sensorType);
 
+  /**
+   * @param sensorType The sensorType of this sensor.
+   * @return The size of one element of the readings of the sensor's data
+   *     events, or 0 if the sample format isn't known to the framework (e.g.
+   *     for vendor sensor types).
+   */
+  static size_t getSampleSize(uint8_t sensorType);
+
   /**
    * @param sensorType The sensor type to obtain a string for.
    * @return A string representation of the sensor type.
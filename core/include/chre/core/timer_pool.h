@@ -23,8 +23,19 @@
 #include "chre/core/nanoapp.h"
 #include "chre/platform/mutex.h"
 #include "chre/platform/system_timer.h"
+#include "chre/util/lock_guard.h"
 #include "chre/util/non_copyable.h"
 #include "chre/util/priority_queue.h"
+#include "chre/util/system/debug_dump.h"
+#include "chre/util/timer_wheel.h"
+
+// The maximum amount of time a nanoapp timer may be delayed past its
+// expiration so that it fires together with other timers, reducing the number
+// of wakeups. The default of 0 disables coalescing. This value can be
+// overridden in the variant-specific makefile.
+#ifndef CHRE_NANOAPP_TIMER_SLACK_NS
+#define CHRE_NANOAPP_TIMER_SLACK_NS 0
+#endif
 
 namespace chre {
 
@@ -38,6 +49,10 @@ typedef uint32_t TimerHandle;
 
 /**
  * Tracks requests from CHRE apps for timed events.
+ *
+ * Outstanding requests are kept in a binary heap by default. If
+ * CHRE_TIMER_WHEEL_ENABLED is defined, they are kept in a TimerWheel instead,
+ * which makes setting, cancelling and rescheduling a timer O(1).
  */
 class TimerPool : public NonCopyable {
  public:
@@ -65,6 +80,19 @@ class TimerPool : public NonCopyable {
                     SystemCallbackType::FirstCallbackType, isOneShot);
   }
 
+  /**
+   * Changes how long nanoapp timers may be delayed past their expiration so
+   * that they fire together with other timers. Only affects the timers set
+   * afterwards.
+   *
+   * @param slack The slack of nanoapp timers, CHRE_NANOAPP_TIMER_SLACK_NS by
+   *        default.
+   */
+  void setNanoappTimerSlack(Nanoseconds slack) {
+    LockGuard<Mutex> lock(mMutex);
+    mNanoappTimerSlack = slack;
+  }
+
   /**
    * Requests a timer for a system callback. When the timer expires, the
    * specified SystemCallbackFunction will be processed in the context of the
@@ -107,6 +135,14 @@ class TimerPool : public NonCopyable {
     return cancelTimer(kSystemInstanceId, timerHandle);
   }
 
+  /**
+   * Prints state in a string buffer, including how many timers fired per
+   * wakeup of the system timer.
+   *
+   * @param debugDump The object that is printed into for debug dump logs.
+   */
+  void logStateToBuffer(DebugDumpWrapper &debugDump) const;
+
  private:
   /**
    * Tracks metadata associated with a request for a timed event.
@@ -118,6 +154,10 @@ class TimerPool : public NonCopyable {
     Nanoseconds expirationTime;
     Nanoseconds duration;
 
+    //! How long the timer may be delayed past expirationTime to coalesce it
+    //! with other timers.
+    Nanoseconds slack;
+
     //! The cookie pointer to be passed as an event to the requesting nanoapp,
     //! or data pointer for system callbacks.
     const void *cookie;
@@ -142,15 +182,6 @@ class TimerPool : public NonCopyable {
     bool operator>(const TimerRequest &request) const;
   };
 
-  //! The queue of outstanding timer requests.
-  PriorityQueue<TimerRequest, std::greater<TimerRequest>> mTimerRequests;
-
-  //! The underlying system timer used to schedule delayed callbacks.
-  SystemTimer mSystemTimer;
-
-  //! The next timer handle for generateTimerHandleLocked() to return.
-  TimerHandle mLastTimerHandle = CHRE_TIMER_INVALID;
-
   //! Max number of timers that can be requested.
   static constexpr size_t kMaxTimerRequests = 64;
 
@@ -165,12 +196,48 @@ class TimerPool : public NonCopyable {
   static_assert(kMaxNanoappTimers >= kNumReservedNanoappTimers,
                 "Max number of nanoapp timers is too small");
 
+#ifdef CHRE_TIMER_WHEEL_ENABLED
+  //! The outstanding timer requests, indexed by the low bits of their handle.
+  TimerWheel<TimerRequest, kMaxTimerRequests> mTimerRequests;
+
+  //! The number of bits of a timer handle that hold the index of the request
+  //! in mTimerRequests.
+  static constexpr uint32_t kTimerHandleIndexBits = 6;
+
+  static_assert(kMaxTimerRequests <= (1 << kTimerHandleIndexBits),
+                "Timer request index doesn't fit in a timer handle");
+
+  //! Incremented for every new timer, and stored in the upper bits of its
+  //! handle so that handles aren't immediately reused.
+  uint32_t mTimerHandleSequence = 0;
+#else
+  //! The queue of outstanding timer requests.
+  PriorityQueue<TimerRequest, std::greater<TimerRequest>> mTimerRequests;
+
+  //! The next timer handle for generateTimerHandleLocked() to return.
+  TimerHandle mLastTimerHandle = CHRE_TIMER_INVALID;
+
   //! Whether or not the timer handle generation logic needs to perform a
   //! search for a vacant timer handle.
   bool mGenerateTimerHandleMustCheckUniqueness = false;
+#endif  // CHRE_TIMER_WHEEL_ENABLED
+
+  //! The underlying system timer used to schedule delayed callbacks.
+  SystemTimer mSystemTimer;
+
+  //! The time mSystemTimer was last set to fire at.
+  Nanoseconds mScheduledWakeupTime;
+
+  //! The number of times expired timers were handled, and the number of timers
+  //! that expired in total, to measure the effect of timer slack.
+  uint32_t mNumExpiryPasses = 0;
+  uint32_t mNumExpiredTimers = 0;
 
   //! The mutex to lock when using this class.
-  Mutex mMutex;
+  mutable Mutex mMutex;
+
+  //! The slack given to nanoapp timers. System timers have no slack.
+  Nanoseconds mNanoappTimerSlack = Nanoseconds(CHRE_NANOAPP_TIMER_SLACK_NS);
 
   //! The number of active nanoapp timers.
   size_t mNumNanoappTimers = 0;
@@ -216,6 +283,26 @@ class TimerPool : public NonCopyable {
   TimerRequest *getTimerRequestByTimerHandleLocked(TimerHandle timerHandle,
                                                    size_t *index = nullptr);
 
+  /**
+   * Returns the timer request with the closest expiration time. mMutex must be
+   * acquired prior to calling this function.
+   *
+   * @return A pointer to the TimerRequest, or nullptr if there are none.
+   */
+  TimerRequest *getNextTimerRequestLocked();
+
+  /**
+   * Returns the latest time the system timer can fire at without delaying any
+   * timer request past its expiration time plus slack. Timers that expire
+   * before then are all handled together when it fires. mMutex must be
+   * acquired prior to calling this function, and there must be at least one
+   * timer request.
+   *
+   * @return The time to set the system timer for.
+   */
+  Nanoseconds getNextWakeupTimeLocked();
+
+#ifndef CHRE_TIMER_WHEEL_ENABLED
   /**
    * Obtains a unique timer handle to return to an app requesting a timer.
    * mMutex must be acquired prior to calling this function.
@@ -232,6 +319,7 @@ class TimerPool : public NonCopyable {
    * @return A guaranteed unique timer handle.
    */
   TimerHandle generateUniqueTimerHandleLocked();
+#endif  // CHRE_TIMER_WHEEL_ENABLED
 
   /**
    * Helper function to determine whether a new timer of the specified type
@@ -243,15 +331,17 @@ class TimerPool : public NonCopyable {
   bool isNewTimerAllowedLocked(bool isNanoappTimer) const;
 
   /**
-   * Inserts a TimerRequest into the list of active timer requests. The order of
-   * mTimerRequests is always maintained such that the timer request with the
-   * closest expiration time is at the front of the list. mMutex must be
-   * acquired prior to calling this function.
+   * Inserts a new TimerRequest into the list of active timer requests, and
+   * assigns it a unique timer handle. The order of mTimerRequests is always
+   * maintained such that getNextTimerRequestLocked() returns the timer request
+   * with the closest expiration time. mMutex must be acquired prior to calling
+   * this function.
    *
-   * @param timerRequest The timer request being inserted into the list.
+   * @param timerRequest The timer request being inserted into the list. Its
+   *        timerHandle is populated on success.
    * @return true if insertion of timer succeeds.
    */
-  bool insertTimerRequestLocked(const TimerRequest &timerRequest);
+  bool insertTimerRequestLocked(TimerRequest &timerRequest);
 
   /**
    * Pops the TimerRequest at the front of the list. mMutex must be acquired
@@ -259,11 +349,21 @@ class TimerPool : public NonCopyable {
    */
   void popTimerRequestLocked();
 
+  /**
+   * Moves the TimerRequest at the front of the list to a new expiration time,
+   * keeping its timer handle. mMutex must be acquired prior to calling this
+   * function.
+   *
+   * @param expirationTime The new expiration time of the request.
+   */
+  void rescheduleNextTimerRequestLocked(Nanoseconds expirationTime);
+
   /**
    * Removes the TimerRequest at the specified index of the list. mMutex must be
    * acquired prior to calling this function.
    *
-   * @param index The index of the TimerRequest to remove.
+   * @param index The index of the TimerRequest to remove, as populated by
+   *        getTimerRequestByTimerHandleLocked().
    */
   void removeTimerRequestLocked(size_t index);
 
@@ -283,6 +383,17 @@ class TimerPool : public NonCopyable {
    */
   bool handleExpiredTimersAndScheduleNextLocked();
 
+  /**
+   * Determines when a periodic timer that expired expires next.
+   *
+   * @param timerRequest The periodic timer request.
+   * @param currentTime The time at which the expiry is being handled.
+   * @return The first expiration time after currentTime that is a whole number
+   *         of periods after the previous expiration time.
+   */
+  static Nanoseconds getNextPeriodicExpirationTime(
+      const TimerRequest &timerRequest, Nanoseconds currentTime);
+
   /**
    * This static method handles the callback from the system timer. The data
    * pointer here is the TimerPool instance.
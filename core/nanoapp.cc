@@ -47,40 +47,64 @@ Nanoapp::~Nanoapp() {
     LOGE("Nanoapp ID=0x%016" PRIx64 " still has %zu allocated bytes!",
          getAppId(), totalAllocatedBytes);
   }
+
+  setBroadcastEventIndex(nullptr);
 }
 
-bool Nanoapp::isRegisteredForBroadcastEvent(uint16_t eventType,
-                                            uint16_t targetGroupIdMask) const {
-  bool registered = false;
-  size_t foundIndex = registrationIndex(eventType);
-  if (foundIndex < mRegisteredEvents.size()) {
-    const EventRegistration &reg = mRegisteredEvents[foundIndex];
-    if (targetGroupIdMask & reg.groupIdMask) {
-      registered = true;
+void Nanoapp::setBroadcastEventIndex(BroadcastEventIndex *index) {
+  if (mBroadcastEventIndex != nullptr) {
+    mBroadcastEventIndex->removeNanoapp(this);
+  }
+
+  mBroadcastEventIndex = index;
+  if (mBroadcastEventIndex != nullptr) {
+    for (const auto &reg : mRegisteredEvents) {
+      if (!mBroadcastEventIndex->setSubscription(this, reg.key, reg.value)) {
+        FATAL_ERROR_OOM();
+      }
     }
   }
-  return registered;
+}
+
+bool Nanoapp::isRegisteredForBroadcastEvent(uint16_t eventType,
+                                            uint16_t targetGroupIdMask) const {
+  auto reg = mRegisteredEvents.find(eventType);
+  return (reg != mRegisteredEvents.end() &&
+          (targetGroupIdMask & reg->value) != 0);
 }
 
 void Nanoapp::registerForBroadcastEvent(uint16_t eventType,
                                         uint16_t groupIdMask) {
-  size_t foundIndex = registrationIndex(eventType);
-  if (foundIndex < mRegisteredEvents.size()) {
-    mRegisteredEvents[foundIndex].groupIdMask |= groupIdMask;
-  } else if (!mRegisteredEvents.push_back(
-                 EventRegistration(eventType, groupIdMask))) {
+  auto reg = mRegisteredEvents.find(eventType);
+  if (reg != mRegisteredEvents.end()) {
+    reg->value |= groupIdMask;
+  } else {
+    reg = mRegisteredEvents.insertOrAssign(eventType, groupIdMask);
+    if (reg == mRegisteredEvents.end()) {
+      FATAL_ERROR_OOM();
+    }
+  }
+
+  if (mBroadcastEventIndex != nullptr &&
+      !mBroadcastEventIndex->setSubscription(this, eventType, reg->value)) {
     FATAL_ERROR_OOM();
   }
 }
 
 void Nanoapp::unregisterForBroadcastEvent(uint16_t eventType,
                                           uint16_t groupIdMask) {
-  size_t foundIndex = registrationIndex(eventType);
-  if (foundIndex < mRegisteredEvents.size()) {
-    EventRegistration &reg = mRegisteredEvents[foundIndex];
-    reg.groupIdMask &= ~groupIdMask;
-    if (reg.groupIdMask == 0) {
-      mRegisteredEvents.erase(foundIndex);
+  auto reg = mRegisteredEvents.find(eventType);
+  if (reg != mRegisteredEvents.end()) {
+    reg->value &= ~groupIdMask;
+    uint16_t remainingMask = reg->value;
+    if (remainingMask == 0) {
+      mRegisteredEvents.erase(reg);
+    }
+
+    if (mBroadcastEventIndex != nullptr &&
+        !mBroadcastEventIndex->setSubscription(this, eventType,
+                                               remainingMask)) {
+      FATAL_ERROR_OOM();
     }
   }
 }
@@ -170,6 +194,15 @@ void Nanoapp::logStateToBuffer(DebugDumpWrapper &debugDump) const {
   }
   // Earliest bucket gets no comma
   debugDump.print("%" PRIu16 " ]\n", mWakeupBuckets.front());
+
+#ifdef CHRE_EVENT_LATENCY_STATS_ENABLED
+  debugDump.print("   events=%" PRIu32 " queueLatency: ",
+                  mHandleDurationHistogram.getCount());
+  mQueueLatencyHistogram.logStateToBuffer(debugDump);
+  debugDump.print(" handleTime: ");
+  mHandleDurationHistogram.logStateToBuffer(debugDump);
+  debugDump.print("\n");
+#endif  // CHRE_EVENT_LATENCY_STATS_ENABLED
 }
 
 bool Nanoapp::permitPermissionUse(uint32_t permission) const {
@@ -177,17 +210,6 @@ bool Nanoapp::permitPermissionUse(uint32_t permission) const {
          ((getAppPermissions() & permission) == permission);
 }
 
-size_t Nanoapp::registrationIndex(uint16_t eventType) const {
-  size_t foundIndex = 0;
-  for (; foundIndex < mRegisteredEvents.size(); ++foundIndex) {
-    const EventRegistration &reg = mRegisteredEvents[foundIndex];
-    if (reg.eventType == eventType) {
-      break;
-    }
-  }
-  return foundIndex;
-}
-
 void Nanoapp::handleGnssMeasurementDataEvent(const Event *event) {
 #ifdef CHRE_GNSS_MEASUREMENT_BACK_COMPAT_ENABLED
   const struct chreGnssDataEvent *data =
@@ -44,6 +44,13 @@ Sensor &Sensor::operator=(Sensor &&other) {
   mLastEventValid = other.mLastEventValid;
   other.mLastEventValid = false;
 
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+  mHistory = std::move(other.mHistory);
+
+  mHistoryEnabled = other.mHistoryEnabled.load();
+  other.mHistoryEnabled = false;
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
+
   return *this;
 }
 
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/core/sensor_data_decimator.h"
+
+#include <cstring>
+
+#include "chre/platform/assert.h"
+#include "chre/platform/log.h"
+#include "chre/platform/memory.h"
+
+namespace chre {
+namespace {
+
+// The readings of all sensor data events start right after the header, and
+// each reading starts with its uint32_t timestamp delta.
+static_assert(offsetof(chreSensorThreeAxisData, readings) ==
+                  sizeof(chreSensorDataHeader),
+              "Three axis readings don't follow the header");
+static_assert(offsetof(chreSensorFloatData, readings) ==
+                  sizeof(chreSensorDataHeader),
+              "Float readings don't follow the header");
+static_assert(offsetof(chreSensorByteData, readings) ==
+                  sizeof(chreSensorDataHeader),
+              "Byte readings don't follow the header");
+
+const uint8_t *getReading(const ChreSensorData *event, size_t sampleSize,
+                          size_t index) {
+  return reinterpret_cast<const uint8_t *>(event) +
+         sizeof(chreSensorDataHeader) + index * sampleSize;
+}
+
+uint32_t getTimestampDelta(const uint8_t *reading) {
+  uint32_t timestampDelta;
+  memcpy(&timestampDelta, reading, sizeof(timestampDelta));
+  return timestampDelta;
+}
+
+}  // anonymous namespace
+
+SensorDataDecimator::SensorDataDecimator(uint64_t intervalNs,
+                                         uint64_t toleranceNs) {
+  setInterval(intervalNs, toleranceNs);
+}
+
+void SensorDataDecimator::setInterval(uint64_t intervalNs,
+                                      uint64_t toleranceNs) {
+  CHRE_ASSERT(toleranceNs < intervalNs);
+  mIntervalNs = intervalNs;
+  mSpacingNs = (toleranceNs < intervalNs) ? intervalNs - toleranceNs : 0;
+}
+
+template <typename Callback>
+void SensorDataDecimator::forEachDueSample(const ChreSensorData *event,
+                                           size_t sampleSize,
+                                           uint64_t spacingNs,
+                                           uint64_t *nextSampleTimeNs,
+                                           Callback callback) {
+  uint16_t readingCount = event->header.readingCount;
+  uint64_t timestampNs = event->header.baseTimestamp;
+  uint64_t nextTimestampNs =
+      timestampNs + getTimestampDelta(getReading(event, sampleSize, 0));
+  bool hasSelected = false;
+  uint64_t lastSelectedNs = 0;
+  for (uint16_t i = 0; i < readingCount; i++) {
+    timestampNs = nextTimestampNs;
+    if (i + 1 < readingCount) {
+      nextTimestampNs =
+          timestampNs + getTimestampDelta(getReading(event, sampleSize, i + 1));
+    }
+
+    bool isLast = (i + 1 == readingCount);
+    if (timestampNs >= *nextSampleTimeNs ||
+        (hasSelected && !isLast &&
+         nextTimestampNs - lastSelectedNs > UINT32_MAX)) {
+      callback(i, timestampNs);
+      hasSelected = true;
+      lastSelectedNs = timestampNs;
+      *nextSampleTimeNs = timestampNs + spacingNs;
+    }
+  }
+}
+
+ChreSensorData *SensorDataDecimator::decimate(const ChreSensorData *event,
+                                              size_t sampleSize) {
+  CHRE_ASSERT(event != nullptr);
+  CHRE_ASSERT(sampleSize >= sizeof(uint32_t));
+
+  ChreSensorData *decimatedEvent = nullptr;
+  if (event->header.readingCount > 0) {
+    size_t numDueSamples = 0;
+    uint64_t nextSampleTimeNs = mNextSampleTimeNs;
+    forEachDueSample(event, sampleSize, mSpacingNs, &nextSampleTimeNs,
+                     [&](uint16_t /* index */, uint64_t /* timestampNs */) {
+                       numDueSamples++;
+                     });
+
+    if (numDueSamples > 0) {
+      decimatedEvent = static_cast<ChreSensorData *>(memoryAlloc(
+          sizeof(chreSensorDataHeader) + numDueSamples * sampleSize));
+      if (decimatedEvent == nullptr) {
+        LOG_OOM();
+      } else {
+        // The selected samples are written right after one another, with the
+        // base timestamp set to the first of them.
+        decimatedEvent->header = event->header;
+        decimatedEvent->header.readingCount =
+            static_cast<uint16_t>(numDueSamples);
+        uint8_t *reading = reinterpret_cast<uint8_t *>(decimatedEvent) +
+                           sizeof(chreSensorDataHeader);
+        uint64_t previousTimestampNs = 0;
+        bool isFirst = true;
+        forEachDueSample(
+            event, sampleSize, mSpacingNs, &mNextSampleTimeNs,
+            [&](uint16_t index, uint64_t timestampNs) {
+              if (isFirst) {
+                decimatedEvent->header.baseTimestamp = timestampNs;
+                previousTimestampNs = timestampNs;
+                isFirst = false;
+              }
+              memcpy(reading, getReading(event, sampleSize, index),
+                     sampleSize);
+              uint32_t timestampDelta =
+                  static_cast<uint32_t>(timestampNs - previousTimestampNs);
+              memcpy(reading, &timestampDelta, sizeof(timestampDelta));
+              previousTimestampNs = timestampNs;
+              reading += sampleSize;
+            });
+      }
+    }
+  }
+
+  return decimatedEvent;
+}
+
+}  // namespace chre
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/core/sensor_history.h"
+
+#include <cstring>
+#include <utility>
+
+#include "chre/platform/assert.h"
+#include "chre/platform/log.h"
+#include "chre/platform/memory.h"
+
+namespace chre {
+
+SensorHistory::SensorHistory(SensorHistory &&other) {
+  *this = std::move(other);
+}
+
+SensorHistory &SensorHistory::operator=(SensorHistory &&other) {
+  memoryFree(mSamples);
+
+  mSamples = other.mSamples;
+  mCapacity = other.mCapacity;
+  mSampleSize = other.mSampleSize;
+  mHead = other.mHead;
+  mSize = other.mSize;
+  mNewestTimestampNs = other.mNewestTimestampNs;
+
+  other.mSamples = nullptr;
+  other.mCapacity = 0;
+  other.mSize = 0;
+
+  return *this;
+}
+
+SensorHistory::~SensorHistory() {
+  memoryFree(mSamples);
+}
+
+bool SensorHistory::resize(size_t capacity, size_t sampleSize) {
+  CHRE_ASSERT(capacity <= UINT16_MAX);
+  CHRE_ASSERT(capacity == 0 || sampleSize >= sizeof(uint32_t));
+
+  bool success = true;
+  if (capacity != mCapacity || sampleSize != mSampleSize) {
+    uint8_t *samples = nullptr;
+    if (capacity > UINT16_MAX) {
+      success = false;
+    } else if (capacity > 0) {
+      samples = static_cast<uint8_t *>(memoryAlloc(capacity * sampleSize));
+      if (samples == nullptr) {
+        LOG_OOM();
+        success = false;
+      }
+    }
+
+    if (success) {
+      size_t numKept = 0;
+      if (sampleSize == mSampleSize) {
+        numKept = (mSize < capacity) ? mSize : capacity;
+      }
+      for (size_t i = 0; i < numKept; i++) {
+        memcpy(samples + i * sampleSize, getSample(mSize - numKept + i),
+               sampleSize);
+      }
+
+      memoryFree(mSamples);
+      mSamples = samples;
+      mCapacity = capacity;
+      mSampleSize = sampleSize;
+      mHead = 0;
+      mSize = numKept;
+    }
+  }
+
+  return success;
+}
+
+void SensorHistory::addSamples(const ChreSensorData *event) {
+  CHRE_ASSERT(event != nullptr);
+
+  if (mCapacity > 0) {
+    const uint8_t *reading =
+        reinterpret_cast<const uint8_t *>(event) + sizeof(chreSensorDataHeader);
+    uint64_t timestampNs = event->header.baseTimestamp;
+    for (uint16_t i = 0; i < event->header.readingCount; i++) {
+      uint32_t timestampDelta;
+      memcpy(&timestampDelta, reading, sizeof(timestampDelta));
+      timestampNs += timestampDelta;
+      addSample(reading, timestampNs);
+      reading += mSampleSize;
+    }
+  }
+}
+
+void SensorHistory::getRange(uint64_t startTimeNs, uint64_t endTimeNs,
+                             struct chreSensorHistory *history) const {
+  CHRE_ASSERT(history != nullptr);
+
+  memset(history, 0, sizeof(*history));
+
+  // Walk back from the newest sample, which only touches the samples newer
+  // than startTimeNs. After each step, timestampNs is the timestamp of the
+  // sample before the current position.
+  size_t end = mSize;
+  uint64_t timestampNs = mNewestTimestampNs;
+  while (end > 0 && timestampNs > endTimeNs) {
+    timestampNs -= getTimestampDelta(end - 1);
+    end--;
+  }
+
+  size_t begin = end;
+  while (begin > 0 && timestampNs >= startTimeNs) {
+    timestampNs -= getTimestampDelta(begin - 1);
+    begin--;
+  }
+
+  if (begin < end) {
+    size_t position = (mHead + begin) % mCapacity;
+    size_t count = end - begin;
+    size_t firstRunCount = mCapacity - position;
+    if (firstRunCount > count) {
+      firstRunCount = count;
+    }
+
+    history->baseTimestamp = timestampNs;
+    history->readings[0] = mSamples + position * mSampleSize;
+    history->readingCount[0] = static_cast<uint16_t>(firstRunCount);
+    if (count > firstRunCount) {
+      history->readings[1] = mSamples;
+      history->readingCount[1] = static_cast<uint16_t>(count - firstRunCount);
+    }
+  }
+}
+
+uint64_t SensorHistory::getOldestTimestampNs() const {
+  uint64_t timestampNs = mNewestTimestampNs;
+  for (size_t i = mSize; i > 1; i--) {
+    timestampNs -= getTimestampDelta(i - 1);
+  }
+  return timestampNs;
+}
+
+uint32_t SensorHistory::getTimestampDelta(size_t index) const {
+  uint32_t timestampDelta;
+  memcpy(&timestampDelta, getSample(index), sizeof(timestampDelta));
+  return timestampDelta;
+}
+
+void SensorHistory::addSample(const uint8_t *reading, uint64_t timestampNs) {
+  // Samples that can't be chained to the previous ones through their
+  // timestamp delta start a new history.
+  if (mSize > 0 && (timestampNs < mNewestTimestampNs ||
+                    timestampNs - mNewestTimestampNs > UINT32_MAX)) {
+    mSize = 0;
+  }
+
+  uint32_t timestampDelta = 0;
+  if (mSize > 0) {
+    timestampDelta = static_cast<uint32_t>(timestampNs - mNewestTimestampNs);
+  }
+
+  if (mSize == mCapacity) {
+    mHead = (mHead + 1) % mCapacity;
+    mSize--;
+  }
+
+  uint8_t *sample = getSample(mSize);
+  memcpy(sample, reading, mSampleSize);
+  memcpy(sample, &timestampDelta, sizeof(timestampDelta));
+  mSize++;
+  mNewestTimestampNs = timestampNs;
+}
+
+}  // namespace chre
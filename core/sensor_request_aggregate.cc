@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/core/sensor_request_aggregate.h"
+
+#include <algorithm>
+
+#include "chre/platform/assert.h"
+
+namespace chre {
+namespace {
+
+//! The order of the modes from highest to lowest priority, as used by
+//! SensorRequest::mergeWith().
+constexpr SensorMode kModesByPriority[] = {
+    SensorMode::ActiveContinuous,
+    SensorMode::ActiveOneShot,
+    SensorMode::PassiveContinuous,
+    SensorMode::PassiveOneShot,
+};
+
+bool reserveCounts(FlatMap<uint64_t, size_t> *counts, size_t numRequests) {
+  // Grow geometrically so that reserving for each new request is amortized
+  // O(1).
+  return (counts->capacity() >= numRequests ||
+          counts->reserve(std::max(numRequests, 2 * counts->capacity())));
+}
+
+void updateCounter(size_t *counter, bool add) {
+  if (add) {
+    (*counter)++;
+  } else {
+    CHRE_ASSERT(*counter > 0);
+    (*counter)--;
+  }
+}
+
+void updateCount(FlatMap<uint64_t, size_t> *counts, uint64_t value, bool add) {
+  auto it = counts->find(value);
+  if (add) {
+    if (it != counts->end()) {
+      it->value++;
+    } else {
+      // Can't fail as enough capacity was reserved for every request.
+      auto inserted = counts->insertOrAssign(value, 1);
+      CHRE_ASSERT(inserted != counts->end());
+    }
+  } else {
+    CHRE_ASSERT(it != counts->end());
+    if (it != counts->end() && --it->value == 0) {
+      counts->erase(it);
+    }
+  }
+}
+
+}  // namespace
+
+bool SensorRequestAggregate::reserve(size_t numRequests) {
+  return reserveCounts(&mIntervals, numRequests) &&
+         reserveCounts(&mLatencies, numRequests) &&
+         reserveCounts(&mBatchIntervals, numRequests);
+}
+
+void SensorRequestAggregate::add(const SensorRequest &request) {
+  update(request, true /* add */);
+}
+
+void SensorRequestAggregate::remove(const SensorRequest &request) {
+  update(request, false /* add */);
+}
+
+void SensorRequestAggregate::clear() {
+  mIntervals.clear();
+  mLatencies.clear();
+  mBatchIntervals.clear();
+  std::fill(mModeCounts, mModeCounts + kNumSensorModes, 0);
+  mNumIntervalOnlyRequests = 0;
+  mNumLatencyOnlyRequests = 0;
+  mNumBiasRequests = 0;
+}
+
+bool SensorRequestAggregate::getMaximalRequest(
+    SensorRequest *maximalRequest) const {
+  CHRE_ASSERT(maximalRequest);
+
+  // If one request only sets an interval and another only sets a latency,
+  // mergeWith() combines them into a batch interval unless a request that
+  // sets both comes first, so the result depends on their order.
+  bool orderDependent =
+      (mNumIntervalOnlyRequests > 0 && mNumLatencyOnlyRequests > 0);
+  if (!orderDependent) {
+    SensorMode mode = SensorMode::Off;
+    for (SensorMode modeByPriority : kModesByPriority) {
+      if (mModeCounts[static_cast<size_t>(modeByPriority)] > 0) {
+        mode = modeByPriority;
+        break;
+      }
+    }
+
+    uint64_t interval = mIntervals.empty() ? CHRE_SENSOR_INTERVAL_DEFAULT
+                                           : mIntervals.begin()->key;
+    uint64_t latency;
+    if (!mBatchIntervals.empty()) {
+      latency = mBatchIntervals.begin()->key - interval;
+    } else {
+      latency = mLatencies.empty() ? CHRE_SENSOR_LATENCY_DEFAULT
+                                   : mLatencies.begin()->key;
+    }
+
+    // The latency is set separately to avoid capping it in the constructor,
+    // which mergeWith() does not do either.
+    *maximalRequest = SensorRequest(mode, Nanoseconds(interval),
+                                    Nanoseconds(CHRE_SENSOR_LATENCY_DEFAULT));
+    maximalRequest->setLatency(Nanoseconds(latency));
+    maximalRequest->setBiasUpdatesRequested(mNumBiasRequests > 0);
+  }
+
+  return !orderDependent;
+}
+
+void SensorRequestAggregate::update(const SensorRequest &request, bool add) {
+  // Requests that are off are ignored by mergeWith().
+  if (request.getMode() != SensorMode::Off) {
+    uint64_t interval = request.getInterval().toRawNanoseconds();
+    uint64_t latency = request.getLatency().toRawNanoseconds();
+    bool hasInterval = (interval != CHRE_SENSOR_INTERVAL_DEFAULT);
+    bool hasLatency = (latency != CHRE_SENSOR_LATENCY_DEFAULT);
+
+    if (hasInterval) {
+      updateCount(&mIntervals, interval, add);
+    }
+    if (hasLatency) {
+      updateCount(&mLatencies, latency, add);
+    }
+    if (hasInterval && hasLatency) {
+      updateCount(&mBatchIntervals, interval + latency, add);
+    } else if (hasInterval) {
+      updateCounter(&mNumIntervalOnlyRequests, add);
+    } else if (hasLatency) {
+      updateCounter(&mNumLatencyOnlyRequests, add);
+    }
+
+    updateCounter(&mModeCounts[static_cast<size_t>(request.getMode())], add);
+    if (request.getBiasUpdatesRequested()) {
+      updateCounter(&mNumBiasRequests, add);
+    }
+  }
+}
+
+}  // namespace chre
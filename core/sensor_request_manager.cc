@@ -17,6 +17,7 @@
 #include "chre/core/sensor_request_manager.h"
 
 #include "chre/core/event_loop_manager.h"
+#include "chre/util/lock_guard.h"
 #include "chre/util/macros.h"
 #include "chre/util/nested_data_ptr.h"
 #include "chre/util/system/debug_dump.h"
@@ -268,6 +269,17 @@ bool SensorRequestManager::setSensorRequest(
 
       if (success) {
         addSensorRequestLog(nanoapp->getInstanceId(), sensorHandle, request);
+#ifdef CHRE_SENSOR_DATA_DECIMATION_ENABLED
+        updateSensorDataSubscribers(sensorHandle);
+#endif  // CHRE_SENSOR_DATA_DECIMATION_ENABLED
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+        // The history is only retained for nanoapps with a request, and its
+        // capacity depends on the interval the sensor samples at.
+        if (request.getMode() == SensorMode::Off) {
+          removeSensorHistoryRequests(sensorHandle, nanoapp->getInstanceId());
+        }
+        updateSensorHistory(sensorHandle);
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
       }
     }
   }
@@ -312,6 +324,13 @@ bool SensorRequestManager::removeAllRequests(uint32_t sensorHandle) {
 
     cancelFlushRequests(sensorHandle);
     success = removeAllRequests(sensor);
+#ifdef CHRE_SENSOR_DATA_DECIMATION_ENABLED
+    updateSensorDataSubscribers(sensorHandle);
+#endif  // CHRE_SENSOR_DATA_DECIMATION_ENABLED
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+    removeSensorHistoryRequests(sensorHandle, kBroadcastInstanceId);
+    updateSensorHistory(sensorHandle);
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
   }
 
   return success;
@@ -434,8 +453,94 @@ bool SensorRequestManager::flushAsync(Nanoapp *nanoapp, uint32_t sensorHandle,
   return success;
 }
 
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+bool SensorRequestManager::configureHistory(Nanoapp *nanoapp,
+                                            uint32_t sensorHandle,
+                                            Nanoseconds duration) {
+  CHRE_ASSERT(nanoapp);
+
+  bool success = false;
+  size_t requestIndex;
+  if (sensorHandle >= mSensors.size()) {
+    LOG_INVALID_HANDLE(sensorHandle);
+  } else if (!mSensors[sensorHandle].isContinuous() ||
+             SensorTypeHelpers::getSampleSize(
+                 mSensors[sensorHandle].getSensorType()) == 0) {
+    LOGE("Sensor %s has no history", mSensors[sensorHandle].getSensorName());
+  } else if (mSensors[sensorHandle].getRequestMultiplexer().findRequest(
+                 nanoapp->getInstanceId(), &requestIndex) == nullptr) {
+    LOGE("Nanoapp ID %" PRIu32 " has no request for sensor %s",
+         nanoapp->getInstanceId(), mSensors[sensorHandle].getSensorName());
+  } else {
+    const Sensor &sensor = mSensors[sensorHandle];
+    uint32_t instanceId = nanoapp->getInstanceId();
+    Nanoseconds prevDuration(0);
+    for (const SensorHistoryRequest &request : mSensorHistoryRequests) {
+      if (request.sensorHandle == sensorHandle &&
+          request.instanceId == instanceId) {
+        prevDuration = request.duration;
+        break;
+      }
+    }
+
+    // The vector doesn't shrink on removal, so adding the request back can
+    // only fail if the nanoapp had no previous configuration.
+    removeSensorHistoryRequests(sensorHandle, instanceId);
+    if (duration.toRawNanoseconds() == 0) {
+      updateSensorHistory(sensorHandle);
+      success = true;
+    } else if (!mSensorHistoryRequests.emplace_back(sensorHandle, instanceId,
+                                                    duration)) {
+      LOG_OOM();
+    } else {
+      updateSensorHistory(sensorHandle);
+      success = sensor.isHistoryEnabled() &&
+                sensor.getHistory().getCapacity() >=
+                    getSensorHistoryCapacity(sensor, duration);
+      if (!success) {
+        LOGE("History of %" PRIu64 " ns of sensor %s exceeds memory budget",
+             duration.toRawNanoseconds(), sensor.getSensorName());
+        removeSensorHistoryRequests(sensorHandle, instanceId);
+        if (prevDuration.toRawNanoseconds() > 0) {
+          mSensorHistoryRequests.emplace_back(sensorHandle, instanceId,
+                                              prevDuration);
+        }
+        updateSensorHistory(sensorHandle);
+      }
+    }
+  }
+
+  return success;
+}
+
+bool SensorRequestManager::getHistory(uint32_t sensorHandle,
+                                      Nanoseconds startTime,
+                                      Nanoseconds endTime,
+                                      struct chreSensorHistory *history) const {
+  CHRE_ASSERT(history);
+
+  bool success = false;
+  if (sensorHandle >= mSensors.size()) {
+    LOG_INVALID_HANDLE(sensorHandle);
+  } else if (mSensors[sensorHandle].isHistoryEnabled()) {
+    mSensors[sensorHandle].getHistory().getRange(startTime.toRawNanoseconds(),
+                                                 endTime.toRawNanoseconds(),
+                                                 history);
+    success = true;
+  }
+
+  return success;
+}
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
+
 void SensorRequestManager::releaseSensorDataEvent(uint16_t eventType,
                                                   void *eventData) {
+#ifdef CHRE_SENSOR_DATA_DECIMATION_ENABLED
+  if (!releaseSharedSensorDataEvent(eventData)) {
+    return;
+  }
+#endif  // CHRE_SENSOR_DATA_DECIMATION_ENABLED
+
   // Remove all requests if it's a one-shot sensor and only after data has been
   // delivered to all clients.
   mPlatformSensorManager.releaseSensorDataEvent(eventData);
@@ -483,22 +588,40 @@ void SensorRequestManager::handleSensorDataEvent(uint32_t sensorHandle,
       updateLastEvent(event);
     }
 
-    uint16_t eventType =
-        getSampleEventTypeForSensorType(sensor.getSensorType());
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+    if (sensor.isHistoryEnabled()) {
+      // Add the samples to the history from the main thread, so that the
+      // samples nanoapps read from it don't change while they handle an event.
+      auto callback = [](uint16_t /*type*/, void *data, void *extraData) {
+        uint32_t cbSensorHandle = NestedDataPtr<uint32_t>(extraData);
+        SensorRequestManager &manager =
+            EventLoopManagerSingleton::get()->getSensorRequestManager();
+        Sensor &cbSensor = manager.mSensors[cbSensorHandle];
+        if (cbSensor.isHistoryEnabled()) {
+          cbSensor.getHistory().addSamples(
+              static_cast<const ChreSensorData *>(data));
+        }
+        manager.postSensorDataEvent(cbSensorHandle, data);
+      };
 
-    // Only allow dropping continuous sensor events since losing one-shot or
-    // on-change events could result in nanoapps stuck in a bad state.
-    if (sensor.isContinuous()) {
-      EventLoopManagerSingleton::get()
-          ->getEventLoop()
-          .postLowPriorityEventOrFree(eventType, event, sensorDataEventFree,
-                                      kSystemInstanceId, kBroadcastInstanceId,
-                                      sensor.getTargetGroupMask());
+      // Only continuous sensors have a history, so the event can be dropped
+      // like in postSensorDataEvent() if the event loop is running low on
+      // events or shutting down.
+      if (!EventLoopManagerSingleton::get()
+               ->getEventLoop()
+               .postLowPrioritySystemEvent(
+                   static_cast<uint16_t>(
+                       SystemCallbackType::SensorHistoryUpdate),
+                   event, callback, NestedDataPtr<uint32_t>(sensorHandle))) {
+        releaseSensorDataEvent(
+            getSampleEventTypeForSensorType(sensor.getSensorType()), event);
+      }
     } else {
-      EventLoopManagerSingleton::get()->getEventLoop().postEventOrDie(
-          eventType, event, sensorDataEventFree, kBroadcastInstanceId,
-          sensor.getTargetGroupMask());
+      postSensorDataEvent(sensorHandle, event);
     }
+#else   // CHRE_SENSOR_HISTORY_ENABLED
+    postSensorDataEvent(sensorHandle, event);
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
   }
 }
 
@@ -591,6 +714,30 @@ void SensorRequestManager::logStateToBuffer(DebugDumpWrapper &debugDump) const {
     }
     debugDump.print("\n");
   }
+
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+  debugDump.print("\n Sensor history: %zu/%zu bytes\n",
+                  getSensorHistoryMemorySize(),
+                  static_cast<size_t>(CHRE_SENSOR_HISTORY_MAX_BYTES));
+  for (const Sensor &sensor : mSensors) {
+    const SensorHistory &history = sensor.getHistory();
+    if (history.getCapacity() > 0) {
+      debugDump.print("  %s: samples=%zu/%zu bytes=%zu",
+                      sensor.getSensorName(), history.size(),
+                      history.getCapacity(), history.getMemorySize());
+      if (history.size() > 0) {
+        debugDump.print(" span=%" PRIu64, history.getNewestTimestampNs() -
+                                              history.getOldestTimestampNs());
+      }
+      debugDump.print("\n");
+    }
+  }
+  for (const SensorHistoryRequest &request : mSensorHistoryRequests) {
+    debugDump.print("  %s: nappId=%" PRIu32 " dur=%" PRIu64 "\n",
+                    mSensors[request.sensorHandle].getSensorName(),
+                    request.instanceId, request.duration.toRawNanoseconds());
+  }
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
 }
 
 void SensorRequestManager::postFlushCompleteEvent(uint32_t sensorHandle,
@@ -897,6 +1044,32 @@ bool SensorRequestManager::configurePlatformSensor(
   return success;
 }
 
+void SensorRequestManager::postSensorDataEvent(uint32_t sensorHandle,
+                                               void *event) {
+  const Sensor &sensor = mSensors[sensorHandle];
+  uint16_t eventType = getSampleEventTypeForSensorType(sensor.getSensorType());
+
+  // Only allow dropping continuous sensor events since losing one-shot or
+  // on-change events could result in nanoapps stuck in a bad state.
+  if (sensor.isContinuous()) {
+#ifdef CHRE_SENSOR_DATA_DECIMATION_ENABLED
+    if (postSensorDataToSubscribers(sensorHandle, event)) {
+      return;
+    }
+#endif  // CHRE_SENSOR_DATA_DECIMATION_ENABLED
+
+    EventLoopManagerSingleton::get()
+        ->getEventLoop()
+        .postLowPriorityEventOrFree(eventType, event, sensorDataEventFree,
+                                    kSystemInstanceId, kBroadcastInstanceId,
+                                    sensor.getTargetGroupMask());
+  } else {
+    EventLoopManagerSingleton::get()->getEventLoop().postEventOrDie(
+        eventType, event, sensorDataEventFree, kBroadcastInstanceId,
+        sensor.getTargetGroupMask());
+  }
+}
+
 uint16_t SensorRequestManager::getActiveTargetGroupMask(
     uint32_t nanoappInstanceId, uint8_t sensorType) {
   uint16_t mask = 0;
@@ -914,4 +1087,234 @@ uint16_t SensorRequestManager::getActiveTargetGroupMask(
   return mask;
 }
 
+#ifdef CHRE_SENSOR_DATA_DECIMATION_ENABLED
+void SensorRequestManager::updateSensorDataSubscribers(uint32_t sensorHandle) {
+  const Sensor &sensor = mSensors[sensorHandle];
+  const SensorRequest &maximalRequest = sensor.getMaximalRequest();
+  uint64_t sensorIntervalNs = maximalRequest.getInterval().toRawNanoseconds();
+
+  // Only continuous sensors with a known sample format and at least one
+  // nanoapp requesting a much longer interval than the sensor's are decimated.
+  bool needsDecimation = false;
+  if (sensor.isContinuous() && maximalRequest.getMode() != SensorMode::Off &&
+      sensorIntervalNs != CHRE_SENSOR_INTERVAL_DEFAULT &&
+      SensorTypeHelpers::getSampleSize(sensor.getSensorType()) > 0) {
+    for (const SensorRequest &request : sensor.getRequests()) {
+      uint64_t intervalNs = request.getInterval().toRawNanoseconds();
+      if (intervalNs != CHRE_SENSOR_INTERVAL_DEFAULT &&
+          intervalNs / kMinDecimationFactor >= sensorIntervalNs) {
+        needsDecimation = true;
+        break;
+      }
+    }
+  }
+
+  LockGuard<Mutex> lock(mSensorDataSubscribersMutex);
+  DynamicVector<SensorDataSubscriber> subscribers;
+  if (needsDecimation) {
+    for (const SensorRequest &request : sensor.getRequests()) {
+      if (!subscribers.emplace_back(sensorHandle, request.getInstanceId())) {
+        LOG_OOM();
+        subscribers.clear();
+        break;
+      }
+
+      uint64_t intervalNs = request.getInterval().toRawNanoseconds();
+      if (intervalNs != CHRE_SENSOR_INTERVAL_DEFAULT &&
+          intervalNs / kMinDecimationFactor >= sensorIntervalNs) {
+        Optional<SensorDataDecimator> &decimator = subscribers.back().decimator;
+        decimator = SensorDataDecimator(intervalNs, sensorIntervalNs / 2);
+        for (const SensorDataSubscriber &previous : mSensorDataSubscribers) {
+          if (previous.sensorHandle == sensorHandle &&
+              previous.instanceId == request.getInstanceId() &&
+              previous.decimator.has_value()) {
+            decimator = previous.decimator.value();
+            decimator->setInterval(intervalNs, sensorIntervalNs / 2);
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  for (size_t i = mSensorDataSubscribers.size(); i > 0; i--) {
+    if (mSensorDataSubscribers[i - 1].sensorHandle == sensorHandle) {
+      mSensorDataSubscribers.erase(i - 1);
+    }
+  }
+  for (const SensorDataSubscriber &subscriber : subscribers) {
+    if (!mSensorDataSubscribers.push_back(subscriber)) {
+      // Without all of its subscribers, the sensor's data is broadcast.
+      LOG_OOM();
+      for (size_t i = mSensorDataSubscribers.size(); i > 0; i--) {
+        if (mSensorDataSubscribers[i - 1].sensorHandle == sensorHandle) {
+          mSensorDataSubscribers.erase(i - 1);
+        }
+      }
+      break;
+    }
+  }
+}
+
+bool SensorRequestManager::postSensorDataToSubscribers(uint32_t sensorHandle,
+                                                       void *event) {
+  LockGuard<Mutex> lock(mSensorDataSubscribersMutex);
+  bool hasSubscribers = false;
+  for (const SensorDataSubscriber &subscriber : mSensorDataSubscribers) {
+    if (subscriber.sensorHandle == sensorHandle) {
+      hasSubscribers = true;
+      break;
+    }
+  }
+
+  if (hasSubscribers) {
+    // The reference added here is held until the event has been posted to all
+    // subscribers, as a subscriber may release it before this returns.
+    LockGuard<Mutex> sharedLock(mSharedSensorDataEventsMutex);
+    if (mSharedSensorDataEvents.full()) {
+      hasSubscribers = false;
+    } else {
+      mSharedSensorDataEvents.emplace_back(event);
+    }
+  }
+
+  if (hasSubscribers) {
+    const Sensor &sensor = mSensors[sensorHandle];
+    uint16_t eventType =
+        getSampleEventTypeForSensorType(sensor.getSensorType());
+    size_t sampleSize =
+        SensorTypeHelpers::getSampleSize(sensor.getSensorType());
+    const auto *sensorData = static_cast<const ChreSensorData *>(event);
+    EventLoop &eventLoop = EventLoopManagerSingleton::get()->getEventLoop();
+
+    for (SensorDataSubscriber &subscriber : mSensorDataSubscribers) {
+      if (subscriber.sensorHandle != sensorHandle) {
+        continue;
+      }
+
+      if (subscriber.decimator.has_value()) {
+        ChreSensorData *decimatedEvent =
+            subscriber.decimator->decimate(sensorData, sampleSize);
+        if (decimatedEvent != nullptr) {
+          eventLoop.postLowPriorityEventOrFree(
+              eventType, decimatedEvent, freeEventDataCallback,
+              kSystemInstanceId, subscriber.instanceId,
+              sensor.getTargetGroupMask());
+        }
+      } else {
+        {
+          LockGuard<Mutex> sharedLock(mSharedSensorDataEventsMutex);
+          for (SharedSensorDataEvent &sharedEvent : mSharedSensorDataEvents) {
+            if (sharedEvent.event == event) {
+              sharedEvent.refCount++;
+              break;
+            }
+          }
+        }
+        eventLoop.postLowPriorityEventOrFree(
+            eventType, event, sensorDataEventFree, kSystemInstanceId,
+            subscriber.instanceId, sensor.getTargetGroupMask());
+      }
+    }
+
+    if (releaseSharedSensorDataEvent(event)) {
+      mPlatformSensorManager.releaseSensorDataEvent(event);
+    }
+  }
+
+  return hasSubscribers;
+}
+
+bool SensorRequestManager::releaseSharedSensorDataEvent(void *eventData) {
+  bool isLastReference = true;
+  LockGuard<Mutex> lock(mSharedSensorDataEventsMutex);
+  for (size_t i = 0; i < mSharedSensorDataEvents.size(); i++) {
+    SharedSensorDataEvent &sharedEvent = mSharedSensorDataEvents[i];
+    if (sharedEvent.event == eventData) {
+      sharedEvent.refCount--;
+      isLastReference = (sharedEvent.refCount == 0);
+      if (isLastReference) {
+        mSharedSensorDataEvents.erase(i);
+      }
+      break;
+    }
+  }
+
+  return isLastReference;
+}
+#endif  // CHRE_SENSOR_DATA_DECIMATION_ENABLED
+
+#ifdef CHRE_SENSOR_HISTORY_ENABLED
+void SensorRequestManager::updateSensorHistory(uint32_t sensorHandle) {
+  Sensor &sensor = mSensors[sensorHandle];
+  Nanoseconds duration(0);
+  for (const SensorHistoryRequest &request : mSensorHistoryRequests) {
+    if (request.sensorHandle == sensorHandle && request.duration > duration) {
+      duration = request.duration;
+    }
+  }
+
+  size_t capacity = 0;
+  size_t sampleSize = SensorTypeHelpers::getSampleSize(sensor.getSensorType());
+  if (duration.toRawNanoseconds() > 0 && sampleSize > 0) {
+    // The histories of the other sensors are kept as they are, and this one
+    // retains as much of the duration as fits in the rest of the budget.
+    size_t otherMemorySize =
+        getSensorHistoryMemorySize() - sensor.getHistory().getMemorySize();
+    size_t availableMemorySize =
+        (otherMemorySize < CHRE_SENSOR_HISTORY_MAX_BYTES)
+            ? CHRE_SENSOR_HISTORY_MAX_BYTES - otherMemorySize
+            : 0;
+    capacity = getSensorHistoryCapacity(sensor, duration);
+    if (capacity > availableMemorySize / sampleSize) {
+      capacity = availableMemorySize / sampleSize;
+    }
+  }
+
+  if (capacity != sensor.getHistory().getCapacity() &&
+      !sensor.getHistory().resize(capacity, sampleSize)) {
+    LOG_OOM();
+  }
+  sensor.setHistoryEnabled(sensor.getHistory().getCapacity() > 0);
+}
+
+size_t SensorRequestManager::getSensorHistoryCapacity(
+    const Sensor &sensor, Nanoseconds duration) const {
+  const SensorRequest &maximalRequest = sensor.getMaximalRequest();
+  uint64_t intervalNs = maximalRequest.getInterval().toRawNanoseconds();
+  if (maximalRequest.getMode() == SensorMode::Off ||
+      intervalNs == CHRE_SENSOR_INTERVAL_DEFAULT ||
+      intervalNs < sensor.getMinInterval()) {
+    intervalNs = sensor.getMinInterval();
+  }
+
+  // Both ends of the duration are included.
+  uint64_t capacity = UINT16_MAX;
+  if (intervalNs > 0) {
+    capacity = duration.toRawNanoseconds() / intervalNs + 1;
+  }
+  return static_cast<size_t>((capacity < UINT16_MAX) ? capacity : UINT16_MAX);
+}
+
+void SensorRequestManager::removeSensorHistoryRequests(uint32_t sensorHandle,
+                                                       uint32_t instanceId) {
+  for (size_t i = mSensorHistoryRequests.size(); i > 0; i--) {
+    const SensorHistoryRequest &request = mSensorHistoryRequests[i - 1];
+    if (request.sensorHandle == sensorHandle &&
+        (instanceId == kBroadcastInstanceId ||
+         request.instanceId == instanceId)) {
+      mSensorHistoryRequests.erase(i - 1);
+    }
+  }
+}
+
+size_t SensorRequestManager::getSensorHistoryMemorySize() const {
+  size_t memorySize = 0;
+  for (const Sensor &sensor : mSensors) {
+    memorySize += sensor.getHistory().getMemorySize();
+  }
+  return memorySize;
+}
+#endif  // CHRE_SENSOR_HISTORY_ENABLED
+
 }  // namespace chre
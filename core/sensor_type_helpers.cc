@@ -129,6 +129,35 @@ size_t SensorTypeHelpers::getLastEventSize(uint8_t sensorType) {
   return 0;
 }
 
+size_t SensorTypeHelpers::getSampleSize(uint8_t sensorType) {
+  switch (sensorType) {
+    case CHRE_SENSOR_TYPE_ACCELEROMETER:
+    case CHRE_SENSOR_TYPE_GYROSCOPE:
+    case CHRE_SENSOR_TYPE_GEOMAGNETIC_FIELD:
+    case CHRE_SENSOR_TYPE_UNCALIBRATED_ACCELEROMETER:
+    case CHRE_SENSOR_TYPE_UNCALIBRATED_GYROSCOPE:
+    case CHRE_SENSOR_TYPE_UNCALIBRATED_GEOMAGNETIC_FIELD:
+      return sizeof(chreSensorThreeAxisData::readings[0]);
+    case CHRE_SENSOR_TYPE_PRESSURE:
+    case CHRE_SENSOR_TYPE_LIGHT:
+    case CHRE_SENSOR_TYPE_ACCELEROMETER_TEMPERATURE:
+    case CHRE_SENSOR_TYPE_GYROSCOPE_TEMPERATURE:
+    case CHRE_SENSOR_TYPE_GEOMAGNETIC_FIELD_TEMPERATURE:
+    case CHRE_SENSOR_TYPE_HINGE_ANGLE:
+      return sizeof(chreSensorFloatData::readings[0]);
+    case CHRE_SENSOR_TYPE_INSTANT_MOTION_DETECT:
+    case CHRE_SENSOR_TYPE_STATIONARY_DETECT:
+    case CHRE_SENSOR_TYPE_STEP_DETECT:
+      return sizeof(chreSensorOccurrenceData::readings[0]);
+    case CHRE_SENSOR_TYPE_PROXIMITY:
+      return sizeof(chreSensorByteData::readings[0]);
+    case CHRE_SENSOR_TYPE_STEP_COUNTER:
+      return sizeof(chreSensorUint64Data::readings[0]);
+    default:
+      return 0;
+  }
+}
+
 const char *SensorTypeHelpers::getSensorTypeName(uint8_t sensorType) {
   if (isVendorSensorType(sensorType)) {
     return getVendorSensorTypeName(sensorType);
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include <cinttypes>
+
+#include "chre/core/broadcast_event_index.h"
+#include "chre/core/nanoapp.h"
+#include "chre/platform/log.h"
+#include "chre/platform/system_time.h"
+#include "chre/util/unique_ptr.h"
+
+using chre::BroadcastEventIndex;
+using chre::DynamicVector;
+using chre::MakeUnique;
+using chre::Nanoapp;
+using chre::Nanoseconds;
+using chre::SystemTime;
+using chre::UniquePtr;
+
+namespace {
+
+size_t countMatchingSubscribers(const BroadcastEventIndex &index,
+                                uint16_t eventType, uint16_t groupMask) {
+  size_t count = 0;
+  const BroadcastEventIndex::SubscriberList *subscribers =
+      index.getSubscribers(eventType);
+  if (subscribers != nullptr) {
+    for (const BroadcastEventIndex::Subscriber &subscriber : *subscribers) {
+      if (subscriber.groupIdMask & groupMask) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST(BroadcastEventIndex, EmptyIndexHasNoSubscribers) {
+  BroadcastEventIndex index;
+  EXPECT_EQ(index.getSubscribers(1), nullptr);
+  EXPECT_EQ(index.getEventTypeCount(), 0);
+}
+
+TEST(BroadcastEventIndex, SetAndClearSubscription) {
+  BroadcastEventIndex index;
+  Nanoapp app1;
+  Nanoapp app2;
+
+  EXPECT_TRUE(index.setSubscription(&app1, 5, 0x1));
+  EXPECT_TRUE(index.setSubscription(&app2, 5, 0x2));
+  EXPECT_TRUE(index.setSubscription(&app1, 3, 0x1));
+  EXPECT_EQ(index.getEventTypeCount(), 2);
+
+  const BroadcastEventIndex::SubscriberList *subscribers =
+      index.getSubscribers(5);
+  ASSERT_NE(subscribers, nullptr);
+  ASSERT_EQ(subscribers->size(), 2);
+  EXPECT_EQ((*subscribers)[0].nanoapp, &app1);
+  EXPECT_EQ((*subscribers)[0].groupIdMask, 0x1);
+  EXPECT_EQ((*subscribers)[1].nanoapp, &app2);
+
+  // Updating the mask must not add a duplicate entry
+  EXPECT_TRUE(index.setSubscription(&app1, 5, 0x3));
+  subscribers = index.getSubscribers(5);
+  ASSERT_EQ(subscribers->size(), 2);
+  EXPECT_EQ((*subscribers)[0].groupIdMask, 0x3);
+
+  EXPECT_TRUE(index.setSubscription(&app1, 5, 0));
+  EXPECT_TRUE(index.setSubscription(&app2, 5, 0));
+  EXPECT_EQ(index.getSubscribers(5), nullptr);
+  EXPECT_EQ(index.getEventTypeCount(), 1);
+
+  // Clearing a subscription that doesn't exist is a no-op
+  EXPECT_TRUE(index.setSubscription(&app2, 7, 0));
+  EXPECT_EQ(index.getEventTypeCount(), 1);
+}
+
+TEST(BroadcastEventIndex, RemoveNanoapp) {
+  BroadcastEventIndex index;
+  Nanoapp app1;
+  Nanoapp app2;
+
+  for (uint16_t eventType = 0; eventType < 10; eventType++) {
+    EXPECT_TRUE(index.setSubscription(&app1, eventType, 0xffff));
+    if (eventType % 2 == 0) {
+      EXPECT_TRUE(index.setSubscription(&app2, eventType, 0xffff));
+    }
+  }
+
+  index.removeNanoapp(&app1);
+  EXPECT_EQ(index.getEventTypeCount(), 5);
+  for (uint16_t eventType = 0; eventType < 10; eventType++) {
+    EXPECT_EQ(countMatchingSubscribers(index, eventType, 0xffff),
+              (eventType % 2 == 0) ? 1 : 0);
+  }
+}
+
+TEST(BroadcastEventIndex, MirrorsNanoappRegistrations) {
+  BroadcastEventIndex index;
+  Nanoapp app;
+
+  // Registrations made before attaching the index are picked up
+  app.registerForBroadcastEvent(10, 0x1);
+  app.setBroadcastEventIndex(&index);
+  EXPECT_EQ(countMatchingSubscribers(index, 10, 0x1), 1);
+
+  app.registerForBroadcastEvent(10, 0x2);
+  app.registerForBroadcastEvent(11);
+  EXPECT_EQ(countMatchingSubscribers(index, 10, 0x2), 1);
+  EXPECT_EQ(countMatchingSubscribers(index, 11, 0xffff), 1);
+
+  app.unregisterForBroadcastEvent(10, 0x1);
+  EXPECT_EQ(countMatchingSubscribers(index, 10, 0x1), 0);
+  EXPECT_EQ(countMatchingSubscribers(index, 10, 0x2), 1);
+
+  app.unregisterForBroadcastEvent(10, 0x2);
+  EXPECT_EQ(index.getSubscribers(10), nullptr);
+
+  {
+    Nanoapp transientApp;
+    transientApp.setBroadcastEventIndex(&index);
+    transientApp.registerForBroadcastEvent(12);
+    EXPECT_EQ(countMatchingSubscribers(index, 12, 0xffff), 1);
+  }
+  EXPECT_EQ(index.getSubscribers(12), nullptr);
+}
+
+//! Compares the cost of finding the recipients of a broadcast event by
+//! querying every nanoapp (the previous EventLoop::distributeEvent approach)
+//! against looking them up in the index, as the number of nanoapps grows.
+TEST(BroadcastEventIndex, DispatchBenchmark) {
+  constexpr size_t kNanoappCounts[] = {1, 4, 16, 32, 64};
+  constexpr size_t kEventTypesPerNanoapp = 8;
+  constexpr size_t kIterations = 10000;
+  constexpr uint16_t kDispatchedEventType = 0x0100;
+
+  for (size_t nanoappCount : kNanoappCounts) {
+    BroadcastEventIndex index;
+    DynamicVector<UniquePtr<Nanoapp>> nanoapps;
+    for (size_t i = 0; i < nanoappCount; i++) {
+      ASSERT_TRUE(nanoapps.push_back(MakeUnique<Nanoapp>()));
+      Nanoapp *app = nanoapps.back().get();
+      app->setBroadcastEventIndex(&index);
+      for (size_t j = 0; j < kEventTypesPerNanoapp; j++) {
+        app->registerForBroadcastEvent(static_cast<uint16_t>(i * 16 + j));
+      }
+
+      // Only every fourth nanoapp subscribes to the dispatched event
+      if (i % 4 == 0) {
+        app->registerForBroadcastEvent(kDispatchedEventType);
+      }
+    }
+
+    size_t linearMatches = 0;
+    Nanoseconds start = SystemTime::getMonotonicTime();
+    for (size_t n = 0; n < kIterations; n++) {
+      for (const UniquePtr<Nanoapp> &app : nanoapps) {
+        if (app->isRegisteredForBroadcastEvent(kDispatchedEventType,
+                                               chre::kDefaultTargetGroupMask)) {
+          linearMatches++;
+        }
+      }
+    }
+    Nanoseconds linearDuration = SystemTime::getMonotonicTime() - start;
+
+    size_t indexedMatches = 0;
+    start = SystemTime::getMonotonicTime();
+    for (size_t n = 0; n < kIterations; n++) {
+      indexedMatches += countMatchingSubscribers(index, kDispatchedEventType,
+                                                 chre::kDefaultTargetGroupMask);
+    }
+    Nanoseconds indexedDuration = SystemTime::getMonotonicTime() - start;
+
+    EXPECT_EQ(linearMatches, indexedMatches);
+    LOGI("%zu nanoapps: linear scan %" PRIu64 " ns/event, index %" PRIu64
+         " ns/event",
+         nanoappCount, linearDuration.toRawNanoseconds() / kIterations,
+         indexedDuration.toRawNanoseconds() / kIterations);
+  }
+}
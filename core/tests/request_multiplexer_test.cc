@@ -15,12 +15,22 @@
  */
 
 #include <algorithm>
+#include <random>
 
 #include "gtest/gtest.h"
 
+#include "chre/core/incremental_request_multiplexer.h"
 #include "chre/core/request_multiplexer.h"
+#include "chre/core/sensor_request_aggregate.h"
+#include "chre/util/flat_map.h"
 
+using chre::FlatMap;
+using chre::IncrementalRequestMultiplexer;
+using chre::Nanoseconds;
 using chre::RequestMultiplexer;
+using chre::SensorMode;
+using chre::SensorRequest;
+using chre::SensorRequestAggregate;
 
 class FakeRequest {
  public:
@@ -418,3 +428,242 @@ TEST(RequestMultiplexer, RemoveAllRequestsNonEmpty) {
   EXPECT_TRUE(maximalRequestChanged);
   EXPECT_EQ(multiplexer.getCurrentMaximalRequest().getPriority(), 0);
 }
+
+namespace {
+
+//! Tracks the priorities of FakeRequests for IncrementalRequestMultiplexer.
+class FakeRequestAggregate {
+ public:
+  bool reserve(size_t numRequests) {
+    return mPriorities.reserve(numRequests);
+  }
+
+  void add(const FakeRequest &request) {
+    auto it = mPriorities.find(request.getPriority());
+    if (it != mPriorities.end()) {
+      it->value++;
+    } else {
+      mPriorities.insertOrAssign(request.getPriority(), 1);
+    }
+  }
+
+  void remove(const FakeRequest &request) {
+    auto it = mPriorities.find(request.getPriority());
+    ASSERT_NE(it, mPriorities.end());
+    if (--it->value == 0) {
+      mPriorities.erase(it);
+    }
+  }
+
+  void clear() {
+    mPriorities.clear();
+  }
+
+  bool getMaximalRequest(FakeRequest *maximalRequest) const {
+    int maxPriority = mPriorities.empty() ? 0 : (mPriorities.end() - 1)->key;
+    *maximalRequest = FakeRequest(std::max(maxPriority, 0));
+    return true;
+  }
+
+ private:
+  FlatMap<int, size_t> mPriorities;
+};
+
+FakeRequest randomFakeRequest(std::minstd_rand &rng) {
+  return FakeRequest(static_cast<int>(rng() % 41) - 10);
+}
+
+/**
+ * Generates a sensor request from a small set of values, so that requests
+ * often share attribute values.
+ *
+ * @param allowMixedDefaults If false, requests either set both the interval
+ *        and the latency, only set one of them, or set neither, but requests
+ *        that only set an interval and requests that only set a latency are not
+ *        both generated.
+ */
+SensorRequest randomSensorRequest(std::minstd_rand &rng,
+                                  bool allowMixedDefaults) {
+  constexpr SensorMode kModes[] = {
+      SensorMode::Off,
+      SensorMode::ActiveContinuous,
+      SensorMode::ActiveOneShot,
+      SensorMode::PassiveContinuous,
+      SensorMode::PassiveOneShot,
+  };
+  constexpr uint64_t kValues[] = {
+      CHRE_SENSOR_INTERVAL_DEFAULT,
+      0,
+      5000000,
+      10000000,
+      20000000,
+      1000000000,
+      chre::kMaxIntervalLatencyNs,
+  };
+  constexpr size_t kNumValues = sizeof(kValues) / sizeof(kValues[0]);
+
+  SensorMode mode = kModes[rng() % (sizeof(kModes) / sizeof(kModes[0]))];
+  uint64_t interval = kValues[rng() % kNumValues];
+  uint64_t latency = kValues[rng() % kNumValues];
+  if (!allowMixedDefaults && interval != CHRE_SENSOR_INTERVAL_DEFAULT &&
+      latency == CHRE_SENSOR_LATENCY_DEFAULT) {
+    interval = CHRE_SENSOR_INTERVAL_DEFAULT;
+  }
+
+  SensorRequest request(mode, Nanoseconds(interval), Nanoseconds(latency));
+  request.setBiasUpdatesRequested(rng() % 4 == 0);
+  return request;
+}
+
+void expectSameMaximalRequest(const FakeRequest &expected,
+                              const FakeRequest &actual) {
+  EXPECT_EQ(expected.getPriority(), actual.getPriority());
+}
+
+void expectSameMaximalRequest(const SensorRequest &expected,
+                              const SensorRequest &actual) {
+  EXPECT_EQ(expected.getMode(), actual.getMode());
+  EXPECT_EQ(expected.getInterval(), actual.getInterval());
+  EXPECT_EQ(expected.getLatency(), actual.getLatency());
+  EXPECT_EQ(expected.getBiasUpdatesRequested(),
+            actual.getBiasUpdatesRequested());
+}
+
+/**
+ * Applies the same random sequence of adds, updates and removals to a
+ * RequestMultiplexer and an IncrementalRequestMultiplexer, and checks that
+ * both report the same maximal request after each operation.
+ */
+template <typename RequestType, typename AggregateType, typename Generator>
+void runDifferentialTest(unsigned int seed, size_t numOperations,
+                         size_t maxRequests, Generator generator) {
+  RequestMultiplexer<RequestType> expected;
+  IncrementalRequestMultiplexer<RequestType, AggregateType> actual;
+  std::minstd_rand rng(seed);
+
+  for (size_t i = 0; i < numOperations; i++) {
+    size_t numRequests = expected.getRequests().size();
+    uint32_t operation = rng() % 100;
+    bool expectedChanged;
+    bool actualChanged;
+
+    if (numRequests == 0 || (operation < 40 && numRequests < maxRequests)) {
+      RequestType request = generator(rng);
+      size_t expectedIndex;
+      size_t actualIndex;
+      ASSERT_TRUE(
+          expected.addRequest(request, &expectedIndex, &expectedChanged));
+      ASSERT_TRUE(actual.addRequest(request, &actualIndex, &actualChanged));
+      EXPECT_EQ(expectedIndex, actualIndex);
+    } else if (operation < 70) {
+      RequestType request = generator(rng);
+      size_t index = rng() % numRequests;
+      expected.updateRequest(index, request, &expectedChanged);
+      actual.updateRequest(index, request, &actualChanged);
+    } else if (operation < 99) {
+      size_t index = rng() % numRequests;
+      expected.removeRequest(index, &expectedChanged);
+      actual.removeRequest(index, &actualChanged);
+    } else {
+      expected.removeAllRequests(&expectedChanged);
+      actual.removeAllRequests(&actualChanged);
+    }
+
+    ASSERT_EQ(expected.getRequests().size(), actual.getRequests().size());
+    EXPECT_EQ(expectedChanged, actualChanged) << "operation " << i;
+    expectSameMaximalRequest(expected.getCurrentMaximalRequest(),
+                             actual.getCurrentMaximalRequest());
+  }
+}
+
+}  // namespace
+
+TEST(IncrementalRequestMultiplexer, AddUpdateRemove) {
+  IncrementalRequestMultiplexer<FakeRequest, FakeRequestAggregate> multiplexer;
+  size_t index;
+  bool maximalRequestChanged;
+
+  ASSERT_TRUE(multiplexer.addRequest(FakeRequest(5), &index,
+                                     &maximalRequestChanged));
+  EXPECT_TRUE(maximalRequestChanged);
+  ASSERT_TRUE(multiplexer.addRequest(FakeRequest(10), &index,
+                                     &maximalRequestChanged));
+  EXPECT_TRUE(maximalRequestChanged);
+  EXPECT_EQ(multiplexer.getCurrentMaximalRequest().getPriority(), 10);
+
+  multiplexer.updateRequest(1, FakeRequest(8), &maximalRequestChanged);
+  EXPECT_TRUE(maximalRequestChanged);
+  EXPECT_EQ(multiplexer.getCurrentMaximalRequest().getPriority(), 8);
+
+  multiplexer.removeRequest(0, &maximalRequestChanged);
+  EXPECT_FALSE(maximalRequestChanged);
+  EXPECT_EQ(multiplexer.getCurrentMaximalRequest().getPriority(), 8);
+
+  multiplexer.removeAllRequests(&maximalRequestChanged);
+  EXPECT_TRUE(maximalRequestChanged);
+  EXPECT_EQ(multiplexer.getCurrentMaximalRequest().getPriority(), 0);
+  EXPECT_TRUE(multiplexer.getRequests().empty());
+}
+
+TEST(IncrementalRequestMultiplexer, RandomFakeRequestsMatchRequestMultiplexer) {
+  for (unsigned int seed = 1; seed <= 10; seed++) {
+    runDifferentialTest<FakeRequest, FakeRequestAggregate>(
+        seed, 2000 /* numOperations */, 32 /* maxRequests */,
+        randomFakeRequest);
+  }
+}
+
+TEST(IncrementalRequestMultiplexer,
+     RandomSensorRequestsMatchRequestMultiplexer) {
+  for (unsigned int seed = 1; seed <= 10; seed++) {
+    runDifferentialTest<SensorRequest, SensorRequestAggregate>(
+        seed, 2000 /* numOperations */, 32 /* maxRequests */,
+        [](std::minstd_rand &rng) {
+          return randomSensorRequest(rng, false /* allowMixedDefaults */);
+        });
+  }
+}
+
+TEST(IncrementalRequestMultiplexer,
+     RandomOrderDependentSensorRequestsMatchRequestMultiplexer) {
+  for (unsigned int seed = 1; seed <= 10; seed++) {
+    runDifferentialTest<SensorRequest, SensorRequestAggregate>(
+        seed, 2000 /* numOperations */, 8 /* maxRequests */,
+        [](std::minstd_rand &rng) {
+          return randomSensorRequest(rng, true /* allowMixedDefaults */);
+        });
+  }
+}
+
+TEST(IncrementalRequestMultiplexer, MixedDefaultSensorRequestsDependOnOrder) {
+  SensorRequest intervalOnly(SensorMode::ActiveContinuous, Nanoseconds(10),
+                             Nanoseconds(CHRE_SENSOR_LATENCY_DEFAULT));
+  SensorRequest latencyOnly(SensorMode::ActiveContinuous,
+                            Nanoseconds(CHRE_SENSOR_INTERVAL_DEFAULT),
+                            Nanoseconds(5));
+  SensorRequest both(SensorMode::ActiveContinuous, Nanoseconds(20),
+                     Nanoseconds(100));
+
+  IncrementalRequestMultiplexer<SensorRequest, SensorRequestAggregate>
+      multiplexer;
+  size_t index;
+  bool maximalRequestChanged;
+  ASSERT_TRUE(
+      multiplexer.addRequest(latencyOnly, &index, &maximalRequestChanged));
+  ASSERT_TRUE(
+      multiplexer.addRequest(intervalOnly, &index, &maximalRequestChanged));
+  ASSERT_TRUE(multiplexer.addRequest(both, &index, &maximalRequestChanged));
+  EXPECT_EQ(multiplexer.getCurrentMaximalRequest().getLatency(),
+            Nanoseconds(5));
+
+  // Moving the request that sets both attributes to the front changes the
+  // merged latency
+  multiplexer.removeRequest(0, &maximalRequestChanged);
+  multiplexer.removeRequest(0, &maximalRequestChanged);
+  ASSERT_TRUE(
+      multiplexer.addRequest(latencyOnly, &index, &maximalRequestChanged));
+  ASSERT_TRUE(
+      multiplexer.addRequest(intervalOnly, &index, &maximalRequestChanged));
+  EXPECT_EQ(multiplexer.getCurrentMaximalRequest().getLatency(),
+            Nanoseconds(110));
+}
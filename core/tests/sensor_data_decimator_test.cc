@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include <cinttypes>
+
+#include "chre/core/sensor_data_decimator.h"
+#include "chre/platform/log.h"
+#include "chre/util/macros.h"
+#include "chre/util/memory.h"
+
+using chre::ChreSensorData;
+using chre::memoryFree;
+using chre::SensorDataDecimator;
+
+namespace {
+
+constexpr size_t kThreeAxisSampleSize =
+    sizeof(chreSensorThreeAxisData::readings[0]);
+
+//! Builds a three-axis event of numSamples evenly spaced samples, the first of
+//! which is taken at firstTimestampNs. The x value of each sample is set to
+//! its index in the stream of samples, starting from firstIndex.
+chreSensorThreeAxisData *buildEvent(uint16_t numSamples,
+                                    uint64_t firstTimestampNs,
+                                    uint64_t intervalNs, float firstIndex) {
+  auto *event = static_cast<chreSensorThreeAxisData *>(
+      chre::memoryAlloc(sizeof(chreSensorDataHeader) +
+                        numSamples * kThreeAxisSampleSize));
+  event->header.baseTimestamp = firstTimestampNs;
+  event->header.sensorHandle = 3;
+  event->header.readingCount = numSamples;
+  event->header.accuracy = CHRE_SENSOR_ACCURACY_HIGH;
+  event->header.reserved = 0;
+  for (uint16_t i = 0; i < numSamples; i++) {
+    event->readings[i].timestampDelta =
+        (i == 0) ? 0 : static_cast<uint32_t>(intervalNs);
+    event->readings[i].x = firstIndex + i;
+    event->readings[i].y = 0.0f;
+    event->readings[i].z = 0.0f;
+  }
+  return event;
+}
+
+ChreSensorData *decimate(SensorDataDecimator &decimator,
+                         const chreSensorThreeAxisData *event) {
+  return decimator.decimate(reinterpret_cast<const ChreSensorData *>(event),
+                            kThreeAxisSampleSize);
+}
+
+}  // namespace
+
+TEST(SensorDataDecimator, SelectsSamplesAtRequestedInterval) {
+  constexpr uint64_t kIntervalNs = 2500000;  // 400 Hz
+  chreSensorThreeAxisData *event =
+      buildEvent(40, 1000000000, kIntervalNs, 0.0f);
+
+  SensorDataDecimator decimator(10 * kIntervalNs, kIntervalNs / 2);
+  ChreSensorData *decimated = decimate(decimator, event);
+  ASSERT_NE(decimated, nullptr);
+
+  const chreSensorThreeAxisData &data = decimated->threeAxisData;
+  EXPECT_EQ(data.header.readingCount, 4);
+  EXPECT_EQ(data.header.baseTimestamp, 1000000000);
+  EXPECT_EQ(data.header.sensorHandle, 3);
+  EXPECT_EQ(data.header.accuracy, CHRE_SENSOR_ACCURACY_HIGH);
+  for (uint16_t i = 0; i < data.header.readingCount; i++) {
+    EXPECT_EQ(data.readings[i].x, 10.0f * i);
+    EXPECT_EQ(data.readings[i].timestampDelta, (i == 0) ? 0 : 10 * kIntervalNs);
+  }
+
+  memoryFree(decimated);
+  memoryFree(event);
+}
+
+TEST(SensorDataDecimator, KeepsIntervalAcrossEvents) {
+  constexpr uint64_t kIntervalNs = 2500000;
+  SensorDataDecimator decimator(7 * kIntervalNs, kIntervalNs / 2);
+
+  // Batches of 4 samples, with every seventh sample being due.
+  uint64_t expectedTimestampNs = 0;
+  size_t numSelected = 0;
+  for (uint16_t batch = 0; batch < 14; batch++) {
+    chreSensorThreeAxisData *event =
+        buildEvent(4, batch * 4 * kIntervalNs, kIntervalNs, batch * 4.0f);
+    ChreSensorData *decimated = decimate(decimator, event);
+    if (decimated != nullptr) {
+      const chreSensorThreeAxisData &data = decimated->threeAxisData;
+      uint64_t timestampNs = data.header.baseTimestamp;
+      for (uint16_t i = 0; i < data.header.readingCount; i++) {
+        timestampNs += data.readings[i].timestampDelta;
+        EXPECT_EQ(timestampNs, expectedTimestampNs);
+        EXPECT_EQ(data.readings[i].x, 7.0f * numSelected);
+        expectedTimestampNs += 7 * kIntervalNs;
+        numSelected++;
+      }
+      memoryFree(decimated);
+    }
+    memoryFree(event);
+  }
+  EXPECT_EQ(numSelected, 8);
+}
+
+TEST(SensorDataDecimator, ReturnsNullIfNoSampleIsDue) {
+  constexpr uint64_t kIntervalNs = 2500000;
+  SensorDataDecimator decimator(100 * kIntervalNs, kIntervalNs / 2);
+
+  chreSensorThreeAxisData *event = buildEvent(8, 0, kIntervalNs, 0.0f);
+  ChreSensorData *decimated = decimate(decimator, event);
+  ASSERT_NE(decimated, nullptr);
+  EXPECT_EQ(decimated->header.readingCount, 1);
+  memoryFree(decimated);
+  memoryFree(event);
+
+  event = buildEvent(8, 8 * kIntervalNs, kIntervalNs, 8.0f);
+  EXPECT_EQ(decimate(decimator, event), nullptr);
+  memoryFree(event);
+}
+
+TEST(SensorDataDecimator, SelectsSamplesToAvoidTimestampDeltaOverflow) {
+  // Samples 2 s apart, with a 10 s interval: skipping two samples in a row
+  // would not fit in a timestamp delta.
+  constexpr uint64_t kIntervalNs = 2000000000;
+  SensorDataDecimator decimator(10000000000, kIntervalNs / 2);
+
+  chreSensorThreeAxisData *event = buildEvent(5, 0, kIntervalNs, 0.0f);
+  ChreSensorData *decimated = decimate(decimator, event);
+  ASSERT_NE(decimated, nullptr);
+
+  const chreSensorThreeAxisData &data = decimated->threeAxisData;
+  ASSERT_EQ(data.header.readingCount, 2);
+  EXPECT_EQ(data.readings[0].x, 0.0f);
+  EXPECT_EQ(data.readings[1].x, 2.0f);
+  EXPECT_EQ(data.readings[1].timestampDelta, 2 * kIntervalNs);
+
+  memoryFree(decimated);
+  memoryFree(event);
+}
+
+TEST(SensorDataDecimator, Benchmark) {
+  // An accelerometer sampling at 400 Hz with a 20 ms latency, on behalf of
+  // nanoapps requesting 400 Hz, 50 Hz and 10 Hz.
+  constexpr uint64_t kIntervalNs = 2500000;
+  constexpr uint16_t kSamplesPerBatch = 8;
+  constexpr size_t kNumBatches = 500;
+  constexpr uint64_t kNanoappIntervalsNs[] = {kIntervalNs, 8 * kIntervalNs,
+                                              40 * kIntervalNs};
+  constexpr size_t kNumNanoapps = ARRAY_SIZE(kNanoappIntervalsNs);
+
+  SensorDataDecimator *decimators[kNumNanoapps] = {};
+  for (size_t i = 0; i < kNumNanoapps; i++) {
+    if (kNanoappIntervalsNs[i] > kIntervalNs) {
+      decimators[i] = chre::memoryAlloc<SensorDataDecimator>(
+          kNanoappIntervalsNs[i], kIntervalNs / 2);
+    }
+  }
+
+  // Without decimation every nanoapp handles every batch, and touches all of
+  // its samples to throw away the ones it doesn't need.
+  size_t batchSize =
+      sizeof(chreSensorDataHeader) + kSamplesPerBatch * kThreeAxisSampleSize;
+  size_t broadcastInvocations = kNumBatches;
+  size_t broadcastBytes = kNumBatches * batchSize;
+
+  size_t invocations[kNumNanoapps] = {};
+  size_t bytes[kNumNanoapps] = {};
+  size_t samples[kNumNanoapps] = {};
+  for (size_t batch = 0; batch < kNumBatches; batch++) {
+    chreSensorThreeAxisData *event =
+        buildEvent(kSamplesPerBatch, batch * kSamplesPerBatch * kIntervalNs,
+                   kIntervalNs, batch * kSamplesPerBatch);
+    for (size_t i = 0; i < kNumNanoapps; i++) {
+      if (decimators[i] == nullptr) {
+        // Nanoapps at the sensor's rate share the platform event.
+        invocations[i]++;
+        bytes[i] += batchSize;
+        samples[i] += kSamplesPerBatch;
+      } else {
+        ChreSensorData *decimated = decimate(*decimators[i], event);
+        if (decimated != nullptr) {
+          invocations[i]++;
+          bytes[i] += sizeof(chreSensorDataHeader) +
+                      decimated->header.readingCount * kThreeAxisSampleSize;
+          samples[i] += decimated->header.readingCount;
+          memoryFree(decimated);
+        }
+      }
+    }
+    memoryFree(event);
+  }
+
+  for (size_t i = 0; i < kNumNanoapps; i++) {
+    LOGI("Nanoapp at %" PRIu64 " ns: %zu invocations, %zu bytes, %zu samples"
+         " (broadcast: %zu invocations, %zu bytes)",
+         kNanoappIntervalsNs[i], invocations[i], bytes[i], samples[i],
+         broadcastInvocations, broadcastBytes);
+    EXPECT_EQ(samples[i], kNumBatches * kSamplesPerBatch * kIntervalNs /
+                              kNanoappIntervalsNs[i]);
+    if (decimators[i] != nullptr) {
+      EXPECT_LT(bytes[i], broadcastBytes);
+      chre::memoryFree(decimators[i]);
+    }
+  }
+
+  // The 10 Hz nanoapp only handles the batches holding a sample it needs.
+  EXPECT_EQ(invocations[2], kNumBatches * kSamplesPerBatch / 40);
+}
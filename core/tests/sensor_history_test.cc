@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include "chre/core/sensor_history.h"
+#include "chre/platform/memory.h"
+
+using chre::ChreSensorData;
+using chre::SensorHistory;
+
+namespace {
+
+constexpr size_t kSampleSize = sizeof(chreSensorThreeAxisData::readings[0]);
+constexpr uint64_t kIntervalNs = 10000000;
+
+typedef chreSensorThreeAxisData::chreSensorThreeAxisSampleData Sample;
+
+//! Adds an event of numSamples samples, kIntervalNs apart, the first of which
+//! is taken at firstTimestampNs. The x value of each sample is set to its
+//! timestamp in milliseconds.
+void addEvent(SensorHistory &history, uint16_t numSamples,
+              uint64_t firstTimestampNs) {
+  auto *event = static_cast<chreSensorThreeAxisData *>(chre::memoryAlloc(
+      sizeof(chreSensorDataHeader) + numSamples * kSampleSize));
+  ASSERT_NE(event, nullptr);
+  // The base timestamp is set before the first sample, as is done by some
+  // platforms.
+  event->header.baseTimestamp = firstTimestampNs - 1000;
+  event->header.sensorHandle = 0;
+  event->header.readingCount = numSamples;
+  event->header.accuracy = CHRE_SENSOR_ACCURACY_UNKNOWN;
+  event->header.reserved = 0;
+  for (uint16_t i = 0; i < numSamples; i++) {
+    event->readings[i].timestampDelta =
+        (i == 0) ? 1000 : static_cast<uint32_t>(kIntervalNs);
+    event->readings[i].x = (firstTimestampNs + i * kIntervalNs) / 1000000;
+    event->readings[i].y = 0.0f;
+    event->readings[i].z = 0.0f;
+  }
+  history.addSamples(reinterpret_cast<const ChreSensorData *>(event));
+  chre::memoryFree(event);
+}
+
+//! Checks that the given history holds the samples taken every kIntervalNs
+//! from firstTimestampNs, and returns how many it holds.
+size_t checkHistory(const chreSensorHistory &history,
+                    uint64_t firstTimestampNs) {
+  uint64_t timestampNs = history.baseTimestamp;
+  uint64_t expectedTimestampNs = firstTimestampNs;
+  size_t numSamples = 0;
+  for (size_t run = 0; run < 2; run++) {
+    const auto *samples = static_cast<const Sample *>(history.readings[run]);
+    for (uint16_t i = 0; i < history.readingCount[run]; i++) {
+      timestampNs += samples[i].timestampDelta;
+      EXPECT_EQ(timestampNs, expectedTimestampNs);
+      EXPECT_EQ(samples[i].x, expectedTimestampNs / 1000000);
+      expectedTimestampNs += kIntervalNs;
+      numSamples++;
+    }
+  }
+  return numSamples;
+}
+
+}  // namespace
+
+TEST(SensorHistory, EmptyHistoryHasNoSamples) {
+  SensorHistory history;
+  addEvent(history, 4, kIntervalNs);
+
+  chreSensorHistory range;
+  history.getRange(0, UINT64_MAX, &range);
+  EXPECT_EQ(range.readingCount[0], 0);
+  EXPECT_EQ(range.readingCount[1], 0);
+  EXPECT_EQ(history.getMemorySize(), 0);
+}
+
+TEST(SensorHistory, GetsRangeAcrossEvents) {
+  SensorHistory history;
+  ASSERT_TRUE(history.resize(32, kSampleSize));
+  EXPECT_EQ(history.getMemorySize(), 32 * kSampleSize);
+
+  addEvent(history, 5, 100 * kIntervalNs);
+  addEvent(history, 5, 105 * kIntervalNs);
+  EXPECT_EQ(history.size(), 10);
+  EXPECT_EQ(history.getOldestTimestampNs(), 100 * kIntervalNs);
+  EXPECT_EQ(history.getNewestTimestampNs(), 109 * kIntervalNs);
+
+  chreSensorHistory range;
+  history.getRange(103 * kIntervalNs, 107 * kIntervalNs, &range);
+  EXPECT_EQ(range.readingCount[1], 0);
+  EXPECT_EQ(checkHistory(range, 103 * kIntervalNs), 5);
+
+  history.getRange(103 * kIntervalNs + 1, 104 * kIntervalNs - 1, &range);
+  EXPECT_EQ(range.readingCount[0], 0);
+  EXPECT_EQ(range.readingCount[1], 0);
+}
+
+TEST(SensorHistory, OverwritesOldestSamplesWhenFull) {
+  SensorHistory history;
+  ASSERT_TRUE(history.resize(8, kSampleSize));
+
+  for (uint64_t i = 0; i < 5; i++) {
+    addEvent(history, 3, (100 + 3 * i) * kIntervalNs);
+  }
+  EXPECT_EQ(history.size(), 8);
+  EXPECT_EQ(history.getOldestTimestampNs(), 107 * kIntervalNs);
+
+  // The samples wrap around the end of the buffer.
+  chreSensorHistory range;
+  history.getRange(0, UINT64_MAX, &range);
+  EXPECT_GT(range.readingCount[1], 0);
+  EXPECT_EQ(checkHistory(range, 107 * kIntervalNs), 8);
+}
+
+TEST(SensorHistory, KeepsNewestSamplesWhenResized) {
+  SensorHistory history;
+  ASSERT_TRUE(history.resize(8, kSampleSize));
+  addEvent(history, 6, 100 * kIntervalNs);
+  addEvent(history, 6, 106 * kIntervalNs);
+
+  ASSERT_TRUE(history.resize(4, kSampleSize));
+  chreSensorHistory range;
+  history.getRange(0, UINT64_MAX, &range);
+  EXPECT_EQ(range.readingCount[1], 0);
+  EXPECT_EQ(checkHistory(range, 108 * kIntervalNs), 4);
+
+  ASSERT_TRUE(history.resize(16, kSampleSize));
+  addEvent(history, 2, 112 * kIntervalNs);
+  history.getRange(0, UINT64_MAX, &range);
+  EXPECT_EQ(checkHistory(range, 108 * kIntervalNs), 6);
+
+  ASSERT_TRUE(history.resize(0, kSampleSize));
+  EXPECT_EQ(history.size(), 0);
+  EXPECT_EQ(history.getMemorySize(), 0);
+}
+
+TEST(SensorHistory, DropsSamplesAfterTimestampGap) {
+  SensorHistory history;
+  ASSERT_TRUE(history.resize(16, kSampleSize));
+  addEvent(history, 4, 100 * kIntervalNs);
+
+  // A gap that doesn't fit in a timestamp delta.
+  uint64_t timestampNs = 103 * kIntervalNs + UINT32_MAX + 1;
+  addEvent(history, 4, timestampNs);
+  EXPECT_EQ(history.size(), 4);
+
+  chreSensorHistory range;
+  history.getRange(0, UINT64_MAX, &range);
+  EXPECT_EQ(checkHistory(range, timestampNs), 4);
+}
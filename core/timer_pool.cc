@@ -15,6 +15,9 @@
  */
 
 #include "chre/core/timer_pool.h"
+
+#include <cinttypes>
+
 #include "chre/core/event_loop.h"
 #include "chre/core/event_loop_manager.h"
 #include "chre/platform/fatal_error.h"
@@ -54,24 +57,27 @@ TimerHandle TimerPool::setTimer(uint32_t instanceId, Nanoseconds duration,
 
   TimerRequest timerRequest;
   timerRequest.instanceId = instanceId;
-  timerRequest.timerHandle = generateTimerHandleLocked();
+  timerRequest.timerHandle = CHRE_TIMER_INVALID;
   timerRequest.expirationTime = SystemTime::getMonotonicTime() + duration;
   timerRequest.duration = duration;
+  timerRequest.slack = (instanceId == kSystemInstanceId) ? Nanoseconds(0)
+                                                        : mNanoappTimerSlack;
   timerRequest.cookie = cookie;
   timerRequest.systemCallback = systemCallback;
   timerRequest.callbackType = callbackType;
   timerRequest.isOneShot = isOneShot;
 
-  bool newTimerExpiresEarliest =
-      (!mTimerRequests.empty() && mTimerRequests.top() > timerRequest);
   bool success = insertTimerRequestLocked(timerRequest);
 
   if (success) {
-    if (newTimerExpiresEarliest) {
-      mSystemTimer.set(handleSystemTimerCallback, this, duration);
-    } else if (mTimerRequests.size() == 1) {
+    Nanoseconds wakeupTime = timerRequest.expirationTime + timerRequest.slack;
+    if (mTimerRequests.size() == 1) {
       // If this timer request was the first, schedule it.
       handleExpiredTimersAndScheduleNextLocked();
+    } else if (wakeupTime < mScheduledWakeupTime) {
+      mScheduledWakeupTime = wakeupTime;
+      mSystemTimer.set(handleSystemTimerCallback, this,
+                       duration + timerRequest.slack);
     }
   }
 
@@ -91,9 +97,14 @@ bool TimerPool::cancelTimer(uint32_t instanceId, TimerHandle timerHandle) {
     LOGW("Failed to cancel timer ID %" PRIu32 ": permission denied",
          timerHandle);
   } else {
+    bool wasNextTimer = (timerRequest == getNextTimerRequestLocked());
+    Nanoseconds wakeupTime = timerRequest->expirationTime + timerRequest->slack;
     removeTimerRequestLocked(index);
 
-    if (index == 0) {
+    // A later timer with a short slack may have brought the wakeup forward, so
+    // it must also be rescheduled when that timer is cancelled. Otherwise the
+    // system timer fires before any remaining timer has expired.
+    if (wasNextTimer || wakeupTime == mScheduledWakeupTime) {
       mSystemTimer.cancel();
       handleExpiredTimersAndScheduleNextLocked();
     }
@@ -104,6 +115,246 @@ bool TimerPool::cancelTimer(uint32_t instanceId, TimerHandle timerHandle) {
   return success;
 }
 
+void TimerPool::logStateToBuffer(DebugDumpWrapper &debugDump) const {
+  LockGuard<Mutex> lock(mMutex);
+  debugDump.print("\nTimer Pool:\n");
+  debugDump.print("  Active timers: %zu/%zu (nanoapp timers: %zu)\n",
+                  mTimerRequests.size(), kMaxTimerRequests, mNumNanoappTimers);
+
+  // Report the average number of timers handled per wakeup with two decimal
+  // places, which is above 1 when timers are being coalesced
+  uint64_t timersPerWakeupX100 =
+      (mNumExpiryPasses == 0)
+          ? 0
+          : static_cast<uint64_t>(mNumExpiredTimers) * 100 / mNumExpiryPasses;
+  debugDump.print("  Expired timers: %" PRIu32 " in %" PRIu32
+                  " wakeups (%" PRIu64 ".%02" PRIu64
+                  " per wakeup), nanoapp timer slack: %" PRIu64 "us\n",
+                  mNumExpiredTimers, mNumExpiryPasses,
+                  timersPerWakeupX100 / 100, timersPerWakeupX100 % 100,
+                  mNanoappTimerSlack.toRawNanoseconds() /
+                      kOneMicrosecondInNanoseconds);
+}
+
+bool TimerPool::TimerRequest::operator>(const TimerRequest &request) const {
+  return (expirationTime > request.expirationTime);
+}
+
+bool TimerPool::isNewTimerAllowedLocked(bool isNanoappTimer) const {
+  static_assert(kMaxNanoappTimers <= kMaxTimerRequests,
+                "Max number of nanoapp timers is too big");
+  static_assert(kNumReservedNanoappTimers <= kMaxTimerRequests,
+                "Number of reserved nanoapp timers is too big");
+
+  bool allowed;
+  if (isNanoappTimer) {
+    allowed = (mNumNanoappTimers < kMaxNanoappTimers);
+  } else {  // System timer
+    // We must not allow more system timers than the required amount of reserved
+    // timers for nanoapps.
+    constexpr size_t kMaxSystemTimers =
+        kMaxTimerRequests - kNumReservedNanoappTimers;
+    size_t numSystemTimers = mTimerRequests.size() - mNumNanoappTimers;
+    allowed = (numSystemTimers < kMaxSystemTimers);
+  }
+
+  return allowed;
+}
+
+bool TimerPool::handleExpiredTimersAndScheduleNext() {
+  LockGuard<Mutex> lock(mMutex);
+  return handleExpiredTimersAndScheduleNextLocked();
+}
+
+bool TimerPool::handleExpiredTimersAndScheduleNextLocked() {
+  bool handledExpiredTimer = false;
+
+  while (!mTimerRequests.empty()) {
+    Nanoseconds currentTime = SystemTime::getMonotonicTime();
+#ifdef CHRE_TIMER_WHEEL_ENABLED
+    mTimerRequests.advance(currentTime);
+#endif  // CHRE_TIMER_WHEEL_ENABLED
+    TimerRequest &currentTimerRequest = *getNextTimerRequestLocked();
+    if (currentTime >= currentTimerRequest.expirationTime) {
+      // This timer has expired, so post an event if it is a nanoapp timer, or
+      // submit a deferred callback if it's a system timer.
+      if (currentTimerRequest.instanceId == kSystemInstanceId) {
+        EventLoopManagerSingleton::get()->deferCallback(
+            currentTimerRequest.callbackType,
+            const_cast<void *>(currentTimerRequest.cookie),
+            currentTimerRequest.systemCallback);
+      } else {
+        EventLoopManagerSingleton::get()->getEventLoop().postEventOrDie(
+            CHRE_EVENT_TIMER, const_cast<void *>(currentTimerRequest.cookie),
+            nullptr /*freeCallback*/, currentTimerRequest.instanceId);
+      }
+      handledExpiredTimer = true;
+      mNumExpiredTimers++;
+
+      // Reschedule the timer if needed, and release the current request.
+      if (!currentTimerRequest.isOneShot) {
+        rescheduleNextTimerRequestLocked(
+            getNextPeriodicExpirationTime(currentTimerRequest, currentTime));
+      } else {
+        popTimerRequestLocked();
+      }
+    } else {
+      // Update the system timer to reflect the duration until the closest
+      // expiry, plus any slack that allows it to fire together with later
+      // timers (mTimerRequests is ordered by expiry, so we just do this for
+      // the first timer found which has not expired yet)
+      mScheduledWakeupTime = getNextWakeupTimeLocked();
+      mSystemTimer.set(handleSystemTimerCallback, this,
+                       mScheduledWakeupTime - currentTime);
+      break;
+    }
+  }
+
+  if (handledExpiredTimer) {
+    mNumExpiryPasses++;
+  }
+
+  return handledExpiredTimer;
+}
+
+Nanoseconds TimerPool::getNextPeriodicExpirationTime(
+    const TimerRequest &timerRequest, Nanoseconds currentTime) {
+  uint64_t durationNs = timerRequest.duration.toRawNanoseconds();
+  if (durationNs == 0) {
+    return currentTime;
+  }
+
+  // Periods are counted from the previous expiration rather than from when the
+  // timer was handled, so that the delays allowed by the slack don't add up.
+  // The periods that elapsed in full meanwhile are skipped.
+  uint64_t expirationTimeNs =
+      timerRequest.expirationTime.toRawNanoseconds() + durationNs;
+  uint64_t currentTimeNs = currentTime.toRawNanoseconds();
+  if (expirationTimeNs <= currentTimeNs) {
+    uint64_t numMissedPeriods =
+        (currentTimeNs - expirationTimeNs) / durationNs + 1;
+    expirationTimeNs += numMissedPeriods * durationNs;
+  }
+
+  return Nanoseconds(expirationTimeNs);
+}
+
+void TimerPool::handleSystemTimerCallback(void *timerPoolPtr) {
+  auto callback = [](uint16_t /*type*/, void *data, void * /*extraData*/) {
+    auto *timerPool = static_cast<TimerPool *>(data);
+    if (!timerPool->handleExpiredTimersAndScheduleNext()) {
+      // Means that the system timer invoked our callback before the next timer
+      // expired. Possible in rare race conditions with time removal, but could
+      // indicate a faulty SystemTimer implementation if this happens often. Not
+      // a major problem - we'll just reset the timer to the next expiration.
+      LOGW("Timer callback invoked prior to expiry");
+    }
+  };
+
+  EventLoopManagerSingleton::get()->deferCallback(
+      SystemCallbackType::TimerPoolTick, timerPoolPtr, callback);
+}
+
+#ifdef CHRE_TIMER_WHEEL_ENABLED
+
+TimerPool::TimerRequest *TimerPool::getTimerRequestByTimerHandleLocked(
+    TimerHandle timerHandle, size_t *index) {
+  size_t requestIndex = timerHandle & ((1 << kTimerHandleIndexBits) - 1);
+  if (mTimerRequests.isInUse(requestIndex) &&
+      mTimerRequests[requestIndex].timerHandle == timerHandle) {
+    if (index != nullptr) {
+      *index = requestIndex;
+    }
+    return &mTimerRequests[requestIndex];
+  }
+
+  return nullptr;
+}
+
+TimerPool::TimerRequest *TimerPool::getNextTimerRequestLocked() {
+  size_t index = mTimerRequests.getNextIndex();
+  return (index == mTimerRequests.kInvalidIndex) ? nullptr
+                                                 : &mTimerRequests[index];
+}
+
+bool TimerPool::insertTimerRequestLocked(TimerRequest &timerRequest) {
+  bool isNanoappTimer = (timerRequest.instanceId != kSystemInstanceId);
+  size_t index = mTimerRequests.kInvalidIndex;
+  if (isNewTimerAllowedLocked(isNanoappTimer)) {
+    index = mTimerRequests.insert(timerRequest, timerRequest.expirationTime);
+  }
+
+  bool success = (index != mTimerRequests.kInvalidIndex);
+  if (!success) {
+    LOG_OOM();
+  } else {
+    // The index makes the handle unique among active timers, and the sequence
+    // number makes it unlikely that a stale handle refers to a new timer
+    TimerHandle timerHandle;
+    do {
+      timerHandle = (mTimerHandleSequence++ << kTimerHandleIndexBits) |
+                    static_cast<TimerHandle>(index);
+    } while (timerHandle == CHRE_TIMER_INVALID);
+
+    timerRequest.timerHandle = timerHandle;
+    mTimerRequests[index].timerHandle = timerHandle;
+    if (isNanoappTimer) {
+      mNumNanoappTimers++;
+    }
+  }
+
+  return success;
+}
+
+void TimerPool::popTimerRequestLocked() {
+  CHRE_ASSERT(!mTimerRequests.empty());
+  if (!mTimerRequests.empty()) {
+    removeTimerRequestLocked(mTimerRequests.getNextIndex());
+  }
+}
+
+void TimerPool::removeTimerRequestLocked(size_t index) {
+  CHRE_ASSERT(mTimerRequests.isInUse(index));
+  if (mTimerRequests.isInUse(index)) {
+    bool isNanoappTimer =
+        (mTimerRequests[index].instanceId != kSystemInstanceId);
+    mTimerRequests.remove(index);
+    if (isNanoappTimer) {
+      mNumNanoappTimers--;
+    }
+  }
+}
+
+Nanoseconds TimerPool::getNextWakeupTimeLocked() {
+  size_t nextIndex = mTimerRequests.getNextIndex();
+  const TimerRequest &nextTimerRequest = mTimerRequests[nextIndex];
+  Nanoseconds wakeupTime =
+      nextTimerRequest.expirationTime + nextTimerRequest.slack;
+
+  // Only timers that expire before the wakeup time can bring it forward, and
+  // there are none if the next timer has no slack
+  if (nextTimerRequest.slack > Nanoseconds(0)) {
+    for (size_t i = 0; i < kMaxTimerRequests; i++) {
+      if (mTimerRequests.isInUse(i)) {
+        const TimerRequest &request = mTimerRequests[i];
+        if (request.expirationTime + request.slack < wakeupTime) {
+          wakeupTime = request.expirationTime + request.slack;
+        }
+      }
+    }
+  }
+
+  return wakeupTime;
+}
+
+void TimerPool::rescheduleNextTimerRequestLocked(Nanoseconds expirationTime) {
+  size_t index = mTimerRequests.getNextIndex();
+  mTimerRequests[index].expirationTime = expirationTime;
+  mTimerRequests.reschedule(index, expirationTime);
+}
+
+#else  // CHRE_TIMER_WHEEL_ENABLED
+
 TimerPool::TimerRequest *TimerPool::getTimerRequestByTimerHandleLocked(
     TimerHandle timerHandle, size_t *index) {
   for (size_t i = 0; i < mTimerRequests.size(); i++) {
@@ -118,8 +369,8 @@ TimerPool::TimerRequest *TimerPool::getTimerRequestByTimerHandleLocked(
   return nullptr;
 }
 
-bool TimerPool::TimerRequest::operator>(const TimerRequest &request) const {
-  return (expirationTime > request.expirationTime);
+TimerPool::TimerRequest *TimerPool::getNextTimerRequestLocked() {
+  return mTimerRequests.empty() ? nullptr : &mTimerRequests.top();
 }
 
 TimerHandle TimerPool::generateTimerHandleLocked() {
@@ -154,31 +405,13 @@ TimerHandle TimerPool::generateUniqueTimerHandleLocked() {
   }
 }
 
-bool TimerPool::isNewTimerAllowedLocked(bool isNanoappTimer) const {
-  static_assert(kMaxNanoappTimers <= kMaxTimerRequests,
-                "Max number of nanoapp timers is too big");
-  static_assert(kNumReservedNanoappTimers <= kMaxTimerRequests,
-                "Number of reserved nanoapp timers is too big");
-
-  bool allowed;
-  if (isNanoappTimer) {
-    allowed = (mNumNanoappTimers < kMaxNanoappTimers);
-  } else {  // System timer
-    // We must not allow more system timers than the required amount of reserved
-    // timers for nanoapps.
-    constexpr size_t kMaxSystemTimers =
-        kMaxTimerRequests - kNumReservedNanoappTimers;
-    size_t numSystemTimers = mTimerRequests.size() - mNumNanoappTimers;
-    allowed = (numSystemTimers < kMaxSystemTimers);
-  }
-
-  return allowed;
-}
-
-bool TimerPool::insertTimerRequestLocked(const TimerRequest &timerRequest) {
+bool TimerPool::insertTimerRequestLocked(TimerRequest &timerRequest) {
   bool isNanoappTimer = (timerRequest.instanceId != kSystemInstanceId);
-  bool success = isNewTimerAllowedLocked(isNanoappTimer) &&
-                 mTimerRequests.push(timerRequest);
+  bool success = isNewTimerAllowedLocked(isNanoappTimer);
+  if (success) {
+    timerRequest.timerHandle = generateTimerHandleLocked();
+    success = mTimerRequests.push(timerRequest);
+  }
 
   if (!success) {
     LOG_OOM();
@@ -213,72 +446,36 @@ void TimerPool::removeTimerRequestLocked(size_t index) {
   }
 }
 
-bool TimerPool::handleExpiredTimersAndScheduleNext() {
-  LockGuard<Mutex> lock(mMutex);
-  return handleExpiredTimersAndScheduleNextLocked();
-}
-
-bool TimerPool::handleExpiredTimersAndScheduleNextLocked() {
-  bool handledExpiredTimer = false;
-
-  while (!mTimerRequests.empty()) {
-    Nanoseconds currentTime = SystemTime::getMonotonicTime();
-    TimerRequest &currentTimerRequest = mTimerRequests.top();
-    if (currentTime >= currentTimerRequest.expirationTime) {
-      // This timer has expired, so post an event if it is a nanoapp timer, or
-      // submit a deferred callback if it's a system timer.
-      if (currentTimerRequest.instanceId == kSystemInstanceId) {
-        EventLoopManagerSingleton::get()->deferCallback(
-            currentTimerRequest.callbackType,
-            const_cast<void *>(currentTimerRequest.cookie),
-            currentTimerRequest.systemCallback);
-      } else {
-        EventLoopManagerSingleton::get()->getEventLoop().postEventOrDie(
-            CHRE_EVENT_TIMER, const_cast<void *>(currentTimerRequest.cookie),
-            nullptr /*freeCallback*/, currentTimerRequest.instanceId);
-      }
-      handledExpiredTimer = true;
-
-      // Reschedule the timer if needed, and release the current request.
-      if (!currentTimerRequest.isOneShot) {
-        // Important: we need to make a copy of currentTimerRequest here,
-        // because it's a reference to memory that may get moved during the
-        // insert operation (thereby invalidating it).
-        TimerRequest cyclicTimerRequest = currentTimerRequest;
-        cyclicTimerRequest.expirationTime =
-            currentTime + currentTimerRequest.duration;
-        popTimerRequestLocked();
-        CHRE_ASSERT(insertTimerRequestLocked(cyclicTimerRequest));
-      } else {
-        popTimerRequestLocked();
+Nanoseconds TimerPool::getNextWakeupTimeLocked() {
+  const TimerRequest &nextTimerRequest = mTimerRequests.top();
+  Nanoseconds wakeupTime =
+      nextTimerRequest.expirationTime + nextTimerRequest.slack;
+
+  // Only timers that expire before the wakeup time can bring it forward, and
+  // there are none if the next timer has no slack
+  if (nextTimerRequest.slack > Nanoseconds(0)) {
+    for (size_t i = 1; i < mTimerRequests.size(); i++) {
+      const TimerRequest &request = mTimerRequests[i];
+      if (request.expirationTime + request.slack < wakeupTime) {
+        wakeupTime = request.expirationTime + request.slack;
       }
-    } else {
-      // Update the system timer to reflect the duration until the closest
-      // expiry (mTimerRequests is sorted by expiry, so we just do this for the
-      // first timer found which has not expired yet)
-      Nanoseconds duration = currentTimerRequest.expirationTime - currentTime;
-      mSystemTimer.set(handleSystemTimerCallback, this, duration);
-      break;
     }
   }
 
-  return handledExpiredTimer;
+  return wakeupTime;
 }
 
-void TimerPool::handleSystemTimerCallback(void *timerPoolPtr) {
-  auto callback = [](uint16_t /*type*/, void *data, void * /*extraData*/) {
-    auto *timerPool = static_cast<TimerPool *>(data);
-    if (!timerPool->handleExpiredTimersAndScheduleNext()) {
-      // Means that the system timer invoked our callback before the next timer
-      // expired. Possible in rare race conditions with time removal, but could
-      // indicate a faulty SystemTimer implementation if this happens often. Not
-      // a major problem - we'll just reset the timer to the next expiration.
-      LOGW("Timer callback invoked prior to expiry");
-    }
-  };
-
-  EventLoopManagerSingleton::get()->deferCallback(
-      SystemCallbackType::TimerPoolTick, timerPoolPtr, callback);
+void TimerPool::rescheduleNextTimerRequestLocked(Nanoseconds expirationTime) {
+  // Important: we need to make a copy of the request here, because top() is a
+  // reference to memory that may get moved during the push operation (thereby
+  // invalidating it).
+  TimerRequest cyclicTimerRequest = mTimerRequests.top();
+  cyclicTimerRequest.expirationTime = expirationTime;
+  mTimerRequests.pop();
+  bool success = mTimerRequests.push(cyclicTimerRequest);
+  CHRE_ASSERT(success);
 }
 
+#endif  // CHRE_TIMER_WHEEL_ENABLED
+
 }  // namespace chre
@@ -16,32 +16,32 @@
 
 #include "chre_host/fragmented_load_transaction.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
 
+#include "chre_host/log.h"
+
 namespace android {
 namespace chre {
 
 namespace {
 
 /**
- * Returns a vector containing a specific subarray of the original vector.
+ * Copies a binary into a buffer that can be shared with the transaction.
  *
- * If the ending index of the subarray exceeds that of the source vector,
- * the size will be truncated to the last element of the source vector.
+ * @param binary the binary to copy
  *
- * @param source the source vector
- * @param start the starting index of the subarray
- * @param size the size of the subarray
- *
- * @return the vector containing the subarray
+ * @return a pointer to the copied binary
  */
-inline std::vector<uint8_t> getSubVector(const std::vector<uint8_t> &source,
-                                         size_t start, size_t size) {
-  size_t end = std::min(source.size(), start + size);
-  return (source.size() == 0)
-             ? std::vector<uint8_t>()
-             : std::vector<uint8_t>(source.begin() + start,
-                                    source.begin() + end);  // [start, end)
+std::shared_ptr<const uint8_t> copyBinary(const std::vector<uint8_t> &binary) {
+  auto copy = std::make_shared<const std::vector<uint8_t>>(binary);
+  return std::shared_ptr<const uint8_t>(copy, copy->data());
 }
 
 }  // anonymous namespace
@@ -49,35 +49,91 @@ inline std::vector<uint8_t> getSubVector(const std::vector<uint8_t> &source,
 FragmentedLoadTransaction::FragmentedLoadTransaction(
     uint32_t transactionId, uint64_t appId, uint32_t appVersion,
     uint32_t appFlags, uint32_t targetApiVersion,
-    const std::vector<uint8_t> &appBinary, size_t fragmentSize) {
-  mTransactionId = transactionId;
+    const std::vector<uint8_t> &appBinary, size_t fragmentSize)
+    : FragmentedLoadTransaction(transactionId, appId, appVersion, appFlags,
+                                targetApiVersion, copyBinary(appBinary),
+                                appBinary.size(), fragmentSize) {}
 
-  // Start with fragmentId at 1 since 0 is used to indicate
-  // legacy behavior at CHRE
-  size_t fragmentId = 1;
-  size_t byteIndex = 0;
-  do {
-    if (fragmentId == 1) {
-      mFragmentRequests.emplace_back(
-          fragmentId++, transactionId, appId, appVersion, appFlags,
-          targetApiVersion, appBinary.size(),
-          getSubVector(appBinary, byteIndex, fragmentSize));
+FragmentedLoadTransaction::FragmentedLoadTransaction(
+    uint32_t transactionId, uint64_t appId, uint32_t appVersion,
+    uint32_t appFlags, uint32_t targetApiVersion,
+    std::shared_ptr<const uint8_t> appBinary, size_t appBinarySize,
+    size_t fragmentSize)
+    : mAppBinary(std::move(appBinary)),
+      mAppBinarySize(appBinarySize),
+      mFragmentSize(fragmentSize),
+      mAppId(appId),
+      mAppVersion(appVersion),
+      mAppFlags(appFlags),
+      mTargetApiVersion(targetApiVersion),
+      mCurrentRequest(0 /* fragmentId */, transactionId, nullptr, 0),
+      mTransactionId(transactionId) {
+  // An empty binary is still sent as a single empty fragment.
+  mNumFragments = std::max<size_t>(
+      1, (mAppBinarySize + mFragmentSize - 1) / mFragmentSize);
+}
+
+std::shared_ptr<const uint8_t> FragmentedLoadTransaction::mapBinaryFile(
+    const char *filename, size_t *size) {
+  std::shared_ptr<const uint8_t> binary;
+
+  int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  struct stat fileStat;
+  if (fd < 0) {
+    LOGE("Couldn't open file '%s': %d (%s)", filename, errno, strerror(errno));
+  } else if (fstat(fd, &fileStat) != 0) {
+    LOGE("Couldn't stat file '%s': %d (%s)", filename, errno, strerror(errno));
+  } else if (fileStat.st_size <= 0) {
+    LOGE("Nanoapp binary '%s' is empty", filename);
+  } else {
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    void *mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      LOGE("Couldn't map file '%s': %d (%s)", filename, errno,
+           strerror(errno));
     } else {
-      mFragmentRequests.emplace_back(
-          fragmentId++, transactionId,
-          getSubVector(appBinary, byteIndex, fragmentSize));
+      // Fragments are read front to back, exactly once.
+      madvise(mapping, fileSize, MADV_SEQUENTIAL);
+      binary = std::shared_ptr<const uint8_t>(
+          static_cast<const uint8_t *>(mapping),
+          [fileSize](const uint8_t *data) {
+            munmap(const_cast<uint8_t *>(data), fileSize);
+          });
+      *size = fileSize;
     }
+  }
+
+  if (fd >= 0) {
+    close(fd);
+  }
 
-    byteIndex += fragmentSize;
-  } while (byteIndex < appBinary.size());
+  return binary;
 }
 
 const FragmentedLoadRequest &FragmentedLoadTransaction::getNextRequest() {
-  return mFragmentRequests.at(mCurrentRequestIndex++);
+  // Start with fragmentId at 1 since 0 is used to indicate
+  // legacy behavior at CHRE
+  size_t fragmentId = mCurrentRequestIndex + 1;
+  size_t byteIndex = std::min(mAppBinarySize,
+                              mCurrentRequestIndex * mFragmentSize);
+  size_t fragmentSize = std::min(mFragmentSize, mAppBinarySize - byteIndex);
+  const uint8_t *fragment = mAppBinary.get() + byteIndex;
+
+  if (fragmentId == 1) {
+    mCurrentRequest = FragmentedLoadRequest(
+        fragmentId, mTransactionId, mAppId, mAppVersion, mAppFlags,
+        mTargetApiVersion, mAppBinarySize, fragment, fragmentSize);
+  } else {
+    mCurrentRequest = FragmentedLoadRequest(fragmentId, mTransactionId,
+                                            fragment, fragmentSize);
+  }
+
+  mCurrentRequestIndex++;
+  return mCurrentRequest;
 }
 
 bool FragmentedLoadTransaction::isComplete() const {
-  return (mCurrentRequestIndex >= mFragmentRequests.size());
+  return (mCurrentRequestIndex >= mNumFragments);
 }
 
 }  // namespace chre
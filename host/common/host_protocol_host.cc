@@ -108,7 +108,8 @@ void HostProtocolHost::encodeFragmentedLoadNanoappRequest(
   encodeLoadNanoappRequestForBinary(
       builder, request.transactionId, request.appId, request.appVersion,
       request.appFlags, request.targetApiVersion, request.binary,
-      request.fragmentId, request.appTotalSizeBytes, respondBeforeStart);
+      request.binarySize, request.fragmentId, request.appTotalSizeBytes,
+      respondBeforeStart);
 }
 
 void HostProtocolHost::encodeNanoappListRequest(FlatBufferBuilder &builder) {
@@ -177,7 +178,18 @@ void HostProtocolHost::encodeLoadNanoappRequestForBinary(
     uint32_t appVersion, uint32_t appFlags, uint32_t targetApiVersion,
     const std::vector<uint8_t> &nanoappBinary, uint32_t fragmentId,
     size_t appTotalSizeBytes, bool respondBeforeStart) {
-  auto appBinary = builder.CreateVector(nanoappBinary);
+  encodeLoadNanoappRequestForBinary(
+      builder, transactionId, appId, appVersion, appFlags, targetApiVersion,
+      nanoappBinary.data(), nanoappBinary.size(), fragmentId,
+      appTotalSizeBytes, respondBeforeStart);
+}
+
+void HostProtocolHost::encodeLoadNanoappRequestForBinary(
+    FlatBufferBuilder &builder, uint32_t transactionId, uint64_t appId,
+    uint32_t appVersion, uint32_t appFlags, uint32_t targetApiVersion,
+    const uint8_t *nanoappBinary, size_t nanoappBinarySize,
+    uint32_t fragmentId, size_t appTotalSizeBytes, bool respondBeforeStart) {
+  auto appBinary = builder.CreateVector(nanoappBinary, nanoappBinarySize);
   auto request = fbs::CreateLoadNanoappRequest(
       builder, transactionId, appId, appVersion, targetApiVersion, appBinary,
       fragmentId, appTotalSizeBytes, 0 /* app_binary_file_name */, appFlags,
@@ -18,6 +18,7 @@
 #define CHRE_HOST_FRAGMENTED_LOAD_TRANSACTION_H_
 
 #include <cinttypes>
+#include <memory>
 #include <vector>
 
 #ifndef CHRE_HOST_DEFAULT_FRAGMENT_SIZE
@@ -43,17 +44,22 @@ struct FragmentedLoadRequest {
   uint32_t appFlags;
   uint32_t targetApiVersion;
   size_t appTotalSizeBytes;
-  std::vector<uint8_t> binary;
+
+  //! The fragment of the nanoapp binary. This points into the binary held by
+  //! the FragmentedLoadTransaction that produced this request, and is valid
+  //! for as long as that binary is.
+  const uint8_t *binary;
+  size_t binarySize;
 
   FragmentedLoadRequest(size_t fragmentId, uint32_t transactionId,
-                        const std::vector<uint8_t> &binary)
-      : FragmentedLoadRequest(fragmentId, transactionId, 0, 0, 0, 0, 0,
-                              binary) {}
+                        const uint8_t *binary, size_t binarySize)
+      : FragmentedLoadRequest(fragmentId, transactionId, 0, 0, 0, 0, 0, binary,
+                              binarySize) {}
 
   FragmentedLoadRequest(size_t fragmentId, uint32_t transactionId,
                         uint64_t appId, uint32_t appVersion, uint32_t appFlags,
                         uint32_t targetApiVersion, size_t appTotalSizeBytes,
-                        const std::vector<uint8_t> &binary)
+                        const uint8_t *binary, size_t binarySize)
       : fragmentId(fragmentId),
         transactionId(transactionId),
         appId(appId),
@@ -61,16 +67,16 @@ struct FragmentedLoadRequest {
         appFlags(appFlags),
         targetApiVersion(targetApiVersion),
         appTotalSizeBytes(appTotalSizeBytes),
-        binary(binary) {}
+        binary(binary),
+        binarySize(binarySize) {}
 };
 
 /**
- * A class which splits a load transaction into separate requests with
- * fragmented binaries. This class can be used to send smaller chunks of data
- * when the kernel is under memory pressure and has limited contiguous memory.
- * The caller should use the getNextRequest() to retrieve the next available
- * fragment and send a load request with the fragmented binary and the fragment
- * ID.
+ * Splits a nanoapp binary into the requests of a fragmented load transaction.
+ *
+ * Requests are produced on demand by getNextRequest() and refer to the binary
+ * in place, so the binary is never copied into per-fragment buffers. The
+ * binary can be held in memory or mapped from a file with mapBinaryFile().
  */
 class FragmentedLoadTransaction {
  public:
@@ -89,6 +95,32 @@ class FragmentedLoadTransaction {
                             const std::vector<uint8_t> &appBinary,
                             size_t fragmentSize = kDefaultFragmentSize);
 
+  /**
+   * Same as above, but shares ownership of the binary instead of copying it,
+   * e.g. to stream the fragments from a binary returned by mapBinaryFile().
+   *
+   * @param appBinary the nanoapp binary data
+   * @param appBinarySize the size of the nanoapp binary in bytes
+   */
+  FragmentedLoadTransaction(uint32_t transactionId, uint64_t appId,
+                            uint32_t appVersion, uint32_t appFlags,
+                            uint32_t targetApiVersion,
+                            std::shared_ptr<const uint8_t> appBinary,
+                            size_t appBinarySize,
+                            size_t fragmentSize = kDefaultFragmentSize);
+
+  /**
+   * Maps a nanoapp binary file into memory read-only. The file is unmapped
+   * once the last reference to the returned binary is released.
+   *
+   * @param filename the path of the nanoapp binary
+   * @param size a non-null pointer that is set to the size of the file
+   *
+   * @return the mapped binary, or nullptr if the file could not be mapped
+   */
+  static std::shared_ptr<const uint8_t> mapBinaryFile(const char *filename,
+                                                      size_t *size);
+
   /**
    * Retrieves the FragmentedLoadRequest including the next fragment of the
    * binary. Invoking getNextRequest() will prepare the next fragment for a
@@ -97,7 +129,8 @@ class FragmentedLoadTransaction {
    * Invoking this method when there is no next request (i.e. isComplete()
    * returns true) is illegal.
    *
-   * @return returns a reference to the next fragment.
+   * @return returns a reference to the next fragment, which is valid until
+   *         getNextRequest() is invoked again.
    */
   const FragmentedLoadRequest &getNextRequest();
 
@@ -112,7 +145,19 @@ class FragmentedLoadTransaction {
   }
 
  private:
-  std::vector<FragmentedLoadRequest> mFragmentRequests;
+  //! The nanoapp binary that requests refer to.
+  std::shared_ptr<const uint8_t> mAppBinary;
+  size_t mAppBinarySize;
+  size_t mFragmentSize;
+  size_t mNumFragments;
+
+  uint64_t mAppId;
+  uint32_t mAppVersion;
+  uint32_t mAppFlags;
+  uint32_t mTargetApiVersion;
+
+  //! The request last returned by getNextRequest().
+  FragmentedLoadRequest mCurrentRequest;
   size_t mCurrentRequestIndex = 0;
   uint32_t mTransactionId;
 
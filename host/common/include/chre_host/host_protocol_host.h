@@ -205,6 +205,17 @@ class HostProtocolHost : public ::chre::HostProtocolCommon {
       uint32_t targetApiVersion, const std::vector<uint8_t> &nanoappBinary,
       uint32_t fragmentId, size_t appTotalSizeBytes, bool respondBeforeStart);
 
+  /**
+   * Same as above, but takes the binary payload as a pointer and size so that
+   * a fragment of a larger binary can be encoded without copying it first.
+   */
+  static void encodeLoadNanoappRequestForBinary(
+      flatbuffers::FlatBufferBuilder &builder, uint32_t transactionId,
+      uint64_t appId, uint32_t appVersion, uint32_t appFlags,
+      uint32_t targetApiVersion, const uint8_t *nanoappBinary,
+      size_t nanoappBinarySize, uint32_t fragmentId, size_t appTotalSizeBytes,
+      bool respondBeforeStart);
+
   /**
    * Encodes a message requesting to load a nanoapp specified by the included
    * binary filename and metadata.
@@ -17,11 +17,11 @@
 #ifndef CHRE_HOST_SOCKET_SERVER_H_
 #define CHRE_HOST_SOCKET_SERVER_H_
 
-#include <poll.h>
-
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -62,7 +62,9 @@ class SocketServer {
            ClientMessageCallback clientMessageCallback);
 
   /**
-   * Delivers data to all connected clients. This method is thread-safe.
+   * Delivers data to all connected clients. This method is thread-safe and
+   * does not block: data that a client can't accept right away is queued and
+   * written from the receive loop once the client's socket is writable.
    *
    * @param data Pointer to buffer containing message data
    * @param length Number of bytes of data to send
@@ -71,31 +73,47 @@ class SocketServer {
 
   /**
    * Sends a message to one client, specified via its unique client ID. This
-   * method is thread-safe.
+   * method is thread-safe and does not block, see sendToAllClients().
    *
    * @param data
    * @param length
    * @param clientId
    *
-   * @return true if the message was successfully sent to the specified client
+   * @return true if the message was sent or queued for the specified client
    */
   bool sendToClientById(const void *data, size_t length, uint16_t clientId);
 
  private:
   DISALLOW_COPY_AND_ASSIGN(SocketServer);
 
-  static constexpr size_t kMaxActiveClients = 8;
-  static constexpr int kMaxPendingConnectionRequests =
-      static_cast<int>(kMaxActiveClients);
+  static constexpr int kMaxPendingConnectionRequests = 8;
   static constexpr size_t kMaxPacketSize = 1024 * 1024;
 
+  //! The maximum number of bytes queued for a client that isn't reading its
+  //! socket. Messages beyond that are dropped for this client only, so a slow
+  //! client can't hold up delivery to the others.
+  static constexpr size_t kMaxClientQueueSize = 1024 * 1024;
+
+  //! The maximum number of events handled per call to epoll_pwait().
+  static constexpr int kMaxEvents = 16;
+
   int mSockFd = INVALID_SOCKET;
+  int mEpollFd = -1;
   uint16_t mNextClientId = 1;
-  // TODO: std::vector-ify this
-  struct pollfd mPollFds[1 + kMaxActiveClients] = {};
+
+  typedef std::shared_ptr<const std::vector<uint8_t>> Packet;
 
   struct ClientData {
     uint16_t clientId;
+
+    //! Packets that couldn't be written to the socket yet, oldest first.
+    std::deque<Packet> queue;
+
+    //! The total size of the packets in queue.
+    size_t queuedBytes = 0;
+
+    //! The number of packets that were dropped because the queue was full.
+    uint64_t droppedCount = 0;
   };
 
   // Maps from socket FD to ClientData
@@ -105,8 +123,8 @@ class SocketServer {
   // the stack.
   std::vector<uint8_t> mRecvBuffer = std::vector<uint8_t>(kMaxPacketSize);
 
-  // Ensures that mClients can be safely iterated over from other threads
-  // without worrying about potential modification from the RX thread
+  // Guards mClients and the client queues, which are accessed by the sending
+  // threads and the RX thread
   std::mutex mClientsMutex;
 
   ClientMessageCallback mClientMessageCallback;
@@ -114,8 +132,32 @@ class SocketServer {
   void acceptClientConnection();
   void disconnectClient(int clientSocket);
   void handleClientData(int clientSocket);
-  bool sendToClientSocket(const void *data, size_t length, int clientSocket,
-                          uint16_t clientId);
+  uint16_t allocateClientId();
+
+  /**
+   * Sends or queues a packet for one client. Must be called with
+   * mClientsMutex held.
+   *
+   * @param packet A non-null pointer to the shared copy of data that is
+   *        queued. It is created on demand if it is empty, so that a broadcast
+   *        copies data at most once.
+   *
+   * @return true if the packet was sent or queued
+   */
+  bool sendToClientLocked(const void *data, size_t length, Packet *packet,
+                          int clientSocket, ClientData *clientData);
+
+  /**
+   * Writes as many queued packets to the client as its socket accepts. Must
+   * be called with mClientsMutex held.
+   */
+  void flushClientQueueLocked(int clientSocket, ClientData *clientData);
+
+  /**
+   * Updates whether the RX loop waits for the client's socket to become
+   * writable.
+   */
+  void setWriteNotification(int clientSocket, bool enabled);
   void serviceSocket();
 
   static std::atomic<bool> sSignalReceived;
@@ -16,9 +16,9 @@
 
 #include "chre_host/socket_server.h"
 
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 
-#include <cassert>
 #include <cinttypes>
 #include <csignal>
 #include <cstdlib>
@@ -56,14 +56,7 @@ void maskAllSignalsExceptIntAndTerm() {
 
 }  // anonymous namespace
 
-SocketServer::SocketServer() {
-  // Initialize the socket fds field for all inactive client slots to -1, so
-  // poll skips over it, and we don't attempt to send on it
-  for (size_t i = 1; i <= kMaxActiveClients; i++) {
-    mPollFds[i].fd = -1;
-    mPollFds[i].events = POLLIN;
-  }
-}
+SocketServer::SocketServer() {}
 
 void SocketServer::run(const char *socketName, bool allowSocketCreation,
                        ClientMessageCallback clientMessageCallback) {
@@ -79,8 +72,16 @@ void SocketServer::run(const char *socketName, bool allowSocketCreation,
   if (mSockFd == INVALID_SOCKET) {
     LOGE("Couldn't get/create socket");
   } else {
-    int ret = listen(mSockFd, kMaxPendingConnectionRequests);
-    if (ret < 0) {
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = mSockFd;
+
+    if (mEpollFd < 0) {
+      LOG_ERROR("Couldn't create epoll instance", errno);
+    } else if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mSockFd, &event) != 0) {
+      LOG_ERROR("Couldn't add socket to epoll instance", errno);
+    } else if (listen(mSockFd, kMaxPendingConnectionRequests) < 0) {
       LOG_ERROR("Couldn't listen on socket", errno);
     } else {
       serviceSocket();
@@ -97,6 +98,11 @@ void SocketServer::run(const char *socketName, bool allowSocketCreation,
       }
       mClients.clear();
     }
+
+    if (mEpollFd >= 0) {
+      close(mEpollFd);
+      mEpollFd = -1;
+    }
     close(mSockFd);
   }
 }
@@ -105,15 +111,10 @@ void SocketServer::sendToAllClients(const void *data, size_t length) {
   std::lock_guard<std::mutex> lock(mClientsMutex);
 
   int deliveredCount = 0;
-  for (const auto &pair : mClients) {
-    int clientSocket = pair.first;
-    uint16_t clientId = pair.second.clientId;
-    if (sendToClientSocket(data, length, clientSocket, clientId)) {
+  Packet packet;
+  for (auto &pair : mClients) {
+    if (sendToClientLocked(data, length, &packet, pair.first, &pair.second)) {
       deliveredCount++;
-    } else if (errno == EINTR) {
-      // Exit early if we were interrupted - we should only get this for
-      // SIGINT/SIGTERM, so we should exit quickly
-      break;
     }
   }
 
@@ -127,11 +128,11 @@ bool SocketServer::sendToClientById(const void *data, size_t length,
   std::lock_guard<std::mutex> lock(mClientsMutex);
 
   bool sent = false;
-  for (const auto &pair : mClients) {
-    uint16_t thisClientId = pair.second.clientId;
-    if (thisClientId == clientId) {
-      int clientSocket = pair.first;
-      sent = sendToClientSocket(data, length, clientSocket, thisClientId);
+  for (auto &pair : mClients) {
+    if (pair.second.clientId == clientId) {
+      Packet packet;
+      sent = sendToClientLocked(data, length, &packet, pair.first,
+                                &pair.second);
       break;
     }
   }
@@ -140,43 +141,24 @@ bool SocketServer::sendToClientById(const void *data, size_t length,
 }
 
 void SocketServer::acceptClientConnection() {
-  int clientSocket = accept(mSockFd, NULL, NULL);
+  int clientSocket =
+      accept4(mSockFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
   if (clientSocket < 0) {
     LOG_ERROR("Couldn't accept client connection", errno);
-  } else if (mClients.size() >= kMaxActiveClients) {
-    LOGW("Rejecting client request - maximum number of clients reached");
-    close(clientSocket);
   } else {
-    ClientData clientData;
-    clientData.clientId = mNextClientId++;
-
-    // We currently don't handle wraparound - if we're getting this many
-    // connects/disconnects, then something is wrong.
-    // TODO: can handle this properly by iterating over the existing clients to
-    // avoid a conflict.
-    if (clientData.clientId == 0) {
-      LOGE("Couldn't allocate client ID");
-      std::exit(-1);
-    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = clientSocket;
 
-    bool slotFound = false;
-    for (size_t i = 1; i <= kMaxActiveClients; i++) {
-      if (mPollFds[i].fd < 0) {
-        mPollFds[i].fd = clientSocket;
-        slotFound = true;
-        break;
-      }
-    }
+    std::lock_guard<std::mutex> lock(mClientsMutex);
+    ClientData &clientData = mClients[clientSocket];
+    clientData.clientId = allocateClientId();
 
-    if (!slotFound) {
-      LOGE("Couldn't find slot for client!");
-      assert(slotFound);
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, clientSocket, &event) != 0) {
+      LOG_ERROR("Couldn't add client to epoll instance", errno);
+      mClients.erase(clientSocket);
       close(clientSocket);
     } else {
-      {
-        std::lock_guard<std::mutex> lock(mClientsMutex);
-        mClients[clientSocket] = clientData;
-      }
       LOGI(
           "Accepted new client connection (count %zu), assigned client ID "
           "%" PRIu16,
@@ -185,15 +167,43 @@ void SocketServer::acceptClientConnection() {
   }
 }
 
+uint16_t SocketServer::allocateClientId() {
+  // Skip over 0, which isn't a valid client ID, and IDs still in use after
+  // wrapping around.
+  auto isInUse = [this](uint16_t clientId) {
+    for (const auto &pair : mClients) {
+      if (pair.second.clientId == clientId) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  uint16_t clientId;
+  do {
+    clientId = mNextClientId++;
+  } while (clientId == 0 || isInUse(clientId));
+
+  return clientId;
+}
+
 void SocketServer::handleClientData(int clientSocket) {
-  const ClientData &clientData = mClients[clientSocket];
-  uint16_t clientId = clientData.clientId;
+  uint16_t clientId;
+  {
+    std::lock_guard<std::mutex> lock(mClientsMutex);
+    clientId = mClients[clientSocket].clientId;
+  }
 
   ssize_t packetSize =
       recv(clientSocket, mRecvBuffer.data(), mRecvBuffer.size(), MSG_DONTWAIT);
   if (packetSize < 0) {
-    LOGE("Couldn't get packet from client %" PRIu16 ": %s", clientId,
-         strerror(errno));
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      // Errors such as a reset connection are reported on every poll, so the
+      // client must be dropped.
+      LOGE("Couldn't get packet from client %" PRIu16 ": %s", clientId,
+           strerror(errno));
+      disconnectClient(clientSocket);
+    }
   } else if (packetSize == 0) {
     LOGI("Client %" PRIu16 " disconnected", clientId);
     disconnectClient(clientSocket);
@@ -206,91 +216,159 @@ void SocketServer::handleClientData(int clientSocket) {
 void SocketServer::disconnectClient(int clientSocket) {
   {
     std::lock_guard<std::mutex> lock(mClientsMutex);
-    mClients.erase(clientSocket);
+    auto it = mClients.find(clientSocket);
+    if (it != mClients.end()) {
+      if (it->second.droppedCount > 0) {
+        LOGW("Dropped %" PRIu64 " messages for client %" PRIu16
+             " that it didn't read in time",
+             it->second.droppedCount, it->second.clientId);
+      }
+      mClients.erase(it);
+    }
+
+    // Closing the socket also removes it from the epoll instance. This is done
+    // with the lock held so that a sending thread can't modify the epoll
+    // registration of a reused FD.
+    close(clientSocket);
   }
-  close(clientSocket);
+}
 
-  bool removed = false;
-  for (size_t i = 1; i <= kMaxActiveClients; i++) {
-    if (mPollFds[i].fd == clientSocket) {
-      mPollFds[i].fd = -1;
-      removed = true;
-      break;
+bool SocketServer::sendToClientLocked(const void *data, size_t length,
+                                      Packet *packet, int clientSocket,
+                                      ClientData *clientData) {
+  bool sent = false;
+  bool mustQueue = true;
+  uint16_t clientId = clientData->clientId;
+
+  // Packets must be delivered in order, so only send directly if nothing is
+  // waiting to be written.
+  if (clientData->queue.empty()) {
+    ssize_t bytesSent = send(clientSocket, data, length, MSG_NOSIGNAL);
+    if (bytesSent >= 0) {
+      LOGV("Delivered message of size %zu bytes to client %" PRIu16, length,
+           clientId);
+      sent = true;
+      mustQueue = false;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      LOGE("Error sending packet of size %zu to client %" PRIu16 ": %s",
+           length, clientId, strerror(errno));
+      mustQueue = false;
     }
   }
 
-  if (!removed) {
-    LOGE("Out of sync");
-    assert(removed);
+  // The client isn't keeping up, so queue the packet unless that would exceed
+  // its budget. A single packet is always accepted into an empty queue.
+  if (mustQueue) {
+    if (!clientData->queue.empty() &&
+        clientData->queuedBytes + length > kMaxClientQueueSize) {
+      if (clientData->droppedCount == 0) {
+        LOGW("Client %" PRIu16 " isn't reading its socket, dropping messages",
+             clientId);
+      }
+      clientData->droppedCount++;
+    } else {
+      if (*packet == nullptr) {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        *packet = std::make_shared<const std::vector<uint8_t>>(
+            bytes, bytes + length);
+      }
+
+      if (clientData->queue.empty()) {
+        setWriteNotification(clientSocket, true);
+      }
+      clientData->queue.push_back(*packet);
+      clientData->queuedBytes += length;
+      sent = true;
+    }
   }
+
+  return sent;
 }
 
-bool SocketServer::sendToClientSocket(const void *data, size_t length,
-                                      int clientSocket, uint16_t clientId) {
-  errno = 0;
-  ssize_t bytesSent = send(clientSocket, data, length, 0);
-  if (bytesSent < 0) {
-    LOGE("Error sending packet of size %zu to client %" PRIu16 ": %s", length,
-         clientId, strerror(errno));
-  } else if (bytesSent == 0) {
-    LOGW("Client %" PRIu16 " disconnected before message could be delivered",
-         clientId);
-  } else {
-    LOGV("Delivered message of size %zu bytes to client %" PRIu16, length,
-         clientId);
+void SocketServer::flushClientQueueLocked(int clientSocket,
+                                          ClientData *clientData) {
+  while (!clientData->queue.empty()) {
+    const Packet &packet = clientData->queue.front();
+    ssize_t bytesSent =
+        send(clientSocket, packet->data(), packet->size(), MSG_NOSIGNAL);
+    if (bytesSent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+
+      // The RX loop disconnects the client once it notices the hangup.
+      LOGE("Error sending packet of size %zu to client %" PRIu16 ": %s",
+           packet->size(), clientData->clientId, strerror(errno));
+    }
+
+    clientData->queuedBytes -= packet->size();
+    clientData->queue.pop_front();
   }
 
-  return (bytesSent > 0);
+  if (clientData->queue.empty()) {
+    setWriteNotification(clientSocket, false);
+  }
 }
 
-void SocketServer::serviceSocket() {
-  constexpr size_t kListenIndex = 0;
-  static_assert(kListenIndex == 0,
-                "Code assumes that the first index is always the listen "
-                "socket");
-
-  mPollFds[kListenIndex].fd = mSockFd;
-  mPollFds[kListenIndex].events = POLLIN;
+void SocketServer::setWriteNotification(int clientSocket, bool enabled) {
+  struct epoll_event event = {};
+  event.events = enabled ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+  event.data.fd = clientSocket;
+  if (epoll_ctl(mEpollFd, EPOLL_CTL_MOD, clientSocket, &event) != 0) {
+    LOG_ERROR("Couldn't update client epoll registration", errno);
+  }
+}
 
-  // Signal mask used with ppoll() so we gracefully handle SIGINT and SIGTERM,
-  // and ignore other signals
+void SocketServer::serviceSocket() {
+  // Signal mask used with epoll_pwait() so we gracefully handle SIGINT and
+  // SIGTERM, and ignore other signals
   sigset_t signalMask;
   sigfillset(&signalMask);
   sigdelset(&signalMask, SIGINT);
   sigdelset(&signalMask, SIGTERM);
 
   // Masking signals here ensure that after this point, we won't handle INT/TERM
-  // until after we call into ppoll()
+  // until after we call into epoll_pwait()
   maskAllSignals();
   std::signal(SIGINT, signalHandler);
   std::signal(SIGTERM, signalHandler);
 
   LOGI("Ready to accept connections");
+  struct epoll_event events[kMaxEvents];
   while (!sSignalReceived) {
-    int ret = TEMP_FAILURE_RETRY(
-        ppoll(mPollFds, 1 + kMaxActiveClients, nullptr, &signalMask));
+    int ret = epoll_pwait(mEpollFd, events, kMaxEvents, -1, &signalMask);
     maskAllSignalsExceptIntAndTerm();
-    if (ret == -1) {
+    // EINTR isn't retried here so that the loop condition is checked after a
+    // signal; ret is -1 in that case, so no events are handled.
+    if (ret == -1 && errno != EINTR) {
       LOGI("Exiting poll loop: %s", strerror(errno));
       break;
     }
 
-    if (mPollFds[kListenIndex].revents & POLLIN) {
-      acceptClientConnection();
-    }
-
-    for (size_t i = 1; i <= kMaxActiveClients; i++) {
-      if (mPollFds[i].fd < 0) {
+    for (int i = 0; i < ret; i++) {
+      int fd = events[i].data.fd;
+      if (fd == mSockFd) {
+        acceptClientConnection();
         continue;
       }
 
-      if (mPollFds[i].revents & POLLIN) {
-        handleClientData(mPollFds[i].fd);
+      if (events[i].events & EPOLLOUT) {
+        std::lock_guard<std::mutex> lock(mClientsMutex);
+        auto it = mClients.find(fd);
+        if (it != mClients.end()) {
+          flushClientQueueLocked(fd, &it->second);
+        }
+      }
+
+      // A hangup is handled through recv() returning 0, after any remaining
+      // data has been read.
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        handleClientData(fd);
       }
     }
 
     // Mask all signals to ensure that sSignalReceived can't become true between
-    // checking it in the while condition and calling into ppoll()
+    // checking it in the while condition and calling into epoll_pwait()
     maskAllSignals();
   }
 }
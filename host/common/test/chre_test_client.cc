@@ -205,19 +205,19 @@ bool readFileContents(const char *filename, std::vector<uint8_t> *buffer) {
 
 void sendNanoappLoad(SocketClient &client, uint64_t appId, uint32_t appVersion,
                      uint32_t apiVersion, uint32_t appFlags,
-                     const std::vector<uint8_t> &binary) {
+                     std::shared_ptr<const uint8_t> binary, size_t binarySize) {
   // Perform loading with 1 fragment for simplicity
-  FlatBufferBuilder builder(binary.size() + 128);
+  FlatBufferBuilder builder(binarySize + 128);
   FragmentedLoadTransaction transaction = FragmentedLoadTransaction(
-      1 /* transactionId */, appId, appVersion, appFlags, apiVersion, binary,
-      binary.size() /* fragmentSize */);
+      1 /* transactionId */, appId, appVersion, appFlags, apiVersion,
+      std::move(binary), binarySize, binarySize /* fragmentSize */);
   HostProtocolHost::encodeFragmentedLoadNanoappRequest(
       builder, transaction.getNextRequest());
 
   LOGI("Sending load nanoapp request (%" PRIu32
        " bytes total w/%zu bytes of "
        "payload)",
-       builder.GetSize(), binary.size());
+       builder.GetSize(), binarySize);
   if (!client.sendMessage(builder.GetBufferPointer(), builder.GetSize())) {
     LOGE("Failed to send message");
   }
@@ -226,9 +226,10 @@ void sendNanoappLoad(SocketClient &client, uint64_t appId, uint32_t appVersion,
 void sendLoadNanoappRequest(SocketClient &client, const char *headerPath,
                             const char *binaryPath) {
   std::vector<uint8_t> headerBuffer;
-  std::vector<uint8_t> binaryBuffer;
-  if (readFileContents(headerPath, &headerBuffer) &&
-      readFileContents(binaryPath, &binaryBuffer)) {
+  size_t binarySize;
+  std::shared_ptr<const uint8_t> binary =
+      FragmentedLoadTransaction::mapBinaryFile(binaryPath, &binarySize);
+  if (binary != nullptr && readFileContents(headerPath, &headerBuffer)) {
     if (headerBuffer.size() != sizeof(NanoAppBinaryHeader)) {
       LOGE("Header size mismatch");
     } else {
@@ -241,7 +242,8 @@ void sendLoadNanoappRequest(SocketClient &client, const char *headerPath,
                                   (appHeader->targetChreApiMinorVersion << 16);
 
       sendNanoappLoad(client, appHeader->appId, appHeader->appVersion,
-                      targetApiVersion, appHeader->flags, binaryBuffer);
+                      targetApiVersion, appHeader->flags, std::move(binary),
+                      binarySize);
     }
   }
 }
@@ -249,15 +251,18 @@ void sendLoadNanoappRequest(SocketClient &client, const char *headerPath,
 void sendLoadNanoappRequest(SocketClient &client, const char *filename,
                             uint64_t appId, uint32_t appVersion,
                             uint32_t apiVersion, bool tcmApp) {
-  std::vector<uint8_t> buffer;
-  if (readFileContents(filename, &buffer)) {
+  size_t binarySize;
+  std::shared_ptr<const uint8_t> binary =
+      FragmentedLoadTransaction::mapBinaryFile(filename, &binarySize);
+  if (binary != nullptr) {
     // All loaded nanoapps must be signed currently.
     uint32_t appFlags = CHRE_NAPP_HEADER_SIGNED;
     if (tcmApp) {
       appFlags |= CHRE_NAPP_HEADER_TCM_CAPABLE;
     }
 
-    sendNanoappLoad(client, appId, appVersion, apiVersion, appFlags, buffer);
+    sendNanoappLoad(client, appId, appVersion, apiVersion, appFlags,
+                    std::move(binary), binarySize);
   }
 }
 
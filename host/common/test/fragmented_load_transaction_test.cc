@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre_host/fragmented_load_transaction.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "chre_host/host_protocol_host.h"
+
+using android::chre::FragmentedLoadRequest;
+using android::chre::FragmentedLoadTransaction;
+using android::chre::HostProtocolHost;
+using flatbuffers::FlatBufferBuilder;
+
+namespace {
+
+constexpr uint32_t kTransactionId = 1234;
+constexpr uint64_t kAppId = 0x476f6f676c000001;
+constexpr uint32_t kAppVersion = 3;
+constexpr uint32_t kAppFlags = 0x1;
+constexpr uint32_t kTargetApiVersion = 0x01050000;
+constexpr size_t kFragmentSize = 1000;
+
+std::vector<uint8_t> makeBinary(size_t size) {
+  std::vector<uint8_t> binary(size);
+  for (size_t i = 0; i < size; i++) {
+    binary[i] = static_cast<uint8_t>(i * 7 + i / 251);
+  }
+  return binary;
+}
+
+/**
+ * Encodes a fragment the way the transaction did before it referred to the
+ * binary in place, i.e. from a copy of the fragment in its own vector.
+ */
+std::vector<uint8_t> encodeCopiedFragment(const std::vector<uint8_t> &binary,
+                                          size_t fragmentIndex) {
+  size_t start = std::min(binary.size(), fragmentIndex * kFragmentSize);
+  size_t end = std::min(binary.size(), start + kFragmentSize);
+  std::vector<uint8_t> fragment(binary.begin() + start, binary.begin() + end);
+
+  // Only the first fragment carries the attributes of the nanoapp.
+  bool isFirst = (fragmentIndex == 0);
+  FlatBufferBuilder builder;
+  HostProtocolHost::encodeLoadNanoappRequestForBinary(
+      builder, kTransactionId, isFirst ? kAppId : 0,
+      isFirst ? kAppVersion : 0, isFirst ? kAppFlags : 0,
+      isFirst ? kTargetApiVersion : 0, fragment,
+      static_cast<uint32_t>(fragmentIndex + 1),
+      isFirst ? binary.size() : 0, false /* respondBeforeStart */);
+  return std::vector<uint8_t>(builder.GetBufferPointer(),
+                              builder.GetBufferPointer() + builder.GetSize());
+}
+
+/**
+ * Checks that every fragment of the transaction is encoded to the same message
+ * as a copy of the corresponding part of the binary.
+ */
+void expectIdenticalFragments(FragmentedLoadTransaction &transaction,
+                              const std::vector<uint8_t> &binary) {
+  size_t numFragments = std::max<size_t>(
+      1, (binary.size() + kFragmentSize - 1) / kFragmentSize);
+  for (size_t i = 0; i < numFragments; i++) {
+    ASSERT_FALSE(transaction.isComplete());
+    const FragmentedLoadRequest &request = transaction.getNextRequest();
+    FlatBufferBuilder builder;
+    HostProtocolHost::encodeFragmentedLoadNanoappRequest(builder, request);
+
+    std::vector<uint8_t> message(
+        builder.GetBufferPointer(),
+        builder.GetBufferPointer() + builder.GetSize());
+    EXPECT_EQ(message, encodeCopiedFragment(binary, i)) << "fragment " << i;
+  }
+  EXPECT_TRUE(transaction.isComplete());
+}
+
+}  // anonymous namespace
+
+TEST(FragmentedLoadTransactionTest, CopiedBinaryProducesIdenticalFragments) {
+  for (size_t size : {0, 1, 999, 1000, 1001, 5000, 5432}) {
+    std::vector<uint8_t> binary = makeBinary(size);
+    FragmentedLoadTransaction transaction(kTransactionId, kAppId, kAppVersion,
+                                          kAppFlags, kTargetApiVersion, binary,
+                                          kFragmentSize);
+
+    // The transaction must not refer to the caller's vector.
+    std::vector<uint8_t> expected = binary;
+    std::fill(binary.begin(), binary.end(), 0);
+    expectIdenticalFragments(transaction, expected);
+  }
+}
+
+TEST(FragmentedLoadTransactionTest, SharedBinaryProducesIdenticalFragments) {
+  for (size_t size : {1, 999, 1000, 1001, 5000, 5432}) {
+    std::vector<uint8_t> binary = makeBinary(size);
+    auto shared = std::make_shared<const std::vector<uint8_t>>(binary);
+    FragmentedLoadTransaction transaction(
+        kTransactionId, kAppId, kAppVersion, kAppFlags, kTargetApiVersion,
+        std::shared_ptr<const uint8_t>(shared, shared->data()), size,
+        kFragmentSize);
+
+    // The transaction keeps the binary alive.
+    shared.reset();
+    expectIdenticalFragments(transaction, binary);
+  }
+}
+
+TEST(FragmentedLoadTransactionTest, MappedFileProducesIdenticalFragments) {
+  std::vector<uint8_t> binary = makeBinary(5432);
+  std::string path = testing::TempDir() + "fragmented_load_transaction_test_" +
+                     std::to_string(getpid()) + ".so";
+  FILE *file = fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(fwrite(binary.data(), 1, binary.size(), file), binary.size());
+  ASSERT_EQ(fclose(file), 0);
+
+  size_t mappedSize = 0;
+  std::shared_ptr<const uint8_t> mapped =
+      FragmentedLoadTransaction::mapBinaryFile(path.c_str(), &mappedSize);
+  unlink(path.c_str());
+  ASSERT_NE(mapped, nullptr);
+  ASSERT_EQ(mappedSize, binary.size());
+
+  FragmentedLoadTransaction transaction(kTransactionId, kAppId, kAppVersion,
+                                        kAppFlags, kTargetApiVersion,
+                                        std::move(mapped), mappedSize,
+                                        kFragmentSize);
+  expectIdenticalFragments(transaction, binary);
+}
+
+TEST(FragmentedLoadTransactionTest, MapMissingFileFails) {
+  size_t mappedSize = 0;
+  EXPECT_EQ(FragmentedLoadTransaction::mapBinaryFile(
+                "/nonexistent/fragmented_load_transaction_test.so",
+                &mappedSize),
+            nullptr);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre_host/log.h"
+#include "chre_host/socket_server.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <cutils/sockets.h>
+
+/**
+ * @file
+ * A benchmark for the fan-out path of SocketServer. It starts a server, connects
+ * a number of local clients to it, some of which read slowly, and broadcasts
+ * messages at the highest rate the server accepts, similar to a log storm.
+ *
+ * Usage:
+ *  chre_socket_server_benchmark [num-clients] [num-slow-clients] \
+ *      [num-messages] [message-size]
+ */
+
+using android::chre::SocketServer;
+
+namespace {
+
+constexpr char kSocketName[] = "chre_socket_server_benchmark";
+
+//! A slow client sleeps this long before reading each message.
+constexpr auto kSlowClientReadDelay = std::chrono::milliseconds(1);
+
+//! Clients stop once they haven't received anything for this long.
+constexpr int kClientIdleTimeoutMs = 500;
+
+struct ClientStats {
+  uint64_t messagesReceived = 0;
+  uint64_t bytesReceived = 0;
+};
+
+int connectClient() {
+  int sockFd = INVALID_SOCKET;
+  for (int attempt = 0; attempt < 100 && sockFd == INVALID_SOCKET; attempt++) {
+    sockFd = socket_local_client(kSocketName, ANDROID_SOCKET_NAMESPACE_RESERVED,
+                                 SOCK_SEQPACKET);
+    if (sockFd == INVALID_SOCKET) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  if (sockFd != INVALID_SOCKET) {
+    struct timeval timeout = {};
+    timeout.tv_usec = kClientIdleTimeoutMs * 1000;
+    setsockopt(sockFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Announce the client so that the benchmark only starts once the server
+    // has registered every client.
+    uint8_t hello = 0;
+    send(sockFd, &hello, sizeof(hello), 0);
+  }
+
+  return sockFd;
+}
+
+void runClient(int sockFd, bool slow, ClientStats *stats) {
+  std::vector<uint8_t> buffer(64 * 1024);
+  while (true) {
+    if (slow) {
+      std::this_thread::sleep_for(kSlowClientReadDelay);
+    }
+
+    ssize_t size = recv(sockFd, buffer.data(), buffer.size(), 0);
+    if (size <= 0) {
+      break;
+    }
+    stats->messagesReceived++;
+    stats->bytesReceived += static_cast<uint64_t>(size);
+  }
+  close(sockFd);
+}
+
+size_t parseArg(int argc, char **argv, int index, size_t defaultValue) {
+  return (argc > index) ? static_cast<size_t>(strtoul(argv[index], nullptr, 0))
+                        : defaultValue;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char **argv) {
+  size_t numClients = parseArg(argc, argv, 1, 32);
+  size_t numSlowClients = std::min(numClients, parseArg(argc, argv, 2, 1));
+  size_t numMessages = parseArg(argc, argv, 3, 100000);
+  size_t messageSize = std::max<size_t>(1, parseArg(argc, argv, 4, 256));
+
+  SocketServer server;
+  std::atomic<size_t> numClientsConnected(0);
+  std::thread serverThread([&]() {
+    server.run(kSocketName, true /* allowSocketCreation */,
+               [&](uint16_t /* clientId */, void * /* data */,
+                   size_t /* len */) { numClientsConnected++; });
+  });
+
+  std::vector<ClientStats> stats(numClients);
+  std::vector<std::thread> clientThreads;
+  for (size_t i = 0; i < numClients; i++) {
+    int sockFd = connectClient();
+    if (sockFd == INVALID_SOCKET) {
+      LOGE("Couldn't connect client %zu", i);
+      std::exit(-1);
+    }
+    clientThreads.emplace_back(runClient, sockFd, (i < numSlowClients),
+                               &stats[i]);
+  }
+
+  while (numClientsConnected < numClients) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  std::vector<uint8_t> message(messageSize, 0xAB);
+  std::chrono::nanoseconds maxSendTime(0);
+  auto startTime = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < numMessages; i++) {
+    auto sendStartTime = std::chrono::steady_clock::now();
+    server.sendToAllClients(message.data(), message.size());
+    maxSendTime =
+        std::max(maxSendTime, std::chrono::steady_clock::now() - sendStartTime);
+  }
+  auto sendDuration = std::chrono::steady_clock::now() - startTime;
+
+  for (auto &thread : clientThreads) {
+    thread.join();
+  }
+
+  // The server loop only exits on SIGINT/SIGTERM, which it unblocks while
+  // waiting for events.
+  pthread_kill(serverThread.native_handle(), SIGINT);
+  serverThread.join();
+
+  auto toUs = [](std::chrono::nanoseconds duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+        .count();
+  };
+  LOGI("Broadcast %zu messages of %zu bytes to %zu clients (%zu slow)",
+       numMessages, messageSize, numClients, numSlowClients);
+  LOGI("Total send time %" PRId64 " us, mean %.2f us, max %" PRId64 " us",
+       static_cast<int64_t>(toUs(sendDuration)),
+       static_cast<double>(toUs(sendDuration)) / numMessages,
+       static_cast<int64_t>(toUs(maxSendTime)));
+
+  uint64_t minFastReceived = UINT64_MAX;
+  uint64_t maxSlowReceived = 0;
+  for (size_t i = 0; i < numClients; i++) {
+    if (i < numSlowClients) {
+      maxSlowReceived = std::max(maxSlowReceived, stats[i].messagesReceived);
+    } else {
+      minFastReceived = std::min(minFastReceived, stats[i].messagesReceived);
+    }
+  }
+  if (numSlowClients < numClients) {
+    LOGI("Fast clients received at least %" PRIu64 " messages",
+         minFastReceived);
+  }
+  if (numSlowClients > 0) {
+    LOGI("Slow clients received at most %" PRIu64 " messages",
+         maxSlowReceived);
+  }
+
+  return 0;
+}
@@ -650,7 +650,7 @@ class GenericContextHubBase : public IContexthubT {
     Result result;
     const FragmentedLoadRequest &request = transaction.getNextRequest();
 
-    FlatBufferBuilder builder(128 + request.binary.size());
+    FlatBufferBuilder builder(128 + request.binarySize);
     HostProtocolHost::encodeFragmentedLoadNanoappRequest(builder, request);
 
     if (!mClient.sendMessage(builder.GetBufferPointer(), builder.GetSize())) {
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/pal/sensor.h"
+
+#include "chre/platform/condition_variable.h"
+#include "chre/platform/log.h"
+#include "chre/platform/mutex.h"
+#include "chre/platform/shared/pal_system_api.h"
+#include "chre/util/dynamic_vector.h"
+#include "chre/util/lock_guard.h"
+#include "chre/util/time.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace sensor_pal_impl_test {
+
+namespace {
+
+using ::chre::Milliseconds;
+using ::chre::Nanoseconds;
+using ::chre::Seconds;
+
+//! The number of samples to receive from a continuous sensor.
+constexpr size_t kNumSamples = 200;
+
+//! The number of sampling intervals a batch may span.
+constexpr uint64_t kSamplesPerBatch = 20;
+
+//! Timeout to wait for a sampling status update or flush completion.
+const Nanoseconds kAsyncResultTimeoutNs = Seconds(5);
+
+//! Timeout to wait for kNumSamples samples.
+const Nanoseconds kSampleTimeoutNs = Seconds(10);
+
+class PalSensorTest;
+
+//! A pointer to the current test running
+PalSensorTest *gTest = nullptr;
+
+bool isThreeAxisSensorType(uint8_t sensorType) {
+  switch (sensorType) {
+    case CHRE_SENSOR_TYPE_ACCELEROMETER:
+    case CHRE_SENSOR_TYPE_UNCALIBRATED_ACCELEROMETER:
+    case CHRE_SENSOR_TYPE_GYROSCOPE:
+    case CHRE_SENSOR_TYPE_UNCALIBRATED_GYROSCOPE:
+    case CHRE_SENSOR_TYPE_GEOMAGNETIC_FIELD:
+    case CHRE_SENSOR_TYPE_UNCALIBRATED_GEOMAGNETIC_FIELD:
+      return true;
+    default:
+      return false;
+  }
+}
+
+class PalSensorTest : public ::testing::Test {
+ public:
+  void samplingStatusUpdateCallback(uint32_t sensorInfoIndex,
+                                    struct chreSensorSamplingStatus *status) {
+    chre::LockGuard<chre::Mutex> lock(mutex_);
+    if (sensorInfoIndex == sensorInfoIndex_) {
+      samplingStatus_ = *status;
+      hasSamplingStatus_ = true;
+      condVar_.notify_one();
+    }
+    api_->releaseSamplingStatusEvent(status);
+  }
+
+  void dataEventCallback(uint32_t sensorInfoIndex, void *data) {
+    auto *event = static_cast<struct chreSensorThreeAxisData *>(data);
+    chre::LockGuard<chre::Mutex> lock(mutex_);
+    if (sensorInfoIndex == sensorInfoIndex_) {
+      EXPECT_EQ(event->header.sensorHandle, sensorInfoIndex);
+      EXPECT_GT(event->header.readingCount, 0);
+      maxReadingCount_ =
+          std::max(maxReadingCount_, event->header.readingCount);
+
+      uint64_t timestampNs = event->header.baseTimestamp;
+      for (uint16_t i = 0; i < event->header.readingCount; i++) {
+        timestampNs += event->readings[i].timestampDelta;
+        timestamps_.push_back(timestampNs);
+      }
+      if (timestamps_.size() >= kNumSamples) {
+        condVar_.notify_one();
+      }
+    }
+    api_->releaseSensorDataEvent(data);
+  }
+
+  void biasEventCallback(uint32_t /* sensorInfoIndex */, void *biasData) {
+    api_->releaseBiasEvent(biasData);
+  }
+
+  void flushCompleteCallback(uint32_t sensorInfoIndex, uint32_t flushRequestId,
+                             uint8_t errorCode) {
+    chre::LockGuard<chre::Mutex> lock(mutex_);
+    if (sensorInfoIndex == sensorInfoIndex_) {
+      completedFlushRequestId_ = flushRequestId;
+      flushErrorCode_ = errorCode;
+      hasFlushCompleted_ = true;
+      condVar_.notify_one();
+    }
+  }
+
+ protected:
+  void SetUp() override;
+
+  void TearDown() override;
+
+  /**
+   * Waits for a sampling status update for the sensor under test, which must
+   * be called with mutex_ held.
+   */
+  void waitForSamplingStatus(bool enabled);
+
+  //! The pointer to the CHRE PAL implementation API
+  const struct chrePalSensorApi *api_;
+
+  //! The sensors returned by the PAL
+  struct chreSensorInfo *sensors_ = nullptr;
+  uint32_t numSensors_ = 0;
+
+  //! Mutex to protect class variables
+  chre::Mutex mutex_;
+  chre::ConditionVariable condVar_;
+
+  //! The index of the sensor under test
+  uint32_t sensorInfoIndex_ = UINT32_MAX;
+
+  bool hasSamplingStatus_ = false;
+  struct chreSensorSamplingStatus samplingStatus_;
+
+  //! The timestamps of the samples received from the sensor under test
+  chre::DynamicVector<uint64_t> timestamps_;
+  uint16_t maxReadingCount_ = 0;
+
+  bool hasFlushCompleted_ = false;
+  uint32_t completedFlushRequestId_ = 0;
+  uint8_t flushErrorCode_ = CHRE_ERROR_LAST;
+};
+
+void chrePalSamplingStatusUpdateCallback(
+    uint32_t sensorInfoIndex, struct chreSensorSamplingStatus *status) {
+  if (gTest != nullptr) {
+    gTest->samplingStatusUpdateCallback(sensorInfoIndex, status);
+  }
+}
+
+void chrePalDataEventCallback(uint32_t sensorInfoIndex, void *data) {
+  if (gTest != nullptr) {
+    gTest->dataEventCallback(sensorInfoIndex, data);
+  }
+}
+
+void chrePalBiasEventCallback(uint32_t sensorInfoIndex, void *biasData) {
+  if (gTest != nullptr) {
+    gTest->biasEventCallback(sensorInfoIndex, biasData);
+  }
+}
+
+void chrePalFlushCompleteCallback(uint32_t sensorInfoIndex,
+                                  uint32_t flushRequestId, uint8_t errorCode) {
+  if (gTest != nullptr) {
+    gTest->flushCompleteCallback(sensorInfoIndex, flushRequestId, errorCode);
+  }
+}
+
+void PalSensorTest::SetUp() {
+  api_ = chrePalSensorGetApi(CHRE_PAL_SENSOR_API_CURRENT_VERSION);
+  ASSERT_NE(api_, nullptr);
+  EXPECT_EQ(api_->moduleVersion, CHRE_PAL_SENSOR_API_CURRENT_VERSION);
+
+  // Open the PAL API
+  static const struct chrePalSensorCallbacks kCallbacks = {
+      .samplingStatusUpdateCallback = chrePalSamplingStatusUpdateCallback,
+      .dataEventCallback = chrePalDataEventCallback,
+      .biasEventCallback = chrePalBiasEventCallback,
+      .flushCompleteCallback = chrePalFlushCompleteCallback,
+  };
+  gTest = this;
+  ASSERT_TRUE(api_->open(&chre::gChrePalSystemApi, &kCallbacks));
+  ASSERT_TRUE(api_->getSensors(&sensors_, &numSensors_));
+}
+
+void PalSensorTest::TearDown() {
+  if (api_ != nullptr) {
+    api_->close();
+  }
+  gTest = nullptr;
+}
+
+void PalSensorTest::waitForSamplingStatus(bool enabled) {
+  bool waitSuccess = true;
+  while (!hasSamplingStatus_ && waitSuccess) {
+    waitSuccess = condVar_.wait_for(mutex_, kAsyncResultTimeoutNs);
+  }
+  ASSERT_TRUE(hasSamplingStatus_);
+  EXPECT_EQ(samplingStatus_.enabled, enabled);
+  hasSamplingStatus_ = false;
+}
+
+}  // anonymous namespace
+
+TEST_F(PalSensorTest, GetSensorsTest) {
+  ASSERT_GT(numSensors_, 0);
+  ASSERT_NE(sensors_, nullptr);
+  for (uint32_t i = 0; i < numSensors_; i++) {
+    LOGI("Sensor %" PRIu32 ": %s, type %" PRIu8 ", min interval %" PRIu64, i,
+         sensors_[i].sensorName, sensors_[i].sensorType,
+         sensors_[i].minInterval);
+    EXPECT_NE(sensors_[i].sensorName, nullptr);
+    EXPECT_FALSE(sensors_[i].isOnChange && sensors_[i].isOneShot);
+  }
+}
+
+TEST_F(PalSensorTest, ContinuousSensorBatchingTest) {
+  for (uint32_t i = 0; i < numSensors_ && sensorInfoIndex_ == UINT32_MAX;
+       i++) {
+    if (isThreeAxisSensorType(sensors_[i].sensorType)) {
+      sensorInfoIndex_ = i;
+    }
+  }
+  if (sensorInfoIndex_ == UINT32_MAX) {
+    GTEST_SKIP();
+  }
+
+  const struct chreSensorInfo &sensor = sensors_[sensorInfoIndex_];
+  uint64_t intervalNs = std::max<uint64_t>(
+      sensor.minInterval, Milliseconds(1).toRawNanoseconds());
+  uint64_t latencyNs = kSamplesPerBatch * intervalNs;
+
+  // The PAL may invoke callbacks before returning, so it is called without
+  // holding the lock.
+  ASSERT_TRUE(api_->configureSensor(sensorInfoIndex_,
+                                    CHRE_SENSOR_CONFIGURE_MODE_CONTINUOUS,
+                                    intervalNs, latencyNs));
+  {
+    chre::LockGuard<chre::Mutex> lock(mutex_);
+    waitForSamplingStatus(true /* enabled */);
+    EXPECT_EQ(samplingStatus_.interval, intervalNs);
+    EXPECT_LE(samplingStatus_.latency, latencyNs);
+
+    bool waitSuccess = true;
+    while (timestamps_.size() < kNumSamples && waitSuccess) {
+      waitSuccess = condVar_.wait_for(mutex_, kSampleTimeoutNs);
+    }
+    ASSERT_GE(timestamps_.size(), kNumSamples);
+
+    // Samples are delivered in batches, in order, at the requested interval.
+    EXPECT_GT(maxReadingCount_, 1);
+    for (size_t i = 1; i < timestamps_.size(); i++) {
+      EXPECT_GT(timestamps_[i], timestamps_[i - 1]);
+    }
+    uint64_t averageIntervalNs = (timestamps_.back() - timestamps_.front()) /
+                                 (timestamps_.size() - 1);
+    LOGI("Received %zu samples, up to %" PRIu16 " per event, every %" PRIu64
+         " ns",
+         timestamps_.size(), maxReadingCount_, averageIntervalNs);
+    EXPECT_GE(averageIntervalNs, intervalNs * 9 / 10);
+    EXPECT_LE(averageIntervalNs, intervalNs * 11 / 10);
+  }
+
+  uint32_t flushRequestId;
+  ASSERT_TRUE(api_->flush(sensorInfoIndex_, &flushRequestId));
+  {
+    chre::LockGuard<chre::Mutex> lock(mutex_);
+    bool waitSuccess = true;
+    while (!hasFlushCompleted_ && waitSuccess) {
+      waitSuccess = condVar_.wait_for(mutex_, kAsyncResultTimeoutNs);
+    }
+    ASSERT_TRUE(hasFlushCompleted_);
+    EXPECT_EQ(flushErrorCode_, CHRE_ERROR_NONE);
+    if (flushRequestId != CHRE_PAL_SENSOR_FLUSH_UNSUPPORTED_REQUEST_ID) {
+      EXPECT_EQ(completedFlushRequestId_, flushRequestId);
+    }
+  }
+
+  ASSERT_TRUE(api_->configureSensor(
+      sensorInfoIndex_, CHRE_SENSOR_CONFIGURE_MODE_DONE,
+      CHRE_SENSOR_INTERVAL_DEFAULT, CHRE_SENSOR_LATENCY_DEFAULT));
+  chre::LockGuard<chre::Mutex> lock(mutex_);
+  waitForSamplingStatus(false /* enabled */);
+}
+
+}  // namespace sensor_pal_impl_test
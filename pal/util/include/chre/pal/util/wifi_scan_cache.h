@@ -31,7 +31,8 @@
  *
  * The memory footprint of this library can be controlled at compile-time using
  * macros. For instance, CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY can be adjusted to
- * reduce the size of the cache storage.
+ * reduce the size of the cache storage, and CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS
+ * to the number of scans that can be cached at once.
  *
  * @see chreWifiScanCacheScanEventBegin() for how to cache scan results.
  */
@@ -52,12 +53,44 @@ extern "C" {
 #define CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY 255
 #endif
 
+//! The number of slots in the hash index used to find duplicate results in the
+//! scan cache. Must be a power of two larger than
+//! CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY, and should be about twice as large to
+//! keep lookups short.
+#ifndef CHRE_PAL_WIFI_SCAN_CACHE_HASH_SIZE
+#define CHRE_PAL_WIFI_SCAN_CACHE_HASH_SIZE 512
+#endif
+
+//! The number of WiFi scans that can be held by the scan cache library at once.
+//! With more than one, a new scan can be cached while CHRE holds the events of
+//! earlier scans, as long as one buffer has been fully released. Each buffer
+//! takes CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY results, so platforms that need
+//! overlapping scans opt in to the extra memory. With one, a new scan fails
+//! with CHRE_ERROR_BUSY until the previous one is released.
+#ifndef CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS
+#define CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS 1
+#endif
+
 //! The maximum value of chreWifiScanEvent.resultCount that will be used
 //! in the scan cache library to send results to CHRE.
 #ifndef CHRE_PAL_WIFI_SCAN_CACHE_MAX_RESULT_COUNT
 #define CHRE_PAL_WIFI_SCAN_CACHE_MAX_RESULT_COUNT 20
 #endif
 
+//! Counters describing the behavior of the scan cache library since
+//! chreWifiScanCacheInit().
+struct chreWifiScanCacheStats {
+  //! The number of scans that could not be cached because another scan was
+  //! being cached, or the events of all buffered scans were pending release.
+  uint32_t numScansBusy;
+
+  //! The number of results dropped or evicted because the cache was full.
+  uint32_t numResultsDropped;
+
+  //! The number of scan events currently pending release.
+  uint32_t numEventsPendingRelease;
+};
+
 /**
  * Initializes the WiFi scan cache.
  *
@@ -95,7 +128,10 @@ void chreWifiScanCacheDeinit(void);
  * chreWifiScanCacheScanEventEnd().
  *
  * This function must not be invoked while a scan caching is currently taking
- * place (i.e. until chreWifiScanCacheScanEventEnd() is invoked).
+ * place (i.e. until chreWifiScanCacheScanEventEnd() is invoked). It may be
+ * invoked before the events of the previous scan are released, but fails with
+ * CHRE_ERROR_BUSY if the events of CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS scans
+ * are all still pending release.
  *
  * @param activeScanResult true if this WiFi scan was a result of an active WiFi
  * scan from CHRE (i.e. not a result of passive scan monitoring only). If true,
@@ -118,8 +154,10 @@ bool chreWifiScanCacheScanEventBegin(enum chreWifiScanType scanType,
  * This method must only be invoked after chreWifiScanCacheScanEventBegin()
  * and before chreWifiScanCacheScanEventEnd(), otherwise has no effect.
  * When this method is invoked, the provided result is stored in the current
- * WiFi scan cache. The cache library may drop scan results if it is out of
- * memory (decided by the CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY value).
+ * WiFi scan cache. If a result for the same BSSID, SSID and channel is
+ * already cached, it is replaced. If the cache is full (decided by the
+ * CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY value), the result replaces the cached
+ * result with the lowest RSSI if it is stronger, and is dropped otherwise.
  *
  * The function does not obtain ownership of the provided pointer.
  *
@@ -155,10 +193,11 @@ void chreWifiScanCacheScanEventEnd(enum chreError errorCode);
  * Checks if a new scan request from CHRE must be dispatched from the cache,
  * and dispatches them through the chrePalWifiCallbacks if appropriate.
  *
- * This method will look at the currently completed WiFi scans and checks if the
+ * This method will look at the latest completed WiFi scan and checks if the
  * cache is within the maxScanAgeMs field of the scan parameter. If this method
  * returns false, the current cache does not meet the maxScanAgeMs requirement,
- * and the WLAN must perform a fresh scan.
+ * or its events have not been released yet, and the WLAN must perform a fresh
+ * scan.
  *
  * This method must be invoked when by the chrePalWifiApi->requestScan()
  * implementation to see if a cached WiFi scan event can be used. An example
@@ -201,6 +240,14 @@ void chreWifiScanCacheReleaseScanEvent(struct chreWifiScanEvent *event);
  */
 void chreWifiScanCacheConfigureScanMonitor(bool enable);
 
+/**
+ * Gets the counters of the scan cache library, e.g. to be included in a debug
+ * dump by the PAL implementation.
+ *
+ * @param stats A non-null pointer to the stats to populate.
+ */
+void chreWifiScanCacheGetStats(struct chreWifiScanCacheStats *stats);
+
 #ifdef __cplusplus
 }
 #endif
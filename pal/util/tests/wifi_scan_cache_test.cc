@@ -17,6 +17,7 @@
 #include "chre/pal/util/wifi_scan_cache.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cinttypes>
 #include <cstring>
 
@@ -56,6 +57,11 @@ chre::FixedSizeVector<chreWifiScanResult, CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY>
 chre::Optional<chreWifiScanEvent> gExpectedWifiScanEvent;
 bool gWifiScanEventCompleted;
 
+//! If true, scan events are kept in gPendingWifiScanEvents instead of being
+//! released by the event callback.
+bool gDelayWifiScanEventRelease;
+chre::FixedSizeVector<chreWifiScanEvent *, 32> gPendingWifiScanEvents;
+
 /************************************************
  *  Test class
  ***********************************************/
@@ -63,6 +69,7 @@ class WifiScanCacheTests : public ::testing::Test {
  protected:
   void SetUp() override {
     clearTestState();
+    gDelayWifiScanEventRelease = false;
     EXPECT_TRUE(chreWifiScanCacheInit(&chre::gChrePalSystemApi,
                                       &gChreWifiPalCallbacks));
   }
@@ -77,6 +84,9 @@ class WifiScanCacheTests : public ::testing::Test {
     while (!gWifiScanResultList.empty()) {
       gWifiScanResultList.pop_back();
     }
+    while (!gPendingWifiScanEvents.empty()) {
+      gPendingWifiScanEvents.pop_back();
+    }
   }
 };
 
@@ -119,7 +129,20 @@ void chreWifiScanEventCallback(struct chreWifiScanEvent *event) {
     gWifiScanEventCompleted = true;
   }
 
-  chreWifiScanCacheReleaseScanEvent(event);
+  if (gDelayWifiScanEventRelease) {
+    gPendingWifiScanEvents.push_back(event);
+  } else {
+    chreWifiScanCacheReleaseScanEvent(event);
+  }
+}
+
+void releasePendingWifiScanEvents() {
+  for (chreWifiScanEvent *event : gPendingWifiScanEvents) {
+    chreWifiScanCacheReleaseScanEvent(event);
+  }
+  while (!gPendingWifiScanEvents.empty()) {
+    gPendingWifiScanEvents.pop_back();
+  }
 }
 
 void beginDefaultWifiCache(const uint32_t *scannedFreqList,
@@ -142,6 +165,13 @@ void beginDefaultWifiCache(const uint32_t *scannedFreqList,
       gExpectedWifiScanEvent->radioChainPref, activeScanResult);
 }
 
+//! The RSSI of the i-th result added by cacheDefaultWifiCacheTest(). It
+//! decreases with i, so results past the cache capacity are never stronger
+//! than a cached one and are dropped.
+int8_t getDefaultRssi(size_t i) {
+  return static_cast<int8_t>(-static_cast<int>(std::min<size_t>(i, 127)));
+}
+
 void cacheDefaultWifiCacheTest(size_t numEvents,
                                const uint32_t *scannedFreqList,
                                uint16_t scannedFreqListLen,
@@ -152,7 +182,7 @@ void cacheDefaultWifiCacheTest(size_t numEvents,
 
   chreWifiScanResult result = {};
   for (size_t i = 0; i < numEvents; i++) {
-    result.rssi = static_cast<int8_t>(i);
+    result.rssi = getDefaultRssi(i);
     memcpy(result.bssid, &i, sizeof(i));
     chreWifiScanCacheScanEventAdd(&result);
   }
@@ -178,7 +208,7 @@ void cacheDefaultWifiCacheTest(size_t numEvents,
   for (size_t i = 0; i < gWifiScanResultList.size(); i++) {
     // ageMs is not known apriori
     result.ageMs = gWifiScanResultList[i].ageMs;
-    result.rssi = static_cast<int8_t>(i);
+    result.rssi = getDefaultRssi(i);
     memcpy(result.bssid, &i, sizeof(i));
     EXPECT_EQ(
         memcmp(&gWifiScanResultList[i], &result, sizeof(chreWifiScanResult)),
@@ -186,6 +216,30 @@ void cacheDefaultWifiCacheTest(size_t numEvents,
   }
 }
 
+//! Returns a result with a unique BSSID and SSID for each value of i.
+chreWifiScanResult makeUniqueResult(size_t i, int8_t rssi) {
+  chreWifiScanResult result = {};
+  result.rssi = rssi;
+  result.primaryChannel = 2412 + static_cast<uint32_t>(i % 13) * 5;
+  memcpy(result.bssid, &i, std::min(sizeof(i), sizeof(result.bssid)));
+  result.ssidLen = static_cast<uint8_t>(
+      snprintf(reinterpret_cast<char *>(result.ssid), sizeof(result.ssid),
+               "ssid-%zu", i % 32));
+  return result;
+}
+
+//! Caches a scan of numResults unique results which all have the given RSSI.
+void cacheUniqueWifiResults(size_t numResults, int8_t rssi) {
+  gWifiScanEventCompleted = false;
+  beginDefaultWifiCache(nullptr /* scannedFreqList */,
+                        0 /* scannedFreqListLen */);
+  for (size_t i = 0; i < numResults; i++) {
+    chreWifiScanResult result = makeUniqueResult(i, rssi);
+    chreWifiScanCacheScanEventAdd(&result);
+  }
+  chreWifiScanCacheScanEventEnd(CHRE_ERROR_NONE);
+}
+
 void testCacheDispatch(size_t numEvents, uint32_t maxScanAgeMs,
                        bool expectSuccess) {
   cacheDefaultWifiCacheTest(numEvents, nullptr /* scannedFreqList */,
@@ -363,3 +417,278 @@ TEST_F(WifiScanCacheTests, DuplicateScanResultTest) {
   EXPECT_EQ(
       memcmp(&gWifiScanResultList[1], &result2, sizeof(chreWifiScanResult)), 0);
 }
+
+TEST_F(WifiScanCacheTests, DuplicateScanResultAtCapacityTest) {
+  beginDefaultWifiCache(nullptr /* scannedFreqList */,
+                        0 /* scannedFreqListLen */,
+                        true /* activeScanResult */);
+
+  // Every result is seen twice, the second time with a stronger RSSI.
+  for (size_t i = 0; i < CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY; i++) {
+    chreWifiScanResult result = makeUniqueResult(i, -80);
+    chreWifiScanCacheScanEventAdd(&result);
+  }
+  for (size_t i = 0; i < CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY; i++) {
+    chreWifiScanResult result = makeUniqueResult(i, -40);
+    chreWifiScanCacheScanEventAdd(&result);
+  }
+
+  chreWifiScanCacheScanEventEnd(CHRE_ERROR_NONE);
+
+  ASSERT_EQ(gWifiScanResultList.size(), CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY);
+  for (size_t i = 0; i < gWifiScanResultList.size(); i++) {
+    chreWifiScanResult result = makeUniqueResult(i, -40);
+    result.ageMs = gWifiScanResultList[i].ageMs;
+    EXPECT_EQ(
+        memcmp(&gWifiScanResultList[i], &result, sizeof(chreWifiScanResult)),
+        0);
+  }
+}
+
+TEST_F(WifiScanCacheTests, WifiResultOverflowEvictWeakestTest) {
+  constexpr size_t kWeakIndex = 10;
+  beginDefaultWifiCache(nullptr /* scannedFreqList */,
+                        0 /* scannedFreqListLen */,
+                        true /* activeScanResult */);
+
+  for (size_t i = 0; i < CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY; i++) {
+    chreWifiScanResult result =
+        makeUniqueResult(i, (i == kWeakIndex) ? -90 : -50);
+    chreWifiScanCacheScanEventAdd(&result);
+  }
+
+  // A weaker result is dropped, and a stronger one replaces the weakest.
+  chreWifiScanResult weakResult =
+      makeUniqueResult(CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY, -95);
+  chreWifiScanCacheScanEventAdd(&weakResult);
+  chreWifiScanResult strongResult =
+      makeUniqueResult(CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY + 1, -40);
+  chreWifiScanCacheScanEventAdd(&strongResult);
+
+  // The evicted result can be added back once it is stronger than the others,
+  // which checks that the index no longer refers to it.
+  chreWifiScanResult evictedResult = makeUniqueResult(kWeakIndex, -30);
+  chreWifiScanCacheScanEventAdd(&evictedResult);
+
+  chreWifiScanCacheScanEventEnd(CHRE_ERROR_NONE);
+
+  ASSERT_EQ(gWifiScanResultList.size(), CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY);
+  size_t numStrongFound = 0;
+  size_t numEvictedFound = 0;
+  for (const chreWifiScanResult &result : gWifiScanResultList) {
+    EXPECT_NE(memcmp(result.bssid, weakResult.bssid, CHRE_WIFI_BSSID_LEN), 0);
+    if (memcmp(result.bssid, strongResult.bssid, CHRE_WIFI_BSSID_LEN) == 0) {
+      numStrongFound++;
+    } else if (memcmp(result.bssid, evictedResult.bssid,
+                      CHRE_WIFI_BSSID_LEN) == 0) {
+      EXPECT_EQ(result.rssi, -30);
+      numEvictedFound++;
+    }
+  }
+  EXPECT_EQ(gWifiScanResultList[kWeakIndex].rssi, -40);
+  EXPECT_EQ(numStrongFound, 1);
+  EXPECT_EQ(numEvictedFound, 1);
+}
+
+#if CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS > 1
+namespace {
+
+//! Checks that the given pending events hold numResults results with the given
+//! RSSI, i.e. that they have not been overwritten by a later scan.
+void expectPendingWifiScanEvents(chreWifiScanEvent *const *events,
+                                 size_t numEvents, size_t numResults,
+                                 int8_t rssi) {
+  size_t numResultsFound = 0;
+  for (size_t i = 0; i < numEvents; i++) {
+    EXPECT_EQ(events[i]->eventIndex, i);
+    for (uint8_t j = 0; j < events[i]->resultCount; j++) {
+      chreWifiScanResult result = makeUniqueResult(numResultsFound++, rssi);
+      result.ageMs = events[i]->results[j].ageMs;
+      EXPECT_EQ(
+          memcmp(&events[i]->results[j], &result, sizeof(chreWifiScanResult)),
+          0);
+    }
+  }
+  EXPECT_EQ(numResultsFound, numResults);
+}
+
+}  // anonymous namespace
+
+TEST_F(WifiScanCacheTests, OverlappingScansDelayedReleaseTest) {
+  constexpr size_t kNumResults = CHRE_PAL_WIFI_SCAN_CACHE_MAX_RESULT_COUNT + 1;
+  gDelayWifiScanEventRelease = true;
+
+  cacheUniqueWifiResults(kNumResults, -50);
+  ASSERT_TRUE(gWifiScanEventCompleted);
+  chreWifiScanEvent *firstScanEvents[2];
+  ASSERT_EQ(gPendingWifiScanEvents.size(), ARRAY_SIZE(firstScanEvents));
+  std::copy(gPendingWifiScanEvents.begin(), gPendingWifiScanEvents.end(),
+            firstScanEvents);
+
+  // The next scan is cached while the first one is still held by CHRE.
+  clearTestState();
+  cacheUniqueWifiResults(kNumResults, -60);
+  ASSERT_TRUE(gWifiScanEventCompleted);
+  ASSERT_TRUE(gWifiScanResponse.has_value());
+  EXPECT_EQ(gWifiScanResponse->errorCode, CHRE_ERROR_NONE);
+  chreWifiScanEvent *secondScanEvents[2];
+  ASSERT_EQ(gPendingWifiScanEvents.size(), ARRAY_SIZE(secondScanEvents));
+  std::copy(gPendingWifiScanEvents.begin(), gPendingWifiScanEvents.end(),
+            secondScanEvents);
+
+  expectPendingWifiScanEvents(firstScanEvents, ARRAY_SIZE(firstScanEvents),
+                              kNumResults, -50);
+  expectPendingWifiScanEvents(secondScanEvents, ARRAY_SIZE(secondScanEvents),
+                              kNumResults, -60);
+
+  chreWifiScanCacheStats stats;
+  chreWifiScanCacheGetStats(&stats);
+  EXPECT_EQ(stats.numScansBusy, 0);
+  EXPECT_EQ(stats.numEventsPendingRelease, 4);
+
+  // Releasing the first scan frees its buffer for the next one, which must not
+  // overwrite the second scan.
+  for (chreWifiScanEvent *event : firstScanEvents) {
+    chreWifiScanCacheReleaseScanEvent(event);
+  }
+  clearTestState();
+  cacheUniqueWifiResults(kNumResults, -70);
+  ASSERT_TRUE(gWifiScanEventCompleted);
+  expectPendingWifiScanEvents(secondScanEvents, ARRAY_SIZE(secondScanEvents),
+                              kNumResults, -60);
+  expectPendingWifiScanEvents(gPendingWifiScanEvents.data(),
+                              gPendingWifiScanEvents.size(), kNumResults, -70);
+
+  for (chreWifiScanEvent *event : secondScanEvents) {
+    chreWifiScanCacheReleaseScanEvent(event);
+  }
+  releasePendingWifiScanEvents();
+  chreWifiScanCacheGetStats(&stats);
+  EXPECT_EQ(stats.numEventsPendingRelease, 0);
+}
+
+#endif  // CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS > 1
+
+TEST_F(WifiScanCacheTests, AllBuffersPendingReleaseTest) {
+  gDelayWifiScanEventRelease = true;
+  for (size_t i = 0; i < CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS; i++) {
+    while (!gWifiScanResultList.empty()) {
+      gWifiScanResultList.pop_back();
+    }
+    cacheUniqueWifiResults(1 /* numResults */, -50);
+    ASSERT_TRUE(gWifiScanEventCompleted);
+  }
+
+  gWifiScanResponse.reset();
+  beginDefaultWifiCache(nullptr /* scannedFreqList */,
+                        0 /* scannedFreqListLen */);
+  ASSERT_TRUE(gWifiScanResponse.has_value());
+  EXPECT_FALSE(gWifiScanResponse->pending);
+  EXPECT_EQ(gWifiScanResponse->errorCode, CHRE_ERROR_BUSY);
+
+  chreWifiScanCacheStats stats;
+  chreWifiScanCacheGetStats(&stats);
+  EXPECT_EQ(stats.numScansBusy, 1);
+  EXPECT_EQ(stats.numEventsPendingRelease,
+            CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS);
+
+  // Releasing an unknown event has no effect.
+  chreWifiScanEvent event = {};
+  chreWifiScanCacheReleaseScanEvent(&event);
+  chreWifiScanCacheGetStats(&stats);
+  EXPECT_EQ(stats.numEventsPendingRelease,
+            CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS);
+
+  releasePendingWifiScanEvents();
+  clearTestState();
+  cacheUniqueWifiResults(1 /* numResults */, -50);
+  ASSERT_TRUE(gWifiScanEventCompleted);
+  EXPECT_EQ(gWifiScanResponse->errorCode, CHRE_ERROR_NONE);
+  releasePendingWifiScanEvents();
+}
+
+#if CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS > 1
+TEST_F(WifiScanCacheTests, CacheDispatchDelayedReleaseTest) {
+  struct chreWifiScanParams params = {
+      .scanType = CHRE_WIFI_SCAN_TYPE_NO_PREFERENCE,
+      .maxScanAgeMs = 5000,
+      .frequencyListLen = 0,
+      .frequencyList = nullptr,
+      .ssidListLen = 0,
+      .ssidList = nullptr,
+      .radioChainPref = CHRE_WIFI_RADIO_CHAIN_PREF_DEFAULT,
+      .channelSet = CHRE_WIFI_CHANNEL_SET_NON_DFS,
+  };
+
+  gDelayWifiScanEventRelease = true;
+  cacheUniqueWifiResults(1 /* numResults */, -50);
+  ASSERT_TRUE(gWifiScanEventCompleted);
+
+  // The latest scan cannot be dispatched again until it is released.
+  EXPECT_FALSE(chreWifiScanCacheDispatchFromCache(&params));
+  releasePendingWifiScanEvents();
+  gWifiScanResultList.pop_back();
+
+  // It can be dispatched while the next scan is being cached.
+  gDelayWifiScanEventRelease = false;
+  beginDefaultWifiCache(nullptr /* scannedFreqList */,
+                        0 /* scannedFreqListLen */);
+  chreWifiScanResult result = makeUniqueResult(1, -60);
+  chreWifiScanCacheScanEventAdd(&result);
+
+  EXPECT_TRUE(chreWifiScanCacheDispatchFromCache(&params));
+  ASSERT_EQ(gWifiScanResultList.size(), 1);
+  EXPECT_EQ(gWifiScanResultList[0].rssi, -50);
+
+  gExpectedWifiScanEvent->eventIndex = 0;
+  gWifiScanResultList.pop_back();
+  chreWifiScanCacheScanEventEnd(CHRE_ERROR_NONE);
+  ASSERT_EQ(gWifiScanResultList.size(), 1);
+  EXPECT_EQ(gWifiScanResultList[0].rssi, -60);
+}
+
+#endif  // CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS > 1
+
+//! Measures the cost of caching a scan that fills the cache, with every
+//! access point reported several times as happens across scanned channels.
+TEST_F(WifiScanCacheTests, FullCapacityBenchmark) {
+  constexpr size_t kNumScans = 100;
+  constexpr size_t kReportsPerResult = 4;
+
+  static chreWifiScanResult results[kReportsPerResult]
+                                   [CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY];
+  for (size_t report = 0; report < kReportsPerResult; report++) {
+    for (size_t i = 0; i < CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY; i++) {
+      results[report][i] =
+          makeUniqueResult(i, static_cast<int8_t>(-60 - report));
+    }
+  }
+
+  uint64_t totalNs = 0;
+  for (size_t scan = 0; scan < kNumScans; scan++) {
+    clearTestState();
+    beginDefaultWifiCache(nullptr /* scannedFreqList */,
+                          0 /* scannedFreqListLen */,
+                          true /* activeScanResult */);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t report = 0; report < kReportsPerResult; report++) {
+      for (size_t i = 0; i < CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY; i++) {
+        chreWifiScanCacheScanEventAdd(&results[report][i]);
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    totalNs += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count());
+
+    chreWifiScanCacheScanEventEnd(CHRE_ERROR_NONE);
+    ASSERT_EQ(gWifiScanResultList.size(), CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY);
+  }
+
+  uint64_t numAdds =
+      kNumScans * kReportsPerResult * CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY;
+  LOGI("Cached %zu results per scan: %" PRIu64 " ns per result added",
+       static_cast<size_t>(CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY),
+       totalNs / numAdds);
+}
@@ -20,10 +20,51 @@
 
 #include "chre/util/macros.h"
 
+#if CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY < 1 || \
+    CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY > UINT8_MAX
+#error "CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY must be in [1, UINT8_MAX]"
+#endif
+
+#if CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS < 1 || \
+    CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS > UINT8_MAX
+#error "CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS must be in [1, UINT8_MAX]"
+#endif
+
+#if (CHRE_PAL_WIFI_SCAN_CACHE_HASH_SIZE &                          \
+     (CHRE_PAL_WIFI_SCAN_CACHE_HASH_SIZE - 1)) != 0 ||             \
+    CHRE_PAL_WIFI_SCAN_CACHE_HASH_SIZE <= CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY
+#error "CHRE_PAL_WIFI_SCAN_CACHE_HASH_SIZE must be a power of two > capacity"
+#endif
+
+//! The number of chreWifiScanEvents needed to deliver a full cache.
+#define CHRE_PAL_WIFI_SCAN_CACHE_MAX_EVENTS_PER_SCAN       \
+  ((CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY +                    \
+    CHRE_PAL_WIFI_SCAN_CACHE_MAX_RESULT_COUNT - 1) /       \
+   CHRE_PAL_WIFI_SCAN_CACHE_MAX_RESULT_COUNT)
+
 /************************************************
  *  Prototypes
  ***********************************************/
 
+//! The storage for the results of a single WiFi scan.
+struct chreWifiScanCacheBuffer {
+  //! The scan event the results are cached into, from which each of
+  //! dispatchedEvents is made when the scan is delivered.
+  struct chreWifiScanEvent event;
+  struct chreWifiScanResult resultList[CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY];
+  uint32_t scannedFreqList[CHRE_WIFI_FREQUENCY_LIST_MAX_LEN];
+
+  //! The events given to CHRE, one per chunk of results, which stay valid
+  //! until released.
+  struct chreWifiScanEvent
+      dispatchedEvents[CHRE_PAL_WIFI_SCAN_CACHE_MAX_EVENTS_PER_SCAN];
+
+  //! The number of dispatchedEvents pending release via
+  //! chreWifiScanCacheReleaseScanEvent(). The buffer can only be reused once
+  //! this is 0.
+  uint8_t numWifiEventsPendingRelease;
+};
+
 struct chreWifiScanCacheState {
   //! true if the scan cache has started, i.e. chreWifiScanCacheScanEventBegin
   //! was invoked and has not yet ended.
@@ -32,20 +73,38 @@ struct chreWifiScanCacheState {
   //! true if the current scan cache is a result of a CHRE active scan request.
   bool activeScanResult;
 
-  //! The number of chreWifiScanResults dropped due to OOM.
+  //! The number of chreWifiScanResults dropped due to OOM in the current scan.
   uint16_t numWifiScanResultsDropped;
 
-  //! Stores the WiFi cache elements
-  struct chreWifiScanEvent event;
-  struct chreWifiScanResult resultList[CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY];
+  //! Stores the WiFi cache elements. A new scan is cached into a buffer that
+  //! is not pending release, so that it can proceed while CHRE still holds the
+  //! events of a previous scan.
+  struct chreWifiScanCacheBuffer buffers[CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS];
 
-  //! The number of chreWifiScanEvent data pending release via
-  //! chreWifiScanCacheReleaseScanEvent().
-  uint8_t numWifiEventsPendingRelease;
+  //! The index of the buffer being filled, only valid if started is true.
+  uint8_t fillBufferIndex;
+
+  //! The index of the buffer holding the last dispatched scan, which can be
+  //! dispatched again from the cache. Only valid if hasLatestScan is true.
+  uint8_t latestBufferIndex;
+  bool hasLatestScan;
+
+  //! An open-addressing hash index of the resultList of the buffer being
+  //! filled, keyed on BSSID + SSID + channel. Each slot holds the resultList
+  //! index plus one, or 0 if empty.
+  uint8_t resultHashIndex[CHRE_PAL_WIFI_SCAN_CACHE_HASH_SIZE];
+
+  //! The index of the result with the lowest RSSI while the cache is full,
+  //! only valid if weakestResultValid is true.
+  uint8_t weakestResultIndex;
+  bool weakestResultValid;
 
   bool scanMonitoringEnabled;
 
-  uint32_t scannedFreqList[CHRE_WIFI_FREQUENCY_LIST_MAX_LEN];
+  //! The counters returned by chreWifiScanCacheGetStats(), since
+  //! chreWifiScanCacheInit().
+  uint32_t numScansBusy;
+  uint32_t numResultsDropped;
 };
 
 /************************************************
@@ -69,8 +128,8 @@ static bool chreWifiScanCacheIsInitialized(void) {
   return (gSystemApi != NULL && gCallbacks != NULL);
 }
 
-static bool areAllScanEventsReleased(void) {
-  return gWifiCacheState.numWifiEventsPendingRelease == 0;
+static struct chreWifiScanCacheBuffer *getFillBuffer(void) {
+  return &gWifiCacheState.buffers[gWifiCacheState.fillBufferIndex];
 }
 
 static bool isFrequencyListValid(const uint32_t *frequencyList,
@@ -78,8 +137,9 @@ static bool isFrequencyListValid(const uint32_t *frequencyList,
   return (frequencyListLen == 0) || (frequencyList != NULL);
 }
 
-static bool paramsMatchScanCache(const struct chreWifiScanParams *params) {
-  uint64_t timeNs = gWifiCacheState.event.referenceTime;
+static bool paramsMatchScanCache(const struct chreWifiScanParams *params,
+                                 const struct chreWifiScanEvent *event) {
+  uint64_t timeNs = event->referenceTime;
   bool scan_within_age =
       (timeNs >= gSystemApi->getCurrentTime() -
                      (params->maxScanAgeMs * kOneMillisecondInNanoseconds));
@@ -91,80 +151,243 @@ static bool paramsMatchScanCache(const struct chreWifiScanParams *params) {
       (params->scanType == CHRE_WIFI_SCAN_TYPE_ACTIVE) ||
       ((params->scanType == CHRE_WIFI_SCAN_TYPE_NO_PREFERENCE) &&
        (params->channelSet == CHRE_WIFI_CHANNEL_SET_NON_DFS));
-  bool cache_non_dfs =
-      (gWifiCacheState.event.scanType == CHRE_WIFI_SCAN_TYPE_ACTIVE) ||
-      (gWifiCacheState.event.scanType == CHRE_WIFI_SCAN_TYPE_PASSIVE);
+  bool cache_non_dfs = (event->scanType == CHRE_WIFI_SCAN_TYPE_ACTIVE) ||
+                       (event->scanType == CHRE_WIFI_SCAN_TYPE_PASSIVE);
 
-  bool cache_all_freq = (gWifiCacheState.event.scannedFreqListLen == 0);
-  bool cache_all_ssid = (gWifiCacheState.event.ssidSetSize == 0);
+  bool cache_all_freq = (event->scannedFreqListLen == 0);
+  bool cache_all_ssid = (event->ssidSetSize == 0);
 
   return scan_within_age && (params_non_dfs || !cache_non_dfs) &&
          cache_all_freq && cache_all_ssid;
 }
 
-static bool isWifiScanCacheBusy(bool logOnBusy) {
+/**
+ * Finds a buffer that is not pending release to cache a new scan into,
+ * preferring one that does not hold the latest scan so that it can still be
+ * dispatched from the cache.
+ *
+ * @return true if a buffer was found.
+ */
+static bool findFreeBuffer(uint8_t *index) {
+  bool found = false;
+  for (uint8_t i = 0; i < CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS; i++) {
+    if (gWifiCacheState.buffers[i].numWifiEventsPendingRelease == 0) {
+      *index = i;
+      found = true;
+      if (!gWifiCacheState.hasLatestScan ||
+          i != gWifiCacheState.latestBufferIndex) {
+        break;
+      }
+    }
+  }
+
+  return found;
+}
+
+static bool isWifiScanCacheBusy(uint8_t *freeBufferIndex) {
   bool busy = true;
   if (gWifiCacheState.started) {
-    if (logOnBusy) {
-      gSystemApi->log(CHRE_LOG_ERROR, "Scan cache already started");
-    }
-  } else if (!areAllScanEventsReleased()) {
-    if (logOnBusy) {
-      gSystemApi->log(CHRE_LOG_ERROR, "Scan cache events pending release");
-    }
+    gSystemApi->log(CHRE_LOG_ERROR, "Scan cache already started");
+  } else if (!findFreeBuffer(freeBufferIndex)) {
+    gSystemApi->log(CHRE_LOG_ERROR, "Scan cache events pending release");
   } else {
     busy = false;
   }
 
+  if (busy) {
+    gWifiCacheState.numScansBusy++;
+  }
+
   return busy;
 }
 
-static void chreWifiScanCacheDispatchAll(void) {
+static struct chreWifiScanCacheBuffer *getBufferOfEvent(
+    const struct chreWifiScanEvent *event) {
+  for (size_t i = 0; i < CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS; i++) {
+    struct chreWifiScanCacheBuffer *buffer = &gWifiCacheState.buffers[i];
+    for (size_t j = 0; j < ARRAY_SIZE(buffer->dispatchedEvents); j++) {
+      if (event == &buffer->dispatchedEvents[j]) {
+        return buffer;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static void chreWifiScanCacheDispatchAll(
+    struct chreWifiScanCacheBuffer *buffer) {
   gSystemApi->log(CHRE_LOG_DEBUG, "Dispatching %" PRIu8 " events",
-                  gWifiCacheState.event.resultTotal);
-  if (gWifiCacheState.event.resultTotal == 0) {
-    gWifiCacheState.event.eventIndex = 0;
-    gWifiCacheState.event.resultCount = 0;
-    gWifiCacheState.event.results = NULL;
-    gCallbacks->scanEventCallback(&gWifiCacheState.event);
+                  buffer->event.resultTotal);
+  if (buffer->event.resultTotal == 0) {
+    struct chreWifiScanEvent *event = &buffer->dispatchedEvents[0];
+    *event = buffer->event;
+    event->eventIndex = 0;
+    event->resultCount = 0;
+    event->results = NULL;
+
+    buffer->numWifiEventsPendingRelease++;
+    gCallbacks->scanEventCallback(event);
   } else {
     uint8_t eventIndex = 0;
-    for (uint16_t i = 0; i < gWifiCacheState.event.resultTotal;
+    for (uint16_t i = 0; i < buffer->event.resultTotal;
          i += CHRE_PAL_WIFI_SCAN_CACHE_MAX_RESULT_COUNT) {
-      gWifiCacheState.event.resultCount =
+      struct chreWifiScanEvent *event =
+          &buffer->dispatchedEvents[eventIndex];
+      *event = buffer->event;
+      event->resultCount =
           MIN(CHRE_PAL_WIFI_SCAN_CACHE_MAX_RESULT_COUNT,
-              (uint8_t)(gWifiCacheState.event.resultTotal - i));
-      gWifiCacheState.event.eventIndex = eventIndex++;
-      gWifiCacheState.event.results = &gWifiCacheState.resultList[i];
-
-      // TODO(b/174511061): The current approach only works for situations where
-      // the event is released immediately. Add a way to handle this scenario
-      // (e.g. an array of chreWifiScanEvent's).
-      gWifiCacheState.numWifiEventsPendingRelease++;
-      gCallbacks->scanEventCallback(&gWifiCacheState.event);
+              (uint8_t)(buffer->event.resultTotal - i));
+      event->eventIndex = eventIndex++;
+      event->results = &buffer->resultList[i];
+
+      buffer->numWifiEventsPendingRelease++;
+      gCallbacks->scanEventCallback(event);
     }
   }
 }
 
-static bool isWifiScanResultInCache(const struct chreWifiScanResult *result,
-                                    size_t *index) {
-  for (uint8_t i = 0; i < gWifiCacheState.event.resultTotal; i++) {
-    const struct chreWifiScanResult *cacheResult =
-        &gWifiCacheState.resultList[i];
-    // Filtering based on BSSID + SSID + frequency based on Linux cfg80211.
-    // https://github.com/torvalds/linux/blob/master/net/wireless/scan.c
-    if ((result->primaryChannel == cacheResult->primaryChannel) &&
-        (memcmp(result->bssid, cacheResult->bssid, CHRE_WIFI_BSSID_LEN) == 0) &&
-        (result->ssidLen == cacheResult->ssidLen) &&
-        (memcmp(result->ssid, cacheResult->ssid, result->ssidLen) == 0)) {
-      *index = i;
+static uint32_t hashWifiScanResult(const struct chreWifiScanResult *result) {
+  // FNV-1a over the same fields that are compared in isSameWifiScanResult().
+  uint32_t hash = UINT32_C(2166136261);
+  for (size_t i = 0; i < CHRE_WIFI_BSSID_LEN; i++) {
+    hash = (hash ^ result->bssid[i]) * UINT32_C(16777619);
+  }
+  for (size_t i = 0; i < result->ssidLen && i < CHRE_WIFI_SSID_MAX_LEN; i++) {
+    hash = (hash ^ result->ssid[i]) * UINT32_C(16777619);
+  }
+  for (size_t i = 0; i < sizeof(result->primaryChannel); i++) {
+    hash = (hash ^ ((result->primaryChannel >> (8 * i)) & 0xff)) *
+           UINT32_C(16777619);
+  }
+
+  return hash;
+}
+
+static size_t getHashSlot(const struct chreWifiScanResult *result) {
+  return hashWifiScanResult(result) & (CHRE_PAL_WIFI_SCAN_CACHE_HASH_SIZE - 1);
+}
+
+static size_t getNextHashSlot(size_t slot) {
+  return (slot + 1) & (CHRE_PAL_WIFI_SCAN_CACHE_HASH_SIZE - 1);
+}
+
+static bool isSameWifiScanResult(const struct chreWifiScanResult *result,
+                                 const struct chreWifiScanResult *cacheResult) {
+  // Filtering based on BSSID + SSID + frequency based on Linux cfg80211.
+  // https://github.com/torvalds/linux/blob/master/net/wireless/scan.c
+  return (result->primaryChannel == cacheResult->primaryChannel) &&
+         (memcmp(result->bssid, cacheResult->bssid, CHRE_WIFI_BSSID_LEN) ==
+          0) &&
+         (result->ssidLen == cacheResult->ssidLen) &&
+         (memcmp(result->ssid, cacheResult->ssid, result->ssidLen) == 0);
+}
+
+/**
+ * Looks up a result in the hash index.
+ *
+ * @param result The result to look up.
+ * @param slot Set to the slot of the cached result if found, or else to the
+ *        empty slot where it can be inserted.
+ *
+ * @return true if the result is in the cache.
+ */
+static bool findWifiScanResultSlot(const struct chreWifiScanResult *result,
+                                   size_t *slot) {
+  // The index always has empty slots since it is larger than the cache.
+  const struct chreWifiScanResult *resultList = getFillBuffer()->resultList;
+  size_t i = getHashSlot(result);
+  while (gWifiCacheState.resultHashIndex[i] != 0) {
+    uint8_t index = gWifiCacheState.resultHashIndex[i] - 1;
+    if (isSameWifiScanResult(result, &resultList[index])) {
+      *slot = i;
       return true;
     }
+    i = getNextHashSlot(i);
   }
 
+  *slot = i;
   return false;
 }
 
+static bool isWifiScanResultInCache(const struct chreWifiScanResult *result,
+                                    size_t *index) {
+  size_t slot;
+  bool found = findWifiScanResultSlot(result, &slot);
+  if (found) {
+    *index = gWifiCacheState.resultHashIndex[slot] - 1;
+  }
+
+  return found;
+}
+
+static void addWifiScanResultToHashIndex(size_t index) {
+  size_t slot;
+  findWifiScanResultSlot(&getFillBuffer()->resultList[index], &slot);
+  gWifiCacheState.resultHashIndex[slot] = (uint8_t)(index + 1);
+}
+
+static void removeWifiScanResultFromHashIndex(size_t index) {
+  const struct chreWifiScanResult *resultList = getFillBuffer()->resultList;
+  size_t slot;
+  if (findWifiScanResultSlot(&resultList[index], &slot)) {
+    // Backward-shift deletion: move up any later entry of the probe sequence
+    // that would no longer be reachable past the emptied slot.
+    size_t next = slot;
+    while (true) {
+      next = getNextHashSlot(next);
+      uint8_t entry = gWifiCacheState.resultHashIndex[next];
+      if (entry == 0) {
+        break;
+      }
+
+      size_t home = getHashSlot(&resultList[entry - 1]);
+      bool homeInRange = (slot <= next) ? (slot < home && home <= next)
+                                        : (slot < home || home <= next);
+      if (!homeInRange) {
+        gWifiCacheState.resultHashIndex[slot] = entry;
+        slot = next;
+      }
+    }
+    gWifiCacheState.resultHashIndex[slot] = 0;
+  }
+}
+
+static uint8_t getWeakestWifiScanResultIndex(void) {
+  if (!gWifiCacheState.weakestResultValid) {
+    const struct chreWifiScanCacheBuffer *buffer = getFillBuffer();
+    uint8_t weakestIndex = 0;
+    for (uint8_t i = 1; i < buffer->event.resultTotal; i++) {
+      if (buffer->resultList[i].rssi <
+          buffer->resultList[weakestIndex].rssi) {
+        weakestIndex = i;
+      }
+    }
+    gWifiCacheState.weakestResultIndex = weakestIndex;
+    gWifiCacheState.weakestResultValid = true;
+  }
+
+  return gWifiCacheState.weakestResultIndex;
+}
+
+/**
+ * Updates the tracked weakest result after the result at index was replaced
+ * with one of the given RSSI.
+ */
+static void updateWeakestWifiScanResult(size_t index, int8_t rssi) {
+  if (gWifiCacheState.weakestResultValid) {
+    const struct chreWifiScanResult *resultList = getFillBuffer()->resultList;
+    uint8_t weakestIndex = gWifiCacheState.weakestResultIndex;
+    if (index == weakestIndex) {
+      if (rssi > resultList[weakestIndex].rssi) {
+        gWifiCacheState.weakestResultValid = false;
+      }
+    } else if (rssi < resultList[weakestIndex].rssi) {
+      gWifiCacheState.weakestResultIndex = (uint8_t)index;
+    }
+  }
+}
+
 /************************************************
  *  Public functions
  ***********************************************/
@@ -196,27 +419,38 @@ bool chreWifiScanCacheScanEventBegin(enum chreWifiScanType scanType,
   bool success = false;
   if (chreWifiScanCacheIsInitialized()) {
     enum chreError error = CHRE_ERROR_NONE;
+    uint8_t bufferIndex;
     if (!isFrequencyListValid(scannedFreqList, scannedFreqListLength)) {
       gSystemApi->log(CHRE_LOG_ERROR, "Invalid frequency argument");
       error = CHRE_ERROR_INVALID_ARGUMENT;
-    } else if (isWifiScanCacheBusy(true /* logOnBusy */)) {
+    } else if (isWifiScanCacheBusy(&bufferIndex)) {
       error = CHRE_ERROR_BUSY;
     } else {
       success = true;
-      memset(&gWifiCacheState, 0, sizeof(gWifiCacheState));
-
-      gWifiCacheState.event.version = CHRE_WIFI_SCAN_EVENT_VERSION;
-      gWifiCacheState.event.scanType = scanType;
-      gWifiCacheState.event.ssidSetSize = ssidSetSize;
+      if (gWifiCacheState.hasLatestScan &&
+          gWifiCacheState.latestBufferIndex == bufferIndex) {
+        gWifiCacheState.hasLatestScan = false;
+      }
+      gWifiCacheState.fillBufferIndex = bufferIndex;
+      gWifiCacheState.numWifiScanResultsDropped = 0;
+      gWifiCacheState.weakestResultValid = false;
+      memset(gWifiCacheState.resultHashIndex, 0,
+             sizeof(gWifiCacheState.resultHashIndex));
+
+      struct chreWifiScanCacheBuffer *buffer = getFillBuffer();
+      memset(buffer, 0, sizeof(*buffer));
+      buffer->event.version = CHRE_WIFI_SCAN_EVENT_VERSION;
+      buffer->event.scanType = scanType;
+      buffer->event.ssidSetSize = ssidSetSize;
 
       scannedFreqListLength =
           MIN(scannedFreqListLength, CHRE_WIFI_FREQUENCY_LIST_MAX_LEN);
       if (scannedFreqList != NULL) {
-        memcpy(gWifiCacheState.scannedFreqList, scannedFreqList,
+        memcpy(buffer->scannedFreqList, scannedFreqList,
                scannedFreqListLength * sizeof(uint32_t));
       }
-      gWifiCacheState.event.scannedFreqListLen = scannedFreqListLength;
-      gWifiCacheState.event.radioChainPref = radioChainPref;
+      buffer->event.scannedFreqListLen = scannedFreqListLength;
+      buffer->event.radioChainPref = radioChainPref;
 
       gWifiCacheState.activeScanResult = activeScanResult;
       gWifiCacheState.started = true;
@@ -234,24 +468,37 @@ void chreWifiScanCacheScanEventAdd(const struct chreWifiScanResult *result) {
   if (!gWifiCacheState.started) {
     gSystemApi->log(CHRE_LOG_ERROR, "Cannot add to cache before starting it");
   } else {
+    struct chreWifiScanCacheBuffer *buffer = getFillBuffer();
     size_t index;
     bool exists = isWifiScanResultInCache(result, &index);
-    if (!exists && gWifiCacheState.event.resultTotal >=
-                       CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY) {
-      // TODO(b/174510884): Filter based on e.g. RSSI if full
-      gWifiCacheState.numWifiScanResultsDropped++;
-    } else {
-      if (!exists) {
-        // Only add a new entry if the result was not already cached.
-        index = gWifiCacheState.event.resultTotal;
-        gWifiCacheState.event.resultTotal++;
+    bool store = true;
+    if (!exists &&
+        buffer->event.resultTotal >= CHRE_PAL_WIFI_SCAN_CACHE_CAPACITY) {
+      // Keep the strongest access points when full.
+      index = getWeakestWifiScanResultIndex();
+      if (result->rssi > buffer->resultList[index].rssi) {
+        removeWifiScanResultFromHashIndex(index);
+      } else {
+        store = false;
       }
+      gWifiCacheState.numWifiScanResultsDropped++;
+      gWifiCacheState.numResultsDropped++;
+    } else if (!exists) {
+      // Only add a new entry if the result was not already cached.
+      index = buffer->event.resultTotal;
+      buffer->event.resultTotal++;
+    }
 
-      memcpy(&gWifiCacheState.resultList[index], result,
+    if (store) {
+      updateWeakestWifiScanResult(index, result->rssi);
+      memcpy(&buffer->resultList[index], result,
              sizeof(const struct chreWifiScanResult));
+      if (!exists) {
+        addWifiScanResultToHashIndex(index);
+      }
 
       // ageMs will be properly populated in chreWifiScanCacheScanEventEnd
-      gWifiCacheState.resultList[index].ageMs = (uint32_t)(
+      buffer->resultList[index].ageMs = (uint32_t)(
           gSystemApi->getCurrentTime() / kOneMillisecondInNanoseconds);
     }
   }
@@ -271,17 +518,20 @@ void chreWifiScanCacheScanEventEnd(enum chreError errorCode) {
 
     if (errorCode == CHRE_ERROR_NONE &&
         (gWifiCacheState.activeScanResult || gScanMonitoringEnabled)) {
-      gWifiCacheState.event.referenceTime = gSystemApi->getCurrentTime();
-      gWifiCacheState.event.scannedFreqList = gWifiCacheState.scannedFreqList;
-
-      uint32_t referenceTimeMs = (uint32_t)(
-          gWifiCacheState.event.referenceTime / kOneMillisecondInNanoseconds);
-      for (uint16_t i = 0; i < gWifiCacheState.event.resultTotal; i++) {
-        gWifiCacheState.resultList[i].ageMs =
-            referenceTimeMs - gWifiCacheState.resultList[i].ageMs;
+      struct chreWifiScanCacheBuffer *buffer = getFillBuffer();
+      buffer->event.referenceTime = gSystemApi->getCurrentTime();
+      buffer->event.scannedFreqList = buffer->scannedFreqList;
+
+      uint32_t referenceTimeMs = (uint32_t)(buffer->event.referenceTime /
+                                            kOneMillisecondInNanoseconds);
+      for (uint16_t i = 0; i < buffer->event.resultTotal; i++) {
+        buffer->resultList[i].ageMs =
+            referenceTimeMs - buffer->resultList[i].ageMs;
       }
 
-      chreWifiScanCacheDispatchAll();
+      gWifiCacheState.latestBufferIndex = gWifiCacheState.fillBufferIndex;
+      gWifiCacheState.hasLatestScan = true;
+      chreWifiScanCacheDispatchAll(buffer);
     }
 
     gWifiCacheState.started = false;
@@ -295,14 +545,15 @@ bool chreWifiScanCacheDispatchFromCache(
     return false;
   }
 
-  if (paramsMatchScanCache(params) &&
-      !isWifiScanCacheBusy(false /* logOnBusy */)) {
-    // TODO(b/174511061): Handle scenario where cache is working on delivering
-    // a scan event. Ideally the library will wait until it is complete to
-    // dispatch from the cache if it meets the criteria, rather than scheduling
-    // a fresh scan.
+  // The latest scan is never the one being filled, so it can be dispatched
+  // while another scan is being cached.
+  struct chreWifiScanCacheBuffer *buffer =
+      &gWifiCacheState.buffers[gWifiCacheState.latestBufferIndex];
+  if (gWifiCacheState.hasLatestScan &&
+      buffer->numWifiEventsPendingRelease == 0 &&
+      paramsMatchScanCache(params, &buffer->event)) {
     gCallbacks->scanResponseCallback(true /* pending */, CHRE_ERROR_NONE);
-    chreWifiScanCacheDispatchAll();
+    chreWifiScanCacheDispatchAll(buffer);
     return true;
   } else {
     return false;
@@ -314,10 +565,11 @@ void chreWifiScanCacheReleaseScanEvent(struct chreWifiScanEvent *event) {
     return;
   }
 
-  if (event != &gWifiCacheState.event) {
+  struct chreWifiScanCacheBuffer *buffer = getBufferOfEvent(event);
+  if (buffer == NULL) {
     gSystemApi->log(CHRE_LOG_ERROR, "Invalid event pointer %p", event);
-  } else if (gWifiCacheState.numWifiEventsPendingRelease > 0) {
-    gWifiCacheState.numWifiEventsPendingRelease--;
+  } else if (buffer->numWifiEventsPendingRelease > 0) {
+    buffer->numWifiEventsPendingRelease--;
   }
 }
 
@@ -328,3 +580,13 @@ void chreWifiScanCacheConfigureScanMonitor(bool enable) {
 
   gScanMonitoringEnabled = enable;
 }
+
+void chreWifiScanCacheGetStats(struct chreWifiScanCacheStats *stats) {
+  stats->numScansBusy = gWifiCacheState.numScansBusy;
+  stats->numResultsDropped = gWifiCacheState.numResultsDropped;
+  stats->numEventsPendingRelease = 0;
+  for (size_t i = 0; i < CHRE_PAL_WIFI_SCAN_CACHE_NUM_BUFFERS; i++) {
+    stats->numEventsPendingRelease +=
+        gWifiCacheState.buffers[i].numWifiEventsPendingRelease;
+  }
+}
@@ -166,6 +166,19 @@ class AtomicUint32 : public AtomicUint32Base, public NonCopyable {
    * @return The previous value of the object.
    */
   uint32_t fetch_decrement();
+
+  /**
+   * Atomically compares the value stored in the atomic object with expected,
+   * and if they are equal, replaces it with desired. Otherwise, loads the
+   * current value of the object into expected.
+   *
+   * @param expected The value the object is expected to hold. Updated with the
+   *        current value of the object on failure.
+   * @param desired The value to store if the comparison succeeds.
+   *
+   * @return true if the value was replaced with desired.
+   */
+  bool compare_exchange(uint32_t &expected, uint32_t desired);
 };
 
 }  // namespace chre
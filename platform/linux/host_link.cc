@@ -16,15 +16,333 @@
 
 #include "chre/platform/host_link.h"
 
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <vector>
+
+#include "chre/core/event_loop_manager.h"
+#include "chre/core/host_comms_manager.h"
+#include "chre/platform/log.h"
+#include "chre/platform/shared/generated/host_messages_generated.h"
+#include "chre/platform/shared/host_protocol_common.h"
+#include "chre/platform/shared/log_buffer_manager.h"
+#include "chre/util/flatbuffers/helpers.h"
+
 namespace chre {
 
-void HostLink::flushMessagesSentByNanoapp(uint64_t /* appId */) {
-  // TODO: implement
+namespace {
+
+void completeMessages(const MessageToHost *const *messages,
+                      size_t numMessages) {
+  HostCommsManager &manager =
+      EventLoopManagerSingleton::get()->getHostCommsManager();
+  for (size_t i = 0; i < numMessages; i++) {
+    manager.onMessageToHostComplete(messages[i]);
+  }
+}
+
+template <typename Iterator>
+bool containsMessageFrom(Iterator begin, Iterator end, uint64_t appId) {
+  return std::any_of(begin, end, [appId](const MessageToHost *message) {
+    return (message->appId == appId);
+  });
+}
+
+/**
+ * Writes a batch of packets to the socket, retrying partial writes. The
+ * writes don't block, so that the packets are given up on if the host doesn't
+ * make room for them within the timeout.
+ *
+ * @param timeout How long to wait for the host to read from the socket
+ *        whenever it is full.
+ * @return The number of packets that were written.
+ */
+size_t writePackets(int sockFd, struct mmsghdr *headers, size_t numPackets,
+                    std::chrono::milliseconds timeout) {
+  size_t numWritten = 0;
+  while (numWritten < numPackets) {
+    int result = sendmmsg(sockFd, &headers[numWritten],
+                          static_cast<unsigned int>(numPackets - numWritten),
+                          MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (result > 0) {
+      numWritten += static_cast<size_t>(result);
+    } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct pollfd pollFd = {};
+      pollFd.fd = sockFd;
+      pollFd.events = POLLOUT;
+      if (poll(&pollFd, 1, static_cast<int>(timeout.count())) == 0) {
+        LOGE("Timed out sending %zu messages to host",
+             numPackets - numWritten);
+        break;
+      }
+    } else if (result < 0 && errno != EINTR) {
+      LOGE("Failed to send %zu messages to host: %s", numPackets - numWritten,
+           strerror(errno));
+      break;
+    }
+  }
+
+  return numWritten;
+}
+
+}  // namespace
+
+constexpr std::chrono::milliseconds HostLinkBase::kFlushTimeout;
+constexpr std::chrono::milliseconds HostLinkBase::kWriteTimeout;
+constexpr size_t HostLinkBase::kMaxMessagesPerWrite;
+
+HostLinkBase::~HostLinkBase() {
+  disconnect();
+}
+
+bool HostLinkBase::connect(const char *socketPath) {
+  bool success = false;
+
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (strlen(socketPath) >= sizeof(address.sun_path)) {
+    LOGE("Host socket path too long: %s", socketPath);
+  } else if (mSockFd >= 0) {
+    LOGE("Host link already connected");
+  } else {
+    strcpy(address.sun_path, socketPath);
+
+    int sockFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sockFd < 0) {
+      LOGE("Failed to create host socket: %s", strerror(errno));
+    } else if (::connect(sockFd, reinterpret_cast<struct sockaddr *>(&address),
+                         sizeof(address)) != 0) {
+      LOGE("Failed to connect to host socket %s: %s", socketPath,
+           strerror(errno));
+      close(sockFd);
+    } else {
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSockFd = sockFd;
+        mStopLink = false;
+      }
+      mTxThread = std::thread(&HostLinkBase::txLooper, this);
+      mRxThread = std::thread(&HostLinkBase::rxLooper, this);
+      LOGI("Connected to host socket %s", socketPath);
+      success = true;
+    }
+  }
+
+  return success;
+}
+
+void HostLinkBase::disconnect() {
+  if (mSockFd >= 0) {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStopLink = true;
+      mConditionVariable.notify_all();
+    }
+
+    // Unblocks the Rx thread, which is waiting in recv().
+    shutdown(mSockFd, SHUT_RDWR);
+    mTxThread.join();
+    mRxThread.join();
+
+    close(mSockFd);
+    mSockFd = -1;
+  }
+}
+
+void HostLinkBase::sendLogMessageV2(const uint8_t *logMessage,
+                                    size_t logMessageSize,
+                                    uint32_t numLogsDropped) {
+  ChreFlatBufferBuilder builder;
+  auto logBufferOffset = builder.CreateVector(
+      reinterpret_cast<const int8_t *>(logMessage), logMessageSize);
+  auto message =
+      fbs::CreateLogMessageV2(builder, logBufferOffset, numLogsDropped);
+  HostProtocolCommon::finalize(builder, fbs::ChreMessage::LogMessageV2,
+                               message.Union());
+
+  bool success = false;
+  int sockFd;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    sockFd = mStopLink ? -1 : mSockFd;
+  }
+  if (sockFd >= 0) {
+    // Each send() on the SOCK_SEQPACKET socket is a separate packet, so this
+    // doesn't need to be serialized with the writes of the Tx thread.
+    ssize_t result = send(sockFd, builder.GetBufferPointer(),
+                          builder.GetSize(), MSG_NOSIGNAL);
+    success = (result == static_cast<ssize_t>(builder.GetSize()));
+  }
+
+  LogBufferManagerSingleton::get()->onLogsSentToHost(success);
+}
+
+bool HostLinkBase::enqueueMessage(const MessageToHost *message) {
+  bool success = false;
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (mSockFd >= 0 && !mStopLink) {
+    mTxQueue.push_back(message);
+    mConditionVariable.notify_all();
+    success = true;
+  }
+
+  return success;
+}
+
+void HostLinkBase::waitForMessagesSentByNanoapp(uint64_t appId) {
+  std::vector<const MessageToHost *> droppedMessages;
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto isInFlight = [this, appId] {
+      return containsMessageFrom(mTxBatch, mTxBatch + mTxBatchSize, appId);
+    };
+    bool flushed = mConditionVariable.wait_for(
+        lock, kFlushTimeout, [this, appId, &isInFlight] {
+          return (!containsMessageFrom(mTxQueue.begin(), mTxQueue.end(),
+                                       appId) &&
+                  !isInFlight());
+        });
+
+    if (!flushed) {
+      auto isFromNanoapp = [appId](const MessageToHost *message) {
+        return (message->appId == appId);
+      };
+      std::copy_if(mTxQueue.begin(), mTxQueue.end(),
+                   std::back_inserter(droppedMessages), isFromNanoapp);
+      mTxQueue.erase(
+          std::remove_if(mTxQueue.begin(), mTxQueue.end(), isFromNanoapp),
+          mTxQueue.end());
+
+      // The Tx thread gives up on the batch within kWriteTimeout.
+      mConditionVariable.wait(lock, [&isInFlight] { return !isInFlight(); });
+    }
+  }
+
+  if (!droppedMessages.empty()) {
+    LOGE("Dropping %zu messages from nanoapp 0x%016" PRIx64
+         " not read by the host",
+         droppedMessages.size(), appId);
+    completeMessages(droppedMessages.data(), droppedMessages.size());
+  }
+}
+
+void HostLinkBase::txLooper() {
+  // The builders are reused across batches so their buffers are only
+  // allocated once they need to grow.
+  ChreFlatBufferBuilder builders[kMaxMessagesPerWrite];
+  struct iovec iovecs[kMaxMessagesPerWrite];
+  struct mmsghdr headers[kMaxMessagesPerWrite];
+
+  while (true) {
+    size_t batchSize;
+    bool stopping;
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mConditionVariable.wait(
+          lock, [this] { return (!mTxQueue.empty() || mStopLink); });
+
+      if (mTxQueue.empty()) {
+        // Only exit once the queue is drained so that every message gets
+        // completed.
+        break;
+      }
+
+      batchSize = std::min(mTxQueue.size(), kMaxMessagesPerWrite);
+      std::copy(mTxQueue.begin(), mTxQueue.begin() + batchSize, mTxBatch);
+      mTxQueue.erase(mTxQueue.begin(), mTxQueue.begin() + batchSize);
+      mTxBatchSize = batchSize;
+      stopping = mStopLink;
+    }
+
+    // Encoding and writing happen outside of the lock so that nanoapps can
+    // keep queueing messages in the meantime. mTxBatch is only modified by
+    // this thread.
+    if (!stopping) {
+      for (size_t i = 0; i < batchSize; i++) {
+        const MessageToHost *message = mTxBatch[i];
+        builders[i].Clear();
+        HostProtocolCommon::encodeNanoappMessage(
+            builders[i], message->appId, message->toHostData.messageType,
+            message->toHostData.hostEndpoint, message->message.data(),
+            message->message.size(), message->toHostData.appPermissions,
+            message->toHostData.messagePermissions);
+
+        iovecs[i].iov_base = builders[i].GetBufferPointer();
+        iovecs[i].iov_len = builders[i].GetSize();
+        headers[i] = {};
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+      }
+
+      writePackets(mSockFd, headers, batchSize, kWriteTimeout);
+    }
+
+    completeMessages(mTxBatch, batchSize);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTxBatchSize = 0;
+    mConditionVariable.notify_all();
+  }
+}
+
+void HostLinkBase::rxLooper() {
+  std::vector<uint8_t> buffer(kMaxRxPacketSize);
+  HostCommsManager &manager =
+      EventLoopManagerSingleton::get()->getHostCommsManager();
+
+  while (true) {
+    ssize_t packetSize =
+        recv(mSockFd, buffer.data(), buffer.size(), MSG_TRUNC);
+    if (packetSize == 0) {
+      LOGI("Host socket closed");
+      break;
+    } else if (packetSize < 0) {
+      if (errno != EINTR) {
+        LOGE("Failed to receive from host: %s", strerror(errno));
+        break;
+      }
+    } else if (static_cast<size_t>(packetSize) > buffer.size()) {
+      LOGE("Dropping oversized message from host (length %zd)", packetSize);
+    } else if (!HostProtocolCommon::verifyMessage(
+                   buffer.data(), static_cast<size_t>(packetSize))) {
+      LOGE("Dropping invalid/corrupted message from host (length %zd)",
+           packetSize);
+    } else {
+      const fbs::MessageContainer *container =
+          fbs::GetMessageContainer(buffer.data());
+      if (container->message_type() == fbs::ChreMessage::NanoappMessage) {
+        const auto *nanoappMsg =
+            static_cast<const fbs::NanoappMessage *>(container->message());
+        const flatbuffers::Vector<uint8_t> *msgData = nanoappMsg->message();
+        manager.sendMessageToNanoappFromHost(
+            nanoappMsg->app_id(), nanoappMsg->message_type(),
+            nanoappMsg->host_endpoint(), msgData->data(), msgData->size());
+      } else {
+        LOGW("Ignoring unsupported message type %" PRIu8 " from host",
+             static_cast<uint8_t>(container->message_type()));
+      }
+    }
+  }
+}
+
+void HostLink::flushMessagesSentByNanoapp(uint64_t appId) {
+  // Queued messages are still delivered rather than purged, since they were
+  // sent before the nanoapp stopped, unless the host isn't reading them.
+  waitForMessagesSentByNanoapp(appId);
 }
 
-bool HostLink::sendMessage(const MessageToHost * /* message */) {
-  // TODO: implement
-  return false;
+bool HostLink::sendMessage(const MessageToHost *message) {
+  return enqueueMessage(message);
 }
 
 }  // namespace chre
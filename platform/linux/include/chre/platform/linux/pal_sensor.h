@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_PLATFORM_LINUX_PAL_SENSOR_H_
+#define CHRE_PLATFORM_LINUX_PAL_SENSOR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace chre {
+
+//! Describes a sensor exposed by the simulated sensor PAL.
+struct SimulatedSensorConfig {
+  //! One of the CHRE_SENSOR_TYPE_* values. Only sensor types with three-axis,
+  //! float or byte samples are supported.
+  uint8_t sensorType;
+
+  //! The shortest sampling interval supported by the sensor, in nanoseconds.
+  uint64_t minIntervalNs;
+};
+
+/**
+ * Replaces the sensors exposed by the simulated sensor PAL. By default, it
+ * exposes calibrated and uncalibrated accelerometer, gyroscope and
+ * magnetometer sensors, a pressure sensor, and light and proximity on-change
+ * sensors.
+ *
+ * This must be invoked before CHRE is initialized.
+ *
+ * @param sensors The sensors to expose, the first of which gets sensor handle
+ *        0. A sensor type must appear at most once.
+ * @param numSensors The number of entries in sensors.
+ *
+ * @return true if the sensors were set, false if one of them is invalid or if
+ *         there are too many, in which case the sensors are left unchanged.
+ */
+bool setSimulatedSensors(const SimulatedSensorConfig *sensors,
+                         size_t numSensors);
+
+/**
+ * Delivers a batch of samples of a sensor to CHRE right away, in addition to
+ * the ones the sensor delivers while it is enabled. This lets tests control
+ * the data CHRE receives.
+ *
+ * @param sensorHandle The handle of the sensor.
+ * @param baseTimestampNs The timestamp of the first sample.
+ * @param intervalNs The time between two samples.
+ * @param numSamples The number of samples, at least 1.
+ *
+ * @return true if the samples were delivered, false if the arguments are
+ *         invalid or the samples were dropped.
+ */
+bool sendSimulatedSensorData(uint32_t sensorHandle, uint64_t baseTimestampNs,
+                             uint32_t intervalNs, uint16_t numSamples);
+
+/**
+ * @return The number of sensor data events delivered to CHRE that it hasn't
+ *         released yet.
+ */
+uint32_t getNumSimulatedSensorEventsPendingRelease();
+
+}  // namespace chre
+
+#endif  // CHRE_PLATFORM_LINUX_PAL_SENSOR_H_
@@ -17,10 +17,131 @@
 #ifndef CHRE_PLATFORM_LINUX_HOST_LINK_BASE_H_
 #define CHRE_PLATFORM_LINUX_HOST_LINK_BASE_H_
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 namespace chre {
 
+struct HostMessage;
+typedef HostMessage MessageToHost;
+
+/**
+ * Linux implementation of the host link, which exchanges messages encoded with
+ * the HostProtocol FlatBuffers schema over a UNIX SOCK_SEQPACKET socket, such
+ * as the one served by the SocketServer in host/common.
+ *
+ * Messages to the host are queued by sendMessage() and written by a dedicated
+ * thread, which coalesces all messages pending at the time of the write (up to
+ * kMaxMessagesPerWrite) into a single system call and then completes them. If
+ * the host stops reading for kWriteTimeout, the rest of the batch is dropped.
+ */
 class HostLinkBase {
-  // Currently unused
+ public:
+  ~HostLinkBase();
+
+  /**
+   * Connects to the host socket and starts the threads that send and receive
+   * messages. Until this is called, sendMessage() fails.
+   *
+   * @param socketPath The filesystem path of the host socket.
+   * @return true if the connection was established.
+   */
+  bool connect(const char *socketPath);
+
+  /**
+   * Stops the link threads and closes the socket. Messages that are still
+   * queued are completed without being sent.
+   */
+  void disconnect();
+
+  /**
+   * Sends a buffer of logs, in the format of LogBuffer, to the host and then
+   * notifies the LogBufferManager that it was sent. Unlike nanoapp messages,
+   * logs are written from the calling thread.
+   *
+   * @param logMessage The buffer of logs, which must remain valid until the
+   *        LogBufferManager is notified.
+   * @param logMessageSize The size of the buffer in bytes.
+   * @param numLogsDropped The number of logs dropped since CHRE started.
+   */
+  void sendLogMessageV2(const uint8_t *logMessage, size_t logMessageSize,
+                        uint32_t numLogsDropped);
+
+ protected:
+  /**
+   * Queues a message for the Tx thread.
+   *
+   * @return true if the link is connected and the message was queued.
+   */
+  bool enqueueMessage(const MessageToHost *message);
+
+  /**
+   * Blocks until every queued or in-flight message sent by the given nanoapp
+   * has been completed. If that takes longer than kFlushTimeout, the messages
+   * that are still queued are completed without being sent, and only the
+   * in-flight ones are waited for, which takes at most kWriteTimeout.
+   */
+  void waitForMessagesSentByNanoapp(uint64_t appId);
+
+ private:
+  //! How long a nanoapp's messages are given to reach the host when it is
+  //! unloaded, as this blocks the event loop.
+  static constexpr std::chrono::milliseconds kFlushTimeout{250};
+
+  //! How long the Tx thread waits for the host to read from the socket before
+  //! dropping the rest of a batch.
+  static constexpr std::chrono::milliseconds kWriteTimeout{250};
+
+  //! The maximum number of messages coalesced into a single socket write.
+  static constexpr size_t kMaxMessagesPerWrite = 16;
+
+  //! The size of the buffer that packets from the host are received into.
+  static constexpr size_t kMaxRxPacketSize = 64 * 1024;
+
+  //! The socket connected to the host, or -1 if not connected.
+  int mSockFd = -1;
+
+  //! The thread that writes queued messages to the socket.
+  std::thread mTxThread;
+
+  //! The thread that receives and decodes messages from the host.
+  std::thread mRxThread;
+
+  //! Guards the fields below.
+  std::mutex mMutex;
+
+  //! Signals that messages were queued, that a write completed, or that the
+  //! link is stopping.
+  std::condition_variable mConditionVariable;
+
+  //! Messages waiting to be picked up by the Tx thread.
+  std::deque<const MessageToHost *> mTxQueue;
+
+  //! The messages being written by the Tx thread.
+  const MessageToHost *mTxBatch[kMaxMessagesPerWrite];
+
+  //! The number of valid entries in mTxBatch.
+  size_t mTxBatchSize = 0;
+
+  //! Set when the link threads should exit.
+  bool mStopLink = false;
+
+  /**
+   * A looper method that waits for queued messages, then encodes and writes
+   * them to the socket in batches and completes them.
+   */
+  void txLooper();
+
+  /**
+   * A looper method that receives packets from the host until the socket is
+   * shut down and dispatches the nanoapp messages they contain.
+   */
+  void rxLooper();
 };
 
 }  // namespace chre
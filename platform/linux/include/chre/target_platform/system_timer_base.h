@@ -17,28 +17,33 @@
 #ifndef CHRE_PLATFORM_LINUX_SYSTEM_TIMER_BASE_H_
 #define CHRE_PLATFORM_LINUX_SYSTEM_TIMER_BASE_H_
 
-#include <signal.h>
-#include <time.h>
 #include <cinttypes>
 
 namespace chre {
 
+class SystemTimerDispatcher;
+
 /**
  * The Linux base class for the SystemTimer. The Linux implementation uses a
- * POSIX timer.
+ * timerfd, which is monitored along with those of all other SystemTimers by a
+ * single dispatcher thread that invokes the callbacks.
  */
 class SystemTimerBase {
  protected:
-  //! The timer id that is generated during the initialization phase.
-  timer_t mTimerId;
+  // The dispatcher needs access to the timerfd and the notify callback.
+  friend class SystemTimerDispatcher;
+
+  //! The timerfd that is created during the initialization phase.
+  int mTimerFd = -1;
 
   //! Tracks whether the timer has been initialized correctly.
   bool mInitialized = false;
 
-  //! A static method that is invoked by the underlying POSIX timer.
-  static void systemTimerNotifyCallback(union sigval cookie);
+  //! A static method that is invoked by the dispatcher thread when the timerfd
+  //! of the given timer has expired.
+  static void systemTimerNotifyCallback(SystemTimerBase *timer);
 
-  //! A utility function to set a POSIX timer.
+  //! A utility function to set the timerfd.
   bool setInternal(uint64_t delayNs);
 };
 
@@ -25,13 +25,19 @@
 #endif  // CHRE_AUDIO_SUPPORT_ENABLED
 #include "chre/platform/context.h"
 #include "chre/platform/fatal_error.h"
+#ifdef CHRE_SENSORS_SUPPORT_ENABLED
+#include "chre/platform/linux/pal_sensor.h"
+#endif  // CHRE_SENSORS_SUPPORT_ENABLED
 #include "chre/platform/linux/platform_log.h"
 #include "chre/platform/log.h"
 #include "chre/platform/system_timer.h"
 #include "chre/util/time.h"
 
+#include <pthread.h>
 #include <tclap/CmdLine.h>
+#include <cinttypes>
 #include <csignal>
+#include <cstdio>
 #include <thread>
 
 using chre::EventLoopManagerSingleton;
@@ -45,16 +51,6 @@ constexpr char kSimDescription[] =
 //! rules of semantic versioning.
 constexpr char kSimVersion[] = "0.1.0";
 
-namespace {
-
-extern "C" void signalHandler(int sig) {
-  (void)sig;
-  LOGI("Stop request received");
-  EventLoopManagerSingleton::get()->getEventLoop().stop();
-}
-
-}  // namespace
-
 int main(int argc, char **argv) {
   try {
     // Parse command-line arguments.
@@ -65,6 +61,10 @@ int main(int argc, char **argv) {
     TCLAP::MultiArg<std::string> nanoappsArg(
         "", "nanoapp", "nanoapp shared object to load and execute", false,
         "path", cmd);
+    TCLAP::ValueArg<std::string> hostSocketArg(
+        "", "host_socket",
+        "UNIX socket of the host daemon to exchange host messages with", false,
+        "", "path", cmd);
 #ifdef CHRE_AUDIO_SUPPORT_ENABLED
     TCLAP::ValueArg<std::string> audioFileArg(
         "", "audio_file", "WAV file to open for audio simulation", false, "",
@@ -76,8 +76,22 @@ int main(int argc, char **argv) {
         "", "max_audio_buf_size", "max buffer size for audio simulation", false,
         10.0, "seconds", cmd);
 #endif  // CHRE_AUDIO_SUPPORT_ENABLED
+#ifdef CHRE_SENSORS_SUPPORT_ENABLED
+    TCLAP::MultiArg<std::string> sensorsArg(
+        "", "sensor",
+        "sensor to simulate instead of the default set, as the sensor type "
+        "and its minimum interval in nanoseconds",
+        false, "type:interval", cmd);
+#endif  // CHRE_SENSORS_SUPPORT_ENABLED
     cmd.parse(argc, argv);
 
+    // Block SIGINT in every thread so that the stop request is only received
+    // by the sigwait() below. This must happen before any thread is created.
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
     // Initialize logging.
     chre::PlatformLogSingleton::init();
 
@@ -94,11 +108,33 @@ int main(int argc, char **argv) {
     // configuration to support multiple sources.
 #endif  // CHRE_AUDIO_SUPPORT_ENABLED
 
+#ifdef CHRE_SENSORS_SUPPORT_ENABLED
+    // Configure the simulated sensors if any are given.
+    if (!sensorsArg.getValue().empty()) {
+      chre::DynamicVector<chre::SimulatedSensorConfig> sensors;
+      for (const auto &sensor : sensorsArg.getValue()) {
+        chre::SimulatedSensorConfig config;
+        if (sscanf(sensor.c_str(), "%" SCNu8 ":%" SCNu64, &config.sensorType,
+                   &config.minIntervalNs) != 2 ||
+            !sensors.push_back(config)) {
+          FATAL_ERROR("Invalid sensor %s", sensor.c_str());
+        }
+      }
+      if (!chre::setSimulatedSensors(sensors.data(), sensors.size())) {
+        FATAL_ERROR("Failed to configure the simulated sensors");
+      }
+    }
+#endif  // CHRE_SENSORS_SUPPORT_ENABLED
+
     // Initialize the system.
     chre::init();
 
-    // Register a signal handler.
-    std::signal(SIGINT, signalHandler);
+    // Connect to the host daemon if one was specified, otherwise messages to
+    // the host are rejected.
+    if (!hostSocketArg.getValue().empty()) {
+      EventLoopManagerSingleton::get()->getHostCommsManager().connect(
+          hostSocketArg.getValue().c_str());
+    }
 
     // Load any static nanoapps and start the event loop.
     std::thread chreThread([&]() {
@@ -120,6 +156,15 @@ int main(int argc, char **argv) {
 
       EventLoopManagerSingleton::get()->getEventLoop().run();
     });
+
+    int stopSignal;
+    sigwait(&stopSignals, &stopSignal);
+    LOGI("Stop request received");
+
+    // Messages to the host are freed through the event loop once completed, so
+    // the link must be stopped while the event loop is still running.
+    EventLoopManagerSingleton::get()->getHostCommsManager().disconnect();
+    EventLoopManagerSingleton::get()->getEventLoop().stop();
     chreThread.join();
 
     chre::deinit();
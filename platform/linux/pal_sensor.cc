@@ -0,0 +1,552 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/pal/sensor.h"
+
+#include "chre/platform/linux/pal_sensor.h"
+#include "chre/platform/memory.h"
+#include "chre/util/macros.h"
+#include "chre/util/memory.h"
+#include "chre/util/time.h"
+#include "chre/util/unique_ptr.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+/**
+ * A simulated implementation of the sensor PAL for the linux platform.
+ *
+ * Each enabled sensor has a thread that generates synthetic samples at the
+ * requested interval, and delivers them in batches spanning the requested
+ * latency.
+ */
+namespace {
+
+using chre::kOneMillisecondInNanoseconds;
+using chre::kOneSecondInNanoseconds;
+
+//! The maximum number of sensors that can be simulated.
+constexpr size_t kMaxSensors = 16;
+
+//! The maximum number of samples in a single data event.
+constexpr uint64_t kMaxSamplesPerEvent = 1000;
+
+//! The maximum number of data events that can be pending release across all
+//! sensors. Samples generated beyond this are dropped, which bounds the memory
+//! used if CHRE falls behind.
+constexpr uint32_t kMaxEventsPendingRelease = 256;
+
+//! The intervals used when CHRE_SENSOR_INTERVAL_DEFAULT is requested.
+constexpr uint64_t kDefaultContinuousIntervalNs =
+    20 * kOneMillisecondInNanoseconds;
+constexpr uint64_t kDefaultOnChangeIntervalNs = kOneSecondInNanoseconds;
+
+enum class SampleFormat {
+  ThreeAxis,
+  Float,
+  Byte,
+};
+
+//! Describes how samples are generated for a supported sensor type. Each axis
+//! follows offset + amplitude * sin(2 * pi * frequency * t + phase), with the
+//! phase shifted by a quarter period per axis.
+struct SimulatedSensorType {
+  uint8_t sensorType;
+  const char *sensorName;
+  SampleFormat format;
+  bool isOnChange;
+  float offset[3];
+  float amplitude;
+  float frequencyHz;
+};
+
+constexpr SimulatedSensorType kSimulatedSensorTypes[] = {
+    {CHRE_SENSOR_TYPE_ACCELEROMETER, "Simulated Accelerometer",
+     SampleFormat::ThreeAxis, false, {0.0f, 0.0f, 9.81f}, 0.3f, 1.0f},
+    {CHRE_SENSOR_TYPE_UNCALIBRATED_ACCELEROMETER,
+     "Simulated Uncalibrated Accelerometer", SampleFormat::ThreeAxis, false,
+     {0.05f, -0.02f, 9.85f}, 0.3f, 1.0f},
+    {CHRE_SENSOR_TYPE_GYROSCOPE, "Simulated Gyroscope",
+     SampleFormat::ThreeAxis, false, {0.0f, 0.0f, 0.0f}, 0.1f, 0.5f},
+    {CHRE_SENSOR_TYPE_UNCALIBRATED_GYROSCOPE,
+     "Simulated Uncalibrated Gyroscope", SampleFormat::ThreeAxis, false,
+     {0.01f, -0.01f, 0.005f}, 0.1f, 0.5f},
+    {CHRE_SENSOR_TYPE_GEOMAGNETIC_FIELD, "Simulated Magnetometer",
+     SampleFormat::ThreeAxis, false, {20.0f, -5.0f, -40.0f}, 2.0f, 0.2f},
+    {CHRE_SENSOR_TYPE_UNCALIBRATED_GEOMAGNETIC_FIELD,
+     "Simulated Uncalibrated Magnetometer", SampleFormat::ThreeAxis, false,
+     {35.0f, 10.0f, -60.0f}, 2.0f, 0.2f},
+    {CHRE_SENSOR_TYPE_PRESSURE, "Simulated Pressure", SampleFormat::Float,
+     false, {1013.25f}, 0.5f, 0.05f},
+    {CHRE_SENSOR_TYPE_LIGHT, "Simulated Light", SampleFormat::Float, true,
+     {200.0f}, 150.0f, 0.1f},
+    {CHRE_SENSOR_TYPE_PROXIMITY, "Simulated Proximity", SampleFormat::Byte,
+     true, {0.0f}, 1.0f, 0.1f},
+};
+
+const chre::SimulatedSensorConfig kDefaultSensors[] = {
+    {CHRE_SENSOR_TYPE_ACCELEROMETER, kOneMillisecondInNanoseconds},
+    {CHRE_SENSOR_TYPE_UNCALIBRATED_ACCELEROMETER, kOneMillisecondInNanoseconds},
+    {CHRE_SENSOR_TYPE_GYROSCOPE, kOneMillisecondInNanoseconds},
+    {CHRE_SENSOR_TYPE_UNCALIBRATED_GYROSCOPE, kOneMillisecondInNanoseconds},
+    {CHRE_SENSOR_TYPE_GEOMAGNETIC_FIELD, 10 * kOneMillisecondInNanoseconds},
+    {CHRE_SENSOR_TYPE_UNCALIBRATED_GEOMAGNETIC_FIELD,
+     10 * kOneMillisecondInNanoseconds},
+    {CHRE_SENSOR_TYPE_PRESSURE, 40 * kOneMillisecondInNanoseconds},
+    {CHRE_SENSOR_TYPE_LIGHT, 100 * kOneMillisecondInNanoseconds},
+    {CHRE_SENSOR_TYPE_PROXIMITY, 100 * kOneMillisecondInNanoseconds},
+};
+
+//! The sampling state of a sensor, shared between CHRE and its thread.
+struct SensorState {
+  //! Thread to deliver sensor data while the sensor is enabled.
+  std::thread thread;
+
+  std::mutex mutex;
+  std::condition_variable condVar;
+
+  //! The resolved interval and latency, set before the thread starts.
+  uint64_t intervalNs = 0;
+  uint64_t latencyNs = 0;
+
+  //! Protected by mutex. Flush requests up to lastFlushRequestId are
+  //! completed by the thread once all samples due have been delivered.
+  bool stopRequested = false;
+  uint32_t lastFlushRequestId = 0;
+  uint32_t lastCompletedFlushRequestId = 0;
+};
+
+const struct chrePalSystemApi *gSystemApi = nullptr;
+const struct chrePalSensorCallbacks *gCallbacks = nullptr;
+
+bool gSensorsConfigured = false;
+size_t gNumSensors = 0;
+struct chreSensorInfo gSensorInfo[kMaxSensors];
+const SimulatedSensorType *gSensorTypes[kMaxSensors];
+SensorState gSensorStates[kMaxSensors];
+
+std::atomic<uint32_t> gNumEventsPendingRelease(0);
+
+const SimulatedSensorType *getSimulatedSensorType(uint8_t sensorType) {
+  for (const SimulatedSensorType &type : kSimulatedSensorTypes) {
+    if (type.sensorType == sensorType) {
+      return &type;
+    }
+  }
+  return nullptr;
+}
+
+float getAxisValue(const SimulatedSensorType &type, size_t axis,
+                   uint64_t timestampNs) {
+  constexpr double kTwoPi = 6.283185307179586;
+  double seconds = static_cast<double>(timestampNs) /
+                   static_cast<double>(kOneSecondInNanoseconds);
+  double phase = kTwoPi * (type.frequencyHz * seconds + 0.25 * axis);
+  return type.offset[axis] +
+         type.amplitude * static_cast<float>(std::sin(phase));
+}
+
+/**
+ * Allocates a sensor data event of the given type and fills in its header and
+ * sample timestamps.
+ *
+ * @return The event, or nullptr if out of memory.
+ */
+template <typename DataType>
+DataType *allocateSensorData(uint32_t sensorInfoIndex,
+                             uint64_t baseTimestampNs, uint64_t intervalNs,
+                             uint16_t numSamples) {
+  size_t size =
+      sizeof(DataType) + (numSamples - 1) * sizeof(DataType::readings[0]);
+  auto *data = static_cast<DataType *>(chre::memoryAlloc(size));
+  if (data != nullptr) {
+    memset(data, 0, size);
+    data->header.baseTimestamp = baseTimestampNs;
+    data->header.sensorHandle = sensorInfoIndex;
+    data->header.readingCount = numSamples;
+    data->header.accuracy = CHRE_SENSOR_ACCURACY_HIGH;
+    for (uint16_t i = 1; i < numSamples; i++) {
+      data->readings[i].timestampDelta = static_cast<uint32_t>(intervalNs);
+    }
+  }
+  return data;
+}
+
+/**
+ * Generates numSamples samples of a sensor starting at the given time.
+ *
+ * @return The sensor data event, or nullptr if out of memory.
+ */
+void *generateSensorData(uint32_t sensorInfoIndex, uint64_t baseTimestampNs,
+                         uint64_t intervalNs, uint16_t numSamples) {
+  const SimulatedSensorType &type = *gSensorTypes[sensorInfoIndex];
+  void *event = nullptr;
+  switch (type.format) {
+    case SampleFormat::ThreeAxis: {
+      auto *data = allocateSensorData<chreSensorThreeAxisData>(
+          sensorInfoIndex, baseTimestampNs, intervalNs, numSamples);
+      for (uint16_t i = 0; data != nullptr && i < numSamples; i++) {
+        uint64_t timestampNs = baseTimestampNs + i * intervalNs;
+        for (size_t axis = 0; axis < 3; axis++) {
+          data->readings[i].values[axis] =
+              getAxisValue(type, axis, timestampNs);
+        }
+      }
+      event = data;
+      break;
+    }
+
+    case SampleFormat::Float: {
+      auto *data = allocateSensorData<chreSensorFloatData>(
+          sensorInfoIndex, baseTimestampNs, intervalNs, numSamples);
+      for (uint16_t i = 0; data != nullptr && i < numSamples; i++) {
+        data->readings[i].value =
+            getAxisValue(type, 0, baseTimestampNs + i * intervalNs);
+      }
+      event = data;
+      break;
+    }
+
+    case SampleFormat::Byte: {
+      auto *data = allocateSensorData<chreSensorByteData>(
+          sensorInfoIndex, baseTimestampNs, intervalNs, numSamples);
+      for (uint16_t i = 0; data != nullptr && i < numSamples; i++) {
+        data->readings[i].isNear =
+            getAxisValue(type, 0, baseTimestampNs + i * intervalNs) > 0.0f;
+      }
+      event = data;
+      break;
+    }
+  }
+
+  return event;
+}
+
+/**
+ * @return true if the samples were delivered, false if they were dropped.
+ */
+bool sendSensorData(uint32_t sensorInfoIndex, uint64_t baseTimestampNs,
+                    uint64_t intervalNs, uint16_t numSamples) {
+  void *event = nullptr;
+  if (gNumEventsPendingRelease.load() < kMaxEventsPendingRelease) {
+    event = generateSensorData(sensorInfoIndex, baseTimestampNs, intervalNs,
+                               numSamples);
+  }
+
+  if (event != nullptr) {
+    gNumEventsPendingRelease++;
+    gCallbacks->dataEventCallback(sensorInfoIndex, event);
+  }
+  return (event != nullptr);
+}
+
+/**
+ * Delivers the samples of a sensor until it is stopped. The first sample is
+ * taken when the sensor is enabled, and every sample is delivered at most the
+ * requested latency after it was taken, in batches of up to
+ * kMaxSamplesPerEvent. A flush delivers the samples taken so far right away.
+ */
+void sendSensorEvents(uint32_t sensorInfoIndex) {
+  SensorState &state = gSensorStates[sensorInfoIndex];
+  const uint64_t intervalNs = state.intervalNs;
+
+  // Timestamp deltas are 32 bits, so longer intervals cannot be batched.
+  uint64_t samplesPerBatch = 1;
+  if (intervalNs <= UINT32_MAX) {
+    samplesPerBatch = std::min(kMaxSamplesPerEvent,
+                               state.latencyNs / intervalNs + 1);
+  }
+
+  uint64_t nextSampleNs = gSystemApi->getCurrentTime();
+  uint64_t numSamplesDropped = 0;
+  std::unique_lock<std::mutex> lock(state.mutex);
+  while (!state.stopRequested) {
+    uint64_t nowNs = gSystemApi->getCurrentTime();
+    uint64_t deliveryNs = nextSampleNs + (samplesPerBatch - 1) * intervalNs;
+    bool flushRequested =
+        (state.lastFlushRequestId != state.lastCompletedFlushRequestId);
+    if (nowNs < deliveryNs && !flushRequested) {
+      state.condVar.wait_for(lock,
+                             std::chrono::nanoseconds(deliveryNs - nowNs));
+      continue;
+    }
+
+    uint32_t firstFlushRequestId = state.lastCompletedFlushRequestId + 1;
+    uint32_t lastFlushRequestId = state.lastFlushRequestId;
+    state.lastCompletedFlushRequestId = lastFlushRequestId;
+    lock.unlock();
+
+    if (nowNs >= nextSampleNs) {
+      uint64_t numSamples =
+          std::min(samplesPerBatch, (nowNs - nextSampleNs) / intervalNs + 1);
+      if (!sendSensorData(sensorInfoIndex, nextSampleNs, intervalNs,
+                          static_cast<uint16_t>(numSamples))) {
+        numSamplesDropped += numSamples;
+      } else if (numSamplesDropped > 0) {
+        gSystemApi->log(CHRE_LOG_WARN,
+                        "Dropped %" PRIu64 " samples of sensor %" PRIu32,
+                        numSamplesDropped, sensorInfoIndex);
+        numSamplesDropped = 0;
+      }
+      nextSampleNs += numSamples * intervalNs;
+    }
+
+    if (flushRequested) {
+      for (uint32_t id = firstFlushRequestId; id != lastFlushRequestId + 1;
+           id++) {
+        gCallbacks->flushCompleteCallback(sensorInfoIndex, id,
+                                          CHRE_ERROR_NONE);
+      }
+    }
+
+    lock.lock();
+  }
+}
+
+void sendSamplingStatus(uint32_t sensorInfoIndex, bool enabled,
+                        uint64_t intervalNs, uint64_t latencyNs) {
+  auto status = chre::MakeUniqueZeroFill<struct chreSensorSamplingStatus>();
+  if (status.isNull()) {
+    gSystemApi->log(CHRE_LOG_ERROR, "Failed to allocate sampling status");
+  } else {
+    status->enabled = enabled;
+    status->interval = intervalNs;
+    status->latency = latencyNs;
+    gCallbacks->samplingStatusUpdateCallback(sensorInfoIndex,
+                                             status.release());
+  }
+}
+
+void stopSensorThread(uint32_t sensorInfoIndex) {
+  SensorState &state = gSensorStates[sensorInfoIndex];
+  if (state.thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      state.stopRequested = true;
+    }
+    state.condVar.notify_one();
+    state.thread.join();
+
+    // Flushes received after the last batch are failed since the sensor is no
+    // longer enabled.
+    for (uint32_t id = state.lastCompletedFlushRequestId + 1;
+         id != state.lastFlushRequestId + 1; id++) {
+      gCallbacks->flushCompleteCallback(sensorInfoIndex, id,
+                                        CHRE_ERROR_FUNCTION_DISABLED);
+    }
+    state.lastCompletedFlushRequestId = state.lastFlushRequestId;
+  }
+}
+
+void chrePalSensorApiClose() {
+  for (uint32_t i = 0; i < gNumSensors; i++) {
+    stopSensorThread(i);
+  }
+}
+
+bool chrePalSensorApiOpen(const struct chrePalSystemApi *systemApi,
+                          const struct chrePalSensorCallbacks *callbacks) {
+  chrePalSensorApiClose();
+
+  bool success = false;
+  if (systemApi != nullptr && callbacks != nullptr) {
+    gSystemApi = systemApi;
+    gCallbacks = callbacks;
+    if (!gSensorsConfigured) {
+      chre::setSimulatedSensors(kDefaultSensors, ARRAY_SIZE(kDefaultSensors));
+    }
+    success = true;
+  }
+
+  return success;
+}
+
+bool chrePalSensorApiGetSensors(struct chreSensorInfo *const *sensors,
+                                uint32_t *arraySize) {
+  // The sensors parameter is declared const, but the PAL is expected to set it
+  // to the array of sensors.
+  *const_cast<struct chreSensorInfo **>(sensors) = gSensorInfo;
+  *arraySize = static_cast<uint32_t>(gNumSensors);
+  return true;
+}
+
+bool chrePalSensorApiConfigureSensor(uint32_t sensorInfoIndex,
+                                     enum chreSensorConfigureMode mode,
+                                     uint64_t intervalNs, uint64_t latencyNs) {
+  if (sensorInfoIndex >= gNumSensors) {
+    return false;
+  }
+
+  stopSensorThread(sensorInfoIndex);
+
+  bool enable = (mode != CHRE_SENSOR_CONFIGURE_MODE_DONE);
+  if (enable) {
+    if (intervalNs == CHRE_SENSOR_INTERVAL_DEFAULT) {
+      intervalNs = gSensorTypes[sensorInfoIndex]->isOnChange
+                       ? kDefaultOnChangeIntervalNs
+                       : kDefaultContinuousIntervalNs;
+    }
+    intervalNs =
+        std::max(intervalNs, gSensorInfo[sensorInfoIndex].minInterval);
+    if (latencyNs == CHRE_SENSOR_LATENCY_DEFAULT) {
+      latencyNs = CHRE_SENSOR_LATENCY_ASAP;
+    }
+
+    SensorState &state = gSensorStates[sensorInfoIndex];
+    state.intervalNs = intervalNs;
+    state.latencyNs = latencyNs;
+    state.stopRequested = false;
+    state.thread = std::thread(sendSensorEvents, sensorInfoIndex);
+  } else {
+    intervalNs = CHRE_SENSOR_INTERVAL_DEFAULT;
+    latencyNs = CHRE_SENSOR_LATENCY_DEFAULT;
+  }
+
+  sendSamplingStatus(sensorInfoIndex, enable, intervalNs, latencyNs);
+  return true;
+}
+
+bool chrePalSensorApiFlush(uint32_t sensorInfoIndex,
+                           uint32_t *flushRequestId) {
+  if (sensorInfoIndex >= gNumSensors ||
+      !gSensorStates[sensorInfoIndex].thread.joinable()) {
+    return false;
+  }
+
+  SensorState &state = gSensorStates[sensorInfoIndex];
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    *flushRequestId = ++state.lastFlushRequestId;
+  }
+  state.condVar.notify_one();
+  return true;
+}
+
+bool chrePalSensorApiConfigureBiasEvents(uint32_t sensorInfoIndex,
+                                         bool /* enable */,
+                                         uint64_t /* latencyNs */) {
+  // None of the simulated sensors report bias events, but the request must
+  // succeed since CHRE enables them by default for calibrated sensors.
+  return (sensorInfoIndex < gNumSensors);
+}
+
+bool chrePalSensorApiGetThreeAxisBias(
+    uint32_t /* sensorInfoIndex */,
+    struct chreSensorThreeAxisData * /* bias */) {
+  return false;
+}
+
+void chrePalSensorApiReleaseSensorDataEvent(void *data) {
+  chre::memoryFree(data);
+  gNumEventsPendingRelease--;
+}
+
+void chrePalSensorApiReleaseSamplingStatusEvent(
+    struct chreSensorSamplingStatus *status) {
+  chre::memoryFree(status);
+}
+
+void chrePalSensorApiReleaseBiasEvent(void *bias) {
+  chre::memoryFree(bias);
+}
+
+}  // anonymous namespace
+
+namespace chre {
+
+bool setSimulatedSensors(const SimulatedSensorConfig *sensors,
+                         size_t numSensors) {
+  if (numSensors > kMaxSensors) {
+    return false;
+  }
+
+  const SimulatedSensorType *types[kMaxSensors];
+  for (size_t i = 0; i < numSensors; i++) {
+    types[i] = getSimulatedSensorType(sensors[i].sensorType);
+    if (types[i] == nullptr) {
+      return false;
+    }
+    for (size_t j = 0; j < i; j++) {
+      if (sensors[j].sensorType == sensors[i].sensorType) {
+        return false;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < numSensors; i++) {
+    struct chreSensorInfo &info = gSensorInfo[i];
+    memset(&info, 0, sizeof(info));
+    info.sensorName = types[i]->sensorName;
+    info.sensorType = types[i]->sensorType;
+    info.isOnChange = types[i]->isOnChange;
+    info.supportsPassiveMode = 1;
+    info.minInterval = std::max<uint64_t>(sensors[i].minIntervalNs, 1);
+    info.sensorIndex = CHRE_SENSOR_INDEX_DEFAULT;
+    gSensorTypes[i] = types[i];
+  }
+  gNumSensors = numSensors;
+  gSensorsConfigured = true;
+
+  return true;
+}
+
+bool sendSimulatedSensorData(uint32_t sensorHandle, uint64_t baseTimestampNs,
+                             uint32_t intervalNs, uint16_t numSamples) {
+  bool success = false;
+  if (gCallbacks != nullptr && sensorHandle < gNumSensors &&
+      numSamples > 0) {
+    success =
+        sendSensorData(sensorHandle, baseTimestampNs, intervalNs, numSamples);
+  }
+  return success;
+}
+
+uint32_t getNumSimulatedSensorEventsPendingRelease() {
+  return gNumEventsPendingRelease.load();
+}
+
+}  // namespace chre
+
+const struct chrePalSensorApi *chrePalSensorGetApi(
+    uint32_t requestedApiVersion) {
+  static const struct chrePalSensorApi kApi = {
+      .moduleVersion = CHRE_PAL_SENSOR_API_CURRENT_VERSION,
+      .open = chrePalSensorApiOpen,
+      .close = chrePalSensorApiClose,
+      .getSensors = chrePalSensorApiGetSensors,
+      .configureSensor = chrePalSensorApiConfigureSensor,
+      .flush = chrePalSensorApiFlush,
+      .configureBiasEvents = chrePalSensorApiConfigureBiasEvents,
+      .getThreeAxisBias = chrePalSensorApiGetThreeAxisBias,
+      .releaseSensorDataEvent = chrePalSensorApiReleaseSensorDataEvent,
+      .releaseSamplingStatusEvent = chrePalSensorApiReleaseSamplingStatusEvent,
+      .releaseBiasEvent = chrePalSensorApiReleaseBiasEvent,
+  };
+
+  if (!CHRE_PAL_VERSIONS_ARE_COMPATIBLE(kApi.moduleVersion,
+                                        requestedApiVersion)) {
+    return nullptr;
+  } else {
+    return &kApi;
+  }
+}
@@ -16,12 +16,21 @@
 
 #include "chre/platform/system_timer.h"
 
+#include "chre/platform/fatal_error.h"
 #include "chre/platform/log.h"
 #include "chre/util/time.h"
 
 #include <errno.h>
-#include <signal.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace chre {
 
@@ -36,8 +45,178 @@ void NanosecondsToTimespec(uint64_t ns, struct timespec *ts) {
 
 }  // anonymous namespace
 
-void SystemTimerBase::systemTimerNotifyCallback(union sigval cookie) {
-  SystemTimer *sysTimer = static_cast<SystemTimer *>(cookie.sival_ptr);
+/**
+ * Waits on the timerfds of all SystemTimers with a single epoll instance, and
+ * invokes their callbacks from one thread. This avoids the thread creation
+ * that a POSIX timer with SIGEV_THREAD notification incurs on every expiry.
+ *
+ * Callbacks are invoked without holding the dispatcher mutex, so they may
+ * initialize, set, cancel or destroy SystemTimers, including their own.
+ * Destroying a timer from another thread waits for its running callback to
+ * return.
+ */
+class SystemTimerDispatcher : public NonCopyable {
+ public:
+  /**
+   * @return The dispatcher shared by all SystemTimers, which is started on
+   *         first use. It is never destroyed, so SystemTimers with static
+   *         storage duration can be safely destroyed at exit.
+   */
+  static SystemTimerDispatcher &getInstance() {
+    static SystemTimerDispatcher *sInstance = new SystemTimerDispatcher();
+    return *sInstance;
+  }
+
+  /**
+   * Starts monitoring the timerfd of the given timer.
+   *
+   * @return true on success.
+   */
+  bool add(SystemTimerBase *timer) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = timer;
+
+    bool success = false;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, timer->mTimerFd, &event) != 0) {
+      LOGE("Couldn't add timer to epoll: %s", strerror(errno));
+    } else {
+      mTimers.push_back(timer);
+      success = true;
+    }
+
+    return success;
+  }
+
+  /**
+   * Drops the expiration of the given timer that is waiting for its callback
+   * to be invoked, if any. Must be called after re-arming or disarming its
+   * timerfd, so that an expiration dispatched in the same pass as the callback
+   * that cancels the timer is not invoked.
+   */
+  void discardExpiration(SystemTimerBase *timer) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mExpiredTimers.erase(
+        std::remove(mExpiredTimers.begin(), mExpiredTimers.end(), timer),
+        mExpiredTimers.end());
+  }
+
+  /**
+   * Stops monitoring the timerfd of the given timer. Once this returns, the
+   * callback of the timer will not be invoked again, and is not running unless
+   * this was called from that callback.
+   */
+  void remove(SystemTimerBase *timer) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_DEL, timer->mTimerFd, nullptr) != 0) {
+      LOGE("Couldn't remove timer from epoll: %s", strerror(errno));
+    }
+    mTimers.erase(std::remove(mTimers.begin(), mTimers.end(), timer),
+                  mTimers.end());
+    mExpiredTimers.erase(
+        std::remove(mExpiredTimers.begin(), mExpiredTimers.end(), timer),
+        mExpiredTimers.end());
+
+    // A callback may destroy its own timer, and must not wait for itself.
+    if (std::this_thread::get_id() != mThreadId) {
+      mCallbackDone.wait(lock,
+                         [this, timer] { return (mRunningTimer != timer); });
+    }
+  }
+
+ private:
+  //! The maximum number of expired timers handled per wakeup.
+  static constexpr int kMaxEvents = 8;
+
+  int mEpollFd;
+
+  //! The timers currently registered. Events are only dispatched to timers in
+  //! this list, as an event returned by epoll_wait() may belong to a timer
+  //! that was removed before the mutex was acquired.
+  std::vector<SystemTimerBase *> mTimers;
+
+  //! Timers that expired and whose callbacks are waiting to be invoked.
+  std::vector<SystemTimerBase *> mExpiredTimers;
+
+  //! The timer whose callback is being invoked, if any.
+  SystemTimerBase *mRunningTimer = nullptr;
+
+  //! Signaled when a callback returns.
+  std::condition_variable mCallbackDone;
+
+  //! Guards the fields above.
+  std::mutex mMutex;
+
+  //! The ID of the thread that invokes the callbacks.
+  std::thread::id mThreadId;
+
+  SystemTimerDispatcher() {
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0) {
+      FATAL_ERROR("Couldn't create timer dispatcher: %s", strerror(errno));
+    }
+
+    std::thread thread(&SystemTimerDispatcher::run, this);
+    mThreadId = thread.get_id();
+    thread.detach();
+  }
+
+  /**
+   * Reads the expiration count of a timerfd, which also clears its readiness.
+   *
+   * @return true if the timer expired since it was last set or read. This is
+   *         false if it was cancelled or re-armed after epoll_wait() reported
+   *         it, in which case its callback must not be invoked.
+   */
+  static bool consumeExpiration(int timerFd) {
+    uint64_t expirations = 0;
+    ssize_t ret = read(timerFd, &expirations, sizeof(expirations));
+    return (ret == sizeof(expirations) && expirations > 0);
+  }
+
+  void run() {
+    struct epoll_event events[kMaxEvents];
+
+    while (true) {
+      int count = epoll_wait(mEpollFd, events, kMaxEvents, -1 /* timeout */);
+      if (count < 0) {
+        if (errno != EINTR) {
+          LOGE("Timer dispatcher epoll_wait failed: %s", strerror(errno));
+        }
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mMutex);
+      for (int i = 0; i < count; i++) {
+        auto *timer = static_cast<SystemTimerBase *>(events[i].data.ptr);
+        if (std::find(mTimers.begin(), mTimers.end(), timer) != mTimers.end() &&
+            consumeExpiration(timer->mTimerFd)) {
+          mExpiredTimers.push_back(timer);
+        }
+      }
+
+      // The mutex is released while each callback runs. remove() and
+      // discardExpiration() drop the timer from mExpiredTimers, so a timer
+      // that was removed, cancelled or re-armed meanwhile is not invoked.
+      while (!mExpiredTimers.empty()) {
+        SystemTimerBase *timer = mExpiredTimers.front();
+        mExpiredTimers.erase(mExpiredTimers.begin());
+        mRunningTimer = timer;
+
+        lock.unlock();
+        SystemTimerBase::systemTimerNotifyCallback(timer);
+        lock.lock();
+
+        mRunningTimer = nullptr;
+        mCallbackDone.notify_all();
+      }
+    }
+  }
+};
+
+void SystemTimerBase::systemTimerNotifyCallback(SystemTimerBase *timer) {
+  SystemTimer *sysTimer = static_cast<SystemTimer *>(timer);
   sysTimer->mCallback(sysTimer->mData);
 }
 
@@ -45,8 +224,8 @@ SystemTimer::SystemTimer() {}
 
 SystemTimer::~SystemTimer() {
   if (mInitialized) {
-    int ret = timer_delete(mTimerId);
-    if (ret != 0) {
+    SystemTimerDispatcher::getInstance().remove(this);
+    if (close(mTimerFd) != 0) {
       LOGE("Couldn't delete timer: %s", strerror(errno));
     }
     mInitialized = false;
@@ -57,15 +236,12 @@ bool SystemTimer::init() {
   if (mInitialized) {
     LOGW("Tried re-initializing timer");
   } else {
-    struct sigevent sigevt = {};
-    sigevt.sigev_notify = SIGEV_THREAD;
-    sigevt.sigev_value.sival_ptr = this;
-    sigevt.sigev_notify_function = systemTimerNotifyCallback;
-    sigevt.sigev_notify_attributes = nullptr;
-
-    int ret = timer_create(CLOCK_MONOTONIC, &sigevt, &mTimerId);
-    if (ret != 0) {
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (mTimerFd < 0) {
       LOGE("Couldn't create timer: %s", strerror(errno));
+    } else if (!SystemTimerDispatcher::getInstance().add(this)) {
+      close(mTimerFd);
+      mTimerFd = -1;
     } else {
       mInitialized = true;
     }
@@ -76,7 +252,7 @@ bool SystemTimer::init() {
 
 bool SystemTimer::set(SystemTimerCallback *callback, void *data,
                       Nanoseconds delay) {
-  // 0 has a special meaning in POSIX, i.e. cancel the timer. In our API, a
+  // 0 has a special meaning for timerfd, i.e. cancel the timer. In our API, a
   // value of 0 just means fire right away.
   if (delay.toRawNanoseconds() == 0) {
     delay = Nanoseconds(1);
@@ -104,7 +280,7 @@ bool SystemTimer::isActive() {
   bool isActive = false;
   if (mInitialized) {
     struct itimerspec spec = {};
-    int ret = timer_gettime(mTimerId, &spec);
+    int ret = timerfd_gettime(mTimerFd, &spec);
     if (ret != 0) {
       LOGE("Couldn't obtain current timer configuration: %s", strerror(errno));
     }
@@ -123,10 +299,14 @@ bool SystemTimerBase::setInternal(uint64_t delayNs) {
   NanosecondsToTimespec(delayNs, &spec.it_value);
   NanosecondsToTimespec(0, &spec.it_interval);
 
-  int ret = timer_settime(mTimerId, kFlags, &spec, nullptr);
+  // Setting a timerfd also clears any expiration that the dispatcher has not
+  // consumed yet, and the one it has consumed but not dispatched is dropped, so
+  // a stale expiry never invokes the callback.
+  int ret = timerfd_settime(mTimerFd, kFlags, &spec, nullptr);
   if (ret != 0) {
     LOGE("Couldn't set timer: %s", strerror(errno));
   } else {
+    SystemTimerDispatcher::getInstance().discardExpiration(this);
     success = true;
   }
 
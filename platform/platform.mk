@@ -180,6 +180,7 @@ SLPI_QSH_SRCS += platform/slpi/see/power_control_manager.cc
 SLPI_QSH_SRCS += platform/slpi/qsh/qsh_shim.cc
 
 ifeq ($(CHRE_USE_BUFFERED_LOGGING), true)
+SLPI_QSH_SRCS += platform/shared/lock_free_log_buffer.cc
 SLPI_QSH_SRCS += platform/shared/log_buffer.cc
 SLPI_QSH_SRCS += platform/shared/log_buffer_manager.cc
 SLPI_QSH_SRCS += platform/slpi/log_buffer_manager.cc
@@ -190,12 +191,16 @@ endif
 
 SIM_CFLAGS += -Iplatform/shared/include
 
+# The host link encodes messages with FlatBuffers.
+SIM_CFLAGS += -I$(FLATBUFFERS_PATH)/include
+
 # Simulator-specific Source Files ##############################################
 
 SIM_SRCS += platform/linux/chre_api_re.cc
 SIM_SRCS += platform/linux/context.cc
 SIM_SRCS += platform/linux/fatal_error.cc
 SIM_SRCS += platform/linux/host_link.cc
+SIM_SRCS += platform/linux/log_buffer_manager.cc
 SIM_SRCS += platform/linux/memory.cc
 SIM_SRCS += platform/linux/memory_manager.cc
 SIM_SRCS += platform/linux/platform_debug_dump_manager.cc
@@ -217,14 +222,24 @@ SIM_SRCS += platform/shared/chre_api_user_settings.cc
 SIM_SRCS += platform/shared/chre_api_version.cc
 SIM_SRCS += platform/shared/chre_api_wifi.cc
 SIM_SRCS += platform/shared/chre_api_wwan.cc
+SIM_SRCS += platform/shared/host_protocol_common.cc
+SIM_SRCS += platform/shared/lock_free_log_buffer.cc
+SIM_SRCS += platform/shared/log_buffer.cc
+SIM_SRCS += platform/shared/log_buffer_manager.cc
 SIM_SRCS += platform/shared/memory_manager.cc
 SIM_SRCS += platform/shared/nanoapp/nanoapp_dso_util.cc
-SIM_SRCS += platform/shared/pal_sensor_stub.cc
 SIM_SRCS += platform/shared/pal_system_api.cc
 SIM_SRCS += platform/shared/platform_sensor_manager.cc
 SIM_SRCS += platform/shared/system_time.cc
 SIM_SRCS += platform/shared/version.cc
 
+# Optional sensors support.
+ifeq ($(CHRE_SENSORS_SUPPORT_ENABLED), true)
+SIM_SRCS += platform/linux/pal_sensor.cc
+else
+SIM_SRCS += platform/shared/pal_sensor_stub.cc
+endif
+
 # Optional GNSS support.
 ifeq ($(CHRE_GNSS_SUPPORT_ENABLED), true)
 SIM_SRCS += platform/linux/pal_gnss.cc
@@ -274,9 +289,6 @@ GOOGLE_ARM64_ANDROID_CFLAGS += -Ihost/common/include
 # Also add the linux sources to fall back to the default Linux implementation.
 GOOGLE_ARM64_ANDROID_CFLAGS += -Iplatform/linux/include
 
-# We use FlatBuffers in the Android simulator
-GOOGLE_ARM64_ANDROID_CFLAGS += -I$(FLATBUFFERS_PATH)/include
-
 # Android-specific Source Files ################################################
 
 ANDROID_CUTILS_TOP = $(ANDROID_BUILD_TOP)/system/core/libcutils
@@ -290,7 +302,6 @@ GOOGLE_ARM64_ANDROID_SRCS += $(ANDROID_LOG_TOP)/logd_reader.c
 
 GOOGLE_ARM64_ANDROID_SRCS += platform/android/init.cc
 GOOGLE_ARM64_ANDROID_SRCS += platform/android/host_link.cc
-GOOGLE_ARM64_ANDROID_SRCS += platform/shared/host_protocol_common.cc
 GOOGLE_ARM64_ANDROID_SRCS += host/common/host_protocol_host.cc
 GOOGLE_ARM64_ANDROID_SRCS += host/common/socket_server.cc
 
@@ -313,4 +324,6 @@ GOOGLETEST_COMMON_SRCS += platform/linux/assert.cc
 GOOGLETEST_COMMON_SRCS += platform/linux/audio_source.cc
 GOOGLETEST_COMMON_SRCS += platform/linux/platform_audio.cc
 GOOGLETEST_COMMON_SRCS += platform/tests/log_buffer_test.cc
-GOOGLETEST_COMMON_SRCS += platform/shared/log_buffer.cc
+GOOGLETEST_COMMON_SRCS += platform/tests/nanoapp_loader_symbols_test.cc
+GOOGLETEST_COMMON_SRCS += platform/tests/system_timer_test.cc
+GOOGLETEST_COMMON_SRCS += platform/shared/nanoapp_loader_symbols.cc
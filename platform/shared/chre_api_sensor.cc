@@ -147,3 +147,37 @@ DLL_EXPORT bool chreSensorFlushAsync(uint32_t sensorHandle,
   return false;
 #endif  // CHRE_SENSORS_SUPPORT_ENABLED
 }
+
+DLL_EXPORT bool chreSensorConfigureHistory(uint32_t sensorHandle,
+                                           uint64_t duration) {
+#if defined(CHRE_SENSORS_SUPPORT_ENABLED) && \
+    defined(CHRE_SENSOR_HISTORY_ENABLED)
+  chre::Nanoapp *nanoapp = EventLoopManager::validateChreApiCall(__func__);
+  return EventLoopManagerSingleton::get()
+      ->getSensorRequestManager()
+      .configureHistory(nanoapp, sensorHandle, Nanoseconds(duration));
+#else
+  UNUSED_VAR(sensorHandle);
+  UNUSED_VAR(duration);
+  return false;
+#endif  // CHRE_SENSORS_SUPPORT_ENABLED && CHRE_SENSOR_HISTORY_ENABLED
+}
+
+DLL_EXPORT bool chreSensorGetHistory(uint32_t sensorHandle, uint64_t startTime,
+                                     uint64_t endTime,
+                                     struct chreSensorHistory *history) {
+#if defined(CHRE_SENSORS_SUPPORT_ENABLED) && \
+    defined(CHRE_SENSOR_HISTORY_ENABLED)
+  EventLoopManager::validateChreApiCall(__func__);
+  return EventLoopManagerSingleton::get()
+      ->getSensorRequestManager()
+      .getHistory(sensorHandle, Nanoseconds(startTime), Nanoseconds(endTime),
+                  history);
+#else
+  UNUSED_VAR(sensorHandle);
+  UNUSED_VAR(startTime);
+  UNUSED_VAR(endTime);
+  UNUSED_VAR(history);
+  return false;
+#endif  // CHRE_SENSORS_SUPPORT_ENABLED && CHRE_SENSOR_HISTORY_ENABLED
+}
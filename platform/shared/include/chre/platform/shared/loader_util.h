@@ -129,6 +129,9 @@ struct ExportedData {
 #define DT_TEXTREL 22
 #define DT_JMPREL 23
 #define DT_ENCODING 32
+#define DT_GNU_HASH 0x6ffffef5
+#define SHN_UNDEF 0
+#define STN_UNDEF 0
 
 typedef __signed__ char __s8;
 typedef unsigned char __u8;
@@ -136,8 +139,8 @@ typedef __signed__ short __s16;
 typedef unsigned short __u16;
 typedef __signed__ int __s32;
 typedef unsigned int __u32;
-typedef __signed__ long __s64;
-typedef unsigned long __u64;
+typedef __signed__ long long __s64;
+typedef unsigned long long __u64;
 
 typedef __u32 Elf32_Addr;
 typedef __u16 Elf32_Half;
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_PLATFORM_SHARED_LOCK_FREE_LOG_BUFFER_H_
+#define CHRE_PLATFORM_SHARED_LOCK_FREE_LOG_BUFFER_H_
+
+#include <cinttypes>
+#include <cstdarg>
+#include <cstddef>
+
+#include "chre/platform/atomic.h"
+#include "chre/platform/shared/log_buffer.h"
+#include "chre/util/non_copyable.h"
+
+namespace chre {
+
+/**
+ * A variant of LogBuffer that logging threads write to without taking a lock.
+ * Entries use the same format as LogBuffer, so the data copied out of it can
+ * be sent to the host unchanged.
+ *
+ * Each log is formatted on the stack, then a producer claims one of a few
+ * pending log slots, reserves space for the log by advancing a reserve index
+ * with a compare-and-swap, copies the whole entry into the ring with at most
+ * two memcpy calls, and commits it by releasing its slot. Logs are never
+ * evicted by producers: if the buffer is full or every slot is in use, the new
+ * log is dropped and counted instead of the oldest one.
+ *
+ * The logs before the oldest pending one are committed, so they can be copied
+ * out while other logs are still being written. Copying out is not
+ * thread-safe: copyLogs() and transferTo() must not be called concurrently
+ * with each other, which LogBufferManager ensures with its flush mutex.
+ */
+class LockFreeLogBuffer : public NonCopyable {
+ public:
+  /**
+   * @param callback The callback object that will receive notifications about
+   *                 the state of the log buffer or nullptr if it is not needed.
+   * @param buffer The buffer location that will store log data.
+   * @param bufferSize The number of bytes in the buffer. This value must be >
+   *                   LogBuffer's minimum size.
+   */
+  LockFreeLogBuffer(LogBufferCallbackInterface *callback, void *buffer,
+                    size_t bufferSize);
+
+  /**
+   * Buffers this log and possibly calls the on logs ready callback. Thread-safe
+   * and lock-free. If the buffer is full, the log is dropped.
+   *
+   * @see LogBuffer::handleLog
+   */
+  void handleLog(LogBufferLogLevel logLevel, uint32_t timestampMs,
+                 const char *logFormat, ...);
+
+  /**
+   * Same as handleLog but with a va_list argument instead of a ... parameter.
+   */
+  void handleLogVa(LogBufferLogLevel logLevel, uint32_t timestampMs,
+                   const char *logFormat, va_list args);
+
+  /**
+   * Copies out as many whole committed logs as fit into the destination
+   * buffer, oldest first, and frees the space they used. Stops at the oldest
+   * log that is still being written.
+   *
+   * @param destination Pointer to the destination memory address.
+   * @param size The max number of bytes to copy.
+   * @param numLogsDropped Non-null pointer which will be set to the number of
+   *        logs dropped since the last call to copyLogs() or transferTo().
+   *
+   * @return The number of bytes copied to destination.
+   */
+  size_t copyLogs(void *destination, size_t size, size_t *numLogsDropped);
+
+  /**
+   * @param logSize The size of the log text in bytes.
+   * @return true if a log of this size would currently be dropped.
+   */
+  bool logWouldCauseOverflow(size_t logSize);
+
+  /**
+   * Moves the logs in this buffer into the given LogBuffer, which is reset
+   * first, along with the number of logs dropped.
+   *
+   * @see LogBuffer::transferTo
+   */
+  void transferTo(LogBuffer &otherBuffer);
+
+  /**
+   * @see LogBuffer::updateNotificationSetting
+   */
+  void updateNotificationSetting(LogBufferNotificationSetting setting,
+                                 size_t thresholdBytes = 0);
+
+  /**
+   * @return The number of bytes of committed logs in the buffer. May be stale
+   *         by the time it returns if other threads are logging.
+   */
+  size_t getBufferSize();
+
+  /**
+   * @return The number of logs dropped since the last call to copyLogs() or
+   *         transferTo().
+   */
+  size_t getNumLogsDropped();
+
+ private:
+  //! The maximum number of logs being written at once. Further logs are
+  //! dropped until a slot is released.
+  static constexpr size_t kNumPendingLogSlots = 8;
+
+  //! The position of a slot that isn't in use, which indices never reach as
+  //! they wrap around below 2 * mCapacity.
+  static constexpr uint32_t kNoPendingLog = UINT32_MAX;
+
+  //! Holds the position of a log being written, from before its space is
+  //! reserved until it is committed.
+  struct PendingLogSlot {
+    AtomicUint32 position{kNoPendingLog};
+  };
+
+  /**
+   * @return The index size bytes after the given one.
+   */
+  uint32_t advanceIndex(uint32_t index, size_t size) const;
+
+  /**
+   * @return The number of bytes from fromIndex to toIndex.
+   */
+  uint32_t getDistance(uint32_t fromIndex, uint32_t toIndex) const;
+
+  /**
+   * Copies size bytes from source into the ring starting at the given
+   * position, wrapping around the end of the buffer if needed.
+   */
+  void copyToBuffer(uint32_t position, size_t size, const void *source);
+
+  /**
+   * Copies size bytes out of the ring starting at the given position, wrapping
+   * around the end of the buffer if needed.
+   */
+  void copyFromBuffer(uint32_t position, size_t size, void *destination) const;
+
+  /**
+   * @return A free pending log slot, now in use, or nullptr if none is free.
+   */
+  PendingLogSlot *claimPendingLogSlot();
+
+  /**
+   * @param readIndex The current read index.
+   * @param reserveIndex The reserve index, loaded after readIndex.
+   * @return The position of the oldest log being written, or reserveIndex if
+   *         every reserved log is committed.
+   */
+  uint32_t getCommitIndex(uint32_t readIndex, uint32_t reserveIndex) const;
+
+  /**
+   * @param position The start of a committed log entry.
+   * @param maxSize The number of committed bytes from position on.
+   * @return The size of the log entry that starts at the given position,
+   *         including its header and null terminator, or more than maxSize if
+   *         it doesn't end within maxSize bytes.
+   */
+  size_t getLogSize(uint32_t position, size_t maxSize) const;
+
+  uint8_t *const mBufferData;
+
+  //! The number of bytes in mBufferData.
+  const uint32_t mCapacity;
+
+  //! Byte indices that wrap around at twice the capacity, so that a full
+  //! buffer can be told apart from an empty one. mReserveIndex is advanced by
+  //! producers as they claim space, and mReadIndex by the consumer as it frees
+  //! it.
+  AtomicUint32 mReserveIndex;
+  AtomicUint32 mReadIndex;
+
+  PendingLogSlot mPendingLogSlots[kNumPendingLogSlots];
+
+  AtomicUint32 mNumLogsDropped;
+
+  LogBufferCallbackInterface *mCallback;
+
+  //! Written by updateNotificationSetting() and read by producers, in the
+  //! same way as LogBuffer which reads them outside of its lock.
+  LogBufferNotificationSetting mNotificationSetting =
+      LogBufferNotificationSetting::ALWAYS;
+  size_t mNotificationThresholdBytes = 0;
+};
+
+}  // namespace chre
+
+#endif  // CHRE_PLATFORM_SHARED_LOCK_FREE_LOG_BUFFER_H_
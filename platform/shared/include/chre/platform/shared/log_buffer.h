@@ -196,6 +196,10 @@ class LogBuffer {
   size_t getNumLogsDropped();
 
  private:
+  //! Shares the entry format constants and transfers its logs into a
+  //! LogBuffer.
+  friend class LockFreeLogBuffer;
+
   /**
    * Increment the value and take the modulus of the max size of the buffer.
    *
@@ -18,8 +18,10 @@
 #define CHRE_PLATFORM_LOG_BUFFER_MANAGER_BUFFER_H_
 
 #include "chre/platform/assert.h"
+#include "chre/platform/atomic.h"
 #include "chre/platform/condition_variable.h"
 #include "chre/platform/mutex.h"
+#include "chre/platform/shared/lock_free_log_buffer.h"
 #include "chre/platform/shared/log_buffer.h"
 #include "chre/util/singleton.h"
 #include "chre_api/chre/re.h"
@@ -92,11 +94,17 @@ class LogBufferManager : public LogBufferCallbackInterface {
 
   /**
    * Loop that waits on the conditions for sending logs to host to be met and
-   * sends the logs to the host if so. This method never exits. Should be called
-   * by a platform thread.
+   * sends the logs to the host if so. This method only exits once
+   * stopSendLogsToHostLoop() is called. Should be called by a platform thread.
    */
   void startSendLogsToHostLoop();
 
+  /**
+   * Makes startSendLogsToHostLoop() return, without waiting for logs that are
+   * still buffered to be sent to the host.
+   */
+  void stopSendLogsToHostLoop();
+
  private:
   /*
    * @return The LogBuffer log level for the given CHRE log level.
@@ -119,7 +127,15 @@ class LogBufferManager : public LogBufferCallbackInterface {
    */
   void onLogsSentToHostLocked(bool success);
 
-  LogBuffer mPrimaryLogBuffer;
+#ifdef CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+  //! Logging threads don't contend with each other or with the flush path
+  //! for the primary buffer. It drops new logs rather than old ones when full.
+  typedef LockFreeLogBuffer PrimaryLogBuffer;
+#else
+  typedef LogBuffer PrimaryLogBuffer;
+#endif  // CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+
+  PrimaryLogBuffer mPrimaryLogBuffer;
   LogBuffer mSecondaryLogBuffer;
 
   size_t mNumLogsDroppedTotal = 0;
@@ -127,7 +143,15 @@ class LogBufferManager : public LogBufferCallbackInterface {
   ConditionVariable mSendLogsToHostCondition;
   bool mLogFlushToHostPending = false;
   bool mLogsBecameReadyWhileFlushPending = false;
+  bool mStopSendLogsToHostLoop = false;
   Mutex mFlushLogsMutex;
+
+#ifdef CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+  //! Set by onLogsReady() and cleared by the send logs to host loop when it
+  //! starts a flush, so that logging never takes mFlushLogsMutex, which the
+  //! loop holds while it moves logs out of the primary buffer.
+  AtomicBool mLogsReady{false};
+#endif  // CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
 };
 
 //! Provides an alias to the LogBufferManager singleton.
@@ -72,7 +72,8 @@ class NanoappLoader {
 
   /**
    * Method for pointer lookup by symbol name. Only function pointers
-   * are currently supported.
+   * are currently supported. The ELF hash table is used when the binary has
+   * one, otherwise the symbol table is searched.
    *
    * @return function pointer on successful lookup, nullptr otherwise
    */
@@ -134,6 +135,19 @@ class NanoappLoader {
   size_t mNumSectionHeaders = 0;
   //! Size of the data pointed to by mSymbolTablePtr.
   size_t mSymbolTableSize = 0;
+  //! Section header of the dynamic symbol table, in mSectionHeadersPtr.
+  SectionHeader *mDynamicSymbolTableHeader = nullptr;
+  //! Section header of the dynamic symbol names, in mSectionHeadersPtr.
+  SectionHeader *mDynamicStringTableHeader = nullptr;
+
+  //! The dynamic symbol table in the mapped binary.
+  const ElfSym *mMappedDynamicSymbolTable = nullptr;
+  //! The dynamic symbol names in the mapped binary.
+  const char *mMappedDynamicStringTable = nullptr;
+  //! The DT_GNU_HASH table in the mapped binary, nullptr if there is none.
+  const ElfWord *mGnuHashTable = nullptr;
+  //! The DT_HASH table in the mapped binary, nullptr if there is none.
+  const ElfWord *mSysvHashTable = nullptr;
 
   //! The ELF that is being mapped into the system. This pointer will be invalid
   //! after open returns.
@@ -274,6 +288,21 @@ class NanoappLoader {
    */
   void *resolveData(size_t posInSymbolTable);
 
+  /**
+   * Locates the dynamic symbol table and the symbol hash tables in the mapped
+   * binary, so that symbols can be looked up after the ELF binary is released.
+   */
+  void initSymbolHashTables();
+
+  /**
+   * Looks up a defined symbol in the dynamic symbol table through the
+   * DT_GNU_HASH or DT_HASH table of the mapped binary.
+   *
+   * @param name The name of the symbol to be found.
+   * @return The symbol. nullptr if not found or the binary has no hash table.
+   */
+  const ElfSym *findDynamicSymbol(const char *name);
+
   /**
    * @return The address for the dynamic segment. nullptr if not found.
    */
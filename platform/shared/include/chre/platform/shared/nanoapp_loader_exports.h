@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_PLATFORM_SHARED_NANOAPP_LOADER_EXPORTS_H_
+#define CHRE_PLATFORM_SHARED_NANOAPP_LOADER_EXPORTS_H_
+
+/**
+ * The symbols that the nanoapp loader exports to nanoapps, which are expanded
+ * by SYMBOL(function, "name") for a function exported under another name, and
+ * by C_SYMBOL(function) for a function exported under its own name.
+ *
+ * The list is kept separate from the loader so that its order can be tested on
+ * the host. It must be sorted by symbol name in strcmp() order, as symbols are
+ * looked up with a binary search.
+ */
+// TODO(karthikmb/stange): While this list was hand-coded for simple
+// "hello-world" prototyping, the list of exported symbols must be
+// generated to minimize runtime errors and build breaks.
+// clang-format off
+#define CHRE_NANOAPP_LOADER_EXPORTS(SYMBOL, C_SYMBOL) \
+  SYMBOL(deleteOverride, "_ZdlPv")                    \
+  C_SYMBOL(__cxa_pure_virtual)                        \
+  C_SYMBOL(acosf)                                     \
+  C_SYMBOL(ashLoadCalibrationParams)                  \
+  C_SYMBOL(ashLoadMultiCalibrationParams)             \
+  C_SYMBOL(ashProfileBegin)                           \
+  C_SYMBOL(ashProfileEnd)                             \
+  C_SYMBOL(ashProfileInit)                            \
+  C_SYMBOL(ashSaveCalibrationParams)                  \
+  C_SYMBOL(ashSaveMultiCalibrationParams)             \
+  C_SYMBOL(ashSetCalibration)                         \
+  C_SYMBOL(ashSetMultiCalibration)                    \
+  SYMBOL(asinOverride, "asin")                        \
+  C_SYMBOL(asinf)                                     \
+  SYMBOL(atan2Override, "atan2")                      \
+  C_SYMBOL(atan2f)                                    \
+  SYMBOL(atexitOverride, "atexit")                    \
+  C_SYMBOL(ceilf)                                     \
+  C_SYMBOL(chreAbort)                                 \
+  C_SYMBOL(chreAudioConfigureSource)                  \
+  C_SYMBOL(chreAudioGetSource)                        \
+  C_SYMBOL(chreConfigureDebugDumpEvent)               \
+  C_SYMBOL(chreConfigureHostSleepStateEvents)         \
+  C_SYMBOL(chreConfigureNanoappInfoEvents)            \
+  C_SYMBOL(chreDebugDumpLog)                          \
+  C_SYMBOL(chreGetApiVersion)                         \
+  C_SYMBOL(chreGetAppId)                              \
+  C_SYMBOL(chreGetEstimatedHostTimeOffset)            \
+  C_SYMBOL(chreGetInstanceId)                         \
+  C_SYMBOL(chreGetNanoappInfoByAppId)                 \
+  C_SYMBOL(chreGetNanoappInfoByInstanceId)            \
+  C_SYMBOL(chreGetPlatformId)                         \
+  C_SYMBOL(chreGetSensorInfo)                         \
+  C_SYMBOL(chreGetSensorSamplingStatus)               \
+  C_SYMBOL(chreGetTime)                               \
+  C_SYMBOL(chreGetVersion)                            \
+  C_SYMBOL(chreGnssConfigurePassiveLocationListener)  \
+  C_SYMBOL(chreGnssGetCapabilities)                   \
+  C_SYMBOL(chreGnssLocationSessionStartAsync)         \
+  C_SYMBOL(chreGnssLocationSessionStopAsync)          \
+  C_SYMBOL(chreGnssMeasurementSessionStartAsync)      \
+  C_SYMBOL(chreGnssMeasurementSessionStopAsync)       \
+  C_SYMBOL(chreHeapAlloc)                             \
+  C_SYMBOL(chreHeapFree)                              \
+  C_SYMBOL(chreIsHostAwake)                           \
+  C_SYMBOL(chreLog)                                   \
+  C_SYMBOL(chreSendEvent)                             \
+  C_SYMBOL(chreSendMessageToHost)                     \
+  C_SYMBOL(chreSendMessageToHostEndpoint)             \
+  C_SYMBOL(chreSendMessageWithPermissions)            \
+  C_SYMBOL(chreSensorConfigure)                       \
+  C_SYMBOL(chreSensorConfigureBiasEvents)             \
+  C_SYMBOL(chreSensorConfigureHistory)                \
+  C_SYMBOL(chreSensorFind)                            \
+  C_SYMBOL(chreSensorFindDefault)                     \
+  C_SYMBOL(chreSensorFlushAsync)                      \
+  C_SYMBOL(chreSensorGetHistory)                      \
+  C_SYMBOL(chreSensorGetThreeAxisBias)                \
+  C_SYMBOL(chreTimerCancel)                           \
+  C_SYMBOL(chreTimerSet)                              \
+  C_SYMBOL(chreUserSettingConfigureEvents)            \
+  C_SYMBOL(chreUserSettingGetState)                   \
+  C_SYMBOL(chreWifiConfigureScanMonitorAsync)         \
+  C_SYMBOL(chreWifiGetCapabilities)                   \
+  C_SYMBOL(chreWifiRequestRangingAsync)               \
+  C_SYMBOL(chreWifiRequestScanAsync)                  \
+  C_SYMBOL(chreWwanGetCapabilities)                   \
+  C_SYMBOL(chreWwanGetCellInfoAsync)                  \
+  SYMBOL(cosOverride, "cos")                          \
+  C_SYMBOL(cosf)                                      \
+  C_SYMBOL(dlsym)                                     \
+  C_SYMBOL(expf)                                      \
+  SYMBOL(floorOverride, "floor")                      \
+  C_SYMBOL(floorf)                                    \
+  SYMBOL(fmaxOverride, "fmax")                        \
+  C_SYMBOL(fmaxf)                                     \
+  SYMBOL(fminOverride, "fmin")                        \
+  C_SYMBOL(fminf)                                     \
+  C_SYMBOL(fmodf)                                     \
+  SYMBOL(frexpOverride, "frexp")                      \
+  C_SYMBOL(log10f)                                    \
+  C_SYMBOL(log1pf)                                    \
+  C_SYMBOL(logf)                                      \
+  C_SYMBOL(lroundf)                                   \
+  C_SYMBOL(memcmp)                                    \
+  C_SYMBOL(memcpy)                                    \
+  C_SYMBOL(memmove)                                   \
+  C_SYMBOL(memset)                                    \
+  C_SYMBOL(platform_chreDebugDumpVaLog)               \
+  SYMBOL(roundOverride, "round")                      \
+  C_SYMBOL(roundf)                                    \
+  SYMBOL(sinOverride, "sin")                          \
+  C_SYMBOL(sinf)                                      \
+  C_SYMBOL(snprintf)                                  \
+  SYMBOL(sqrtOverride, "sqrt")                        \
+  C_SYMBOL(sqrtf)                                     \
+  C_SYMBOL(strcmp)                                    \
+  C_SYMBOL(strlen)                                    \
+  C_SYMBOL(strncmp)                                   \
+  C_SYMBOL(tanhf)                                     \
+  C_SYMBOL(tolower)
+// clang-format on
+
+#endif  // CHRE_PLATFORM_SHARED_NANOAPP_LOADER_EXPORTS_H_
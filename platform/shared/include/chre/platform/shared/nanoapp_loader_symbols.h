@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_PLATFORM_SHARED_NANOAPP_LOADER_SYMBOLS_H_
+#define CHRE_PLATFORM_SHARED_NANOAPP_LOADER_SYMBOLS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chre/platform/shared/loader_util.h"
+
+/**
+ * @file
+ * Symbol lookups of the nanoapp loader, which don't depend on the platform so
+ * that they can be tested on the host. Nanoapp binaries are 32-bit ELF files.
+ */
+
+namespace chre {
+
+/**
+ * @return The hash of a symbol name used by DT_GNU_HASH tables.
+ */
+uint32_t gnuHash(const char *name);
+
+/**
+ * @return The hash of a symbol name used by DT_HASH tables.
+ */
+uint32_t sysvHash(const char *name);
+
+/**
+ * Looks up a defined symbol through a DT_GNU_HASH table.
+ *
+ * @param hashTable The DT_GNU_HASH table.
+ * @param symbolTable The dynamic symbol table that hashTable indexes.
+ * @param stringTable The names of the symbols in symbolTable.
+ * @param name The name of the symbol to be found.
+ * @return The symbol. nullptr if not found.
+ */
+const Elf32_Sym *gnuHashLookup(const Elf32_Word *hashTable,
+                               const Elf32_Sym *symbolTable,
+                               const char *stringTable, const char *name);
+
+/**
+ * Looks up a defined symbol through a DT_HASH table.
+ *
+ * @param hashTable The DT_HASH table.
+ * @param symbolTable The dynamic symbol table that hashTable indexes.
+ * @param stringTable The names of the symbols in symbolTable.
+ * @param name The name of the symbol to be found.
+ * @return The symbol. nullptr if not found.
+ */
+const Elf32_Sym *sysvHashLookup(const Elf32_Word *hashTable,
+                                const Elf32_Sym *symbolTable,
+                                const char *stringTable, const char *name);
+
+/**
+ * @param exportedData The exported data.
+ * @param numExportedData The number of entries in exportedData.
+ * @return true if the entries are sorted by name in strcmp() order without
+ *     duplicates, as required by findExportedData().
+ */
+bool isExportedDataSorted(const ExportedData *exportedData,
+                          size_t numExportedData);
+
+/**
+ * Looks up exported data by name through a binary search.
+ *
+ * @param exportedData The exported data, sorted by name in strcmp() order.
+ * @param numExportedData The number of entries in exportedData.
+ * @param name The name of the data to be found.
+ * @return The entry of the data. nullptr if not found.
+ */
+const ExportedData *findExportedData(const ExportedData *exportedData,
+                                     size_t numExportedData, const char *name);
+
+}  // namespace chre
+
+#endif  // CHRE_PLATFORM_SHARED_NANOAPP_LOADER_SYMBOLS_H_
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/platform/shared/lock_free_log_buffer.h"
+#include "chre/platform/assert.h"
+#include "chre/util/lock_guard.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace chre {
+
+LockFreeLogBuffer::LockFreeLogBuffer(LogBufferCallbackInterface *callback,
+                                     void *buffer, size_t bufferSize)
+    : mBufferData(static_cast<uint8_t *>(buffer)),
+      mCapacity(static_cast<uint32_t>(bufferSize)),
+      mReserveIndex(0),
+      mReadIndex(0),
+      mNumLogsDropped(0),
+      mCallback(callback) {
+  CHRE_ASSERT(bufferSize >= LogBuffer::kBufferMinSize);
+  CHRE_ASSERT(bufferSize <= UINT32_MAX / 2);
+}
+
+void LockFreeLogBuffer::handleLog(LogBufferLogLevel logLevel,
+                                  uint32_t timestampMs, const char *logFormat,
+                                  ...) {
+  va_list args;
+  va_start(args, logFormat);
+  handleLogVa(logLevel, timestampMs, logFormat, args);
+  va_end(args);
+}
+
+void LockFreeLogBuffer::handleLogVa(LogBufferLogLevel logLevel,
+                                    uint32_t timestampMs,
+                                    const char *logFormat, va_list args) {
+  constexpr size_t kDataOffset = LogBuffer::kLogDataOffset;
+  constexpr size_t maxLogLen = LogBuffer::kLogMaxSize - kDataOffset;
+
+  // Format the whole entry up front so that it can be copied into the ring
+  // in one go once space is reserved.
+  uint8_t entry[LogBuffer::kLogMaxSize];
+  char *logData = reinterpret_cast<char *>(&entry[kDataOffset]);
+  int logLenSigned = vsnprintf(logData, maxLogLen, logFormat, args);
+  if (logLenSigned > 0) {
+    size_t logLen = static_cast<size_t>(logLenSigned);
+    if (logLen >= maxLogLen) {
+      // Leave space for the null terminator
+      logLen = maxLogLen - 1;
+    }
+    logData[logLen] = '\0';
+
+    // The final log level as parsed by the daemon requires that the log level
+    // be incremented.
+    entry[0] = static_cast<uint8_t>(logLevel) + 1;
+    memcpy(&entry[1], &timestampMs, sizeof(timestampMs));
+    uint32_t entrySize = static_cast<uint32_t>(kDataOffset + logLen + 1);
+
+    // A slot holds the position of the log until it is written, so that
+    // copyLogs() doesn't read past it. Its position is published before each
+    // attempt to reserve space, so that the reservation can't be seen without
+    // it. The read index is loaded after the reserve index, so it can only be
+    // ahead of it if another producer has since reserved space, in which case
+    // the compare-and-swap fails anyway.
+    PendingLogSlot *slot = claimPendingLogSlot();
+    uint32_t reserveIndex = 0;
+    bool reserved = false;
+    while (slot != nullptr) {
+      reserveIndex = mReserveIndex.load();
+      slot->position.store(reserveIndex);
+      uint32_t readIndex = mReadIndex.load();
+      if (getDistance(readIndex, reserveIndex) + entrySize > mCapacity) {
+        if (mReserveIndex.load() == reserveIndex) {
+          break;
+        }
+      } else if (mReserveIndex.compare_exchange(
+                     reserveIndex, advanceIndex(reserveIndex, entrySize))) {
+        reserved = true;
+        break;
+      }
+    }
+
+    if (reserved) {
+      copyToBuffer(reserveIndex, entrySize, entry);
+    }
+    if (slot != nullptr) {
+      slot->position.store(kNoPendingLog);
+    }
+
+    if (!reserved) {
+      mNumLogsDropped.fetch_increment();
+    } else {
+      if (mCallback != nullptr) {
+        switch (mNotificationSetting) {
+          case LogBufferNotificationSetting::ALWAYS: {
+            mCallback->onLogsReady();
+            break;
+          }
+          case LogBufferNotificationSetting::NEVER: {
+            break;
+          }
+          case LogBufferNotificationSetting::THRESHOLD: {
+            if (getBufferSize() > mNotificationThresholdBytes) {
+              mCallback->onLogsReady();
+            }
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+size_t LockFreeLogBuffer::copyLogs(void *destination, size_t size,
+                                   size_t *numLogsDropped) {
+  size_t copySize = 0;
+
+  if (size != 0 && destination != nullptr) {
+    uint32_t readIndex = mReadIndex.load();
+    uint32_t reserveIndex = mReserveIndex.load();
+    uint32_t commitIndex = getCommitIndex(readIndex, reserveIndex);
+    size_t available = getDistance(readIndex, commitIndex);
+    if (size >= available && commitIndex == reserveIndex) {
+      copySize = available;
+    } else {
+      // Logs are only counted up to the first one that isn't written yet, or
+      // up to the first one that doesn't fit.
+      while (copySize < available) {
+        size_t logSize = getLogSize(advanceIndex(readIndex, copySize),
+                                    available - copySize);
+        if (copySize + logSize > available || copySize + logSize > size) {
+          break;
+        }
+        copySize += logSize;
+      }
+    }
+
+    copyFromBuffer(readIndex, copySize, destination);
+    mReadIndex.store(advanceIndex(readIndex, copySize));
+  }
+
+  *numLogsDropped = mNumLogsDropped.exchange(0);
+
+  return copySize;
+}
+
+bool LockFreeLogBuffer::logWouldCauseOverflow(size_t logSize) {
+  uint32_t readIndex = mReadIndex.load();
+  uint32_t reserveIndex = mReserveIndex.load();
+  return (getDistance(readIndex, reserveIndex) + logSize +
+              LogBuffer::kLogDataOffset + 1 /* null terminator */ >
+          mCapacity);
+}
+
+void LockFreeLogBuffer::transferTo(LogBuffer &buffer) {
+  LockGuard<Mutex> lockGuardOther(buffer.mLock);
+  // The buffer being transferred to should be as big or bigger.
+  CHRE_ASSERT(buffer.mBufferMaxSize >= mCapacity);
+
+  buffer.resetLocked();
+
+  size_t numLogsDropped;
+  size_t bytesCopied =
+      copyLogs(buffer.mBufferData, buffer.mBufferMaxSize, &numLogsDropped);
+
+  buffer.mBufferDataTailIndex = bytesCopied % buffer.mBufferMaxSize;
+  buffer.mBufferDataSize = bytesCopied;
+  buffer.mNumLogsDropped = numLogsDropped;
+}
+
+void LockFreeLogBuffer::updateNotificationSetting(
+    LogBufferNotificationSetting setting, size_t thresholdBytes) {
+  mNotificationSetting = setting;
+  mNotificationThresholdBytes = thresholdBytes;
+}
+
+size_t LockFreeLogBuffer::getBufferSize() {
+  uint32_t readIndex = mReadIndex.load();
+  uint32_t reserveIndex = mReserveIndex.load();
+  return getDistance(readIndex, getCommitIndex(readIndex, reserveIndex));
+}
+
+size_t LockFreeLogBuffer::getNumLogsDropped() {
+  return mNumLogsDropped.load();
+}
+
+uint32_t LockFreeLogBuffer::advanceIndex(uint32_t index, size_t size) const {
+  uint32_t newIndex = index + static_cast<uint32_t>(size);
+  return (newIndex >= 2 * mCapacity) ? newIndex - 2 * mCapacity : newIndex;
+}
+
+uint32_t LockFreeLogBuffer::getDistance(uint32_t fromIndex,
+                                        uint32_t toIndex) const {
+  return (toIndex >= fromIndex) ? toIndex - fromIndex
+                                : toIndex + 2 * mCapacity - fromIndex;
+}
+
+void LockFreeLogBuffer::copyToBuffer(uint32_t position, size_t size,
+                                     const void *source) {
+  const uint8_t *sourceBytes = static_cast<const uint8_t *>(source);
+  size_t offset = (position >= mCapacity) ? position - mCapacity : position;
+  if (offset + size > mCapacity) {
+    size_t firstSize = mCapacity - offset;
+    memcpy(&mBufferData[offset], sourceBytes, firstSize);
+    memcpy(mBufferData, &sourceBytes[firstSize], size - firstSize);
+  } else {
+    memcpy(&mBufferData[offset], sourceBytes, size);
+  }
+}
+
+void LockFreeLogBuffer::copyFromBuffer(uint32_t position, size_t size,
+                                       void *destination) const {
+  uint8_t *destinationBytes = static_cast<uint8_t *>(destination);
+  size_t offset = (position >= mCapacity) ? position - mCapacity : position;
+  if (offset + size > mCapacity) {
+    size_t firstSize = mCapacity - offset;
+    memcpy(destinationBytes, &mBufferData[offset], firstSize);
+    memcpy(&destinationBytes[firstSize], mBufferData, size - firstSize);
+  } else {
+    memcpy(destinationBytes, &mBufferData[offset], size);
+  }
+}
+
+LockFreeLogBuffer::PendingLogSlot *LockFreeLogBuffer::claimPendingLogSlot() {
+  PendingLogSlot *claimedSlot = nullptr;
+  for (PendingLogSlot &slot : mPendingLogSlots) {
+    uint32_t expected = kNoPendingLog;
+    if (slot.position.compare_exchange(expected, mReserveIndex.load())) {
+      claimedSlot = &slot;
+      break;
+    }
+  }
+  return claimedSlot;
+}
+
+uint32_t LockFreeLogBuffer::getCommitIndex(uint32_t readIndex,
+                                           uint32_t reserveIndex) const {
+  // The reserve index must be loaded before the slots: a log reserved since
+  // then starts after it, and one reserved before then is either still in its
+  // slot or written. A position published before a failed reservation may be
+  // stale, which only stops logs from being copied early, and copyLogs() only
+  // copies whole logs before it anyway.
+  uint32_t commitIndex = reserveIndex;
+  for (const PendingLogSlot &slot : mPendingLogSlots) {
+    uint32_t position = slot.position.load();
+    if (position != kNoPendingLog &&
+        getDistance(readIndex, position) <
+            getDistance(readIndex, commitIndex)) {
+      commitIndex = position;
+    }
+  }
+  return commitIndex;
+}
+
+size_t LockFreeLogBuffer::getLogSize(uint32_t position,
+                                     size_t maxSize) const {
+  // Every written entry has a null terminator within kLogMaxSize bytes. The
+  // search stops at maxSize so that it doesn't read a log being written.
+  size_t offset = (position >= mCapacity) ? position - mCapacity : position;
+  size_t logSize = LogBuffer::kLogDataOffset;
+  while (logSize < LogBuffer::kLogMaxSize && logSize < maxSize &&
+         mBufferData[(offset + logSize) % mCapacity] != '\0') {
+    logSize++;
+  }
+  return logSize + 1;
+}
+
+}  // namespace chre
@@ -50,7 +50,7 @@ void LogBuffer::handleLogVa(LogBufferLogLevel logLevel, uint32_t timestampMs,
       // Leave space for nullptr to be copied on end
       logLen = maxLogLen - 1;
     }
-    size_t totalLogSize = kLogDataOffset + logLen;
+    size_t totalLogSize = kLogDataOffset + logLen + 1 /* nullptr */;
     {
       LockGuard<Mutex> lockGuard(mLock);
       // Invalidate memory allocated for log at head while the buffer is greater
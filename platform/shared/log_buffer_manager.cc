@@ -30,21 +30,43 @@ void chrePlatformLogToBuffer(chreLogLevel chreLogLevel, const char *format,
 }
 
 namespace chre {
+namespace {
+
+#ifdef CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+//! How often the send logs to host loop checks for ready logs while waiting.
+//! onLogsReady() notifies it without holding the flush mutex, so the
+//! notification is lost if it comes just before the loop starts waiting.
+constexpr Seconds kLogsReadyPollInterval(1);
+#endif  // CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+
+bool hostIsAwake() {
+  return EventLoopManagerSingleton::isInitialized() &&
+         EventLoopManagerSingleton::get()
+             ->getEventLoop()
+             .getPowerControlManager()
+             .hostIsAwake();
+}
+
+}  // anonymous namespace
 
 void LogBufferManager::onLogsReady() {
+#ifdef CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+  // This is called for every log, so only the first log since the loop last
+  // started a flush notifies it.
+  if (hostIsAwake() && !mLogsReady.exchange(true)) {
+    mSendLogsToHostCondition.notify_one();
+  }
+#else
   LockGuard<Mutex> lockGuard(mFlushLogsMutex);
   if (!mLogFlushToHostPending) {
-    if (EventLoopManagerSingleton::isInitialized() &&
-        EventLoopManagerSingleton::get()
-            ->getEventLoop()
-            .getPowerControlManager()
-            .hostIsAwake()) {
+    if (hostIsAwake()) {
       mLogFlushToHostPending = true;
       mSendLogsToHostCondition.notify_one();
     }
   } else {
     mLogsBecameReadyWhileFlushPending = true;
   }
+#endif  // CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
 }
 
 void LogBufferManager::flushLogs() {
@@ -58,16 +80,25 @@ void LogBufferManager::onLogsSentToHost(bool success) {
 
 void LogBufferManager::startSendLogsToHostLoop() {
   LockGuard<Mutex> lockGuard(mFlushLogsMutex);
-  // TODO(b/181871430): Allow this loop to exit for certain platforms
   while (true) {
-    while (!mLogFlushToHostPending) {
+    while (!mLogFlushToHostPending && !mStopSendLogsToHostLoop) {
+#ifdef CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+      if (mLogsReady.exchange(false)) {
+        mLogFlushToHostPending = true;
+      } else {
+        mSendLogsToHostCondition.wait_for(mFlushLogsMutex,
+                                          kLogsReadyPollInterval);
+      }
+#else
       mSendLogsToHostCondition.wait(mFlushLogsMutex);
+#endif  // CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+    }
+    if (mStopSendLogsToHostLoop) {
+      break;
     }
+
     bool logWasSent = false;
-    if (EventLoopManagerSingleton::get()
-            ->getEventLoop()
-            .getPowerControlManager()
-            .hostIsAwake()) {
+    if (hostIsAwake()) {
       auto &hostCommsMgr =
           EventLoopManagerSingleton::get()->getHostCommsManager();
       preSecondaryBufferUse();
@@ -75,6 +106,9 @@ void LogBufferManager::startSendLogsToHostLoop() {
         // TODO (b/184178045): Transfer logs into the secondary buffer from
         // primary if there is room.
         mPrimaryLogBuffer.transferTo(mSecondaryLogBuffer);
+        // Counted here rather than when the logs are sent, as logs may have
+        // been dropped even if none were transferred.
+        mNumLogsDroppedTotal += mSecondaryLogBuffer.getNumLogsDropped();
       }
       // If the primary buffer was not flushed to the secondary buffer then set
       // the flag that will cause sendLogsToHost to be run again after
@@ -84,7 +118,6 @@ void LogBufferManager::startSendLogsToHostLoop() {
         mLogsBecameReadyWhileFlushPending = true;
       }
       if (mSecondaryLogBuffer.getBufferSize() > 0) {
-        mNumLogsDroppedTotal += mSecondaryLogBuffer.getNumLogsDropped();
         mFlushLogsMutex.unlock();
         hostCommsMgr.sendLogMessageV2(mSecondaryLogBuffer.getBufferData(),
                                       mSecondaryLogBuffer.getBufferSize(),
@@ -99,6 +132,12 @@ void LogBufferManager::startSendLogsToHostLoop() {
   }
 }
 
+void LogBufferManager::stopSendLogsToHostLoop() {
+  LockGuard<Mutex> lockGuard(mFlushLogsMutex);
+  mStopSendLogsToHostLoop = true;
+  mSendLogsToHostCondition.notify_one();
+}
+
 void LogBufferManager::log(chreLogLevel logLevel, const char *formatStr, ...) {
   va_list args;
   va_start(args, formatStr);
@@ -112,6 +151,7 @@ void LogBufferManager::logVa(chreLogLevel logLevel, const char *formatStr,
   uint64_t timeNs = SystemTime::getMonotonicTime().toRawNanoseconds();
   uint32_t timeMs =
       static_cast<uint32_t>(timeNs / kOneMillisecondInNanoseconds);
+#ifndef CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
   // Copy the va_list before getting size from vsnprintf so that the next
   // argument that will be accessed in buffer.handleLogVa is the starting one.
   va_list getSizeArgs;
@@ -123,8 +163,13 @@ void LogBufferManager::logVa(chreLogLevel logLevel, const char *formatStr,
     if (!mLogFlushToHostPending) {
       preSecondaryBufferUse();
       mPrimaryLogBuffer.transferTo(mSecondaryLogBuffer);
+      mNumLogsDroppedTotal += mSecondaryLogBuffer.getNumLogsDropped();
     }
   }
+#endif  // CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+  // With CHRE_LOCK_FREE_LOG_BUFFER_ENABLED, a log that doesn't fit is dropped
+  // and counted by the primary buffer, and only the flush loop moves logs out
+  // of it, so that logging doesn't wait on the flush mutex.
   mPrimaryLogBuffer.handleLogVa(logBufLogLevel, timeMs, formatStr, args);
 }
 
@@ -150,6 +195,13 @@ void LogBufferManager::onLogsSentToHostLocked(bool success) {
   // one to avoid an infinite loop occurring
   mLogFlushToHostPending = mLogsBecameReadyWhileFlushPending && success;
   mLogsBecameReadyWhileFlushPending = false;
+#ifdef CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
+  if (!success) {
+    // Same as above for the logs that became ready during the failed flush,
+    // which the loop would otherwise pick up right away.
+    mLogsReady = false;
+  }
+#endif  // CHRE_LOCK_FREE_LOG_BUFFER_ENABLED
   if (mLogFlushToHostPending) {
     mSendLogsToHostCondition.notify_one();
   }
@@ -287,6 +287,20 @@ bool chreSensorFlushAsync(uint32_t sensorHandle, const void *cookie) {
   return (fptr != nullptr) ? fptr(sensorHandle, cookie) : false;
 }
 
+WEAK_SYMBOL
+bool chreSensorConfigureHistory(uint32_t sensorHandle, uint64_t duration) {
+  auto *fptr = CHRE_NSL_LAZY_LOOKUP(chreSensorConfigureHistory);
+  return (fptr != nullptr) ? fptr(sensorHandle, duration) : false;
+}
+
+WEAK_SYMBOL
+bool chreSensorGetHistory(uint32_t sensorHandle, uint64_t startTime,
+                          uint64_t endTime, struct chreSensorHistory *history) {
+  auto *fptr = CHRE_NSL_LAZY_LOOKUP(chreSensorGetHistory);
+  return (fptr != nullptr) ? fptr(sensorHandle, startTime, endTime, history)
+                           : false;
+}
+
 WEAK_SYMBOL
 void chreConfigureDebugDumpEvent(bool enable) {
   auto *fptr = CHRE_NSL_LAZY_LOOKUP(chreConfigureDebugDumpEvent);
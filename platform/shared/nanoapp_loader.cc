@@ -28,6 +28,8 @@
 #include "chre/platform/fatal_error.h"
 #include "chre/platform/shared/debug_dump.h"
 #include "chre/platform/shared/memory.h"
+#include "chre/platform/shared/nanoapp_loader_exports.h"
+#include "chre/platform/shared/nanoapp_loader_symbols.h"
 #include "chre/target_platform/platform_cache_management.h"
 #include "chre/util/dynamic_vector.h"
 #include "chre/util/macros.h"
@@ -42,11 +44,6 @@ namespace {
 using ElfHeader = ElfW(Ehdr);
 using ProgramHeader = ElfW(Phdr);
 
-struct ExportedData {
-  void *data;
-  const char *dataName;
-};
-
 //! If non-null, a nanoapp is currently being loaded. This allows certain C
 //! functions to access the nanoapp if called during static init.
 NanoappLoader *gCurrentlyLoadingNanoapp = nullptr;
@@ -124,124 +121,16 @@ void __cxa_pure_virtual(void) {
 }
 
 #define ADD_EXPORTED_SYMBOL(function_name, function_string) \
-  { reinterpret_cast<void *>(function_name), function_string }
+  {reinterpret_cast<void *>(function_name), function_string},
 #define ADD_EXPORTED_C_SYMBOL(function_name) \
   ADD_EXPORTED_SYMBOL(function_name, STRINGIFY(function_name))
 
-// TODO(karthikmb/stange): While this array was hand-coded for simple
-// "hello-world" prototyping, the list of exported symbols must be
-// generated to minimize runtime errors and build breaks.
-// clang-format off
 // Disable deprecation warning so that deprecated symbols in the array
 // can be exported for older nanoapps and tests.
 CHRE_DEPRECATED_PREAMBLE
 const ExportedData gExportedData[] = {
-    /* libmath overrrides and symbols */
-    ADD_EXPORTED_SYMBOL(asinOverride, "asin"),
-    ADD_EXPORTED_SYMBOL(atan2Override, "atan2"),
-    ADD_EXPORTED_SYMBOL(cosOverride, "cos"),
-    ADD_EXPORTED_SYMBOL(frexpOverride, "frexp"),
-    ADD_EXPORTED_SYMBOL(fmaxOverride, "fmax"),
-    ADD_EXPORTED_SYMBOL(fminOverride, "fmin"),
-    ADD_EXPORTED_SYMBOL(floorOverride, "floor"),
-    ADD_EXPORTED_SYMBOL(roundOverride, "round"),
-    ADD_EXPORTED_SYMBOL(sinOverride, "sin"),
-    ADD_EXPORTED_SYMBOL(sqrtOverride, "sqrt"),
-    ADD_EXPORTED_C_SYMBOL(acosf),
-    ADD_EXPORTED_C_SYMBOL(asinf),
-    ADD_EXPORTED_C_SYMBOL(atan2f),
-    ADD_EXPORTED_C_SYMBOL(ceilf),
-    ADD_EXPORTED_C_SYMBOL(cosf),
-    ADD_EXPORTED_C_SYMBOL(expf),
-    ADD_EXPORTED_C_SYMBOL(floorf),
-    ADD_EXPORTED_C_SYMBOL(fmaxf),
-    ADD_EXPORTED_C_SYMBOL(fminf),
-    ADD_EXPORTED_C_SYMBOL(fmodf),
-    ADD_EXPORTED_C_SYMBOL(log10f),
-    ADD_EXPORTED_C_SYMBOL(log1pf),
-    ADD_EXPORTED_C_SYMBOL(logf),
-    ADD_EXPORTED_C_SYMBOL(lroundf),
-    ADD_EXPORTED_C_SYMBOL(roundf),
-    ADD_EXPORTED_C_SYMBOL(sinf),
-    ADD_EXPORTED_C_SYMBOL(sqrtf),
-    ADD_EXPORTED_C_SYMBOL(tanhf),
-    /* libc overrides and symbols */
-    ADD_EXPORTED_C_SYMBOL(__cxa_pure_virtual),
-    ADD_EXPORTED_SYMBOL(atexitOverride, "atexit"),
-    ADD_EXPORTED_SYMBOL(deleteOverride, "_ZdlPv"),
-    ADD_EXPORTED_C_SYMBOL(dlsym),
-    ADD_EXPORTED_C_SYMBOL(memcmp),
-    ADD_EXPORTED_C_SYMBOL(memcpy),
-    ADD_EXPORTED_C_SYMBOL(memmove),
-    ADD_EXPORTED_C_SYMBOL(memset),
-    ADD_EXPORTED_C_SYMBOL(snprintf),
-    ADD_EXPORTED_C_SYMBOL(strcmp),
-    ADD_EXPORTED_C_SYMBOL(strlen),
-    ADD_EXPORTED_C_SYMBOL(strncmp),
-    ADD_EXPORTED_C_SYMBOL(tolower),
-    /* ash symbols */
-    ADD_EXPORTED_C_SYMBOL(ashProfileInit),
-    ADD_EXPORTED_C_SYMBOL(ashProfileBegin),
-    ADD_EXPORTED_C_SYMBOL(ashProfileEnd),
-    ADD_EXPORTED_C_SYMBOL(ashLoadCalibrationParams),
-    ADD_EXPORTED_C_SYMBOL(ashSaveCalibrationParams),
-    ADD_EXPORTED_C_SYMBOL(ashSetCalibration),
-    ADD_EXPORTED_C_SYMBOL(ashLoadMultiCalibrationParams),
-    ADD_EXPORTED_C_SYMBOL(ashSaveMultiCalibrationParams),
-    ADD_EXPORTED_C_SYMBOL(ashSetMultiCalibration),
-    /* CHRE symbols */
-    ADD_EXPORTED_C_SYMBOL(chreAbort),
-    ADD_EXPORTED_C_SYMBOL(chreAudioConfigureSource),
-    ADD_EXPORTED_C_SYMBOL(chreAudioGetSource),
-    ADD_EXPORTED_C_SYMBOL(chreConfigureDebugDumpEvent),
-    ADD_EXPORTED_C_SYMBOL(chreConfigureHostSleepStateEvents),
-    ADD_EXPORTED_C_SYMBOL(chreConfigureNanoappInfoEvents),
-    ADD_EXPORTED_C_SYMBOL(chreDebugDumpLog),
-    ADD_EXPORTED_C_SYMBOL(chreGetApiVersion),
-    ADD_EXPORTED_C_SYMBOL(chreGetAppId),
-    ADD_EXPORTED_C_SYMBOL(chreGetInstanceId),
-    ADD_EXPORTED_C_SYMBOL(chreGetEstimatedHostTimeOffset),
-    ADD_EXPORTED_C_SYMBOL(chreGetNanoappInfoByAppId),
-    ADD_EXPORTED_C_SYMBOL(chreGetNanoappInfoByInstanceId),
-    ADD_EXPORTED_C_SYMBOL(chreGetPlatformId),
-    ADD_EXPORTED_C_SYMBOL(chreGetSensorInfo),
-    ADD_EXPORTED_C_SYMBOL(chreGetSensorSamplingStatus),
-    ADD_EXPORTED_C_SYMBOL(chreGetTime),
-    ADD_EXPORTED_C_SYMBOL(chreGetVersion),
-    ADD_EXPORTED_C_SYMBOL(chreGnssConfigurePassiveLocationListener),
-    ADD_EXPORTED_C_SYMBOL(chreGnssGetCapabilities),
-    ADD_EXPORTED_C_SYMBOL(chreGnssLocationSessionStartAsync),
-    ADD_EXPORTED_C_SYMBOL(chreGnssLocationSessionStopAsync),
-    ADD_EXPORTED_C_SYMBOL(chreGnssMeasurementSessionStartAsync),
-    ADD_EXPORTED_C_SYMBOL(chreGnssMeasurementSessionStopAsync),
-    ADD_EXPORTED_C_SYMBOL(chreHeapAlloc),
-    ADD_EXPORTED_C_SYMBOL(chreHeapFree),
-    ADD_EXPORTED_C_SYMBOL(chreIsHostAwake),
-    ADD_EXPORTED_C_SYMBOL(chreLog),
-    ADD_EXPORTED_C_SYMBOL(chreSendEvent),
-    ADD_EXPORTED_C_SYMBOL(chreSendMessageToHost),
-    ADD_EXPORTED_C_SYMBOL(chreSendMessageToHostEndpoint),
-    ADD_EXPORTED_C_SYMBOL(chreSendMessageWithPermissions),
-    ADD_EXPORTED_C_SYMBOL(chreSensorConfigure),
-    ADD_EXPORTED_C_SYMBOL(chreSensorConfigureBiasEvents),
-    ADD_EXPORTED_C_SYMBOL(chreSensorFind),
-    ADD_EXPORTED_C_SYMBOL(chreSensorFindDefault),
-    ADD_EXPORTED_C_SYMBOL(chreSensorFlushAsync),
-    ADD_EXPORTED_C_SYMBOL(chreSensorGetThreeAxisBias),
-    ADD_EXPORTED_C_SYMBOL(chreTimerCancel),
-    ADD_EXPORTED_C_SYMBOL(chreTimerSet),
-    ADD_EXPORTED_C_SYMBOL(chreUserSettingConfigureEvents),
-    ADD_EXPORTED_C_SYMBOL(chreUserSettingGetState),
-    ADD_EXPORTED_C_SYMBOL(chreWifiConfigureScanMonitorAsync),
-    ADD_EXPORTED_C_SYMBOL(chreWifiGetCapabilities),
-    ADD_EXPORTED_C_SYMBOL(chreWifiRequestScanAsync),
-    ADD_EXPORTED_C_SYMBOL(chreWifiRequestRangingAsync),
-    ADD_EXPORTED_C_SYMBOL(chreWwanGetCapabilities),
-    ADD_EXPORTED_C_SYMBOL(chreWwanGetCellInfoAsync),
-    ADD_EXPORTED_C_SYMBOL(platform_chreDebugDumpVaLog),
-};
+    CHRE_NANOAPP_LOADER_EXPORTS(ADD_EXPORTED_SYMBOL, ADD_EXPORTED_C_SYMBOL)};
 CHRE_DEPRECATED_EPILOGUE
-// clang-format on
 
 }  // namespace
 
@@ -270,16 +159,23 @@ void NanoappLoader::destroy(NanoappLoader *loader) {
 }
 
 void *NanoappLoader::findExportedSymbol(const char *name) {
-  size_t nameLen = strlen(name);
-  for (size_t i = 0; i < ARRAY_SIZE(gExportedData); i++) {
-    if (nameLen == strlen(gExportedData[i].dataName) &&
-        strncmp(name, gExportedData[i].dataName, nameLen) == 0) {
-      return gExportedData[i].data;
-    }
+#ifdef CHRE_ASSERTIONS_ENABLED
+  static bool sExportedDataVerified = false;
+  if (!sExportedDataVerified) {
+    CHRE_ASSERT_LOG(
+        isExportedDataSorted(gExportedData, ARRAY_SIZE(gExportedData)),
+        "Exported symbols must be sorted");
+    sExportedDataVerified = true;
   }
+#endif  // CHRE_ASSERTIONS_ENABLED
 
-  LOGE("Unable to find %s", name);
-  return nullptr;
+  const ExportedData *exportedData =
+      findExportedData(gExportedData, ARRAY_SIZE(gExportedData), name);
+  if (exportedData == nullptr) {
+    LOGE("Unable to find %s", name);
+    return nullptr;
+  }
+  return exportedData->data;
 }
 
 bool NanoappLoader::open() {
@@ -294,6 +190,8 @@ bool NanoappLoader::open() {
     } else if (!resolveGot()) {
       LOGE("Failed to resolve GOT");
     } else {
+      initSymbolHashTables();
+
       // Wipe caches before calling init array to ensure initializers are not in
       // the data cache.
       wipeSystemCaches();
@@ -319,6 +217,11 @@ void NanoappLoader::close() {
 }
 
 void *NanoappLoader::findSymbolByName(const char *name) {
+  const ElfSym *dynamicSymbol = findDynamicSymbol(name);
+  if (dynamicSymbol != nullptr) {
+    return mMapping + dynamicSymbol->st_value;
+  }
+
   void *symbol = nullptr;
   uint8_t *index = mSymbolTablePtr;
   while (index < (mSymbolTablePtr + mSymbolTableSize)) {
@@ -490,7 +393,7 @@ size_t NanoappLoader::getProgramHeaderArraySize() {
 char *NanoappLoader::getDynamicStringTable() {
   char *table = nullptr;
 
-  SectionHeader *dynamicStringTablePtr = getSectionHeader(".dynstr");
+  SectionHeader *dynamicStringTablePtr = mDynamicStringTableHeader;
   CHRE_ASSERT(dynamicStringTablePtr != nullptr);
   if (dynamicStringTablePtr != nullptr && mBinary != nullptr) {
     table =
@@ -503,7 +406,7 @@ char *NanoappLoader::getDynamicStringTable() {
 uint8_t *NanoappLoader::getDynamicSymbolTable() {
   uint8_t *table = nullptr;
 
-  SectionHeader *dynamicSymbolTablePtr = getSectionHeader(".dynsym");
+  SectionHeader *dynamicSymbolTablePtr = mDynamicSymbolTableHeader;
   CHRE_ASSERT(dynamicSymbolTablePtr != nullptr);
   if (dynamicSymbolTablePtr != nullptr && mBinary != nullptr) {
     table = (mBinary + dynamicSymbolTablePtr->sh_offset);
@@ -515,7 +418,7 @@ uint8_t *NanoappLoader::getDynamicSymbolTable() {
 size_t NanoappLoader::getDynamicSymbolTableSize() {
   size_t tableSize = 0;
 
-  SectionHeader *dynamicSymbolTablePtr = getSectionHeader(".dynsym");
+  SectionHeader *dynamicSymbolTablePtr = mDynamicSymbolTableHeader;
   CHRE_ASSERT(dynamicSymbolTablePtr != nullptr);
   if (dynamicSymbolTablePtr != nullptr) {
     tableSize = dynamicSymbolTablePtr->sh_size;
@@ -594,6 +497,13 @@ bool NanoappLoader::copyAndVerifyHeaders() {
   success = verifySectionHeaders();
   LOGV("Verified Section headers %d", success);
 
+  // Look up the dynamic symbol sections once, as every relocation that refers
+  // to a symbol needs them.
+  if (success) {
+    mDynamicSymbolTableHeader = getSectionHeader(".dynsym");
+    mDynamicStringTableHeader = getSectionHeader(".dynstr");
+  }
+
   // Load symbol table
   if (success) {
     SectionHeader *symbolTableHeader = getSectionHeader(kSymTableName);
@@ -748,6 +658,47 @@ void *NanoappLoader::resolveData(size_t posInSymbolTable) {
   return nullptr;
 }
 
+void NanoappLoader::initSymbolHashTables() {
+  DynamicHeader *dyn = getDynamicHeader();
+  if (dyn != nullptr) {
+    ElfAddr symbolTableAddr = getDynEntry(dyn, DT_SYMTAB);
+    ElfAddr stringTableAddr = getDynEntry(dyn, DT_STRTAB);
+    ElfAddr gnuHashAddr = getDynEntry(dyn, DT_GNU_HASH);
+    ElfAddr sysvHashAddr = getDynEntry(dyn, DT_HASH);
+
+    if (symbolTableAddr != 0 && stringTableAddr != 0) {
+      mMappedDynamicSymbolTable =
+          reinterpret_cast<const ElfSym *>(symbolTableAddr + mLoadBias);
+      mMappedDynamicStringTable =
+          reinterpret_cast<const char *>(stringTableAddr + mLoadBias);
+      if (gnuHashAddr != 0) {
+        mGnuHashTable =
+            reinterpret_cast<const ElfWord *>(gnuHashAddr + mLoadBias);
+      }
+      if (sysvHashAddr != 0) {
+        mSysvHashTable =
+            reinterpret_cast<const ElfWord *>(sysvHashAddr + mLoadBias);
+      }
+    }
+  }
+
+  LOGV("Symbol hash tables: GNU %p SysV %p", mGnuHashTable, mSysvHashTable);
+}
+
+const NanoappLoader::ElfSym *NanoappLoader::findDynamicSymbol(
+    const char *name) {
+  const ElfSym *symbol = nullptr;
+  if (mGnuHashTable != nullptr) {
+    symbol = gnuHashLookup(mGnuHashTable, mMappedDynamicSymbolTable,
+                           mMappedDynamicStringTable, name);
+  } else if (mSysvHashTable != nullptr) {
+    symbol = sysvHashLookup(mSysvHashTable, mMappedDynamicSymbolTable,
+                            mMappedDynamicStringTable, name);
+  }
+
+  return symbol;
+}
+
 NanoappLoader::DynamicHeader *NanoappLoader::getDynamicHeader() {
   DynamicHeader *dyn = nullptr;
   ProgramHeader *programHeaders = getProgramHeaderArray();
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/platform/shared/nanoapp_loader_symbols.h"
+
+#include <cstring>
+
+#include "chre/platform/log.h"
+
+namespace chre {
+
+uint32_t gnuHash(const char *name) {
+  uint32_t hash = 5381;
+  for (const uint8_t *c = reinterpret_cast<const uint8_t *>(name); *c != '\0';
+       c++) {
+    hash = (hash << 5) + hash + *c;
+  }
+  return hash;
+}
+
+uint32_t sysvHash(const char *name) {
+  uint32_t hash = 0;
+  for (const uint8_t *c = reinterpret_cast<const uint8_t *>(name); *c != '\0';
+       c++) {
+    hash = (hash << 4) + *c;
+    uint32_t high = hash & 0xf0000000;
+    hash ^= high >> 24;
+    hash &= ~high;
+  }
+  return hash;
+}
+
+const Elf32_Sym *gnuHashLookup(const Elf32_Word *hashTable,
+                               const Elf32_Sym *symbolTable,
+                               const char *stringTable, const char *name) {
+  // The table is laid out as a header of four words, followed by the bloom
+  // filter, the buckets and the hash values of the symbols.
+  constexpr uint32_t kBloomWordBits = 8 * sizeof(Elf32_Addr);
+  Elf32_Word numBuckets = hashTable[0];
+  Elf32_Word symbolOffset = hashTable[1];
+  Elf32_Word bloomSize = hashTable[2];
+  Elf32_Word bloomShift = hashTable[3];
+  const Elf32_Addr *bloom = reinterpret_cast<const Elf32_Addr *>(&hashTable[4]);
+  const Elf32_Word *buckets =
+      reinterpret_cast<const Elf32_Word *>(&bloom[bloomSize]);
+  const Elf32_Word *hashValues = &buckets[numBuckets];
+
+  if (numBuckets == 0 || bloomSize == 0) {
+    return nullptr;
+  }
+
+  uint32_t hash = gnuHash(name);
+  Elf32_Addr bloomWord = bloom[(hash / kBloomWordBits) % bloomSize];
+  Elf32_Addr bloomMask =
+      (static_cast<Elf32_Addr>(1) << (hash % kBloomWordBits)) |
+      (static_cast<Elf32_Addr>(1) << ((hash >> bloomShift) % kBloomWordBits));
+  if ((bloomWord & bloomMask) != bloomMask) {
+    return nullptr;
+  }
+
+  // Symbols in a bucket are contiguous, and the lowest bit of the hash value
+  // marks the last one.
+  for (Elf32_Word index = buckets[hash % numBuckets]; index >= symbolOffset;
+       index++) {
+    Elf32_Word symbolHash = hashValues[index - symbolOffset];
+    const Elf32_Sym *symbol = &symbolTable[index];
+    if ((symbolHash | 1) == (hash | 1) && symbol->st_shndx != SHN_UNDEF &&
+        strcmp(name, &stringTable[symbol->st_name]) == 0) {
+      return symbol;
+    }
+    if ((symbolHash & 1) != 0) {
+      break;
+    }
+  }
+
+  return nullptr;
+}
+
+const Elf32_Sym *sysvHashLookup(const Elf32_Word *hashTable,
+                                const Elf32_Sym *symbolTable,
+                                const char *stringTable, const char *name) {
+  // The table is laid out as the number of buckets and of chain entries,
+  // followed by the buckets and the chains.
+  Elf32_Word numBuckets = hashTable[0];
+  Elf32_Word numChains = hashTable[1];
+  const Elf32_Word *buckets = &hashTable[2];
+  const Elf32_Word *chains = &buckets[numBuckets];
+
+  if (numBuckets == 0) {
+    return nullptr;
+  }
+
+  for (Elf32_Word index = buckets[sysvHash(name) % numBuckets];
+       index != STN_UNDEF && index < numChains; index = chains[index]) {
+    const Elf32_Sym *symbol = &symbolTable[index];
+    if (symbol->st_shndx != SHN_UNDEF &&
+        strcmp(name, &stringTable[symbol->st_name]) == 0) {
+      return symbol;
+    }
+  }
+
+  return nullptr;
+}
+
+bool isExportedDataSorted(const ExportedData *exportedData,
+                          size_t numExportedData) {
+  for (size_t i = 1; i < numExportedData; i++) {
+    if (strcmp(exportedData[i - 1].dataName, exportedData[i].dataName) >= 0) {
+      LOGE("Exported symbol %s is out of order", exportedData[i].dataName);
+      return false;
+    }
+  }
+  return true;
+}
+
+const ExportedData *findExportedData(const ExportedData *exportedData,
+                                     size_t numExportedData,
+                                     const char *name) {
+  size_t low = 0;
+  size_t high = numExportedData;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    int result = strcmp(name, exportedData[mid].dataName);
+    if (result == 0) {
+      return &exportedData[mid];
+    } else if (result < 0) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+
+  return nullptr;
+}
+
+}  // namespace chre
@@ -15,11 +15,18 @@
  */
 
 #include <gtest/gtest.h>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "chre/platform/atomic.h"
 #include "chre/platform/condition_variable.h"
+#include "chre/platform/log.h"
 #include "chre/platform/mutex.h"
+#include "chre/platform/shared/lock_free_log_buffer.h"
 #include "chre/platform/shared/log_buffer.h"
 
 namespace chre {
@@ -283,6 +290,260 @@ TEST(LogBuffer, TransferTest) {
   ASSERT_EQ(bytesCopied, 0);
 }
 
-// TODO(srok): Add multithreaded tests
+TEST(LockFreeLogBuffer, SameFormatAsLogBuffer) {
+  char buffer[kDefaultBufferSize];
+  char lockFreeBuffer[kDefaultBufferSize];
+  constexpr size_t kOutBufferSize = 100;
+  char outBuffer[kOutBufferSize];
+  char lockFreeOutBuffer[kOutBufferSize];
+  size_t numLogsDropped;
+  TestLogBufferCallback callback;
+  LogBuffer logBuffer(&callback, buffer, kDefaultBufferSize);
+  LockFreeLogBuffer lockFreeLogBuffer(&callback, lockFreeBuffer,
+                                      kDefaultBufferSize);
+
+  logBuffer.handleLog(LogBufferLogLevel::WARN, 1234, "test %d", 1);
+  logBuffer.handleLog(LogBufferLogLevel::DEBUG, 5678, "test2");
+  lockFreeLogBuffer.handleLog(LogBufferLogLevel::WARN, 1234, "test %d", 1);
+  lockFreeLogBuffer.handleLog(LogBufferLogLevel::DEBUG, 5678, "test2");
+  EXPECT_EQ(lockFreeLogBuffer.getBufferSize(), logBuffer.getBufferSize());
+
+  size_t bytesCopied =
+      logBuffer.copyLogs(outBuffer, kOutBufferSize, &numLogsDropped);
+  size_t lockFreeBytesCopied = lockFreeLogBuffer.copyLogs(
+      lockFreeOutBuffer, kOutBufferSize, &numLogsDropped);
+  ASSERT_EQ(lockFreeBytesCopied, bytesCopied);
+  EXPECT_EQ(memcmp(lockFreeOutBuffer, outBuffer, bytesCopied), 0);
+  EXPECT_EQ(lockFreeLogBuffer.getBufferSize(), 0);
+}
+
+TEST(LockFreeLogBuffer, CopyWholeLogsOnly) {
+  char buffer[kDefaultBufferSize];
+  constexpr size_t kOutBufferSize = 20;
+  char outBuffer[kOutBufferSize];
+  size_t numLogsDropped;
+  TestLogBufferCallback callback;
+  LockFreeLogBuffer logBuffer(&callback, buffer, kDefaultBufferSize);
+
+  logBuffer.handleLog(LogBufferLogLevel::INFO, 0, "str1");
+  logBuffer.handleLog(LogBufferLogLevel::INFO, 0, "str2");
+
+  // Each log takes 10 bytes, so only one fits with room to spare.
+  EXPECT_EQ(logBuffer.copyLogs(outBuffer, 15, &numLogsDropped), 10);
+  EXPECT_TRUE(strcmp(outBuffer + kBytesBeforeLogData, "str1") == 0);
+  EXPECT_EQ(logBuffer.copyLogs(outBuffer, kOutBufferSize, &numLogsDropped),
+            10);
+  EXPECT_TRUE(strcmp(outBuffer + kBytesBeforeLogData, "str2") == 0);
+  EXPECT_EQ(logBuffer.copyLogs(outBuffer, kOutBufferSize, &numLogsDropped), 0);
+}
+
+TEST(LockFreeLogBuffer, DropNewestLogWhenFull) {
+  char buffer[kDefaultBufferSize];
+  constexpr size_t kOutBufferSize = kDefaultBufferSize;
+  char outBuffer[kOutBufferSize];
+  TestLogBufferCallback callback;
+  LockFreeLogBuffer logBuffer(&callback, buffer, kDefaultBufferSize);
+
+  // Each log takes 106 bytes, so only the first 9 fit.
+  for (size_t i = 0; i < 10; i++) {
+    std::string testLogStrStr(100, 'a' + i);
+    EXPECT_EQ(logBuffer.logWouldCauseOverflow(100), i == 9);
+    logBuffer.handleLog(LogBufferLogLevel::INFO, 0, testLogStrStr.c_str());
+  }
+  EXPECT_EQ(logBuffer.getNumLogsDropped(), 1);
+
+  size_t numLogsDropped;
+  size_t bytesCopied =
+      logBuffer.copyLogs(outBuffer, kOutBufferSize, &numLogsDropped);
+  EXPECT_EQ(bytesCopied, 9 * (kBytesBeforeLogData + 100 + 1));
+  EXPECT_EQ(numLogsDropped, 1);
+  EXPECT_TRUE(strcmp(outBuffer + kBytesBeforeLogData,
+                     std::string(100, 'a').c_str()) == 0);
+  EXPECT_EQ(logBuffer.getNumLogsDropped(), 0);
+}
+
+TEST(LockFreeLogBuffer, WrapAround) {
+  // Use a size that isn't a power of two to exercise the index wrapping.
+  constexpr size_t kBufferSize = 1500;
+  char buffer[kBufferSize];
+  constexpr size_t kOutBufferSize = 300;
+  char outBuffer[kOutBufferSize];
+  size_t numLogsDropped;
+  TestLogBufferCallback callback;
+  LockFreeLogBuffer logBuffer(&callback, buffer, kBufferSize);
+
+  // Entries of 5 + 60 + 1 bytes land at every offset relative to the end of
+  // the buffer over enough iterations.
+  for (size_t i = 0; i < 200; i++) {
+    std::string testLogStrStr(60, 'a' + (i % 26));
+    logBuffer.handleLog(LogBufferLogLevel::INFO, static_cast<uint32_t>(i),
+                        testLogStrStr.c_str());
+    if (i % 4 == 3) {
+      size_t bytesCopied =
+          logBuffer.copyLogs(outBuffer, kOutBufferSize, &numLogsDropped);
+      ASSERT_EQ(bytesCopied, 4 * 66);
+      for (size_t j = 0; j < 4; j++) {
+        const char *entry = outBuffer + j * 66;
+        uint32_t timestampMs;
+        memcpy(&timestampMs, entry + 1, sizeof(timestampMs));
+        EXPECT_EQ(timestampMs, i - 3 + j);
+        EXPECT_TRUE(strcmp(entry + kBytesBeforeLogData,
+                           std::string(60, 'a' + (timestampMs % 26)).c_str()) ==
+                    0);
+      }
+      EXPECT_EQ(numLogsDropped, 0);
+    }
+  }
+}
+
+TEST(LockFreeLogBuffer, TransferTest) {
+  char buffer[kDefaultBufferSize];
+  char bufferTo[kDefaultBufferSize];
+  const size_t kOutBufferSize = 10;
+  char outBuffer[kOutBufferSize];
+  size_t numLogsDropped;
+  TestLogBufferCallback callback;
+  LockFreeLogBuffer logBufferFrom(&callback, buffer, kDefaultBufferSize);
+  LogBuffer logBufferTo(&callback, bufferTo, kDefaultBufferSize);
+
+  logBufferFrom.handleLog(LogBufferLogLevel::INFO, 0, "str1");
+  logBufferFrom.handleLog(LogBufferLogLevel::INFO, 0, "str2");
+
+  logBufferFrom.transferTo(logBufferTo);
+  EXPECT_EQ(logBufferFrom.getBufferSize(), 0);
+  EXPECT_EQ(logBufferTo.getBufferSize(), 20);
+
+  logBufferTo.copyLogs(outBuffer, kOutBufferSize, &numLogsDropped);
+  ASSERT_TRUE(strcmp(outBuffer + kBytesBeforeLogData, "str1") == 0);
+  logBufferTo.copyLogs(outBuffer, kOutBufferSize, &numLogsDropped);
+  ASSERT_TRUE(strcmp(outBuffer + kBytesBeforeLogData, "str2") == 0);
+}
+
+namespace {
+
+constexpr size_t kLogsPerProducer = 20000;
+
+// LogBuffer reports the number of logs dropped since it was reset, while
+// LockFreeLogBuffer reports the number dropped since the last copy.
+size_t accumulateLogsDropped(LogBuffer & /* buffer */, size_t /* total */,
+                             size_t numLogsDropped) {
+  return numLogsDropped;
+}
+
+size_t accumulateLogsDropped(LockFreeLogBuffer & /* buffer */, size_t total,
+                             size_t numLogsDropped) {
+  return total + numLogsDropped;
+}
+
+/**
+ * Logs from producerCount threads while the calling thread copies logs out in
+ * chunks, as LogBufferManager does. Verifies that every log copied out is
+ * intact and in per-producer order, and that every log is either copied out
+ * or counted as dropped.
+ *
+ * @param elapsedNs Set to the elapsed time in nanoseconds.
+ * @param numLogsReceived Set to the number of logs copied out.
+ */
+template <typename BufferType>
+void runLogStorm(uint32_t producerCount, uint64_t *elapsedNs,
+                 size_t *numLogsReceived) {
+  constexpr size_t kBufferSize = 4000;
+  static uint8_t buffer[kBufferSize];
+  static uint8_t outBuffer[kBufferSize];
+  TestLogBufferCallback callback;
+  BufferType logBuffer(&callback, buffer, kBufferSize);
+  logBuffer.updateNotificationSetting(LogBufferNotificationSetting::NEVER);
+
+  std::vector<uint32_t> nextExpected(producerCount, 0);
+  AtomicUint32 producersDone(0);
+  size_t received = 0;
+  size_t dropped = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < producerCount; p++) {
+    producers.emplace_back([&logBuffer, &producersDone, p]() {
+      for (size_t i = 0; i < kLogsPerProducer; i++) {
+        logBuffer.handleLog(LogBufferLogLevel::INFO, p,
+                            "producer %" PRIu32 " log %zu, some padding text",
+                            p, i);
+      }
+      producersDone.fetch_increment();
+    });
+  }
+
+  // Logs are only checked once the producers are done, so that the copy loop
+  // keeps up with them as well as possible.
+  std::vector<uint8_t> copiedLogs;
+  bool done = false;
+  while (!done) {
+    done = (producersDone.load() == producerCount);
+    size_t numLogsDropped;
+    size_t bytesCopied =
+        logBuffer.copyLogs(outBuffer, kBufferSize, &numLogsDropped);
+    dropped = accumulateLogsDropped(logBuffer, dropped, numLogsDropped);
+    if (bytesCopied > 0) {
+      copiedLogs.insert(copiedLogs.end(), outBuffer, outBuffer + bytesCopied);
+      done = false;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+
+  size_t offset = 0;
+  while (offset < copiedLogs.size()) {
+    const char *entry = reinterpret_cast<const char *>(&copiedLogs[offset]);
+    ASSERT_EQ(entry[0], static_cast<char>(LogBufferLogLevel::INFO) + 1);
+    uint32_t producer;
+    memcpy(&producer, entry + 1, sizeof(producer));
+    ASSERT_LT(producer, producerCount);
+
+    uint32_t logProducer;
+    size_t logIndex;
+    ASSERT_EQ(sscanf(entry + kBytesBeforeLogData,
+                     "producer %" SCNu32 " log %zu", &logProducer, &logIndex),
+              2);
+    ASSERT_EQ(logProducer, producer);
+    ASSERT_GE(logIndex, nextExpected[producer]);
+    nextExpected[producer] = logIndex + 1;
+    received++;
+
+    offset += kBytesBeforeLogData + strlen(entry + kBytesBeforeLogData) + 1;
+  }
+  EXPECT_EQ(offset, copiedLogs.size());
+  EXPECT_EQ(received + dropped, producerCount * kLogsPerProducer);
+  *numLogsReceived = received;
+  *elapsedNs = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count());
+}
+
+}  // anonymous namespace
+
+//! Measures log throughput with 1-8 threads logging while another thread
+//! flushes the buffer, for LogBuffer and LockFreeLogBuffer.
+TEST(LockFreeLogBuffer, MultiThreadedThroughput) {
+  constexpr uint32_t kProducerCounts[] = {1, 2, 4, 8};
+
+  for (uint32_t producerCount : kProducerCounts) {
+    uint64_t lockedNs = 0;
+    uint64_t lockFreeNs = 0;
+    size_t received = 0;
+    size_t lockFreeReceived = 0;
+    runLogStorm<LogBuffer>(producerCount, &lockedNs, &received);
+    runLogStorm<LockFreeLogBuffer>(producerCount, &lockFreeNs,
+                                   &lockFreeReceived);
+
+    uint64_t logCount = producerCount * kLogsPerProducer;
+    LOGI("%" PRIu32 " producers: LogBuffer %" PRIu64
+         " ns/log (%zu copied out), LockFreeLogBuffer %" PRIu64
+         " ns/log (%zu copied out)",
+         producerCount, lockedNs / logCount, received, lockFreeNs / logCount,
+         lockFreeReceived);
+  }
+}
 
 }  // namespace chre
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "chre/platform/shared/nanoapp_loader_exports.h"
+#include "chre/platform/shared/nanoapp_loader_symbols.h"
+#include "chre/util/macros.h"
+
+using chre::findExportedData;
+using chre::gnuHash;
+using chre::gnuHashLookup;
+using chre::isExportedDataSorted;
+using chre::sysvHash;
+using chre::sysvHashLookup;
+
+namespace {
+
+#define EXPORTED_SYMBOL_NAME(function_name, function_string) function_string,
+#define EXPORTED_C_SYMBOL_NAME(function_name) STRINGIFY(function_name),
+
+//! The names of the symbols exported by the nanoapp loader, in order.
+const char *const kExportedNames[] = {CHRE_NANOAPP_LOADER_EXPORTS(
+    EXPORTED_SYMBOL_NAME, EXPORTED_C_SYMBOL_NAME)};
+
+//! Arbitrary section index of the defined symbols.
+constexpr Elf32_Half kDefinedSection = 1;
+
+/**
+ * The dynamic symbol and string tables of a binary that defines the exported
+ * symbols, in the order that a hash table requires, after the undefined symbol
+ * at index 0.
+ */
+class SymbolTables {
+ public:
+  explicit SymbolTables(const std::vector<std::string> &names) {
+    mStrings.push_back('\0');
+    mSymbols.push_back(Elf32_Sym{});
+    for (const std::string &name : names) {
+      Elf32_Sym symbol = {};
+      symbol.st_name = static_cast<Elf32_Word>(mStrings.size());
+      symbol.st_shndx = kDefinedSection;
+      mSymbols.push_back(symbol);
+      mStrings.insert(mStrings.end(), name.begin(), name.end());
+      mStrings.push_back('\0');
+    }
+  }
+
+  const Elf32_Sym *symbols() const {
+    return mSymbols.data();
+  }
+
+  const char *strings() const {
+    return mStrings.data();
+  }
+
+  const char *name(const Elf32_Sym *symbol) const {
+    return &mStrings[symbol->st_name];
+  }
+
+ private:
+  std::vector<Elf32_Sym> mSymbols;
+  std::vector<char> mStrings;
+};
+
+std::vector<std::string> exportedNames() {
+  return std::vector<std::string>(std::begin(kExportedNames),
+                                  std::end(kExportedNames));
+}
+
+/**
+ * Builds a DT_HASH table as a linker does, chaining the symbols of each bucket
+ * from the last one.
+ */
+std::vector<Elf32_Word> buildSysvHashTable(
+    const std::vector<std::string> &names, Elf32_Word numBuckets) {
+  Elf32_Word numChains = static_cast<Elf32_Word>(names.size() + 1);
+  std::vector<Elf32_Word> table(2 + numBuckets + numChains, STN_UNDEF);
+  table[0] = numBuckets;
+  table[1] = numChains;
+  Elf32_Word *buckets = &table[2];
+  Elf32_Word *chains = &buckets[numBuckets];
+  for (Elf32_Word index = 1; index < numChains; index++) {
+    Elf32_Word bucket = sysvHash(names[index - 1].c_str()) % numBuckets;
+    chains[index] = buckets[bucket];
+    buckets[bucket] = index;
+  }
+  return table;
+}
+
+/**
+ * Sorts the names by their DT_GNU_HASH bucket, as the symbols of a bucket must
+ * be contiguous in the symbol table.
+ */
+std::vector<std::string> sortByGnuBucket(std::vector<std::string> names,
+                                         Elf32_Word numBuckets) {
+  std::stable_sort(names.begin(), names.end(),
+                   [numBuckets](const std::string &a, const std::string &b) {
+                     return (gnuHash(a.c_str()) % numBuckets) <
+                            (gnuHash(b.c_str()) % numBuckets);
+                   });
+  return names;
+}
+
+/**
+ * Builds a DT_GNU_HASH table as a linker does for names sorted by
+ * sortByGnuBucket(), with every symbol after the undefined one hashed.
+ */
+std::vector<Elf32_Word> buildGnuHashTable(
+    const std::vector<std::string> &names, Elf32_Word numBuckets,
+    Elf32_Word bloomSize, Elf32_Word bloomShift) {
+  constexpr Elf32_Word kSymbolOffset = 1;
+  constexpr uint32_t kBloomWordBits = 8 * sizeof(Elf32_Addr);
+  static_assert(sizeof(Elf32_Addr) == sizeof(Elf32_Word),
+                "The bloom filter of ELF32 has words of 32 bits");
+
+  std::vector<Elf32_Word> table(4 + bloomSize + numBuckets + names.size(), 0);
+  table[0] = numBuckets;
+  table[1] = kSymbolOffset;
+  table[2] = bloomSize;
+  table[3] = bloomShift;
+  Elf32_Word *bloom = &table[4];
+  Elf32_Word *buckets = &bloom[bloomSize];
+  Elf32_Word *hashValues = &buckets[numBuckets];
+
+  for (size_t i = 0; i < names.size(); i++) {
+    uint32_t hash = gnuHash(names[i].c_str());
+    Elf32_Word bucket = hash % numBuckets;
+    bloom[(hash / kBloomWordBits) % bloomSize] |=
+        (1u << (hash % kBloomWordBits)) |
+        (1u << ((hash >> bloomShift) % kBloomWordBits));
+    if (buckets[bucket] == 0) {
+      buckets[bucket] = static_cast<Elf32_Word>(i + kSymbolOffset);
+    }
+
+    bool lastInBucket = (i + 1 == names.size()) ||
+                        (gnuHash(names[i + 1].c_str()) % numBuckets != bucket);
+    hashValues[i] = lastInBucket ? (hash | 1) : (hash & ~1u);
+  }
+  return table;
+}
+
+}  // namespace
+
+TEST(NanoappLoaderSymbols, ExportedDataIsSorted) {
+  std::vector<ExportedData> exportedData;
+  for (const char *name : kExportedNames) {
+    exportedData.push_back({nullptr, name});
+  }
+  EXPECT_TRUE(isExportedDataSorted(exportedData.data(), exportedData.size()));
+
+  std::swap(exportedData[0], exportedData[1]);
+  EXPECT_FALSE(isExportedDataSorted(exportedData.data(), exportedData.size()));
+}
+
+TEST(NanoappLoaderSymbols, FindExportedDataFindsEverySymbol) {
+  std::vector<ExportedData> exportedData;
+  for (const char *name : kExportedNames) {
+    exportedData.push_back({nullptr, name});
+  }
+
+  for (const ExportedData &entry : exportedData) {
+    std::string name = entry.dataName;
+    EXPECT_EQ(findExportedData(exportedData.data(), exportedData.size(),
+                               name.c_str()),
+              &entry)
+        << name;
+    EXPECT_EQ(findExportedData(exportedData.data(), exportedData.size(),
+                               (name + "_").c_str()),
+              nullptr)
+        << name;
+  }
+  EXPECT_EQ(findExportedData(exportedData.data(), exportedData.size(), ""),
+            nullptr);
+  EXPECT_EQ(findExportedData(exportedData.data(), 0, kExportedNames[0]),
+            nullptr);
+}
+
+TEST(NanoappLoaderSymbols, SysvHashLookupFindsEverySymbol) {
+  std::vector<std::string> names = exportedNames();
+  SymbolTables tables(names);
+
+  for (Elf32_Word numBuckets : {1, 3, 17, 128}) {
+    std::vector<Elf32_Word> hashTable = buildSysvHashTable(names, numBuckets);
+    for (const std::string &name : names) {
+      const Elf32_Sym *symbol = sysvHashLookup(
+          hashTable.data(), tables.symbols(), tables.strings(), name.c_str());
+      ASSERT_NE(symbol, nullptr) << name << " buckets " << numBuckets;
+      EXPECT_STREQ(tables.name(symbol), name.c_str());
+      EXPECT_EQ(sysvHashLookup(hashTable.data(), tables.symbols(),
+                               tables.strings(), (name + "_").c_str()),
+                nullptr);
+    }
+  }
+}
+
+TEST(NanoappLoaderSymbols, GnuHashLookupFindsEverySymbol) {
+  for (Elf32_Word numBuckets : {1, 3, 17, 128}) {
+    std::vector<std::string> names =
+        sortByGnuBucket(exportedNames(), numBuckets);
+    SymbolTables tables(names);
+
+    for (Elf32_Word bloomSize : {1, 4}) {
+      std::vector<Elf32_Word> hashTable =
+          buildGnuHashTable(names, numBuckets, bloomSize, 6 /* bloomShift */);
+      for (const std::string &name : names) {
+        const Elf32_Sym *symbol = gnuHashLookup(
+            hashTable.data(), tables.symbols(), tables.strings(), name.c_str());
+        ASSERT_NE(symbol, nullptr)
+            << name << " buckets " << numBuckets << " bloom " << bloomSize;
+        EXPECT_STREQ(tables.name(symbol), name.c_str());
+        EXPECT_EQ(gnuHashLookup(hashTable.data(), tables.symbols(),
+                                tables.strings(), (name + "_").c_str()),
+                  nullptr);
+      }
+    }
+  }
+}
+
+TEST(NanoappLoaderSymbols, HashLookupsSkipUndefinedSymbols) {
+  std::vector<std::string> names = {"chreGetTime"};
+  std::vector<Elf32_Word> sysvTable = buildSysvHashTable(names, 1);
+  std::vector<Elf32_Word> gnuTable = buildGnuHashTable(names, 1, 1, 6);
+  SymbolTables tables(names);
+  std::vector<Elf32_Sym> undefinedSymbols(tables.symbols(),
+                                          tables.symbols() + 2);
+  undefinedSymbols[1].st_shndx = SHN_UNDEF;
+
+  EXPECT_EQ(sysvHashLookup(sysvTable.data(), undefinedSymbols.data(),
+                           tables.strings(), "chreGetTime"),
+            nullptr);
+  EXPECT_EQ(gnuHashLookup(gnuTable.data(), undefinedSymbols.data(),
+                          tables.strings(), "chreGetTime"),
+            nullptr);
+}
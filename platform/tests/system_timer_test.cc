@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <signal.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "chre/platform/log.h"
+#include "chre/platform/system_timer.h"
+
+namespace chre {
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+//! Records when a timer fired, and allows waiting for it.
+struct FireRecord {
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::atomic<uint32_t> count{0};
+  Clock::time_point fireTime;
+
+  void onFired() {
+    std::lock_guard<std::mutex> lock(mutex);
+    fireTime = Clock::now();
+    count++;
+    condition.notify_all();
+  }
+
+  bool waitForCount(uint32_t expectedCount) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return condition.wait_for(lock, std::chrono::seconds(1), [&] {
+      return count >= expectedCount;
+    });
+  }
+};
+
+void timerCallback(void *data) {
+  static_cast<FireRecord *>(data)->onFired();
+}
+
+//! A timer callback that holds up the dispatcher thread until released, so
+//! that tests can control when expirations are dispatched.
+struct Blocker {
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool running = false;
+  bool released = false;
+  std::atomic<bool> finished{false};
+
+  static void callback(void *data) {
+    auto *blocker = static_cast<Blocker *>(data);
+    {
+      std::unique_lock<std::mutex> lock(blocker->mutex);
+      blocker->running = true;
+      blocker->condition.notify_all();
+      blocker->condition.wait(lock, [blocker] { return blocker->released; });
+    }
+    blocker->finished = true;
+  }
+
+  void waitUntilRunning() {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return running; });
+  }
+
+  void release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    released = true;
+    condition.notify_all();
+  }
+};
+
+//! Waits until the timerfd of the given timer has expired. This doesn't
+//! depend on when the dispatcher gets to the expiration.
+void waitForExpiry(SystemTimer &timer) {
+  while (timer.isActive()) {
+    std::this_thread::yield();
+  }
+}
+
+/**
+ * Waits until the dispatcher has invoked the callback of every timer that
+ * expired before this call. A probe timer may be dispatched in the same batch
+ * as such a timer, and ahead of it, so a second probe is armed once the first
+ * has fired: it can only be returned by a later batch.
+ */
+void flushDispatcher() {
+  SystemTimer probe;
+  FireRecord record;
+  ASSERT_TRUE(probe.init());
+  for (uint32_t i = 1; i <= 2; i++) {
+    ASSERT_TRUE(probe.set(timerCallback, &record, Nanoseconds(0)));
+    ASSERT_TRUE(record.waitForCount(i));
+  }
+}
+
+/**
+ * Holds up the dispatcher in the callback of a blocker timer, so that the
+ * given timer can expire and be re-armed or cancelled before the dispatcher
+ * sees the expiration.
+ */
+template <typename Function>
+void whileDispatcherBlocked(Function function) {
+  SystemTimer blockerTimer;
+  Blocker blocker;
+  ASSERT_TRUE(blockerTimer.init());
+  ASSERT_TRUE(blockerTimer.set(Blocker::callback, &blocker, Nanoseconds(0)));
+  blocker.waitUntilRunning();
+  function();
+  blocker.release();
+}
+
+void posixTimerCallback(union sigval value) {
+  static_cast<FireRecord *>(value.sival_ptr)->onFired();
+}
+
+struct LatencyStats {
+  uint64_t averageNs;
+  uint64_t maxNs;
+};
+
+/**
+ * Repeatedly arms a timer and measures how late it fires.
+ *
+ * @param arm Arms the timer to fire after the given delay.
+ * @param record The record updated by the timer callback.
+ */
+template <typename ArmFunction>
+LatencyStats measureLatency(ArmFunction arm, FireRecord *record) {
+  constexpr uint32_t kIterations = 200;
+  constexpr std::chrono::microseconds kDelay(500);
+  uint64_t totalNs = 0;
+  uint64_t maxNs = 0;
+
+  for (uint32_t i = 0; i < kIterations; i++) {
+    Clock::time_point deadline = Clock::now() + kDelay;
+    arm(std::chrono::duration_cast<std::chrono::nanoseconds>(kDelay).count());
+    EXPECT_TRUE(record->waitForCount(i + 1));
+
+    std::lock_guard<std::mutex> lock(record->mutex);
+    uint64_t latencyNs =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::max(record->fireTime - deadline, Clock::duration::zero()))
+            .count();
+    totalNs += latencyNs;
+    maxNs = std::max(maxNs, latencyNs);
+  }
+
+  return LatencyStats{totalNs / kIterations, maxNs};
+}
+
+}  // namespace
+
+TEST(SystemTimer, FiresAfterDelay) {
+  SystemTimer timer;
+  FireRecord record;
+  ASSERT_TRUE(timer.init());
+
+  Clock::time_point start = Clock::now();
+  ASSERT_TRUE(timer.set(timerCallback, &record, Nanoseconds(Milliseconds(2))));
+  ASSERT_TRUE(record.waitForCount(1));
+  EXPECT_GE(record.fireTime - start, std::chrono::milliseconds(2));
+  EXPECT_FALSE(timer.isActive());
+}
+
+TEST(SystemTimer, CancelPreventsCallback) {
+  SystemTimer timer;
+  FireRecord record;
+  ASSERT_TRUE(timer.init());
+
+  ASSERT_TRUE(timer.set(timerCallback, &record, Nanoseconds(Milliseconds(10))));
+  EXPECT_TRUE(timer.isActive());
+  EXPECT_TRUE(timer.cancel());
+  EXPECT_FALSE(timer.isActive());
+
+  flushDispatcher();
+  EXPECT_EQ(record.count, 0);
+}
+
+TEST(SystemTimer, CancelDropsUndispatchedExpiry) {
+  SystemTimer timer;
+  FireRecord record;
+  ASSERT_TRUE(timer.init());
+
+  whileDispatcherBlocked([&] {
+    ASSERT_TRUE(timer.set(timerCallback, &record, Nanoseconds(0)));
+    waitForExpiry(timer);
+    EXPECT_TRUE(timer.cancel());
+  });
+
+  flushDispatcher();
+  EXPECT_EQ(record.count, 0);
+}
+
+TEST(SystemTimer, SetReplacesPendingExpiry) {
+  SystemTimer timer;
+  FireRecord record;
+  ASSERT_TRUE(timer.init());
+
+  whileDispatcherBlocked([&] {
+    ASSERT_TRUE(timer.set(timerCallback, &record, Nanoseconds(0)));
+    waitForExpiry(timer);
+    ASSERT_TRUE(timer.set(timerCallback, &record, Nanoseconds(0)));
+    waitForExpiry(timer);
+  });
+
+  flushDispatcher();
+  EXPECT_EQ(record.count, 1);
+}
+
+//! A timer whose callback cancels another timer.
+struct CancellingTimer {
+  SystemTimer timer;
+  SystemTimer *otherTimer;
+  FireRecord record;
+
+  static void callback(void *data) {
+    auto *self = static_cast<CancellingTimer *>(data);
+    EXPECT_TRUE(self->otherTimer->cancel());
+    self->record.onFired();
+  }
+};
+
+TEST(SystemTimer, CancelFromCallbackDropsExpiryOfSameTick) {
+  CancellingTimer first;
+  CancellingTimer second;
+  first.otherTimer = &second.timer;
+  second.otherTimer = &first.timer;
+  ASSERT_TRUE(first.timer.init());
+  ASSERT_TRUE(second.timer.init());
+
+  // Both timers expire while the dispatcher is held up, so it handles them in
+  // the same pass. Whichever is invoked first cancels the other.
+  whileDispatcherBlocked([&] {
+    ASSERT_TRUE(first.timer.set(CancellingTimer::callback, &first,
+                                Nanoseconds(0)));
+    ASSERT_TRUE(second.timer.set(CancellingTimer::callback, &second,
+                                 Nanoseconds(0)));
+    waitForExpiry(first.timer);
+    waitForExpiry(second.timer);
+  });
+
+  flushDispatcher();
+  EXPECT_EQ(first.record.count + second.record.count, 1);
+}
+
+//! A timer whose callback initializes, sets and destroys other timers, and
+//! finally destroys its own.
+struct SelfManagingTimer {
+  std::unique_ptr<SystemTimer> timer;
+  SystemTimer *otherTimer;
+  FireRecord *otherRecord;
+  FireRecord record;
+
+  static void callback(void *data) {
+    auto *self = static_cast<SelfManagingTimer *>(data);
+    {
+      SystemTimer scratch;
+      EXPECT_TRUE(scratch.init());
+    }
+    EXPECT_TRUE(self->otherTimer->set(timerCallback, self->otherRecord,
+                                      Nanoseconds(0)));
+    self->timer.reset();
+    self->record.onFired();
+  }
+};
+
+TEST(SystemTimer, CallbackCanManageTimers) {
+  SystemTimer otherTimer;
+  FireRecord otherRecord;
+  ASSERT_TRUE(otherTimer.init());
+
+  SelfManagingTimer self;
+  self.timer.reset(new SystemTimer());
+  self.otherTimer = &otherTimer;
+  self.otherRecord = &otherRecord;
+  ASSERT_TRUE(self.timer->init());
+  ASSERT_TRUE(
+      self.timer->set(SelfManagingTimer::callback, &self, Nanoseconds(0)));
+
+  ASSERT_TRUE(self.record.waitForCount(1));
+  EXPECT_TRUE(otherRecord.waitForCount(1));
+}
+
+TEST(SystemTimer, DestroyWaitsForRunningCallback) {
+  auto timer = std::unique_ptr<SystemTimer>(new SystemTimer());
+  Blocker blocker;
+  ASSERT_TRUE(timer->init());
+  ASSERT_TRUE(timer->set(Blocker::callback, &blocker, Nanoseconds(0)));
+  blocker.waitUntilRunning();
+
+  std::atomic<bool> finishedBeforeDestroy(false);
+  std::thread destroyer([&] {
+    timer.reset();
+    finishedBeforeDestroy = blocker.finished.load();
+  });
+
+  // The destroyer may not be waiting yet when the callback is released, but
+  // it must not return before the callback does in either case.
+  blocker.release();
+  destroyer.join();
+  EXPECT_TRUE(finishedBeforeDestroy);
+}
+
+TEST(SystemTimer, ManyTimersFire) {
+  constexpr size_t kNumTimers = 16;
+  SystemTimer timers[kNumTimers];
+  FireRecord records[kNumTimers];
+
+  for (size_t i = 0; i < kNumTimers; i++) {
+    ASSERT_TRUE(timers[i].init());
+    ASSERT_TRUE(timers[i].set(timerCallback, &records[i],
+                              Nanoseconds(Milliseconds(1 + i % 4))));
+  }
+  for (size_t i = 0; i < kNumTimers; i++) {
+    EXPECT_TRUE(records[i].waitForCount(1));
+  }
+}
+
+//! Compares the expiry latency of SystemTimer with a POSIX timer using
+//! SIGEV_THREAD notification, which SystemTimer used previously on Linux.
+TEST(SystemTimer, LatencyBenchmark) {
+  SystemTimer timer;
+  FireRecord timerRecord;
+  ASSERT_TRUE(timer.init());
+  LatencyStats timerStats = measureLatency(
+      [&](uint64_t delayNs) {
+        timer.set(timerCallback, &timerRecord, Nanoseconds(delayNs));
+      },
+      &timerRecord);
+
+  FireRecord posixRecord;
+  struct sigevent sigevt = {};
+  sigevt.sigev_notify = SIGEV_THREAD;
+  sigevt.sigev_value.sival_ptr = &posixRecord;
+  sigevt.sigev_notify_function = posixTimerCallback;
+  timer_t posixTimer;
+  ASSERT_EQ(timer_create(CLOCK_MONOTONIC, &sigevt, &posixTimer), 0);
+  LatencyStats posixStats = measureLatency(
+      [&](uint64_t delayNs) {
+        struct itimerspec spec = {};
+        spec.it_value.tv_nsec = static_cast<long>(delayNs);
+        timer_settime(posixTimer, 0 /* flags */, &spec, nullptr);
+      },
+      &posixRecord);
+  timer_delete(posixTimer);
+
+  LOGI("Timer latency: timerfd avg %" PRIu64 "us max %" PRIu64
+       "us, SIGEV_THREAD avg %" PRIu64 "us max %" PRIu64 "us",
+       timerStats.averageNs / 1000, timerStats.maxNs / 1000,
+       posixStats.averageNs / 1000, posixStats.maxNs / 1000);
+}
+
+}  // namespace chre
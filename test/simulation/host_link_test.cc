@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "chre/core/event_loop_manager.h"
+#include "chre/platform/shared/generated/host_messages_generated.h"
+#include "chre/platform/shared/host_protocol_common.h"
+#include "chre/test/simulation/test_base.h"
+#include "chre/util/flatbuffers/helpers.h"
+#include "chre_api/chre.h"
+
+namespace chre {
+namespace {
+
+constexpr uint64_t kAppId = 0x0123456789abcdef;
+constexpr uint32_t kMessageType = 1234;
+constexpr uint16_t kHostEndpoint = 0x8001;
+constexpr size_t kNumMessages = 20;
+
+uint8_t gMessageData[kNumMessages];
+std::atomic<size_t> gNumMessagesFreed;
+std::atomic<bool> gReceivedFromHost;
+std::vector<uint8_t> gDataFromHost;
+
+void messageFreeCallback(void * /*message*/, size_t /*messageSize*/) {
+  gNumMessagesFreed++;
+}
+
+//! Sends kNumMessages messages to the host, each holding its own index.
+bool sendingNanoappStart() {
+  bool success = true;
+  for (size_t i = 0; i < kNumMessages && success; i++) {
+    gMessageData[i] = static_cast<uint8_t>(i);
+    success = chreSendMessageToHostEndpoint(
+        &gMessageData[i], sizeof(gMessageData[i]), kMessageType,
+        CHRE_HOST_ENDPOINT_BROADCAST, messageFreeCallback);
+  }
+
+  return success;
+}
+
+bool receivingNanoappStart() {
+  return true;
+}
+
+void nanoappHandleEvent(uint32_t /*senderInstanceId*/, uint16_t eventType,
+                        const void *eventData) {
+  if (eventType == CHRE_EVENT_MESSAGE_FROM_HOST) {
+    auto *message = static_cast<const chreMessageFromHostData *>(eventData);
+    auto *data = static_cast<const uint8_t *>(message->message);
+    gDataFromHost.assign(data, data + message->messageSize);
+    gReceivedFromHost = true;
+  }
+}
+
+void nanoappEnd() {}
+
+class HostLinkTest : public TestBase {
+ protected:
+  void SetUp() override {
+    TestBase::SetUp();
+    gNumMessagesFreed = 0;
+    gReceivedFromHost = false;
+    gDataFromHost.clear();
+
+    mSocketPath = testing::TempDir() + "chre_host_link_test_" +
+                  std::to_string(getpid());
+    unlink(mSocketPath.c_str());
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    ASSERT_LT(mSocketPath.size(), sizeof(address.sun_path));
+    strcpy(address.sun_path, mSocketPath.c_str());
+
+    mListenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    ASSERT_GE(mListenFd, 0);
+    ASSERT_EQ(bind(mListenFd, reinterpret_cast<struct sockaddr *>(&address),
+                   sizeof(address)),
+              0);
+    ASSERT_EQ(listen(mListenFd, 1), 0);
+
+    ASSERT_TRUE(getHostCommsManager().connect(mSocketPath.c_str()));
+    mHostFd = accept(mListenFd, nullptr, nullptr);
+    ASSERT_GE(mHostFd, 0);
+  }
+
+  void TearDown() override {
+    // Same order as the simulator: the link is stopped while the event loop
+    // can still free completed messages.
+    getHostCommsManager().disconnect();
+    TestBase::TearDown();
+
+    close(mHostFd);
+    close(mListenFd);
+    unlink(mSocketPath.c_str());
+  }
+
+  HostCommsManager &getHostCommsManager() {
+    return EventLoopManagerSingleton::get()->getHostCommsManager();
+  }
+
+  /**
+   * @return The file descriptor of the socket the host link connected to the
+   *         host with, i.e. the one whose peer is the host socket, or -1.
+   */
+  int findLinkSocket() {
+    for (int fd = 0; fd < 1024; fd++) {
+      struct sockaddr_un address = {};
+      socklen_t length = sizeof(address);
+      if (getpeername(fd, reinterpret_cast<struct sockaddr *>(&address),
+                      &length) == 0 &&
+          address.sun_family == AF_UNIX &&
+          mSocketPath == address.sun_path) {
+        return fd;
+      }
+    }
+    return -1;
+  }
+
+  std::string mSocketPath;
+  int mListenFd = -1;
+  int mHostFd = -1;
+};
+
+TEST_F(HostLinkTest, DeliversEveryMessageToTheHostInOrder) {
+  startNanoapp(kAppId, sendingNanoappStart, nanoappHandleEvent, nanoappEnd);
+
+  uint8_t buffer[256];
+  for (size_t i = 0; i < kNumMessages; i++) {
+    ssize_t size = recv(mHostFd, buffer, sizeof(buffer), 0);
+    ASSERT_GT(size, 0);
+    ASSERT_TRUE(HostProtocolCommon::verifyMessage(buffer, size));
+
+    const fbs::MessageContainer *container = fbs::GetMessageContainer(buffer);
+    ASSERT_EQ(container->message_type(), fbs::ChreMessage::NanoappMessage);
+    const auto *message =
+        static_cast<const fbs::NanoappMessage *>(container->message());
+    EXPECT_EQ(message->app_id(), kAppId);
+    EXPECT_EQ(message->message_type(), kMessageType);
+    EXPECT_EQ(message->host_endpoint(), CHRE_HOST_ENDPOINT_BROADCAST);
+    ASSERT_EQ(message->message()->size(), 1);
+    EXPECT_EQ(message->message()->Get(0), i);
+  }
+
+  EXPECT_TRUE(waitFor([] { return gNumMessagesFreed == kNumMessages; }));
+}
+
+TEST_F(HostLinkTest, DisconnectFreesQueuedMessages) {
+  startNanoapp(kAppId, sendingNanoappStart, nanoappHandleEvent, nanoappEnd);
+
+  // The host never reads, so messages may still be queued. They must all be
+  // completed and freed through the still-running event loop.
+  getHostCommsManager().disconnect();
+  EXPECT_TRUE(waitFor([] { return gNumMessagesFreed == kNumMessages; }));
+}
+
+TEST_F(HostLinkTest, UnloadDoesNotWaitForAHostThatIsNotReading) {
+  // Shrinks the send buffer of the link, so that it fills up with a few
+  // messages.
+  int linkFd = findLinkSocket();
+  ASSERT_GE(linkFd, 0);
+  int sendBufferSize = 0;
+  ASSERT_EQ(setsockopt(linkFd, SOL_SOCKET, SO_SNDBUF, &sendBufferSize,
+                       sizeof(sendBufferSize)),
+            0);
+
+  uint32_t instanceId = startNanoapp(kAppId, sendingNanoappStart,
+                                     nanoappHandleEvent, nanoappEnd);
+
+  // The host never reads, so the socket fills up before every message is
+  // written. Unloading the nanoapp must still complete, and free every message.
+  auto start = std::chrono::steady_clock::now();
+  runInEventLoop([instanceId] {
+    EXPECT_TRUE(EventLoopManagerSingleton::get()->getEventLoop().unloadNanoapp(
+        instanceId, true /* allowSystemNanoappUnload */));
+  });
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+  EXPECT_EQ(gNumMessagesFreed, kNumMessages);
+}
+
+TEST_F(HostLinkTest, DeliversMessagesFromTheHost) {
+  startNanoapp(kAppId, receivingNanoappStart, nanoappHandleEvent, nanoappEnd);
+
+  const uint8_t data[] = {1, 2, 3, 4};
+  ChreFlatBufferBuilder builder;
+  HostProtocolCommon::encodeNanoappMessage(builder, kAppId, kMessageType,
+                                           kHostEndpoint, data, sizeof(data));
+  ASSERT_EQ(send(mHostFd, builder.GetBufferPointer(), builder.GetSize(), 0),
+            static_cast<ssize_t>(builder.GetSize()));
+
+  ASSERT_TRUE(waitFor([] { return gReceivedFromHost.load(); }));
+  EXPECT_EQ(gDataFromHost, std::vector<uint8_t>(data, data + sizeof(data)));
+}
+
+}  // namespace
+}  // namespace chre
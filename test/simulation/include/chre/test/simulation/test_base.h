@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_TEST_SIMULATION_TEST_BASE_H_
+#define CHRE_TEST_SIMULATION_TEST_BASE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "chre/platform/shared/nanoapp_support_lib_dso.h"
+
+namespace chre {
+
+/**
+ * A test fixture that runs the full CHRE of the Linux simulator. CHRE is
+ * initialized and its event loop is run in a dedicated thread for the duration
+ * of each test, so tests exercise the same code paths as nanoapps do.
+ */
+class TestBase : public testing::Test {
+ protected:
+  void SetUp() override;
+  void TearDown() override;
+
+  /**
+   * Runs a function in the context of the event loop thread and waits for it
+   * to return.
+   */
+  void runInEventLoop(const std::function<void()> &function);
+
+  /**
+   * Starts a test nanoapp with the given entry points.
+   *
+   * @return The instance ID of the nanoapp.
+   */
+  uint32_t startNanoapp(uint64_t appId, chreNanoappStartFunction *start,
+                        chreNanoappHandleEventFunction *handleEvent,
+                        chreNanoappEndFunction *end);
+
+  /**
+   * Blocks until the given condition holds, checking it periodically.
+   *
+   * @return false if the condition did not hold within kWaitTimeout.
+   */
+  bool waitFor(const std::function<bool()> &condition);
+
+ private:
+  //! Bounds waitFor() so that a broken test fails rather than hangs.
+  static constexpr std::chrono::seconds kWaitTimeout{5};
+
+  //! The thread that runs the event loop.
+  std::thread mChreThread;
+
+  //! The app info of the nanoapps started by the test, which must outlive them.
+  std::deque<chreNslNanoappInfo> mAppInfos;
+};
+
+}  // namespace chre
+
+#endif  // CHRE_TEST_SIMULATION_TEST_BASE_H_
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "chre/core/event_loop_manager.h"
+#include "chre/platform/log.h"
+#include "chre/platform/shared/generated/host_messages_generated.h"
+#include "chre/platform/shared/host_protocol_common.h"
+#include "chre/platform/shared/log_buffer_manager.h"
+#include "chre/test/simulation/test_base.h"
+
+namespace chre {
+namespace {
+
+//! The number of bytes of each log entry before its text: the log level and
+//! the timestamp.
+constexpr size_t kBytesBeforeLogData = 5;
+
+constexpr size_t kLogsPerProducer = 20000;
+
+uint8_t gPrimaryLogBufferData[CHRE_LOG_BUFFER_DATA_SIZE];
+uint8_t gSecondaryLogBufferData[CHRE_LOG_BUFFER_DATA_SIZE];
+
+/**
+ * Runs the LogBufferManager with its send logs to host loop, and a host that
+ * receives the logs it sends through the Linux host link.
+ */
+class LogBufferManagerTest : public TestBase {
+ protected:
+  void SetUp() override {
+    TestBase::SetUp();
+    mNumLogs = 0;
+    mNumLogsReceived = 0;
+    mNumLogsDropped = 0;
+    mLogsOutOfOrder = false;
+    mNextLogIndex.clear();
+
+    mSocketPath = testing::TempDir() + "chre_log_buffer_manager_test_" +
+                  std::to_string(getpid());
+    unlink(mSocketPath.c_str());
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    ASSERT_LT(mSocketPath.size(), sizeof(address.sun_path));
+    strcpy(address.sun_path, mSocketPath.c_str());
+
+    mListenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    ASSERT_GE(mListenFd, 0);
+    ASSERT_EQ(bind(mListenFd, reinterpret_cast<struct sockaddr *>(&address),
+                   sizeof(address)),
+              0);
+    ASSERT_EQ(listen(mListenFd, 1), 0);
+
+    ASSERT_TRUE(getHostCommsManager().connect(mSocketPath.c_str()));
+    mHostFd = accept(mListenFd, nullptr, nullptr);
+    ASSERT_GE(mHostFd, 0);
+    mHostThread = std::thread(&LogBufferManagerTest::hostLooper, this);
+
+    LogBufferManagerSingleton::init(gPrimaryLogBufferData,
+                                    gSecondaryLogBufferData,
+                                    sizeof(gPrimaryLogBufferData));
+    mSendLogsThread = std::thread(
+        [] { LogBufferManagerSingleton::get()->startSendLogsToHostLoop(); });
+  }
+
+  void TearDown() override {
+    if (mSendLogsThread.joinable()) {
+      LogBufferManagerSingleton::get()->stopSendLogsToHostLoop();
+      mSendLogsThread.join();
+    }
+    if (LogBufferManagerSingleton::isInitialized()) {
+      LogBufferManagerSingleton::deinit();
+    }
+
+    getHostCommsManager().disconnect();
+    TestBase::TearDown();
+
+    // The host thread exits once the link has closed the socket.
+    if (mHostThread.joinable()) {
+      mHostThread.join();
+    }
+    close(mHostFd);
+    close(mListenFd);
+    unlink(mSocketPath.c_str());
+  }
+
+  HostCommsManager &getHostCommsManager() {
+    return EventLoopManagerSingleton::get()->getHostCommsManager();
+  }
+
+  /**
+   * Logs "producer <producer> log <index>" for each index from 0 to numLogs.
+   * The caller adds the logs to mNumLogs.
+   */
+  static void logFromProducer(uint32_t producer, size_t numLogs) {
+    for (size_t i = 0; i < numLogs; i++) {
+      LogBufferManagerSingleton::get()->log(
+          CHRE_LOG_INFO, "producer %" PRIu32 " log %zu, some padding text",
+          producer, i);
+    }
+  }
+
+  /**
+   * Logs dropped by the LogBufferManager are only reported to the host along
+   * with the next logs it sends, so this keeps logging until every log has
+   * been received by the host or reported as dropped.
+   *
+   * @return true if every log was accounted for within the waitFor() timeout.
+   */
+  bool waitForLogs() {
+    return waitFor([this] {
+      bool allLogsReceived;
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        allLogsReceived = (mNumLogsReceived + mNumLogsDropped == mNumLogs);
+      }
+      if (!allLogsReceived) {
+        LogBufferManagerSingleton::get()->log(CHRE_LOG_INFO, "waiting");
+        mNumLogs++;
+      }
+      return allLogsReceived;
+    });
+  }
+
+  //! The number of logs made through the LogBufferManager by the test.
+  size_t mNumLogs;
+
+  //! Guards the fields below, which are updated by the host thread.
+  std::mutex mMutex;
+  size_t mNumLogsReceived;
+  size_t mNumLogsDropped;
+  bool mLogsOutOfOrder;
+  std::vector<size_t> mNextLogIndex;
+
+ private:
+  /**
+   * Receives the log messages sent to the host and checks that the logs of
+   * each producer are received in order.
+   */
+  void hostLooper() {
+    std::vector<uint8_t> buffer(2 * CHRE_LOG_BUFFER_DATA_SIZE);
+    while (true) {
+      ssize_t size = recv(mHostFd, buffer.data(), buffer.size(), 0);
+      if (size <= 0) {
+        break;
+      }
+      ASSERT_TRUE(HostProtocolCommon::verifyMessage(buffer.data(), size));
+      const fbs::MessageContainer *container =
+          fbs::GetMessageContainer(buffer.data());
+      ASSERT_EQ(container->message_type(), fbs::ChreMessage::LogMessageV2);
+      const auto *message =
+          static_cast<const fbs::LogMessageV2 *>(container->message());
+      const flatbuffers::Vector<int8_t> *logs = message->buffer();
+
+      std::lock_guard<std::mutex> lock(mMutex);
+      mNumLogsDropped = message->num_logs_dropped();
+      size_t offset = 0;
+      while (offset < logs->size()) {
+        const char *text =
+            reinterpret_cast<const char *>(logs->data()) + offset +
+            kBytesBeforeLogData;
+        uint32_t producer;
+        size_t index;
+        if (sscanf(text, "producer %" SCNu32 " log %zu", &producer, &index) ==
+            2) {
+          if (producer >= mNextLogIndex.size()) {
+            mNextLogIndex.resize(producer + 1, 0);
+          }
+          mLogsOutOfOrder |= (index < mNextLogIndex[producer]);
+          mNextLogIndex[producer] = index + 1;
+        }
+        mNumLogsReceived++;
+        offset += kBytesBeforeLogData + strlen(text) + 1;
+      }
+    }
+  }
+
+  std::string mSocketPath;
+  int mListenFd = -1;
+  int mHostFd = -1;
+  std::thread mHostThread;
+  std::thread mSendLogsThread;
+};
+
+TEST_F(LogBufferManagerTest, LogsAreSentToTheHost) {
+  // Few enough logs to fit in the buffer, so that none are dropped.
+  constexpr size_t kNumLogs = 20;
+  logFromProducer(0 /* producer */, kNumLogs);
+  mNumLogs += kNumLogs;
+
+  ASSERT_TRUE(waitForLogs());
+  std::lock_guard<std::mutex> lock(mMutex);
+  EXPECT_EQ(mNumLogsReceived, mNumLogs);
+  EXPECT_EQ(mNumLogsDropped, 0);
+  ASSERT_EQ(mNextLogIndex.size(), 1);
+  EXPECT_EQ(mNextLogIndex[0], kNumLogs);
+  EXPECT_FALSE(mLogsOutOfOrder);
+}
+
+//! Measures the cost of logging from 1-8 threads through the LogBufferManager
+//! while it sends the logs to the host.
+TEST_F(LogBufferManagerTest, MultiThreadedThroughput) {
+  constexpr uint32_t kProducerCounts[] = {1, 2, 4, 8};
+
+  uint32_t firstProducer = 0;
+  for (uint32_t producerCount : kProducerCounts) {
+    size_t numLogsReceived;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      numLogsReceived = mNumLogsReceived;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (uint32_t p = firstProducer; p < firstProducer + producerCount; p++) {
+      producers.emplace_back(logFromProducer, p, kLogsPerProducer);
+    }
+    for (std::thread &producer : producers) {
+      producer.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    size_t numLogs = producerCount * kLogsPerProducer;
+    mNumLogs += numLogs;
+    ASSERT_TRUE(waitForLogs());
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    EXPECT_FALSE(mLogsOutOfOrder);
+    uint64_t elapsedNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count());
+    LOGI("%" PRIu32 " producers: %" PRIu64 " ns/log (%zu sent to the host)",
+         producerCount, elapsedNs / numLogs,
+         mNumLogsReceived - numLogsReceived);
+    firstProducer += producerCount;
+  }
+}
+
+}  // namespace
+}  // namespace chre
@@ -0,0 +1,380 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <future>
+#include <mutex>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "chre/core/event_loop_manager.h"
+#include "chre/core/sensor_request.h"
+#include "chre/platform/linux/pal_sensor.h"
+#include "chre/test/simulation/test_base.h"
+#include "chre/util/time.h"
+#include "chre_api/chre.h"
+
+namespace chre {
+namespace {
+
+//! The interval that the fast nanoapps request, which the sensor samples at.
+constexpr uint64_t kSensorIntervalNs = 10 * kOneMillisecondInNanoseconds;
+
+//! The interval of the decimated nanoapp. The sensor's interval being 10 ms,
+//! samples are selected at least 45 ms apart.
+constexpr uint64_t kDecimatedIntervalNs = 50 * kOneMillisecondInNanoseconds;
+
+//! The simulated sensor PAL delivers the samples it takes itself after this
+//! latency, or after 1000 samples, i.e. well after a test completes. The data
+//! received by the nanoapps is therefore only what a test sends.
+constexpr uint64_t kLatencyNs = 60 * kOneSecondInNanoseconds;
+
+constexpr uint16_t kSamplesPerBatch = 10;
+constexpr uint64_t kBatchDurationNs = kSamplesPerBatch * kSensorIntervalNs;
+constexpr uint64_t kFirstTimestampNs = kOneSecondInNanoseconds;
+
+//! The number of data events that SensorRequestManager shares between
+//! nanoapps at once, beyond which data is broadcast.
+constexpr size_t kMaxSharedSensorDataEvents = 16;
+
+//! An accelerometer data event received by a nanoapp.
+struct ReceivedEvent {
+  const void *eventData;
+  std::vector<uint64_t> timestampsNs;
+};
+
+//! The events received by each test nanoapp, in the order received.
+constexpr size_t kNumNanoapps = 3;
+std::mutex gMutex;
+std::vector<ReceivedEvent> gReceivedEvents[kNumNanoapps];
+
+bool nanoappStart() {
+  return true;
+}
+
+template <size_t kIndex>
+void nanoappHandleEvent(uint32_t /*senderInstanceId*/, uint16_t eventType,
+                        const void *eventData) {
+  if (eventType == CHRE_EVENT_SENSOR_ACCELEROMETER_DATA) {
+    const auto *data =
+        static_cast<const chreSensorThreeAxisData *>(eventData);
+    ReceivedEvent event = {eventData, {}};
+    uint64_t timestampNs = data->header.baseTimestamp;
+    for (uint16_t i = 0; i < data->header.readingCount; i++) {
+      timestampNs += data->readings[i].timestampDelta;
+      event.timestampsNs.push_back(timestampNs);
+    }
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    gReceivedEvents[kIndex].push_back(event);
+  }
+}
+
+void nanoappEnd() {}
+
+class SensorDataDecimationTest : public TestBase {
+ protected:
+  void SetUp() override {
+    TestBase::SetUp();
+    for (std::vector<ReceivedEvent> &events : gReceivedEvents) {
+      events.clear();
+    }
+
+    mInstanceIds[0] = startNanoapp(0x0123456789000001, nanoappStart,
+                                   nanoappHandleEvent<0>, nanoappEnd);
+    mInstanceIds[1] = startNanoapp(0x0123456789000002, nanoappStart,
+                                   nanoappHandleEvent<1>, nanoappEnd);
+    mInstanceIds[2] = startNanoapp(0x0123456789000003, nanoappStart,
+                                   nanoappHandleEvent<2>, nanoappEnd);
+    runInEventLoop([this] {
+      Nanoapp *nanoapp = getNanoapp(0);
+      ASSERT_NE(nanoapp, nullptr);
+      ASSERT_TRUE(getSensorRequestManager().getSensorHandleForNanoapp(
+          CHRE_SENSOR_TYPE_ACCELEROMETER, CHRE_SENSOR_INDEX_DEFAULT, *nanoapp,
+          &mSensorHandle));
+    });
+  }
+
+  void TearDown() override {
+    for (size_t i = 0; i < kNumNanoapps; i++) {
+      setRequest(i, 0 /* intervalNs */);
+    }
+    drainEventLoop();
+
+    // Every data event was released back to the PAL exactly once.
+    EXPECT_EQ(getNumSimulatedSensorEventsPendingRelease(), 0);
+    TestBase::TearDown();
+  }
+
+  Nanoapp *getNanoapp(size_t index) {
+    return EventLoopManagerSingleton::get()
+        ->getEventLoop()
+        .findNanoappByInstanceId(mInstanceIds[index]);
+  }
+
+  /**
+   * Sets the accelerometer request of a nanoapp.
+   *
+   * @param index The index of the nanoapp.
+   * @param intervalNs The requested interval, or 0 to remove the request.
+   */
+  void setRequest(size_t index, uint64_t intervalNs) {
+    runInEventLoop([this, index, intervalNs] {
+      Nanoapp *nanoapp = getNanoapp(index);
+      ASSERT_NE(nanoapp, nullptr);
+      SensorRequest request(nanoapp->getInstanceId(), SensorMode::Off,
+                            Nanoseconds(CHRE_SENSOR_INTERVAL_DEFAULT),
+                            Nanoseconds(CHRE_SENSOR_LATENCY_DEFAULT));
+      if (intervalNs != 0) {
+        request = SensorRequest(nanoapp->getInstanceId(),
+                                SensorMode::ActiveContinuous,
+                                Nanoseconds(intervalNs),
+                                Nanoseconds(kLatencyNs));
+      }
+      EXPECT_TRUE(getSensorRequestManager().setSensorRequest(
+          nanoapp, mSensorHandle, request));
+    });
+  }
+
+  //! Sends the batch of samples that starts batchIndex batches after the
+  //! first sample, as the PAL would.
+  void sendBatch(size_t batchIndex, uint16_t numSamples = kSamplesPerBatch) {
+    ASSERT_TRUE(sendSimulatedSensorData(
+        mSensorHandle, kFirstTimestampNs + batchIndex * kBatchDurationNs,
+        kSensorIntervalNs, numSamples));
+  }
+
+  //! Waits for the events posted so far to be processed and freed.
+  void drainEventLoop() {
+    runInEventLoop([] {});
+  }
+
+  /**
+   * Keeps the event loop busy until unblockEventLoop() is invoked, so that the
+   * data events sent meanwhile are all pending at once.
+   */
+  void blockEventLoop() {
+    std::promise<void> blocked;
+    mUnblock = std::promise<void>();
+    mBlocker = {&blocked, mUnblock.get_future()};
+    auto callback = [](uint16_t /*type*/, void *data, void * /*extraData*/) {
+      auto *blocker = static_cast<Blocker *>(data);
+      blocker->blocked->set_value();
+      blocker->unblock.wait();
+    };
+    EventLoopManagerSingleton::get()->deferCallback(
+        SystemCallbackType::FirstCallbackType, &mBlocker, callback);
+    blocked.get_future().wait();
+  }
+
+  void unblockEventLoop() {
+    mUnblock.set_value();
+    drainEventLoop();
+  }
+
+  std::vector<ReceivedEvent> getReceivedEvents(size_t index) {
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gReceivedEvents[index];
+  }
+
+  uint32_t mInstanceIds[kNumNanoapps];
+  uint32_t mSensorHandle = 0;
+
+ private:
+  struct Blocker {
+    std::promise<void> *blocked;
+    std::future<void> unblock;
+  };
+
+  Blocker mBlocker;
+  std::promise<void> mUnblock;
+};
+
+//! @return The timestamps of the samples of the given batches.
+std::vector<uint64_t> getBatchTimestamps(size_t firstBatch, size_t numBatches,
+                                         uint64_t intervalNs) {
+  std::vector<uint64_t> timestampsNs;
+  for (uint64_t t = 0; t < numBatches * kBatchDurationNs; t += intervalNs) {
+    timestampsNs.push_back(kFirstTimestampNs + firstBatch * kBatchDurationNs +
+                           t);
+  }
+  return timestampsNs;
+}
+
+//! @return The timestamps of all the samples of the given events.
+std::vector<uint64_t> getTimestamps(const std::vector<ReceivedEvent> &events) {
+  std::vector<uint64_t> timestampsNs;
+  for (const ReceivedEvent &event : events) {
+    timestampsNs.insert(timestampsNs.end(), event.timestampsNs.begin(),
+                        event.timestampsNs.end());
+  }
+  return timestampsNs;
+}
+
+TEST_F(SensorDataDecimationTest, DecimatedNanoappGetsDueSamplesOnly) {
+  setRequest(0, kSensorIntervalNs);
+  setRequest(2, kDecimatedIntervalNs);
+  for (size_t i = 0; i < 4; i++) {
+    sendBatch(i);
+  }
+  drainEventLoop();
+
+  // Each nanoapp handles one event per batch, and the decimated one gets only
+  // every fifth sample in its own copy of the batch.
+  std::vector<ReceivedEvent> fastEvents = getReceivedEvents(0);
+  std::vector<ReceivedEvent> decimatedEvents = getReceivedEvents(2);
+  ASSERT_EQ(fastEvents.size(), 4);
+  ASSERT_EQ(decimatedEvents.size(), 4);
+  EXPECT_EQ(getTimestamps(fastEvents),
+            getBatchTimestamps(0, 4, kSensorIntervalNs));
+  EXPECT_EQ(getTimestamps(decimatedEvents),
+            getBatchTimestamps(0, 4, kDecimatedIntervalNs));
+  for (size_t i = 0; i < decimatedEvents.size(); i++) {
+    EXPECT_NE(decimatedEvents[i].eventData, fastEvents[i].eventData);
+  }
+  EXPECT_TRUE(getReceivedEvents(1).empty());
+}
+
+TEST_F(SensorDataDecimationTest, NanoappsAtSensorRateShareThePlatformEvent) {
+  setRequest(0, kSensorIntervalNs);
+  setRequest(1, kSensorIntervalNs);
+  setRequest(2, kDecimatedIntervalNs);
+
+  // The platform events are held until both nanoapps at the sensor's rate
+  // have processed them.
+  blockEventLoop();
+  for (size_t i = 0; i < 3; i++) {
+    sendBatch(i);
+  }
+  EXPECT_EQ(getNumSimulatedSensorEventsPendingRelease(), 3);
+  unblockEventLoop();
+  EXPECT_EQ(getNumSimulatedSensorEventsPendingRelease(), 0);
+
+  // Each of them is posted the same platform event once, rather than once
+  // as a broadcast and once more as a unicast.
+  std::vector<ReceivedEvent> firstEvents = getReceivedEvents(0);
+  std::vector<ReceivedEvent> secondEvents = getReceivedEvents(1);
+  ASSERT_EQ(firstEvents.size(), 3);
+  ASSERT_EQ(secondEvents.size(), 3);
+  for (size_t i = 0; i < firstEvents.size(); i++) {
+    EXPECT_EQ(firstEvents[i].eventData, secondEvents[i].eventData);
+    EXPECT_EQ(firstEvents[i].timestampsNs, secondEvents[i].timestampsNs);
+    EXPECT_EQ(firstEvents[i].timestampsNs,
+              getBatchTimestamps(i, 1, kSensorIntervalNs));
+  }
+  EXPECT_EQ(getReceivedEvents(2).size(), 3);
+}
+
+TEST_F(SensorDataDecimationTest, BatchWithoutDueSampleIsNotPosted) {
+  setRequest(0, kSensorIntervalNs);
+  setRequest(2, kDecimatedIntervalNs);
+
+  // Samples at 0 to 20 ms, 30 and 40 ms, and 50 and 60 ms from the first one.
+  ASSERT_TRUE(sendSimulatedSensorData(mSensorHandle, kFirstTimestampNs,
+                                      kSensorIntervalNs, 3));
+  ASSERT_TRUE(sendSimulatedSensorData(
+      mSensorHandle, kFirstTimestampNs + 3 * kSensorIntervalNs,
+      kSensorIntervalNs, 2));
+  ASSERT_TRUE(sendSimulatedSensorData(
+      mSensorHandle, kFirstTimestampNs + 5 * kSensorIntervalNs,
+      kSensorIntervalNs, 2));
+  drainEventLoop();
+
+  EXPECT_EQ(getReceivedEvents(0).size(), 3);
+  std::vector<ReceivedEvent> decimatedEvents = getReceivedEvents(2);
+  ASSERT_EQ(decimatedEvents.size(), 2);
+  EXPECT_EQ(decimatedEvents[0].timestampsNs,
+            std::vector<uint64_t>{kFirstTimestampNs});
+  EXPECT_EQ(decimatedEvents[1].timestampsNs,
+            std::vector<uint64_t>{kFirstTimestampNs + kDecimatedIntervalNs});
+}
+
+TEST_F(SensorDataDecimationTest, FullSharedEventTableFallsBackToBroadcast) {
+  setRequest(0, kSensorIntervalNs);
+  setRequest(2, kDecimatedIntervalNs);
+
+  blockEventLoop();
+  for (size_t i = 0; i <= kMaxSharedSensorDataEvents; i++) {
+    sendBatch(i);
+  }
+  unblockEventLoop();
+
+  // The last batch is broadcast as is, since every shared event is still
+  // held by the fast nanoapp when it is received.
+  std::vector<ReceivedEvent> fastEvents = getReceivedEvents(0);
+  std::vector<ReceivedEvent> decimatedEvents = getReceivedEvents(2);
+  ASSERT_EQ(fastEvents.size(), kMaxSharedSensorDataEvents + 1);
+  ASSERT_EQ(decimatedEvents.size(), kMaxSharedSensorDataEvents + 1);
+  for (size_t i = 0; i < kMaxSharedSensorDataEvents; i++) {
+    EXPECT_EQ(decimatedEvents[i].timestampsNs,
+              getBatchTimestamps(i, 1, kDecimatedIntervalNs));
+  }
+  const ReceivedEvent &broadcastEvent = decimatedEvents.back();
+  EXPECT_EQ(broadcastEvent.eventData, fastEvents.back().eventData);
+  EXPECT_EQ(broadcastEvent.timestampsNs,
+            getBatchTimestamps(kMaxSharedSensorDataEvents, 1,
+                               kSensorIntervalNs));
+
+  // Once the shared events are released, data is decimated again.
+  sendBatch(kMaxSharedSensorDataEvents + 1);
+  drainEventLoop();
+  decimatedEvents = getReceivedEvents(2);
+  ASSERT_EQ(decimatedEvents.size(), kMaxSharedSensorDataEvents + 2);
+  EXPECT_EQ(decimatedEvents.back().timestampsNs,
+            getBatchTimestamps(kMaxSharedSensorDataEvents + 1, 1,
+                               kDecimatedIntervalNs));
+}
+
+TEST_F(SensorDataDecimationTest, RequestChangesUpdateSubscribers) {
+  setRequest(0, kSensorIntervalNs);
+  setRequest(2, kDecimatedIntervalNs);
+  sendBatch(0);
+  drainEventLoop();
+  ASSERT_EQ(getReceivedEvents(2).size(), 1);
+  EXPECT_EQ(getReceivedEvents(2).back().timestampsNs,
+            getBatchTimestamps(0, 1, kDecimatedIntervalNs));
+
+  // At the sensor's rate, the nanoapp gets the platform event.
+  setRequest(2, kSensorIntervalNs);
+  sendBatch(1);
+  drainEventLoop();
+  ASSERT_EQ(getReceivedEvents(2).size(), 2);
+  EXPECT_EQ(getReceivedEvents(2).back().eventData,
+            getReceivedEvents(0).back().eventData);
+  EXPECT_EQ(getReceivedEvents(2).back().timestampsNs,
+            getBatchTimestamps(1, 1, kSensorIntervalNs));
+
+  // Decimated again, the nanoapp keeps getting samples at its interval.
+  setRequest(2, kDecimatedIntervalNs);
+  sendBatch(2);
+  drainEventLoop();
+  ASSERT_EQ(getReceivedEvents(2).size(), 3);
+  EXPECT_EQ(getReceivedEvents(2).back().timestampsNs,
+            getBatchTimestamps(2, 1, kDecimatedIntervalNs));
+
+  // Once it is the only nanoapp, the sensor samples at its interval, and the
+  // data isn't decimated any more.
+  setRequest(0, 0 /* intervalNs */);
+  sendBatch(3);
+  drainEventLoop();
+  ASSERT_EQ(getReceivedEvents(2).size(), 4);
+  EXPECT_EQ(getReceivedEvents(2).back().timestampsNs,
+            getBatchTimestamps(3, 1, kSensorIntervalNs));
+  EXPECT_EQ(getReceivedEvents(0).size(), 3);
+}
+
+}  // namespace
+}  // namespace chre
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <future>
+
+#include "gtest/gtest.h"
+
+#include "chre/core/event_loop_manager.h"
+#include "chre/core/sensor_request.h"
+#include "chre/platform/linux/pal_sensor.h"
+#include "chre/test/simulation/test_base.h"
+#include "chre/util/time.h"
+#include "chre_api/chre.h"
+
+namespace chre {
+namespace {
+
+constexpr uint64_t kIntervalNs = 10 * kOneMillisecondInNanoseconds;
+
+//! The simulated sensor PAL delivers the samples it takes itself after this
+//! latency, i.e. well after a test completes. The samples in the histories are
+//! therefore only the ones a test sends.
+constexpr uint64_t kLatencyNs = 60 * kOneSecondInNanoseconds;
+
+constexpr uint64_t kFirstTimestampNs = kOneSecondInNanoseconds;
+
+//! The number of three-axis samples that fit in the memory budget shared by
+//! the histories of all sensors.
+constexpr size_t kSampleSize = sizeof(chreSensorThreeAxisData::readings[0]);
+constexpr size_t kBudgetSamples = CHRE_SENSOR_HISTORY_MAX_BYTES / kSampleSize;
+
+typedef chreSensorThreeAxisData::chreSensorThreeAxisSampleData Sample;
+
+//! @return The duration of history that takes the given number of samples at
+//!     kIntervalNs, both ends of the duration being included.
+constexpr uint64_t getDurationNs(size_t numSamples) {
+  return (numSamples - 1) * kIntervalNs;
+}
+
+constexpr size_t kNumNanoapps = 2;
+
+bool nanoappStart() {
+  return true;
+}
+
+void nanoappHandleEvent(uint32_t /*senderInstanceId*/, uint16_t /*eventType*/,
+                        const void * /*eventData*/) {}
+
+void nanoappEnd() {}
+
+class SensorHistoryTest : public TestBase {
+ protected:
+  void SetUp() override {
+    TestBase::SetUp();
+    mInstanceIds[0] = startNanoapp(0x0123456789000001, nanoappStart,
+                                   nanoappHandleEvent, nanoappEnd);
+    mInstanceIds[1] = startNanoapp(0x0123456789000002, nanoappStart,
+                                   nanoappHandleEvent, nanoappEnd);
+    mAccelHandle = getSensorHandle(CHRE_SENSOR_TYPE_ACCELEROMETER);
+    mGyroHandle = getSensorHandle(CHRE_SENSOR_TYPE_GYROSCOPE);
+    mMagHandle = getSensorHandle(CHRE_SENSOR_TYPE_GEOMAGNETIC_FIELD);
+  }
+
+  void TearDown() override {
+    for (size_t i = 0; i < kNumNanoapps; i++) {
+      for (uint32_t sensorHandle : {mAccelHandle, mGyroHandle, mMagHandle}) {
+        setRequest(i, sensorHandle, 0 /* intervalNs */);
+      }
+    }
+    drainEventLoop();
+
+    // The histories are released along with the requests, and every data
+    // event was released back to the PAL.
+    EXPECT_EQ(getTotalMemorySize(), 0);
+    EXPECT_EQ(getNumSimulatedSensorEventsPendingRelease(), 0);
+    TestBase::TearDown();
+  }
+
+  Nanoapp *getNanoapp(size_t index) {
+    return EventLoopManagerSingleton::get()
+        ->getEventLoop()
+        .findNanoappByInstanceId(mInstanceIds[index]);
+  }
+
+  uint32_t getSensorHandle(uint8_t sensorType) {
+    uint32_t sensorHandle = 0;
+    runInEventLoop([this, sensorType, &sensorHandle] {
+      Nanoapp *nanoapp = getNanoapp(0);
+      ASSERT_NE(nanoapp, nullptr);
+      ASSERT_TRUE(getSensorRequestManager().getSensorHandleForNanoapp(
+          sensorType, CHRE_SENSOR_INDEX_DEFAULT, *nanoapp, &sensorHandle));
+    });
+    return sensorHandle;
+  }
+
+  /**
+   * Sets the request of a nanoapp for a sensor.
+   *
+   * @param index The index of the nanoapp.
+   * @param sensorHandle The handle of the sensor.
+   * @param intervalNs The requested interval, or 0 to remove the request.
+   */
+  void setRequest(size_t index, uint32_t sensorHandle, uint64_t intervalNs) {
+    runInEventLoop([this, index, sensorHandle, intervalNs] {
+      Nanoapp *nanoapp = getNanoapp(index);
+      ASSERT_NE(nanoapp, nullptr);
+      SensorRequest request(nanoapp->getInstanceId(), SensorMode::Off,
+                            Nanoseconds(CHRE_SENSOR_INTERVAL_DEFAULT),
+                            Nanoseconds(CHRE_SENSOR_LATENCY_DEFAULT));
+      if (intervalNs != 0) {
+        request = SensorRequest(nanoapp->getInstanceId(),
+                                SensorMode::ActiveContinuous,
+                                Nanoseconds(intervalNs),
+                                Nanoseconds(kLatencyNs));
+      }
+      EXPECT_TRUE(getSensorRequestManager().setSensorRequest(
+          nanoapp, sensorHandle, request));
+    });
+  }
+
+  bool configureHistory(size_t index, uint32_t sensorHandle,
+                        uint64_t durationNs) {
+    bool success = false;
+    runInEventLoop([this, index, sensorHandle, durationNs, &success] {
+      Nanoapp *nanoapp = getNanoapp(index);
+      ASSERT_NE(nanoapp, nullptr);
+      success = getSensorRequestManager().configureHistory(
+          nanoapp, sensorHandle, Nanoseconds(durationNs));
+    });
+    return success;
+  }
+
+  //! @return The number of samples the history of a sensor can hold, or 0 if
+  //!     the history of the sensor isn't retained.
+  size_t getCapacity(uint32_t sensorHandle) {
+    size_t capacity = 0;
+    runInEventLoop([sensorHandle, &capacity] {
+      Sensor *sensor = getSensorRequestManager().getSensor(sensorHandle);
+      ASSERT_NE(sensor, nullptr);
+      if (sensor->isHistoryEnabled()) {
+        capacity = sensor->getHistory().getCapacity();
+      }
+    });
+    return capacity;
+  }
+
+  //! @return The memory held by the histories of all the sensors.
+  size_t getTotalMemorySize() {
+    size_t memorySize = 0;
+    runInEventLoop([this, &memorySize] {
+      for (uint32_t sensorHandle : {mAccelHandle, mGyroHandle, mMagHandle}) {
+        Sensor *sensor = getSensorRequestManager().getSensor(sensorHandle);
+        ASSERT_NE(sensor, nullptr);
+        memorySize += sensor->getHistory().getMemorySize();
+      }
+    });
+    return memorySize;
+  }
+
+  //! @return The number of samples of the accelerometer in its history.
+  size_t getNumAccelSamples() {
+    size_t numSamples = 0;
+    runInEventLoop([this, &numSamples] {
+      chreSensorHistory history;
+      if (getSensorRequestManager().getHistory(
+              mAccelHandle, Nanoseconds(0), Nanoseconds(UINT64_MAX),
+              &history)) {
+        numSamples = history.readingCount[0] + history.readingCount[1];
+      }
+    });
+    return numSamples;
+  }
+
+  //! Waits for the events posted so far to be processed and freed.
+  void drainEventLoop() {
+    runInEventLoop([] {});
+  }
+
+  /**
+   * Keeps the event loop busy until unblockEventLoop() is invoked, so that the
+   * data events sent meanwhile are all pending at once.
+   */
+  void blockEventLoop() {
+    std::promise<void> blocked;
+    mUnblock = std::promise<void>();
+    mBlocker = {&blocked, mUnblock.get_future()};
+    auto callback = [](uint16_t /*type*/, void *data, void * /*extraData*/) {
+      auto *blocker = static_cast<Blocker *>(data);
+      blocker->blocked->set_value();
+      blocker->unblock.wait();
+    };
+    EventLoopManagerSingleton::get()->deferCallback(
+        SystemCallbackType::FirstCallbackType, &mBlocker, callback);
+    blocked.get_future().wait();
+  }
+
+  void unblockEventLoop() {
+    mUnblock.set_value();
+    drainEventLoop();
+  }
+
+  uint32_t mInstanceIds[kNumNanoapps];
+  uint32_t mAccelHandle = 0;
+  uint32_t mGyroHandle = 0;
+  uint32_t mMagHandle = 0;
+
+ private:
+  struct Blocker {
+    std::promise<void> *blocked;
+    std::future<void> unblock;
+  };
+
+  Blocker mBlocker;
+  std::promise<void> mUnblock;
+};
+
+TEST_F(SensorHistoryTest, HistoryHoldsSamplesBeforeTheirEventIsDelivered) {
+  setRequest(0, mAccelHandle, kIntervalNs);
+  ASSERT_TRUE(configureHistory(0, mAccelHandle, kOneSecondInNanoseconds));
+  EXPECT_EQ(getCapacity(mAccelHandle), 101);
+
+  ASSERT_TRUE(sendSimulatedSensorData(mAccelHandle, kFirstTimestampNs,
+                                      kIntervalNs, 10));
+  drainEventLoop();
+
+  runInEventLoop([this] {
+    chreSensorHistory history;
+    ASSERT_TRUE(getSensorRequestManager().getHistory(
+        mAccelHandle, Nanoseconds(kFirstTimestampNs + kIntervalNs),
+        Nanoseconds(kFirstTimestampNs + 5 * kIntervalNs), &history));
+    ASSERT_EQ(history.readingCount[0] + history.readingCount[1], 5);
+    const auto *readings = static_cast<const Sample *>(history.readings[0]);
+    EXPECT_EQ(history.baseTimestamp + readings[0].timestampDelta,
+              kFirstTimestampNs + kIntervalNs);
+  });
+}
+
+TEST_F(SensorHistoryTest, BudgetIsSharedBetweenSensors) {
+  setRequest(0, mAccelHandle, kIntervalNs);
+  setRequest(0, mGyroHandle, kIntervalNs);
+  setRequest(1, mMagHandle, kIntervalNs);
+
+  // Two sensors take the whole budget between them.
+  ASSERT_TRUE(configureHistory(0, mAccelHandle,
+                               getDurationNs(kBudgetSamples / 2)));
+  ASSERT_TRUE(configureHistory(0, mGyroHandle,
+                               getDurationNs(kBudgetSamples / 2)));
+  EXPECT_EQ(getCapacity(mAccelHandle), kBudgetSamples / 2);
+  EXPECT_EQ(getCapacity(mGyroHandle), kBudgetSamples / 2);
+
+  // The history of a third sensor doesn't fit, and the others are untouched.
+  EXPECT_FALSE(configureHistory(1, mMagHandle, getDurationNs(2)));
+  EXPECT_EQ(getCapacity(mMagHandle), 0);
+  EXPECT_EQ(getCapacity(mAccelHandle), kBudgetSamples / 2);
+  EXPECT_EQ(getCapacity(mGyroHandle), kBudgetSamples / 2);
+
+  // It fits in the memory released by another sensor.
+  ASSERT_TRUE(configureHistory(0, mGyroHandle,
+                               getDurationNs(kBudgetSamples / 4)));
+  EXPECT_TRUE(configureHistory(1, mMagHandle,
+                               getDurationNs(kBudgetSamples / 4)));
+  EXPECT_EQ(getCapacity(mGyroHandle), kBudgetSamples / 4);
+  EXPECT_EQ(getCapacity(mMagHandle), kBudgetSamples / 4);
+  EXPECT_LE(getTotalMemorySize(), CHRE_SENSOR_HISTORY_MAX_BYTES);
+}
+
+TEST_F(SensorHistoryTest, HistoryIsCappedWhenIntervalShortens) {
+  setRequest(0, mAccelHandle, kIntervalNs);
+  setRequest(0, mGyroHandle, kIntervalNs);
+  ASSERT_TRUE(configureHistory(0, mAccelHandle,
+                               getDurationNs(kBudgetSamples / 2)));
+  ASSERT_TRUE(configureHistory(0, mGyroHandle,
+                               getDurationNs(kBudgetSamples / 2)));
+
+  // Twice the samples are needed for the same duration, but only the rest of
+  // the budget is available.
+  setRequest(0, mAccelHandle, kIntervalNs / 2);
+  EXPECT_EQ(getCapacity(mAccelHandle), kBudgetSamples / 2);
+  EXPECT_EQ(getCapacity(mGyroHandle), kBudgetSamples / 2);
+  EXPECT_EQ(getTotalMemorySize(), kBudgetSamples * kSampleSize);
+
+  // Once the other history is gone, it covers the whole duration.
+  ASSERT_TRUE(configureHistory(0, mGyroHandle, 0 /* durationNs */));
+  ASSERT_TRUE(configureHistory(0, mAccelHandle,
+                               getDurationNs(kBudgetSamples / 2)));
+  EXPECT_EQ(getCapacity(mAccelHandle), kBudgetSamples - 1);
+  EXPECT_EQ(getCapacity(mGyroHandle), 0);
+}
+
+TEST_F(SensorHistoryTest, FailedConfigurationIsRolledBack) {
+  setRequest(0, mAccelHandle, kIntervalNs);
+  setRequest(1, mAccelHandle, kIntervalNs);
+  ASSERT_TRUE(configureHistory(0, mAccelHandle, kOneSecondInNanoseconds));
+  EXPECT_EQ(getCapacity(mAccelHandle), 101);
+
+  // The nanoapp keeps the duration it had configured.
+  EXPECT_FALSE(
+      configureHistory(0, mAccelHandle, getDurationNs(kBudgetSamples + 1)));
+  EXPECT_EQ(getCapacity(mAccelHandle), 101);
+
+  // A nanoapp without a previous configuration is left without one, so the
+  // history is released along with the other nanoapp's configuration.
+  EXPECT_FALSE(
+      configureHistory(1, mAccelHandle, getDurationNs(kBudgetSamples + 1)));
+  EXPECT_EQ(getCapacity(mAccelHandle), 101);
+  ASSERT_TRUE(configureHistory(0, mAccelHandle, 0 /* durationNs */));
+  EXPECT_EQ(getCapacity(mAccelHandle), 0);
+  EXPECT_EQ(getTotalMemorySize(), 0);
+}
+
+TEST_F(SensorHistoryTest, HistoryUpdatesAreDroppedWhenEventsRunLow) {
+  constexpr uint16_t kNumEvents = CHRE_MAX_EVENT_COUNT + 4;
+  setRequest(0, mAccelHandle, kIntervalNs);
+  ASSERT_TRUE(configureHistory(0, mAccelHandle, getDurationNs(kNumEvents)));
+
+  // Rather than being a fatal error, the events that can't be posted are
+  // released back to the PAL right away.
+  blockEventLoop();
+  for (uint16_t i = 0; i < kNumEvents; i++) {
+    ASSERT_TRUE(sendSimulatedSensorData(
+        mAccelHandle, kFirstTimestampNs + i * kIntervalNs, kIntervalNs, 1));
+  }
+  uint32_t numEventsPosted = getNumSimulatedSensorEventsPendingRelease();
+  EXPECT_GT(numEventsPosted, 0);
+  EXPECT_LT(numEventsPosted, kNumEvents);
+  unblockEventLoop();
+
+  // The data events are only posted to nanoapps once their samples have been
+  // added to the history, i.e. after the event loop was unblocked.
+  drainEventLoop();
+  EXPECT_EQ(getNumSimulatedSensorEventsPendingRelease(), 0);
+  EXPECT_EQ(getNumAccelSamples(), numEventsPosted);
+}
+
+}  // namespace
+}  // namespace chre
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/test/simulation/test_base.h"
+
+#include <future>
+
+#include "chre/core/event_loop_manager.h"
+#include "chre/core/init.h"
+#include "chre/core/nanoapp.h"
+#include "chre/util/unique_ptr.h"
+#include "chre_api/chre/version.h"
+
+namespace chre {
+
+constexpr std::chrono::seconds TestBase::kWaitTimeout;
+
+void TestBase::SetUp() {
+  chre::init();
+  EventLoopManagerSingleton::get()->lateInit();
+  mChreThread = std::thread(
+      []() { EventLoopManagerSingleton::get()->getEventLoop().run(); });
+}
+
+void TestBase::TearDown() {
+  EventLoopManagerSingleton::get()->getEventLoop().stop();
+  mChreThread.join();
+  chre::deinit();
+}
+
+void TestBase::runInEventLoop(const std::function<void()> &function) {
+  struct Request {
+    const std::function<void()> *function;
+    std::promise<void> done;
+  } request = {&function, {}};
+
+  auto callback = [](uint16_t /*type*/, void *data, void * /*extraData*/) {
+    auto *request = static_cast<Request *>(data);
+    (*request->function)();
+    request->done.set_value();
+  };
+
+  std::future<void> done = request.done.get_future();
+  EventLoopManagerSingleton::get()->deferCallback(
+      SystemCallbackType::FirstCallbackType, &request, callback);
+  done.wait();
+}
+
+uint32_t TestBase::startNanoapp(uint64_t appId,
+                                chreNanoappStartFunction *start,
+                                chreNanoappHandleEventFunction *handleEvent,
+                                chreNanoappEndFunction *end) {
+  mAppInfos.emplace_back();
+  chreNslNanoappInfo &appInfo = mAppInfos.back();
+  appInfo.magic = CHRE_NSL_NANOAPP_INFO_MAGIC;
+  appInfo.structMinorVersion = CHRE_NSL_NANOAPP_INFO_STRUCT_MINOR_VERSION;
+  appInfo.targetApiVersion = CHRE_API_VERSION;
+  appInfo.vendor = "Google";
+  appInfo.name = "TestNanoapp";
+  appInfo.isSystemNanoapp = true;
+  appInfo.appId = appId;
+  appInfo.entryPoints.start = start;
+  appInfo.entryPoints.handleEvent = handleEvent;
+  appInfo.entryPoints.end = end;
+  appInfo.appVersionString = "<undefined>";
+
+  uint32_t instanceId = kInvalidInstanceId;
+  runInEventLoop([&]() {
+    UniquePtr<Nanoapp> nanoapp = MakeUnique<Nanoapp>();
+    ASSERT_FALSE(nanoapp.isNull());
+    nanoapp->loadStatic(&appInfo);
+    EventLoop &eventLoop = EventLoopManagerSingleton::get()->getEventLoop();
+    ASSERT_TRUE(eventLoop.startNanoapp(nanoapp));
+    eventLoop.findNanoappInstanceIdByAppId(appId, &instanceId);
+  });
+
+  return instanceId;
+}
+
+bool TestBase::waitFor(const std::function<bool()> &condition) {
+  auto deadline = std::chrono::steady_clock::now() + kWaitTimeout;
+  bool satisfied = condition();
+  while (!satisfied && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    satisfied = condition();
+  }
+
+  return satisfied;
+}
+
+}  // namespace chre
@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "chre/core/event_loop_manager.h"
+#include "chre/core/timer_pool.h"
+#include "chre/platform/system_time.h"
+#include "chre/test/simulation/test_base.h"
+#include "chre/util/system/debug_dump.h"
+#include "chre/util/time.h"
+#include "chre_api/chre.h"
+
+namespace chre {
+namespace {
+
+constexpr uint64_t kAppId = 0x0123456789abcdef;
+
+//! The slack given to nanoapp timers by the tests, so that timers that expire
+//! within it of each other are handled in a single wakeup.
+constexpr Milliseconds kNanoappTimerSlack(100);
+
+//! The timers started by the nanoapp. The index of each timer is its cookie.
+constexpr size_t kMaxTimers = 2;
+Milliseconds gTimerDurations[kMaxTimers];
+size_t gNumTimers;
+uint32_t gTimerHandles[kMaxTimers];
+
+std::atomic<uint32_t> gFiredTimers;
+std::atomic<size_t> gNumTimerEvents;
+
+//! If set, the nanoapp cancels the other one of its two timers when the first
+//! one fires, and records whether the cancellation succeeded.
+bool gCancelOtherTimer;
+std::atomic<bool> gOtherTimerCancelled;
+
+//! The cookies of the timer events, and when they were received, in the order
+//! received.
+std::mutex gMutex;
+std::vector<uintptr_t> gFiredCookies;
+std::vector<Nanoseconds> gFiredTimes;
+
+bool nanoappStart() {
+  bool success = true;
+  for (size_t i = 0; i < gNumTimers && success; i++) {
+    gTimerHandles[i] = chreTimerSet(
+        Nanoseconds(gTimerDurations[i]).toRawNanoseconds(),
+        reinterpret_cast<void *>(i), true /* oneShot */);
+    success = (gTimerHandles[i] != CHRE_TIMER_INVALID);
+  }
+
+  return success;
+}
+
+void nanoappHandleEvent(uint32_t /*senderInstanceId*/, uint16_t eventType,
+                        const void *eventData) {
+  if (eventType == CHRE_EVENT_TIMER) {
+    auto index = reinterpret_cast<uintptr_t>(eventData);
+    gFiredTimers |= (1 << index);
+    {
+      std::lock_guard<std::mutex> lock(gMutex);
+      gFiredCookies.push_back(index);
+      gFiredTimes.push_back(SystemTime::getMonotonicTime());
+    }
+    if (gCancelOtherTimer && gNumTimerEvents == 0) {
+      gOtherTimerCancelled = chreTimerCancel(gTimerHandles[1 - index]);
+    }
+    gNumTimerEvents++;
+  }
+}
+
+void nanoappEnd() {}
+
+class TimerTest : public TestBase {
+ protected:
+  void SetUp() override {
+    TestBase::SetUp();
+    getTimerPool().setNanoappTimerSlack(kNanoappTimerSlack);
+    gNumTimers = 0;
+    gFiredTimers = 0;
+    gNumTimerEvents = 0;
+    gCancelOtherTimer = false;
+    gOtherTimerCancelled = false;
+    std::lock_guard<std::mutex> lock(gMutex);
+    gFiredCookies.clear();
+    gFiredTimes.clear();
+  }
+
+  //! Starts a nanoapp that sets two one-shot timers.
+  uint32_t startTimers(Milliseconds first, Milliseconds second) {
+    gTimerDurations[0] = first;
+    gTimerDurations[1] = second;
+    gNumTimers = 2;
+    return startNanoapp(kAppId, nanoappStart, nanoappHandleEvent, nanoappEnd);
+  }
+
+  //! Starts a nanoapp that sets no timer of its own.
+  uint32_t startIdleNanoapp() {
+    gNumTimers = 0;
+    return startNanoapp(kAppId, nanoappStart, nanoappHandleEvent, nanoappEnd);
+  }
+
+  /**
+   * Sets a timer for a nanoapp from the event loop.
+   *
+   * @return The handle of the timer, CHRE_TIMER_INVALID on failure.
+   */
+  TimerHandle setTimer(uint32_t instanceId, Milliseconds duration,
+                       uintptr_t cookie, bool isOneShot = true) {
+    TimerHandle timerHandle = CHRE_TIMER_INVALID;
+    runInEventLoop([this, instanceId, duration, cookie, isOneShot,
+                    &timerHandle] {
+      Nanoapp *nanoapp = EventLoopManagerSingleton::get()
+                             ->getEventLoop()
+                             .findNanoappByInstanceId(instanceId);
+      ASSERT_NE(nanoapp, nullptr);
+      timerHandle = getTimerPool().setNanoappTimer(
+          nanoapp, duration, reinterpret_cast<void *>(cookie), isOneShot);
+    });
+    return timerHandle;
+  }
+
+  //! Cancels a timer of a nanoapp from the event loop.
+  bool cancelTimer(uint32_t instanceId, TimerHandle timerHandle) {
+    bool success = false;
+    runInEventLoop([this, instanceId, timerHandle, &success] {
+      Nanoapp *nanoapp = EventLoopManagerSingleton::get()
+                             ->getEventLoop()
+                             .findNanoappByInstanceId(instanceId);
+      ASSERT_NE(nanoapp, nullptr);
+      success = getTimerPool().cancelNanoappTimer(nanoapp, timerHandle);
+    });
+    return success;
+  }
+
+  std::vector<uintptr_t> getFiredCookies() {
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gFiredCookies;
+  }
+
+  std::vector<Nanoseconds> getFiredTimes() {
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gFiredTimes;
+  }
+
+  TimerPool &getTimerPool() {
+    return EventLoopManagerSingleton::get()->getEventLoop().getTimerPool();
+  }
+
+  /**
+   * Reads the number of expired timers and of wakeups that handled them from
+   * the debug dump of the TimerPool.
+   */
+  void getExpiryStats(uint32_t *numExpiredTimers, uint32_t *numWakeups) {
+    DebugDumpWrapper debugDump(1024);
+    getTimerPool().logStateToBuffer(debugDump);
+    std::string dump;
+    for (const auto &buffer : debugDump.getBuffers()) {
+      dump += buffer.get();
+    }
+
+    const char *stats = strstr(dump.c_str(), "Expired timers:");
+    ASSERT_NE(stats, nullptr);
+    ASSERT_EQ(sscanf(stats, "Expired timers: %u in %u wakeups",
+                     numExpiredTimers, numWakeups),
+              2);
+  }
+};
+
+TEST_F(TimerTest, TimersWithinSlackExpireInOneWakeup) {
+  startTimers(Milliseconds(100), Milliseconds(160));
+  ASSERT_TRUE(waitFor([] { return gNumTimerEvents == 2; }));
+
+  uint32_t numExpiredTimers;
+  uint32_t numWakeups;
+  getExpiryStats(&numExpiredTimers, &numWakeups);
+  EXPECT_EQ(numExpiredTimers, 2);
+  EXPECT_EQ(numWakeups, 1);
+}
+
+TEST_F(TimerTest, CancellingTheNextTimerReschedulesTheWakeup) {
+  uint32_t instanceId = startTimers(Milliseconds(50), Milliseconds(100));
+  runInEventLoop([this, instanceId] {
+    EventLoop &eventLoop = EventLoopManagerSingleton::get()->getEventLoop();
+    Nanoapp *nanoapp = eventLoop.findNanoappByInstanceId(instanceId);
+    ASSERT_NE(nanoapp, nullptr);
+    EXPECT_TRUE(getTimerPool().cancelNanoappTimer(nanoapp, gTimerHandles[0]));
+  });
+
+  // The cancelled timer would have fired first.
+  ASSERT_TRUE(waitFor([] { return gNumTimerEvents == 1; }));
+  EXPECT_EQ(gFiredTimers, 1 << 1);
+}
+
+TEST_F(TimerTest, CancellingAnEarlyWakeupRestoresCoalescing) {
+  startTimers(Milliseconds(100), Milliseconds(160));
+
+  // A system timer has no slack, so it brings the wakeup forward even though
+  // it expires after the first nanoapp timer. Once it is cancelled, both
+  // nanoapp timers should again be handled by the wakeup that their slack
+  // allows, rather than by the early one and another wakeup after it.
+  auto callback = [](uint16_t /*type*/, void * /*data*/,
+                     void * /*extraData*/) { FAIL(); };
+  TimerHandle handle = EventLoopManagerSingleton::get()->setDelayedCallback(
+      SystemCallbackType::FirstCallbackType, nullptr, callback,
+      Milliseconds(130));
+  ASSERT_TRUE(EventLoopManagerSingleton::get()->cancelDelayedCallback(handle));
+  ASSERT_TRUE(waitFor([] { return gNumTimerEvents == 2; }));
+
+  uint32_t numExpiredTimers;
+  uint32_t numWakeups;
+  getExpiryStats(&numExpiredTimers, &numWakeups);
+  EXPECT_EQ(numExpiredTimers, 2);
+  EXPECT_EQ(numWakeups, 1);
+}
+
+TEST_F(TimerTest, TimerThatFiredInSameWakeupCannotBeCancelled) {
+  // Both timers are handled in the same wakeup. The second one has fired by
+  // the time the first one's event is handled, so cancelling it fails rather
+  // than succeeding with its event still delivered.
+  gCancelOtherTimer = true;
+  startTimers(Milliseconds(100), Milliseconds(160));
+  ASSERT_TRUE(waitFor([] { return gNumTimerEvents == 2; }));
+  EXPECT_FALSE(gOtherTimerCancelled);
+}
+
+TEST_F(TimerTest, TimerCancelledFromTimerEventDoesNotFire) {
+  gCancelOtherTimer = true;
+  startTimers(Milliseconds(50), Milliseconds(400));
+  ASSERT_TRUE(waitFor([] { return gNumTimerEvents == 1; }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  EXPECT_TRUE(gOtherTimerCancelled);
+  EXPECT_EQ(gNumTimerEvents, 1);
+}
+
+TEST_F(TimerTest, TimersInDifferentWheelLevelsFireInOrder) {
+  // With the timer wheel, the first timer is in the lowest level, and the
+  // others in the next one.
+  uint32_t instanceId = startIdleNanoapp();
+  ASSERT_NE(setTimer(instanceId, Milliseconds(250), 0), CHRE_TIMER_INVALID);
+  ASSERT_NE(setTimer(instanceId, Milliseconds(30), 1), CHRE_TIMER_INVALID);
+  ASSERT_NE(setTimer(instanceId, Milliseconds(120), 2), CHRE_TIMER_INVALID);
+
+  ASSERT_TRUE(waitFor([] { return gNumTimerEvents == 3; }));
+  EXPECT_EQ(getFiredCookies(), (std::vector<uintptr_t>{1, 2, 0}));
+}
+
+TEST_F(TimerTest, PeriodicTimerFiresUntilCancelled) {
+  uint32_t instanceId = startIdleNanoapp();
+  TimerHandle timerHandle =
+      setTimer(instanceId, Milliseconds(30), 0, false /* isOneShot */);
+  ASSERT_NE(timerHandle, CHRE_TIMER_INVALID);
+  ASSERT_TRUE(waitFor([] { return gNumTimerEvents >= 3; }));
+
+  ASSERT_TRUE(cancelTimer(instanceId, timerHandle));
+  size_t numTimerEvents = gNumTimerEvents;
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_EQ(gNumTimerEvents, numTimerEvents);
+}
+
+TEST_F(TimerTest, SlackDoesNotAccumulateOverPeriods) {
+  // Alone, the timer is handled when its slack runs out, i.e. 100 ms after it
+  // expires. Counting each period from then would make it fire every 250 ms
+  // rather than every 150 ms.
+  uint32_t instanceId = startIdleNanoapp();
+  TimerHandle timerHandle =
+      setTimer(instanceId, Milliseconds(150), 0, false /* isOneShot */);
+  ASSERT_NE(timerHandle, CHRE_TIMER_INVALID);
+  ASSERT_TRUE(waitFor([] { return gNumTimerEvents >= 5; }));
+  ASSERT_TRUE(cancelTimer(instanceId, timerHandle));
+
+  std::vector<Nanoseconds> firedTimes = getFiredTimes();
+  uint64_t averagePeriodNs =
+      (firedTimes[4] - firedTimes[1]).toRawNanoseconds() / 3;
+  EXPECT_GT(averagePeriodNs, 100 * kOneMillisecondInNanoseconds);
+  EXPECT_LT(averagePeriodNs, 200 * kOneMillisecondInNanoseconds);
+}
+
+TEST_F(TimerTest, HandleOfCancelledTimerIsNotReused) {
+  uint32_t instanceId = startIdleNanoapp();
+  TimerHandle first = setTimer(instanceId, Milliseconds(1000), 0);
+  ASSERT_NE(first, CHRE_TIMER_INVALID);
+  ASSERT_TRUE(cancelTimer(instanceId, first));
+  EXPECT_FALSE(cancelTimer(instanceId, first));
+
+  // The new timer may take the place of the cancelled one, but not its handle.
+  TimerHandle second = setTimer(instanceId, Milliseconds(1000), 1);
+  ASSERT_NE(second, CHRE_TIMER_INVALID);
+  EXPECT_NE(second, first);
+  EXPECT_FALSE(cancelTimer(instanceId, first));
+  EXPECT_TRUE(cancelTimer(instanceId, second));
+}
+
+TEST_F(TimerTest, NanoappTimersAreLimited) {
+  uint32_t instanceId = startIdleNanoapp();
+  std::vector<TimerHandle> timerHandles;
+  TimerHandle timerHandle;
+  while ((timerHandle = setTimer(instanceId, Milliseconds(10000),
+                                 timerHandles.size())) != CHRE_TIMER_INVALID) {
+    timerHandles.push_back(timerHandle);
+  }
+  // Nanoapps are guaranteed 32 timers by the CHRE API.
+  EXPECT_GE(timerHandles.size(), 32);
+
+  // A timer can be set again once another one is cancelled.
+  ASSERT_TRUE(cancelTimer(instanceId, timerHandles.back()));
+  EXPECT_NE(setTimer(instanceId, Milliseconds(10000), 0), CHRE_TIMER_INVALID);
+}
+
+}  // namespace
+}  // namespace chre
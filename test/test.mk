@@ -40,3 +40,14 @@ COMMON_SRCS += $(CHRE_PREFIX)/pal/tests/src/version_test.cc
 COMMON_SRCS += $(CHRE_PREFIX)/pal/tests/src/wwan_test.cc
 
 endif
+
+# Simulation tests, which run against the full CHRE of the Linux simulator and
+# are built into the googletest target.
+GOOGLETEST_CFLAGS += -I$(CHRE_PREFIX)/test/simulation/include
+
+GOOGLETEST_SRCS += $(CHRE_PREFIX)/test/simulation/host_link_test.cc
+GOOGLETEST_SRCS += $(CHRE_PREFIX)/test/simulation/log_buffer_manager_test.cc
+GOOGLETEST_SRCS += $(CHRE_PREFIX)/test/simulation/sensor_data_decimation_test.cc
+GOOGLETEST_SRCS += $(CHRE_PREFIX)/test/simulation/sensor_history_test.cc
+GOOGLETEST_SRCS += $(CHRE_PREFIX)/test/simulation/test_base.cc
+GOOGLETEST_SRCS += $(CHRE_PREFIX)/test/simulation/timer_test.cc
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_UTIL_FLAT_MAP_H_
+#define CHRE_UTIL_FLAT_MAP_H_
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+#include "chre/util/dynamic_vector.h"
+
+namespace chre {
+
+/**
+ * An associative container that stores its entries contiguously in a
+ * DynamicVector, sorted by key. Lookups are O(log n) via binary search, and
+ * insertion/removal are O(n) due to shifting the entries that follow. This
+ * makes it a good fit for small maps/sets that are read much more often than
+ * they are modified, as it only performs an allocation when the underlying
+ * vector needs to grow and has no per-entry overhead.
+ *
+ * A set can be modeled by using a small ValueType, or by only using the key.
+ *
+ * Keys are unique. Iteration visits the entries in ascending key order. Any
+ * insertion or removal invalidates all iterators and references. Like
+ * DynamicVector, this container is movable but not copyable.
+ */
+template <typename KeyType, typename ValueType,
+          typename CompareFunction = std::less<KeyType>>
+class FlatMap {
+ public:
+  //! A single key/value pair in the map.
+  struct Entry {
+    Entry(const KeyType &key_, const ValueType &value_)
+        : key(key_), value(value_) {}
+    Entry(const KeyType &key_, ValueType &&value_)
+        : key(key_), value(std::move(value_)) {}
+
+    //! The key must not be modified through an iterator, as doing so would
+    //! break the sort order of the map.
+    KeyType key;
+    ValueType value;
+  };
+
+  typedef Entry *iterator;
+  typedef const Entry *const_iterator;
+
+  /**
+   * Constructs an empty map. No memory is allocated until the first insertion.
+   */
+  FlatMap();
+
+  /**
+   * Constructs an empty map with a compare type that provides a strict weak
+   * ordering over keys.
+   *
+   * @param compare The comparator that returns true if left < right.
+   */
+  FlatMap(const CompareFunction &compare);
+
+  /**
+   * @return The number of entries in the map.
+   */
+  size_t size() const;
+
+  /**
+   * @return The number of entries that can be stored without resizing.
+   */
+  size_t capacity() const;
+
+  /**
+   * @return true if the map has no entries.
+   */
+  bool empty() const;
+
+  /**
+   * Removes all entries from the map. Does not release the underlying memory.
+   */
+  void clear();
+
+  /**
+   * Ensures that the map can hold at least newCapacity entries without
+   * needing another allocation.
+   *
+   * @param newCapacity The minimum capacity to reserve.
+   * @return true if the capacity is at least newCapacity.
+   */
+  bool reserve(size_t newCapacity);
+
+  /**
+   * Looks up the entry with the given key.
+   *
+   * @param key The key to search for.
+   * @return An iterator to the matching entry, or end() if not found.
+   */
+  iterator find(const KeyType &key);
+  const_iterator find(const KeyType &key) const;
+
+  /**
+   * @param key The key to search for.
+   * @return true if the map has an entry with the given key.
+   */
+  bool contains(const KeyType &key) const;
+
+  /**
+   * Adds an entry with the given key and value. If an entry with the same key
+   * already exists, its value is replaced.
+   *
+   * @param key The key of the entry.
+   * @param value The value to associate with the key.
+   * @return An iterator to the inserted or updated entry, or end() if memory
+   *         allocation failed, in which case the map is unmodified.
+   */
+  iterator insertOrAssign(const KeyType &key, const ValueType &value);
+  iterator insertOrAssign(const KeyType &key, ValueType &&value);
+
+  /**
+   * Removes the entry with the given key, if present.
+   *
+   * @param key The key of the entry to remove.
+   * @return true if an entry was removed.
+   */
+  bool erase(const KeyType &key);
+
+  /**
+   * Removes the entry referenced by an iterator obtained from this map.
+   *
+   * @param it A valid, dereferenceable iterator into this map.
+   */
+  void erase(const_iterator it);
+
+  /**
+   * Random-access iterators to the entries in ascending key order.
+   */
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+  const_iterator cbegin() const;
+  const_iterator cend() const;
+
+ private:
+  //! The sorted entries.
+  DynamicVector<Entry> mEntries;
+
+  //! The comparator used to order keys.
+  CompareFunction mCompare;
+
+  /**
+   * @return The index of the first entry whose key is not less than the given
+   *         key, or size() if there is none.
+   */
+  size_t lowerBound(const KeyType &key) const;
+
+  /**
+   * @return true if the entry at the given index exists and has the given key,
+   *         where index was obtained from lowerBound(key).
+   */
+  bool keyMatchesAt(size_t index, const KeyType &key) const;
+};
+
+}  // namespace chre
+
+#include "chre/util/flat_map_impl.h"
+
+#endif  // CHRE_UTIL_FLAT_MAP_H_
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_UTIL_FLAT_MAP_IMPL_H_
+#define CHRE_UTIL_FLAT_MAP_IMPL_H_
+
+#include "chre/util/flat_map.h"
+
+#include <utility>
+
+#include "chre/platform/assert.h"
+
+namespace chre {
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+FlatMap<KeyType, ValueType, CompareFunction>::FlatMap() {}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+FlatMap<KeyType, ValueType, CompareFunction>::FlatMap(
+    const CompareFunction &compare)
+    : mCompare(compare) {}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+size_t FlatMap<KeyType, ValueType, CompareFunction>::size() const {
+  return mEntries.size();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+size_t FlatMap<KeyType, ValueType, CompareFunction>::capacity() const {
+  return mEntries.capacity();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+bool FlatMap<KeyType, ValueType, CompareFunction>::empty() const {
+  return mEntries.empty();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+void FlatMap<KeyType, ValueType, CompareFunction>::clear() {
+  mEntries.clear();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+bool FlatMap<KeyType, ValueType, CompareFunction>::reserve(
+    size_t newCapacity) {
+  return mEntries.reserve(newCapacity);
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::iterator
+FlatMap<KeyType, ValueType, CompareFunction>::find(const KeyType &key) {
+  size_t index = lowerBound(key);
+  return keyMatchesAt(index, key) ? (begin() + index) : end();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::const_iterator
+FlatMap<KeyType, ValueType, CompareFunction>::find(const KeyType &key) const {
+  size_t index = lowerBound(key);
+  return keyMatchesAt(index, key) ? (begin() + index) : end();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+bool FlatMap<KeyType, ValueType, CompareFunction>::contains(
+    const KeyType &key) const {
+  return keyMatchesAt(lowerBound(key), key);
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::iterator
+FlatMap<KeyType, ValueType, CompareFunction>::insertOrAssign(
+    const KeyType &key, const ValueType &value) {
+  size_t index = lowerBound(key);
+  if (keyMatchesAt(index, key)) {
+    mEntries[index].value = value;
+  } else if (!mEntries.insert(index, Entry(key, value))) {
+    return end();
+  }
+  return begin() + index;
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::iterator
+FlatMap<KeyType, ValueType, CompareFunction>::insertOrAssign(
+    const KeyType &key, ValueType &&value) {
+  size_t index = lowerBound(key);
+  if (keyMatchesAt(index, key)) {
+    mEntries[index].value = std::move(value);
+  } else if (!mEntries.insert(index, Entry(key, std::move(value)))) {
+    return end();
+  }
+  return begin() + index;
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+bool FlatMap<KeyType, ValueType, CompareFunction>::erase(const KeyType &key) {
+  size_t index = lowerBound(key);
+  bool found = keyMatchesAt(index, key);
+  if (found) {
+    mEntries.erase(index);
+  }
+  return found;
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+void FlatMap<KeyType, ValueType, CompareFunction>::erase(const_iterator it) {
+  CHRE_ASSERT(it >= cbegin() && it < cend());
+  mEntries.erase(static_cast<size_t>(it - cbegin()));
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::iterator
+FlatMap<KeyType, ValueType, CompareFunction>::begin() {
+  return mEntries.begin();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::iterator
+FlatMap<KeyType, ValueType, CompareFunction>::end() {
+  return mEntries.end();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::const_iterator
+FlatMap<KeyType, ValueType, CompareFunction>::begin() const {
+  return cbegin();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::const_iterator
+FlatMap<KeyType, ValueType, CompareFunction>::end() const {
+  return cend();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::const_iterator
+FlatMap<KeyType, ValueType, CompareFunction>::cbegin() const {
+  return mEntries.cbegin();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+typename FlatMap<KeyType, ValueType, CompareFunction>::const_iterator
+FlatMap<KeyType, ValueType, CompareFunction>::cend() const {
+  return mEntries.cend();
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+size_t FlatMap<KeyType, ValueType, CompareFunction>::lowerBound(
+    const KeyType &key) const {
+  size_t low = 0;
+  size_t high = mEntries.size();
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (mCompare(mEntries[mid].key, key)) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+template <typename KeyType, typename ValueType, typename CompareFunction>
+bool FlatMap<KeyType, ValueType, CompareFunction>::keyMatchesAt(
+    size_t index, const KeyType &key) const {
+  // lowerBound() guarantees !(entry.key < key), so the keys are equivalent if
+  // !(key < entry.key) as well
+  return (index < mEntries.size() && !mCompare(key, mEntries[index].key));
+}
+
+}  // namespace chre
+
+#endif  // CHRE_UTIL_FLAT_MAP_IMPL_H_
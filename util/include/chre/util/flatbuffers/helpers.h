@@ -44,6 +44,12 @@ class ChreFlatBufferBuilder : public flatbuffers::FlatBufferBuilder {
   explicit ChreFlatBufferBuilder(size_t initialSize = 1024)
       : flatbuffers::FlatBufferBuilder(initialSize, &mAllocator) {}
 
+  // The buffer must be released while mAllocator is still alive, as the base
+  // class destructor runs after mAllocator has been destroyed.
+  ~ChreFlatBufferBuilder() {
+    Reset();
+  }
+
   // This is defined in flatbuffers::FlatBufferBuilder, but must be further
   // defined here since template functions aren't inherited.
   template <typename T>
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_UTIL_LOCK_FREE_MEMORY_POOL_H_
+#define CHRE_UTIL_LOCK_FREE_MEMORY_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "chre/platform/atomic.h"
+#include "chre/util/non_copyable.h"
+
+namespace chre {
+
+/**
+ * A thread-safe variant of MemoryPool that does not take a lock. It can be used
+ * in place of SynchronizedMemoryPool where many threads allocate and free
+ * concurrently.
+ *
+ * The free list is a Treiber stack of block indices. The head of the stack
+ * packs a 16-bit block index with a 16-bit tag that is incremented on every
+ * pop, which protects against the ABA problem as long as a thread is not
+ * preempted for 65536 consecutive allocations in the middle of its own. The
+ * "next" links are kept outside the element storage so that a concurrent
+ * allocation can never observe an element's bytes as a link.
+ *
+ * getFreeBlockCount() is maintained with a separate atomic counter. It is
+ * exact when there are no concurrent operations, and otherwise may briefly lag
+ * by the number of in-flight allocate()/deallocate() calls.
+ */
+template <typename ElementType, size_t kSize>
+class LockFreeMemoryPool : public NonCopyable {
+ public:
+  static_assert(kSize > 0 && kSize < UINT16_MAX,
+                "Pool size must fit in a 16-bit block index");
+
+  /**
+   * Constructs a LockFreeMemoryPool with all blocks on the free list.
+   */
+  LockFreeMemoryPool();
+
+  /**
+   * Allocates space for an object, constructs it and returns the pointer to
+   * that object. Safe to call from any thread.
+   *
+   * @param  The arguments to be forwarded to the constructor of the object.
+   * @return A pointer to a constructed object or nullptr if the allocation
+   *         fails.
+   */
+  template <typename... Args>
+  ElementType *allocate(Args &&... args);
+
+  /**
+   * Releases the memory of a previously allocated element. The pointer provided
+   * here must be one that was produced by a previous call to the allocate()
+   * function. The destructor is invoked on the object. Safe to call from any
+   * thread.
+   *
+   * @param A pointer to an element that was previously allocated by the
+   *        allocate() function.
+   */
+  void deallocate(ElementType *element);
+
+  /**
+   * Returns the number of blocks that can currently be allocated, read from a
+   * counter maintained separately from the free list. This method is
+   * thread-safe and never blocks.
+   *
+   * @return the number of unused blocks in this memory pool, between 0 and
+   *         kSize. While allocate() or deallocate() calls are in flight on
+   *         other threads, this may differ from the length of the free list
+   *         by the number of those calls.
+   */
+  size_t getFreeBlockCount() const;
+
+ private:
+  //! Marks the end of the free list.
+  static constexpr uint32_t kInvalidBlockIndex = UINT16_MAX;
+
+  //! Mask of the block index part of mFreeListHead.
+  static constexpr uint32_t kBlockIndexMask = 0xffff;
+
+  //! The amount to shift the tag part of mFreeListHead by.
+  static constexpr uint32_t kTagShift = 16;
+
+  //! The link to the next free block, stored outside the element storage.
+  struct FreeListLink {
+    FreeListLink() : nextFreeBlockIndex(kInvalidBlockIndex) {}
+
+    AtomicUint32 nextFreeBlockIndex;
+  };
+
+  //! Storage for memory pool blocks. To avoid static initialization of members,
+  //! std::aligned_storage is used.
+  typename std::aligned_storage<sizeof(ElementType),
+                                alignof(ElementType)>::type mBlocks[kSize];
+
+  //! The next free block for each block that is on the free list.
+  FreeListLink mLinks[kSize];
+
+  //! The head of the free list: (tag << kTagShift) | blockIndex.
+  AtomicUint32 mFreeListHead;
+
+  //! The number of free blocks available.
+  AtomicUint32 mFreeBlockCount;
+
+  /**
+   * Pops a block index off the free list.
+   *
+   * @return The block index, or kInvalidBlockIndex if the pool is exhausted.
+   */
+  uint32_t popFreeBlock();
+
+  /**
+   * Pushes a block index onto the free list.
+   */
+  void pushFreeBlock(uint32_t blockIndex);
+
+  /**
+   * @return A pointer to the storage of the given block.
+   */
+  ElementType *blockAt(uint32_t blockIndex) {
+    return reinterpret_cast<ElementType *>(&mBlocks[blockIndex]);
+  }
+};
+
+}  // namespace chre
+
+#include "chre/util/lock_free_memory_pool_impl.h"
+
+#endif  // CHRE_UTIL_LOCK_FREE_MEMORY_POOL_H_
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_UTIL_LOCK_FREE_MEMORY_POOL_IMPL_H_
+#define CHRE_UTIL_LOCK_FREE_MEMORY_POOL_IMPL_H_
+
+#include "chre/util/lock_free_memory_pool.h"
+
+#include <new>
+#include <utility>
+
+#include "chre/platform/assert.h"
+
+namespace chre {
+
+template <typename ElementType, size_t kSize>
+LockFreeMemoryPool<ElementType, kSize>::LockFreeMemoryPool()
+    : mFreeListHead(0), mFreeBlockCount(kSize) {
+  // Build the free list such that each block refers to the next one, as in
+  // MemoryPool. The last block keeps the default kInvalidBlockIndex.
+  for (uint32_t i = 0; i + 1 < kSize; i++) {
+    mLinks[i].nextFreeBlockIndex.store(i + 1);
+  }
+}
+
+template <typename ElementType, size_t kSize>
+template <typename... Args>
+ElementType *LockFreeMemoryPool<ElementType, kSize>::allocate(
+    Args &&... args) {
+  uint32_t blockIndex = popFreeBlock();
+  if (blockIndex == kInvalidBlockIndex) {
+    return nullptr;
+  }
+
+  mFreeBlockCount.fetch_decrement();
+  return new (blockAt(blockIndex)) ElementType(std::forward<Args>(args)...);
+}
+
+template <typename ElementType, size_t kSize>
+void LockFreeMemoryPool<ElementType, kSize>::deallocate(ElementType *element) {
+  uintptr_t elementAddress = reinterpret_cast<uintptr_t>(element);
+  uintptr_t baseAddress = reinterpret_cast<uintptr_t>(&mBlocks[0]);
+  uint32_t blockIndex = static_cast<uint32_t>(
+      (elementAddress - baseAddress) / sizeof(mBlocks[0]));
+  CHRE_ASSERT(blockIndex < kSize);
+
+  element->~ElementType();
+  pushFreeBlock(blockIndex);
+  mFreeBlockCount.fetch_increment();
+}
+
+template <typename ElementType, size_t kSize>
+size_t LockFreeMemoryPool<ElementType, kSize>::getFreeBlockCount() const {
+  // The counter is decremented after a block is taken and incremented after it
+  // is returned, so it can't exceed kSize, but it may transiently wrap below 0
+  // if a deallocate() increment races ahead of the matching allocate()
+  // decrement being observed.
+  uint32_t count = mFreeBlockCount.load();
+  return (count > kSize) ? 0 : count;
+}
+
+template <typename ElementType, size_t kSize>
+uint32_t LockFreeMemoryPool<ElementType, kSize>::popFreeBlock() {
+  uint32_t head = mFreeListHead.load();
+  while (true) {
+    uint32_t blockIndex = head & kBlockIndexMask;
+    if (blockIndex == kInvalidBlockIndex) {
+      return kInvalidBlockIndex;
+    }
+
+    // If another thread pops this block first, its tag bump makes the CAS
+    // below fail, so a stale link read here is never installed
+    uint32_t next = mLinks[blockIndex].nextFreeBlockIndex.load();
+    uint32_t tag = (head >> kTagShift) + 1;
+    if (mFreeListHead.compare_exchange(head, (tag << kTagShift) | next)) {
+      return blockIndex;
+    }
+  }
+}
+
+template <typename ElementType, size_t kSize>
+void LockFreeMemoryPool<ElementType, kSize>::pushFreeBlock(
+    uint32_t blockIndex) {
+  uint32_t head = mFreeListHead.load();
+  do {
+    mLinks[blockIndex].nextFreeBlockIndex.store(head & kBlockIndexMask);
+  } while (!mFreeListHead.compare_exchange(
+      head, (head & ~kBlockIndexMask) | blockIndex));
+}
+
+}  // namespace chre
+
+#endif  // CHRE_UTIL_LOCK_FREE_MEMORY_POOL_IMPL_H_
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_UTIL_LOCK_FREE_MPSC_QUEUE_H_
+#define CHRE_UTIL_LOCK_FREE_MPSC_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "chre/platform/atomic.h"
+#include "chre/platform/condition_variable.h"
+#include "chre/platform/mutex.h"
+#include "chre/util/non_copyable.h"
+
+namespace chre {
+
+/**
+ * @return The smallest power of two that is greater than or equal to value,
+ *         e.g. for sizing a LockFreeMpscQueue from a configurable element count
+ */
+constexpr size_t roundUpToPowerOfTwo(size_t value, size_t powerOfTwo = 1) {
+  return (powerOfTwo >= value) ? powerOfTwo
+                               : roundUpToPowerOfTwo(value, powerOfTwo * 2);
+}
+
+/**
+ * A bounded multi-producer, single-consumer queue that offers the same
+ * push/pop/empty/size contract as FixedSizeBlockingQueue, but where push() does
+ * not take a lock. Producers claim a slot with a compare-and-swap on the
+ * enqueue position, and publish the element through a per-slot sequence
+ * number, so concurrent producers never block each other or the consumer.
+ *
+ * The consumer only falls back to the mutex and condition variable when the
+ * queue is empty and it needs to sleep in pop(). Producers only touch the
+ * mutex when they observe that the consumer is sleeping, so in the common case
+ * where the consumer is busy, neither side takes a lock.
+ *
+ * pop(), empty() and size() must only be called from the single consumer
+ * thread. push() is safe to call from any thread.
+ *
+ * @param ElementType The type of element stored in the queue.
+ * @param kCapacity The maximum number of elements, must be a power of two.
+ */
+template <typename ElementType, size_t kCapacity>
+class LockFreeMpscQueue : public NonCopyable {
+ public:
+  static_assert(kCapacity > 0 && (kCapacity & (kCapacity - 1)) == 0,
+                "Capacity must be a power of two");
+  static_assert(kCapacity <= (UINT32_MAX / 2), "Capacity is too large");
+
+  LockFreeMpscQueue();
+  ~LockFreeMpscQueue();
+
+  /**
+   * Pushes an element into the queue, and wakes up the consumer if it is
+   * blocked in pop(). Safe to call from any thread.
+   *
+   * @param element The element to be pushed.
+   *
+   * @return true if the element was pushed, false if the queue was full.
+   */
+  bool push(const ElementType &element);
+  bool push(ElementType &&element);
+
+  /**
+   * Pops one element from the queue. If the queue is empty, the calling thread
+   * will block until an element has been pushed. Must only be called from the
+   * consumer thread.
+   *
+   * @return The element that was popped.
+   */
+  ElementType pop();
+
+  /**
+   * Determines whether an element is ready to be popped. Must only be called
+   * from the consumer thread.
+   */
+  bool empty();
+
+  /**
+   * Returns the number of elements in the queue, including any that are in the
+   * process of being pushed by another thread. Must only be called from the
+   * consumer thread.
+   */
+  size_t size();
+
+ private:
+  //! A single slot in the ring buffer.
+  struct Cell {
+    Cell() : sequence(0) {}
+
+    //! Equal to the position of the next push that may use this cell when it
+    //! is free, and to that position + 1 once the element has been published.
+    AtomicUint32 sequence;
+
+    //! Storage for the element, constructed in-place on push.
+    typename std::aligned_storage<sizeof(ElementType),
+                                  alignof(ElementType)>::type data;
+  };
+
+  //! Mask used to map a position to an index in mCells.
+  static constexpr uint32_t kIndexMask = static_cast<uint32_t>(kCapacity - 1);
+
+  //! The ring buffer of cells.
+  Cell mCells[kCapacity];
+
+  //! The position of the next push. Shared between all producers.
+  AtomicUint32 mEnqueuePos;
+
+  //! The position of the next pop. Only accessed by the consumer.
+  uint32_t mDequeuePos = 0;
+
+  //! Set by the consumer while it is (about to be) waiting on
+  //! mConditionVariable, to let producers know they need to wake it up.
+  AtomicBool mConsumerWaiting;
+
+  //! Used with mConditionVariable to block the consumer when the queue is
+  //! empty.
+  Mutex mMutex;
+
+  //! Signaled by producers when the consumer is waiting.
+  ConditionVariable mConditionVariable;
+
+  /**
+   * Claims the next free cell for a producer.
+   *
+   * @param pos Populated with the claimed position on success.
+   *
+   * @return The claimed cell, or nullptr if the queue is full.
+   */
+  Cell *claimCell(uint32_t *pos);
+
+  /**
+   * Makes an element constructed in a claimed cell visible to the consumer,
+   * and wakes the consumer up if needed.
+   */
+  void publishCell(Cell *cell, uint32_t pos);
+
+  /**
+   * @return The cell at the front of the queue if its element has been
+   *         published, nullptr otherwise.
+   */
+  Cell *frontCell();
+
+  /**
+   * @return A pointer to the element stored in the given cell.
+   */
+  ElementType *elementAt(Cell *cell) {
+    return reinterpret_cast<ElementType *>(&cell->data);
+  }
+};
+
+}  // namespace chre
+
+#include "chre/util/lock_free_mpsc_queue_impl.h"
+
+#endif  // CHRE_UTIL_LOCK_FREE_MPSC_QUEUE_H_
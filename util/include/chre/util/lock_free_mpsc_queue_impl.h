@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_UTIL_LOCK_FREE_MPSC_QUEUE_IMPL_H_
+#define CHRE_UTIL_LOCK_FREE_MPSC_QUEUE_IMPL_H_
+
+#include "chre/util/lock_free_mpsc_queue.h"
+
+#include <new>
+#include <utility>
+
+#include "chre/util/lock_guard.h"
+
+namespace chre {
+
+template <typename ElementType, size_t kCapacity>
+LockFreeMpscQueue<ElementType, kCapacity>::LockFreeMpscQueue()
+    : mEnqueuePos(0), mConsumerWaiting(false) {
+  for (uint32_t i = 0; i < kCapacity; i++) {
+    mCells[i].sequence.store(i);
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+LockFreeMpscQueue<ElementType, kCapacity>::~LockFreeMpscQueue() {
+  Cell *cell;
+  while ((cell = frontCell()) != nullptr) {
+    elementAt(cell)->~ElementType();
+    mDequeuePos++;
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+bool LockFreeMpscQueue<ElementType, kCapacity>::push(
+    const ElementType &element) {
+  uint32_t pos;
+  Cell *cell = claimCell(&pos);
+  if (cell != nullptr) {
+    new (&cell->data) ElementType(element);
+    publishCell(cell, pos);
+  }
+  return (cell != nullptr);
+}
+
+template <typename ElementType, size_t kCapacity>
+bool LockFreeMpscQueue<ElementType, kCapacity>::push(ElementType &&element) {
+  uint32_t pos;
+  Cell *cell = claimCell(&pos);
+  if (cell != nullptr) {
+    new (&cell->data) ElementType(std::move(element));
+    publishCell(cell, pos);
+  }
+  return (cell != nullptr);
+}
+
+template <typename ElementType, size_t kCapacity>
+ElementType LockFreeMpscQueue<ElementType, kCapacity>::pop() {
+  Cell *cell = frontCell();
+  while (cell == nullptr) {
+    // Announce that we're about to sleep before re-checking the queue, so that
+    // a producer either sees the flag or its element is seen here
+    LockGuard<Mutex> lock(mMutex);
+    mConsumerWaiting = true;
+    cell = frontCell();
+    if (cell == nullptr) {
+      mConditionVariable.wait(mMutex);
+      cell = frontCell();
+    }
+    mConsumerWaiting = false;
+  }
+
+  ElementType *element = elementAt(cell);
+  ElementType result(std::move(*element));
+  element->~ElementType();
+
+  // Hand the cell back to producers for the next lap around the ring
+  cell->sequence.store(mDequeuePos + static_cast<uint32_t>(kCapacity));
+  mDequeuePos++;
+  return result;
+}
+
+template <typename ElementType, size_t kCapacity>
+bool LockFreeMpscQueue<ElementType, kCapacity>::empty() {
+  return (frontCell() == nullptr);
+}
+
+template <typename ElementType, size_t kCapacity>
+size_t LockFreeMpscQueue<ElementType, kCapacity>::size() {
+  uint32_t count = mEnqueuePos.load() - mDequeuePos;
+  return (count > kCapacity) ? kCapacity : count;
+}
+
+template <typename ElementType, size_t kCapacity>
+typename LockFreeMpscQueue<ElementType, kCapacity>::Cell *
+LockFreeMpscQueue<ElementType, kCapacity>::claimCell(uint32_t *pos) {
+  uint32_t enqueuePos = mEnqueuePos.load();
+  while (true) {
+    Cell *cell = &mCells[enqueuePos & kIndexMask];
+    int32_t diff = static_cast<int32_t>(cell->sequence.load() - enqueuePos);
+    if (diff == 0) {
+      // The cell is free for this lap - try to claim it. On failure,
+      // enqueuePos is updated to the latest value and we retry.
+      if (mEnqueuePos.compare_exchange(enqueuePos, enqueuePos + 1)) {
+        *pos = enqueuePos;
+        return cell;
+      }
+    } else if (diff < 0) {
+      // The consumer hasn't released this cell from the previous lap
+      return nullptr;
+    } else {
+      // Another producer claimed this position first
+      enqueuePos = mEnqueuePos.load();
+    }
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+void LockFreeMpscQueue<ElementType, kCapacity>::publishCell(Cell *cell,
+                                                            uint32_t pos) {
+  cell->sequence.store(pos + 1);
+
+  if (mConsumerWaiting) {
+    // Taking the lock ensures the consumer is either inside wait() or hasn't
+    // yet re-checked the queue, so the notification can't be lost
+    LockGuard<Mutex> lock(mMutex);
+    mConditionVariable.notify_one();
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+typename LockFreeMpscQueue<ElementType, kCapacity>::Cell *
+LockFreeMpscQueue<ElementType, kCapacity>::frontCell() {
+  Cell *cell = &mCells[mDequeuePos & kIndexMask];
+  return (cell->sequence.load() == mDequeuePos + 1) ? cell : nullptr;
+}
+
+}  // namespace chre
+
+#endif  // CHRE_UTIL_LOCK_FREE_MPSC_QUEUE_IMPL_H_
@@ -52,7 +52,13 @@ class SynchronizedMemoryPool : public NonCopyable {
   void deallocate(ElementType *element);
 
   /**
-   * @return the number of unused blocks in this memory pool.
+   * Returns the number of blocks that can currently be allocated. This method
+   * is thread-safe and a lock will be acquired upon entry to this method, but
+   * the count may be stale by the time it is returned if other threads
+   * allocate or deallocate concurrently.
+   *
+   * @return the number of unused blocks in this memory pool, between 0 and
+   *         kSize.
    */
   size_t getFreeBlockCount();
 
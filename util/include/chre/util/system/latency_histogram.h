@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_UTIL_SYSTEM_LATENCY_HISTOGRAM_H_
+#define CHRE_UTIL_SYSTEM_LATENCY_HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chre/util/system/debug_dump.h"
+#include "chre/util/time.h"
+
+namespace chre {
+
+/**
+ * A fixed-size histogram of durations, cheap enough to update on the event
+ * delivery path. Buckets are on a logarithmic scale, each covering 4x the range
+ * of the previous one: [0, 16us), [16us, 64us), ... [16ms, 64ms), [64ms, inf).
+ */
+class LatencyHistogram {
+ public:
+  //! The number of buckets in the histogram.
+  static constexpr size_t kNumBuckets = 8;
+
+  /**
+   * Adds a sample to the histogram. Bucket counts saturate rather than wrap.
+   *
+   * @param duration The duration to record.
+   */
+  void record(Nanoseconds duration);
+
+  /**
+   * @return The number of samples recorded.
+   */
+  uint32_t getCount() const {
+    return mCount;
+  }
+
+  /**
+   * @return The number of samples recorded in the given bucket.
+   */
+  uint32_t getBucketCount(size_t index) const {
+    return mBucketCounts[index];
+  }
+
+  /**
+   * @return The average of all samples recorded, or 0 if there are none.
+   */
+  Nanoseconds getAverage() const;
+
+  /**
+   * @return The largest sample recorded.
+   */
+  Nanoseconds getMax() const {
+    return Nanoseconds(mMaxNs);
+  }
+
+  /**
+   * @return The exclusive upper bound of the given bucket, in microseconds. The
+   *         last bucket has no upper bound, and UINT32_MAX is returned.
+   */
+  static uint32_t getBucketUpperBoundMicros(size_t index);
+
+  /**
+   * Prints the average, maximum and bucket counts on a single line, without a
+   * trailing newline.
+   *
+   * @param debugDump The object that is printed into for debug dump logs.
+   */
+  void logStateToBuffer(DebugDumpWrapper &debugDump) const;
+
+ private:
+  //! The upper bound of the first bucket, in microseconds.
+  static constexpr uint32_t kFirstBucketUpperBoundMicros = 16;
+
+  //! The number of bits the upper bound is shifted by for each bucket.
+  static constexpr uint32_t kBucketShift = 2;
+
+  uint32_t mBucketCounts[kNumBuckets] = {};
+
+  //! The total number of samples recorded, saturating at UINT32_MAX.
+  uint32_t mCount = 0;
+
+  //! The sum of all samples recorded, in nanoseconds.
+  uint64_t mTotalNs = 0;
+
+  //! The largest sample recorded, in nanoseconds.
+  uint64_t mMaxNs = 0;
+};
+
+}  // namespace chre
+
+#endif  // CHRE_UTIL_SYSTEM_LATENCY_HISTOGRAM_H_
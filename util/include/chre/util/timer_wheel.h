@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_UTIL_TIMER_WHEEL_H_
+#define CHRE_UTIL_TIMER_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chre/util/non_copyable.h"
+#include "chre/util/time.h"
+
+namespace chre {
+
+/**
+ * A fixed-capacity hierarchical timing wheel, which keeps elements ordered by
+ * expiration time with O(1) insertion, removal and rescheduling.
+ *
+ * Time is divided into ticks of 2^kTickShift nanoseconds (~1ms). Each level of
+ * the wheel has kSlotsPerLevel slots, and each slot of a level spans as many
+ * ticks as the whole level below it. An element is filed in the lowest level
+ * where its tick shares all higher-order slot digits with the current tick, so
+ * all elements of a level expire before all elements of the next one, and
+ * slots within a level are ordered by time. Elements too far in the future for
+ * the top level are kept in an unordered overflow list.
+ *
+ * The exact expiration time of every element is kept, so the wheel never
+ * reports an element as expiring early or late: getNextIndex() returns the
+ * element with the earliest exact expiration time.
+ *
+ * Elements are referred to by a stable index in [0, kCapacity), which remains
+ * valid until the element is removed.
+ *
+ * @param ElementType The type of element stored, must be copy-assignable and
+ *        default-constructible.
+ * @param kCapacity The maximum number of elements.
+ */
+template <typename ElementType, size_t kCapacity>
+class TimerWheel : public NonCopyable {
+ public:
+  static_assert(kCapacity > 0 && kCapacity < UINT16_MAX,
+                "Capacity must fit in a 16-bit index");
+
+  //! Returned by insert() and getNextIndex() when there is no valid index.
+  static constexpr size_t kInvalidIndex = kCapacity;
+
+  TimerWheel();
+
+  /**
+   * @return The number of elements in the wheel.
+   */
+  size_t size() const {
+    return mSize;
+  }
+
+  /**
+   * @return true if the wheel contains no elements.
+   */
+  bool empty() const {
+    return (mSize == 0);
+  }
+
+  /**
+   * Adds an element to the wheel.
+   *
+   * @param element The element to add.
+   * @param expirationTime The time at which the element expires.
+   * @return The index of the new element, or kInvalidIndex if the wheel is
+   *         full.
+   */
+  size_t insert(const ElementType &element, Nanoseconds expirationTime);
+
+  /**
+   * Removes an element from the wheel.
+   *
+   * @param index The index of an element currently in the wheel.
+   */
+  void remove(size_t index);
+
+  /**
+   * Changes the expiration time of an element, keeping its index.
+   *
+   * @param index The index of an element currently in the wheel.
+   * @param expirationTime The new expiration time of the element.
+   */
+  void reschedule(size_t index, Nanoseconds expirationTime);
+
+  /**
+   * @return true if index refers to an element currently in the wheel.
+   */
+  bool isInUse(size_t index) const {
+    return (index < kCapacity && mNodes[index].list != kNoList);
+  }
+
+  /**
+   * @return The element at the given index, which must be in use.
+   */
+  ElementType &operator[](size_t index) {
+    return mNodes[index].element;
+  }
+  const ElementType &operator[](size_t index) const {
+    return mNodes[index].element;
+  }
+
+  /**
+   * @return The expiration time of the element at the given index, which must
+   *         be in use.
+   */
+  Nanoseconds getExpirationTime(size_t index) const {
+    return mNodes[index].expirationTime;
+  }
+
+  /**
+   * @return The index of the element with the earliest expiration time, or
+   *         kInvalidIndex if the wheel is empty.
+   */
+  size_t getNextIndex() const;
+
+  /**
+   * Moves the wheel forward towards the given time, cascading elements from
+   * higher levels into lower ones as their slots come due. The wheel never
+   * moves past the earliest element, so this can be called at any time, and
+   * should be called before expired elements are collected to keep the lower
+   * levels short.
+   *
+   * @param currentTime The current time.
+   */
+  void advance(Nanoseconds currentTime);
+
+ private:
+  //! The number of bits of a nanosecond timestamp below one tick.
+  static constexpr uint32_t kTickShift = 20;
+
+  //! The number of bits of the tick that select a slot in one level.
+  static constexpr uint32_t kSlotBits = 6;
+
+  static constexpr size_t kSlotsPerLevel = (1 << kSlotBits);
+
+  static constexpr size_t kNumLevels = 4;
+
+  //! The list holding elements beyond the range of the top level.
+  static constexpr uint16_t kOverflowList = kNumLevels * kSlotsPerLevel;
+
+  static constexpr size_t kNumLists = kOverflowList + 1;
+
+  //! Marks the end of a list, and unused nodes.
+  static constexpr uint16_t kNoList = UINT16_MAX;
+  static constexpr uint16_t kNoNode = UINT16_MAX;
+
+  struct Node {
+    ElementType element;
+    Nanoseconds expirationTime;
+
+    //! The tick the element expires in.
+    uint64_t tick;
+
+    //! Links within the list the node is in, or the free list.
+    uint16_t prev;
+    uint16_t next;
+
+    //! The list the node is in, or kNoList if it's free.
+    uint16_t list = kNoList;
+  };
+
+  Node mNodes[kCapacity];
+
+  //! The first node of each slot, followed by the overflow list.
+  uint16_t mListHeads[kNumLists];
+
+  //! One bit per non-empty slot, for each level.
+  uint64_t mOccupiedSlots[kNumLevels] = {};
+
+  //! The first free node, linked through Node::next.
+  uint16_t mFreeHead;
+
+  size_t mSize = 0;
+
+  //! The tick the wheel has advanced to. Every element expires at or after
+  //! this tick.
+  uint64_t mCurrentTick = 0;
+
+  /**
+   * @return The list a node expiring at the given tick belongs in, relative
+   *         to mCurrentTick.
+   */
+  uint16_t getListForTick(uint64_t tick) const;
+
+  /**
+   * @return The earliest non-empty slot, or kNoList if there is none. Does not
+   *         consider the overflow list.
+   */
+  uint16_t getNextSlot() const;
+
+  /**
+   * @return The first tick covered by the given slot.
+   */
+  uint64_t getSlotStartTick(uint16_t list) const;
+
+  /**
+   * Adds a node to the front of the list given by its tick.
+   */
+  void linkNode(uint16_t index);
+
+  /**
+   * Removes a node from its list.
+   */
+  void unlinkNode(uint16_t index);
+
+  /**
+   * Re-files every node in the given list relative to mCurrentTick.
+   */
+  void refileList(uint16_t list);
+
+  /**
+   * @return The index of the lowest set bit of a non-zero value.
+   */
+  static size_t getLowestSetBit(uint64_t bits);
+};
+
+}  // namespace chre
+
+#include "chre/util/timer_wheel_impl.h"
+
+#endif  // CHRE_UTIL_TIMER_WHEEL_H_
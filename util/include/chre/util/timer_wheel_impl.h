@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CHRE_UTIL_TIMER_WHEEL_IMPL_H_
+#define CHRE_UTIL_TIMER_WHEEL_IMPL_H_
+
+#include "chre/util/timer_wheel.h"
+
+#include "chre/platform/assert.h"
+
+namespace chre {
+
+template <typename ElementType, size_t kCapacity>
+constexpr size_t TimerWheel<ElementType, kCapacity>::kInvalidIndex;
+
+template <typename ElementType, size_t kCapacity>
+constexpr uint16_t TimerWheel<ElementType, kCapacity>::kOverflowList;
+
+template <typename ElementType, size_t kCapacity>
+constexpr uint16_t TimerWheel<ElementType, kCapacity>::kNoList;
+
+template <typename ElementType, size_t kCapacity>
+constexpr uint16_t TimerWheel<ElementType, kCapacity>::kNoNode;
+
+template <typename ElementType, size_t kCapacity>
+TimerWheel<ElementType, kCapacity>::TimerWheel() : mFreeHead(0) {
+  for (size_t i = 0; i < kNumLists; i++) {
+    mListHeads[i] = kNoNode;
+  }
+  for (size_t i = 0; i < kCapacity; i++) {
+    mNodes[i].next = (i + 1 < kCapacity) ? static_cast<uint16_t>(i + 1)
+                                         : kNoNode;
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+size_t TimerWheel<ElementType, kCapacity>::insert(const ElementType &element,
+                                                  Nanoseconds expirationTime) {
+  if (mFreeHead == kNoNode) {
+    return kInvalidIndex;
+  }
+
+  uint16_t index = mFreeHead;
+  Node &node = mNodes[index];
+  mFreeHead = node.next;
+
+  node.element = element;
+  node.expirationTime = expirationTime;
+  node.tick = expirationTime.toRawNanoseconds() >> kTickShift;
+  linkNode(index);
+  mSize++;
+
+  return index;
+}
+
+template <typename ElementType, size_t kCapacity>
+void TimerWheel<ElementType, kCapacity>::remove(size_t index) {
+  CHRE_ASSERT(isInUse(index));
+  if (isInUse(index)) {
+    uint16_t nodeIndex = static_cast<uint16_t>(index);
+    unlinkNode(nodeIndex);
+    mNodes[nodeIndex].list = kNoList;
+    mNodes[nodeIndex].next = mFreeHead;
+    mFreeHead = nodeIndex;
+    mSize--;
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+void TimerWheel<ElementType, kCapacity>::reschedule(
+    size_t index, Nanoseconds expirationTime) {
+  CHRE_ASSERT(isInUse(index));
+  if (isInUse(index)) {
+    uint16_t nodeIndex = static_cast<uint16_t>(index);
+    unlinkNode(nodeIndex);
+    mNodes[nodeIndex].expirationTime = expirationTime;
+    mNodes[nodeIndex].tick = expirationTime.toRawNanoseconds() >> kTickShift;
+    linkNode(nodeIndex);
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+size_t TimerWheel<ElementType, kCapacity>::getNextIndex() const {
+  uint16_t list = getNextSlot();
+  if (list == kNoList) {
+    list = kOverflowList;
+  }
+
+  // Elements within a slot (or the overflow list) aren't sorted, but level 0
+  // slots only span a single tick so they are usually short
+  size_t nextIndex = kInvalidIndex;
+  for (uint16_t i = mListHeads[list]; i != kNoNode; i = mNodes[i].next) {
+    if (nextIndex == kInvalidIndex ||
+        mNodes[i].expirationTime < mNodes[nextIndex].expirationTime) {
+      nextIndex = i;
+    }
+  }
+
+  return nextIndex;
+}
+
+template <typename ElementType, size_t kCapacity>
+void TimerWheel<ElementType, kCapacity>::advance(Nanoseconds currentTime) {
+  uint64_t targetTick = currentTime.toRawNanoseconds() >> kTickShift;
+
+  while (mCurrentTick < targetTick) {
+    uint16_t list = getNextSlot();
+    if (list == kNoList) {
+      // Only overflow elements remain, if any. Jump ahead, but no further than
+      // the earliest of them, and file them into the wheel where possible.
+      for (uint16_t i = mListHeads[kOverflowList]; i != kNoNode;
+           i = mNodes[i].next) {
+        if (mNodes[i].tick < targetTick) {
+          targetTick = mNodes[i].tick;
+        }
+      }
+      mCurrentTick = targetTick;
+      refileList(kOverflowList);
+      break;
+    }
+
+    uint64_t slotStartTick = getSlotStartTick(list);
+    if (slotStartTick > targetTick) {
+      mCurrentTick = targetTick;
+    } else {
+      // Elements in a level 0 slot all expire in its tick, so the wheel can't
+      // advance past them. Higher level slots are cascaded into lower levels.
+      mCurrentTick = slotStartTick;
+      if (list >= kSlotsPerLevel) {
+        refileList(list);
+        continue;
+      }
+    }
+    break;
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+uint16_t TimerWheel<ElementType, kCapacity>::getListForTick(
+    uint64_t tick) const {
+  if (tick < mCurrentTick) {
+    tick = mCurrentTick;
+  }
+
+  uint64_t diff = tick ^ mCurrentTick;
+  for (size_t level = 0; level < kNumLevels; level++) {
+    uint32_t levelShift = static_cast<uint32_t>(kSlotBits * level);
+    if ((diff >> (levelShift + kSlotBits)) == 0) {
+      size_t slot = (tick >> levelShift) & (kSlotsPerLevel - 1);
+      return static_cast<uint16_t>(level * kSlotsPerLevel + slot);
+    }
+  }
+
+  return kOverflowList;
+}
+
+template <typename ElementType, size_t kCapacity>
+uint16_t TimerWheel<ElementType, kCapacity>::getNextSlot() const {
+  // Every element in a level expires before every element in the levels above,
+  // and occupied slots are never behind the current tick, so the lowest set
+  // bit of the lowest non-empty level is the next slot.
+  for (size_t level = 0; level < kNumLevels; level++) {
+    if (mOccupiedSlots[level] != 0) {
+      size_t slot = getLowestSetBit(mOccupiedSlots[level]);
+      return static_cast<uint16_t>(level * kSlotsPerLevel + slot);
+    }
+  }
+
+  return kNoList;
+}
+
+template <typename ElementType, size_t kCapacity>
+uint64_t TimerWheel<ElementType, kCapacity>::getSlotStartTick(
+    uint16_t list) const {
+  size_t level = list / kSlotsPerLevel;
+  uint32_t levelShift = static_cast<uint32_t>(kSlotBits * level);
+  uint64_t slot = list % kSlotsPerLevel;
+  uint64_t levelMask = (UINT64_C(1) << (levelShift + kSlotBits)) - 1;
+  return (mCurrentTick & ~levelMask) | (slot << levelShift);
+}
+
+template <typename ElementType, size_t kCapacity>
+void TimerWheel<ElementType, kCapacity>::linkNode(uint16_t index) {
+  Node &node = mNodes[index];
+  uint16_t list = getListForTick(node.tick);
+
+  node.list = list;
+  node.prev = kNoNode;
+  node.next = mListHeads[list];
+  if (node.next != kNoNode) {
+    mNodes[node.next].prev = index;
+  }
+  mListHeads[list] = index;
+
+  if (list != kOverflowList) {
+    mOccupiedSlots[list / kSlotsPerLevel] |= UINT64_C(1)
+                                             << (list % kSlotsPerLevel);
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+void TimerWheel<ElementType, kCapacity>::unlinkNode(uint16_t index) {
+  Node &node = mNodes[index];
+  if (node.prev != kNoNode) {
+    mNodes[node.prev].next = node.next;
+  } else {
+    mListHeads[node.list] = node.next;
+  }
+  if (node.next != kNoNode) {
+    mNodes[node.next].prev = node.prev;
+  }
+
+  if (mListHeads[node.list] == kNoNode && node.list != kOverflowList) {
+    mOccupiedSlots[node.list / kSlotsPerLevel] &=
+        ~(UINT64_C(1) << (node.list % kSlotsPerLevel));
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+void TimerWheel<ElementType, kCapacity>::refileList(uint16_t list) {
+  uint16_t index = mListHeads[list];
+  mListHeads[list] = kNoNode;
+  if (list != kOverflowList) {
+    mOccupiedSlots[list / kSlotsPerLevel] &=
+        ~(UINT64_C(1) << (list % kSlotsPerLevel));
+  }
+
+  while (index != kNoNode) {
+    uint16_t next = mNodes[index].next;
+    linkNode(index);
+    index = next;
+  }
+}
+
+template <typename ElementType, size_t kCapacity>
+size_t TimerWheel<ElementType, kCapacity>::getLowestSetBit(uint64_t bits) {
+  size_t index = 0;
+  for (uint32_t width = 32; width > 0; width /= 2) {
+    uint64_t lowMask = (UINT64_C(1) << width) - 1;
+    if ((bits & lowMask) == 0) {
+      bits >>= width;
+      index += width;
+    }
+  }
+
+  return index;
+}
+
+}  // namespace chre
+
+#endif  // CHRE_UTIL_TIMER_WHEEL_IMPL_H_
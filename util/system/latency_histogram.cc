@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chre/util/system/latency_histogram.h"
+
+#include <cinttypes>
+
+namespace chre {
+
+constexpr size_t LatencyHistogram::kNumBuckets;
+constexpr uint32_t LatencyHistogram::kFirstBucketUpperBoundMicros;
+constexpr uint32_t LatencyHistogram::kBucketShift;
+
+void LatencyHistogram::record(Nanoseconds duration) {
+  uint64_t durationNs = duration.toRawNanoseconds();
+  uint64_t durationUs = durationNs / kOneMicrosecondInNanoseconds;
+
+  size_t index = 0;
+  uint64_t upperBoundUs = kFirstBucketUpperBoundMicros;
+  while (index < kNumBuckets - 1 && durationUs >= upperBoundUs) {
+    index++;
+    upperBoundUs <<= kBucketShift;
+  }
+
+  if (mBucketCounts[index] < UINT32_MAX) {
+    mBucketCounts[index]++;
+  }
+  if (mCount < UINT32_MAX) {
+    mCount++;
+    mTotalNs += durationNs;
+  }
+  if (durationNs > mMaxNs) {
+    mMaxNs = durationNs;
+  }
+}
+
+Nanoseconds LatencyHistogram::getAverage() const {
+  return Nanoseconds((mCount == 0) ? 0 : mTotalNs / mCount);
+}
+
+uint32_t LatencyHistogram::getBucketUpperBoundMicros(size_t index) {
+  return (index >= kNumBuckets - 1)
+             ? UINT32_MAX
+             : kFirstBucketUpperBoundMicros << (kBucketShift * index);
+}
+
+void LatencyHistogram::logStateToBuffer(DebugDumpWrapper &debugDump) const {
+  uint64_t averageNs = getAverage().toRawNanoseconds();
+  debugDump.print("avg=%" PRIu64 "us max=%" PRIu64 "us [",
+                  averageNs / kOneMicrosecondInNanoseconds,
+                  mMaxNs / kOneMicrosecondInNanoseconds);
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    debugDump.print((i == 0) ? "%" PRIu32 : " %" PRIu32, mBucketCounts[i]);
+  }
+  debugDump.print("]");
+}
+
+}  // namespace chre
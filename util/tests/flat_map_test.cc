@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <functional>
+#include <map>
+
+#include "chre/util/flat_map.h"
+#include "chre/util/unique_ptr.h"
+
+using chre::FlatMap;
+using chre::MakeUnique;
+using chre::UniquePtr;
+
+TEST(FlatMap, IsEmptyInitially) {
+  FlatMap<int, int> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_EQ(map.capacity(), 0);
+  EXPECT_EQ(map.begin(), map.end());
+  EXPECT_EQ(map.find(1), map.end());
+  EXPECT_FALSE(map.contains(1));
+}
+
+TEST(FlatMap, InsertKeepsKeysSorted) {
+  FlatMap<int, int> map;
+  const int kKeys[] = {5, 1, 4, 2, 3};
+  for (int key : kKeys) {
+    auto it = map.insertOrAssign(key, key * 10);
+    ASSERT_NE(it, map.end());
+  }
+
+  ASSERT_EQ(map.size(), 5);
+  int expectedKey = 1;
+  for (const auto &entry : map) {
+    EXPECT_EQ(entry.key, expectedKey);
+    EXPECT_EQ(entry.value, expectedKey * 10);
+    expectedKey++;
+  }
+}
+
+TEST(FlatMap, InsertOrAssignReplacesExistingValue) {
+  FlatMap<int, int> map;
+  auto it = map.insertOrAssign(7, 1);
+  ASSERT_NE(it, map.end());
+  EXPECT_EQ(it->value, 1);
+
+  it = map.insertOrAssign(7, 2);
+  ASSERT_NE(it, map.end());
+  EXPECT_EQ(it->value, 2);
+  EXPECT_EQ(map.size(), 1);
+}
+
+TEST(FlatMap, FindAllowsValueModification) {
+  FlatMap<uint16_t, uint16_t> map;
+  map.insertOrAssign(0x10, 0x1);
+  map.insertOrAssign(0x20, 0x1);
+
+  auto it = map.find(0x20);
+  ASSERT_NE(it, map.end());
+  it->value |= 0x2;
+  EXPECT_EQ(map.find(0x20)->value, 0x3);
+  EXPECT_EQ(map.find(0x10)->value, 0x1);
+  EXPECT_EQ(map.find(0x30), map.end());
+}
+
+TEST(FlatMap, EraseByKey) {
+  FlatMap<int, int> map;
+  for (int i = 0; i < 10; i++) {
+    map.insertOrAssign(i, i);
+  }
+
+  EXPECT_TRUE(map.erase(0));
+  EXPECT_TRUE(map.erase(5));
+  EXPECT_TRUE(map.erase(9));
+  EXPECT_FALSE(map.erase(5));
+  EXPECT_FALSE(map.erase(100));
+  EXPECT_EQ(map.size(), 7);
+  EXPECT_FALSE(map.contains(5));
+  EXPECT_TRUE(map.contains(4));
+  EXPECT_TRUE(map.contains(6));
+}
+
+TEST(FlatMap, EraseByIterator) {
+  FlatMap<int, int> map;
+  map.insertOrAssign(1, 1);
+  map.insertOrAssign(2, 2);
+  map.insertOrAssign(3, 3);
+
+  map.erase(map.find(2));
+  ASSERT_EQ(map.size(), 2);
+  EXPECT_EQ(map.begin()->key, 1);
+  EXPECT_EQ((map.begin() + 1)->key, 3);
+}
+
+TEST(FlatMap, ClearKeepsCapacity) {
+  FlatMap<int, int> map;
+  ASSERT_TRUE(map.reserve(8));
+  EXPECT_GE(map.capacity(), 8);
+  map.insertOrAssign(1, 1);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_GE(map.capacity(), 8);
+}
+
+TEST(FlatMap, CustomComparator) {
+  FlatMap<int, int, std::greater<int>> map;
+  map.insertOrAssign(1, 0);
+  map.insertOrAssign(3, 0);
+  map.insertOrAssign(2, 0);
+
+  int expectedKey = 3;
+  for (const auto &entry : map) {
+    EXPECT_EQ(entry.key, expectedKey--);
+  }
+  EXPECT_TRUE(map.contains(2));
+}
+
+TEST(FlatMap, SupportsMoveOnlyValues) {
+  FlatMap<int, UniquePtr<int>> map;
+  map.insertOrAssign(2, MakeUnique<int>(20));
+  map.insertOrAssign(1, MakeUnique<int>(10));
+  map.insertOrAssign(2, MakeUnique<int>(21));
+
+  ASSERT_EQ(map.size(), 2);
+  EXPECT_EQ(*map.find(1)->value, 10);
+  EXPECT_EQ(*map.find(2)->value, 21);
+
+  FlatMap<int, UniquePtr<int>> other(std::move(map));
+  EXPECT_EQ(other.size(), 2);
+  EXPECT_EQ(*other.find(2)->value, 21);
+}
+
+TEST(FlatMap, MatchesStdMapUnderRandomOperations) {
+  FlatMap<int, int> map;
+  std::map<int, int> reference;
+
+  srand(0);
+  for (int i = 0; i < 5000; i++) {
+    int key = rand() % 128;
+    int value = rand();
+    if (rand() % 3 == 0) {
+      EXPECT_EQ(map.erase(key), reference.erase(key) == 1);
+    } else {
+      auto it = map.insertOrAssign(key, value);
+      ASSERT_NE(it, map.end());
+      reference[key] = value;
+    }
+  }
+
+  ASSERT_EQ(map.size(), reference.size());
+  auto it = map.begin();
+  for (const auto &pair : reference) {
+    EXPECT_EQ(it->key, pair.first);
+    EXPECT_EQ(it->value, pair.second);
+    ++it;
+  }
+}
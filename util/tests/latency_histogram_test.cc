@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include "chre/util/system/latency_histogram.h"
+
+using chre::LatencyHistogram;
+using chre::Microseconds;
+using chre::Milliseconds;
+using chre::Nanoseconds;
+using chre::Seconds;
+
+TEST(LatencyHistogram, EmptyByDefault) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.getCount(), 0);
+  EXPECT_EQ(histogram.getAverage().toRawNanoseconds(), 0);
+  EXPECT_EQ(histogram.getMax().toRawNanoseconds(), 0);
+  for (size_t i = 0; i < LatencyHistogram::kNumBuckets; i++) {
+    EXPECT_EQ(histogram.getBucketCount(i), 0);
+  }
+}
+
+TEST(LatencyHistogram, BucketUpperBounds) {
+  EXPECT_EQ(LatencyHistogram::getBucketUpperBoundMicros(0), 16);
+  EXPECT_EQ(LatencyHistogram::getBucketUpperBoundMicros(1), 64);
+  EXPECT_EQ(LatencyHistogram::getBucketUpperBoundMicros(3), 1024);
+  EXPECT_EQ(LatencyHistogram::getBucketUpperBoundMicros(6), 65536);
+  EXPECT_EQ(LatencyHistogram::getBucketUpperBoundMicros(7), UINT32_MAX);
+}
+
+TEST(LatencyHistogram, RecordsIntoBuckets) {
+  LatencyHistogram histogram;
+  histogram.record(Nanoseconds(0));
+  histogram.record(Nanoseconds(Microseconds(15)));
+  histogram.record(Nanoseconds(Microseconds(16)));
+  histogram.record(Nanoseconds(Milliseconds(1)));
+  histogram.record(Nanoseconds(Seconds(10)));
+
+  EXPECT_EQ(histogram.getCount(), 5);
+  EXPECT_EQ(histogram.getBucketCount(0), 2);
+  EXPECT_EQ(histogram.getBucketCount(1), 1);
+  EXPECT_EQ(histogram.getBucketCount(3), 1);
+  EXPECT_EQ(histogram.getBucketCount(LatencyHistogram::kNumBuckets - 1), 1);
+  EXPECT_EQ(histogram.getMax(), Nanoseconds(Seconds(10)));
+}
+
+TEST(LatencyHistogram, Average) {
+  LatencyHistogram histogram;
+  histogram.record(Nanoseconds(100));
+  histogram.record(Nanoseconds(300));
+  EXPECT_EQ(histogram.getAverage().toRawNanoseconds(), 200);
+  EXPECT_EQ(histogram.getMax().toRawNanoseconds(), 300);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <thread>
+#include <vector>
+
+#include "chre/platform/log.h"
+#include "chre/util/lock_free_memory_pool.h"
+#include "chre/util/synchronized_memory_pool.h"
+
+using chre::LockFreeMemoryPool;
+using chre::SynchronizedMemoryPool;
+
+namespace {
+
+constexpr size_t kStressPoolSize = 96;
+
+//! An element large enough to make a torn or shared block visible.
+struct Payload {
+  Payload(uint32_t owner_) : owner(owner_), check(~owner_) {}
+
+  uint32_t owner;
+  uint32_t check;
+};
+
+/**
+ * Repeatedly allocates a few blocks from the pool, checks that no other thread
+ * modified them, and frees them again.
+ */
+template <typename PoolType>
+void allocFreeLoop(PoolType *pool, uint32_t threadId, size_t iterations,
+                   std::atomic<size_t> *failures) {
+  constexpr size_t kBlocksPerIteration = 4;
+  Payload *blocks[kBlocksPerIteration];
+
+  for (size_t i = 0; i < iterations; i++) {
+    for (size_t j = 0; j < kBlocksPerIteration; j++) {
+      blocks[j] = pool->allocate(threadId);
+    }
+    for (size_t j = 0; j < kBlocksPerIteration; j++) {
+      if (blocks[j] == nullptr) {
+        continue;
+      }
+      if (blocks[j]->owner != threadId || blocks[j]->check != ~threadId) {
+        (*failures)++;
+      }
+      pool->deallocate(blocks[j]);
+    }
+  }
+}
+
+/**
+ * Runs threadCount threads doing alloc/free cycles against the same pool, and
+ * returns the elapsed time in nanoseconds.
+ */
+template <typename PoolType>
+uint64_t runAllocFree(size_t threadCount, size_t iterations) {
+  PoolType pool;
+  std::atomic<size_t> failures(0);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < threadCount; i++) {
+    threads.emplace_back(allocFreeLoop<PoolType>, &pool,
+                         static_cast<uint32_t>(i), iterations, &failures);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(failures.load(), 0);
+  EXPECT_EQ(pool.getFreeBlockCount(), kStressPoolSize);
+
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count());
+}
+
+}  // namespace
+
+TEST(LockFreeMemoryPool, ExhaustPool) {
+  LockFreeMemoryPool<int, 3> memoryPool;
+  EXPECT_EQ(memoryPool.getFreeBlockCount(), 3);
+  EXPECT_NE(memoryPool.allocate(), nullptr);
+  EXPECT_NE(memoryPool.allocate(), nullptr);
+  EXPECT_NE(memoryPool.allocate(), nullptr);
+  EXPECT_EQ(memoryPool.getFreeBlockCount(), 0);
+  EXPECT_EQ(memoryPool.allocate(), nullptr);
+  EXPECT_EQ(memoryPool.getFreeBlockCount(), 0);
+}
+
+TEST(LockFreeMemoryPool, ExhaustPoolThenDeallocateOneAndAllocateOne) {
+  LockFreeMemoryPool<int, 3> memoryPool;
+
+  int *element1 = memoryPool.allocate(0xcafe);
+  int *element2 = memoryPool.allocate(0xbeef);
+  int *element3 = memoryPool.allocate(0xface);
+  ASSERT_NE(element1, nullptr);
+  ASSERT_NE(element2, nullptr);
+  ASSERT_NE(element3, nullptr);
+
+  memoryPool.deallocate(element1);
+  EXPECT_EQ(memoryPool.getFreeBlockCount(), 1);
+  element1 = memoryPool.allocate(0xfade);
+  ASSERT_NE(element1, nullptr);
+  EXPECT_EQ(memoryPool.allocate(), nullptr);
+
+  EXPECT_EQ(*element1, 0xfade);
+  EXPECT_EQ(*element2, 0xbeef);
+  EXPECT_EQ(*element3, 0xface);
+}
+
+TEST(LockFreeMemoryPool, ReusesBlocksInLifoOrder) {
+  LockFreeMemoryPool<int, 4> memoryPool;
+  int *element1 = memoryPool.allocate();
+  int *element2 = memoryPool.allocate();
+
+  memoryPool.deallocate(element1);
+  memoryPool.deallocate(element2);
+  EXPECT_EQ(memoryPool.allocate(), element2);
+  EXPECT_EQ(memoryPool.allocate(), element1);
+}
+
+TEST(LockFreeMemoryPool, ConcurrentAllocFreeNeverSharesBlocks) {
+  runAllocFree<LockFreeMemoryPool<Payload, kStressPoolSize>>(8, 20000);
+}
+
+//! Compares alloc/free throughput of the lock-free pool with the mutex-based
+//! SynchronizedMemoryPool used by default for EventLoop::mEventPool.
+TEST(LockFreeMemoryPool, AllocFreeBenchmark) {
+  constexpr size_t kIterations = 100000;
+
+  for (size_t threadCount = 1; threadCount <= 8; threadCount *= 2) {
+    uint64_t synchronizedNs =
+        runAllocFree<SynchronizedMemoryPool<Payload, kStressPoolSize>>(
+            threadCount, kIterations);
+    uint64_t lockFreeNs =
+        runAllocFree<LockFreeMemoryPool<Payload, kStressPoolSize>>(
+            threadCount, kIterations);
+
+    // Each iteration allocates and frees 4 blocks
+    uint64_t opCount = threadCount * kIterations * 4;
+    LOGI("%zu threads: synchronized pool %" PRIu64
+         " ns/alloc+free, lock-free pool %" PRIu64 " ns/alloc+free",
+         threadCount, synchronizedNs / opCount, lockFreeNs / opCount);
+  }
+}
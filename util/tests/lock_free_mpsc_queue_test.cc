@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <thread>
+#include <vector>
+
+#include "chre/platform/log.h"
+#include "chre/util/fixed_size_blocking_queue.h"
+#include "chre/util/lock_free_mpsc_queue.h"
+#include "chre/util/unique_ptr.h"
+
+using chre::FixedSizeBlockingQueue;
+using chre::LockFreeMpscQueue;
+using chre::MakeUnique;
+using chre::UniquePtr;
+
+namespace {
+
+constexpr uint32_t kProducerShift = 24;
+
+int gDestructorCount = 0;
+
+struct CountsDestruction {
+  ~CountsDestruction() {
+    gDestructorCount++;
+  }
+};
+
+/**
+ * Pushes itemCount values tagged with the producer index, spinning while the
+ * queue is full.
+ */
+template <typename QueueType>
+void produce(QueueType *queue, uint32_t producer, uint32_t itemCount) {
+  for (uint32_t i = 0; i < itemCount; i++) {
+    while (!queue->push((producer << kProducerShift) | i)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+/**
+ * Runs producerCount threads against a single consumer, verifies that every
+ * item is received exactly once and in per-producer FIFO order, and returns
+ * the elapsed time in nanoseconds.
+ */
+template <typename QueueType>
+uint64_t runContention(uint32_t producerCount, uint32_t itemsPerProducer) {
+  QueueType queue;
+  std::vector<uint32_t> nextExpected(producerCount, 0);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < producerCount; p++) {
+    producers.emplace_back(produce<QueueType>, &queue, p, itemsPerProducer);
+  }
+
+  for (uint32_t i = 0; i < producerCount * itemsPerProducer; i++) {
+    uint32_t value = queue.pop();
+    uint32_t producer = value >> kProducerShift;
+    uint32_t sequence = value & ((1u << kProducerShift) - 1);
+    EXPECT_LT(producer, producerCount);
+    EXPECT_EQ(sequence, nextExpected[producer]);
+    nextExpected[producer] = sequence + 1;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(queue.empty());
+
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count());
+}
+
+}  // namespace
+
+TEST(LockFreeMpscQueue, RoundUpToPowerOfTwo) {
+  EXPECT_EQ(chre::roundUpToPowerOfTwo(1), 1);
+  EXPECT_EQ(chre::roundUpToPowerOfTwo(2), 2);
+  EXPECT_EQ(chre::roundUpToPowerOfTwo(3), 4);
+  EXPECT_EQ(chre::roundUpToPowerOfTwo(96), 128);
+  EXPECT_EQ(chre::roundUpToPowerOfTwo(128), 128);
+}
+
+TEST(LockFreeMpscQueue, IsEmptyByDefault) {
+  LockFreeMpscQueue<int, 16> queue;
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.size(), 0);
+}
+
+TEST(LockFreeMpscQueue, PushPopVerifyOrder) {
+  LockFreeMpscQueue<int, 16> queue;
+
+  ASSERT_TRUE(queue.push(0x1337));
+  ASSERT_TRUE(queue.push(0xcafe));
+  EXPECT_FALSE(queue.empty());
+  EXPECT_EQ(queue.size(), 2);
+
+  EXPECT_EQ(queue.pop(), 0x1337);
+  EXPECT_EQ(queue.pop(), 0xcafe);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(LockFreeMpscQueue, PushPopMove) {
+  static constexpr int kVal = 0xbeef;
+  UniquePtr<int> ptr = MakeUnique<int>(kVal);
+
+  LockFreeMpscQueue<UniquePtr<int>, 4> queue;
+  ASSERT_TRUE(queue.push(std::move(ptr)));
+  EXPECT_TRUE(ptr.isNull());
+  EXPECT_EQ(*(queue.pop()), kVal);
+}
+
+TEST(LockFreeMpscQueue, PushFailsWhenFullAndWrapsAround) {
+  LockFreeMpscQueue<int, 4> queue;
+
+  for (int lap = 0; lap < 3; lap++) {
+    for (int i = 0; i < 4; i++) {
+      EXPECT_TRUE(queue.push(lap * 4 + i));
+    }
+    EXPECT_FALSE(queue.push(-1));
+    EXPECT_EQ(queue.size(), 4);
+
+    for (int i = 0; i < 4; i++) {
+      EXPECT_EQ(queue.pop(), lap * 4 + i);
+    }
+    EXPECT_TRUE(queue.empty());
+  }
+}
+
+TEST(LockFreeMpscQueue, DestructorDestroysRemainingElements) {
+  gDestructorCount = 0;
+  {
+    LockFreeMpscQueue<CountsDestruction, 4> queue;
+    ASSERT_TRUE(queue.push(CountsDestruction()));
+    ASSERT_TRUE(queue.push(CountsDestruction()));
+    gDestructorCount = 0;
+  }
+  EXPECT_EQ(gDestructorCount, 2);
+}
+
+TEST(LockFreeMpscQueue, PopBlocksUntilPush) {
+  LockFreeMpscQueue<int, 4> queue;
+
+  std::thread producer([&queue]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    queue.push(42);
+  });
+
+  EXPECT_EQ(queue.pop(), 42);
+  producer.join();
+}
+
+TEST(LockFreeMpscQueue, MultipleProducersPreserveFifoPerProducer) {
+  runContention<LockFreeMpscQueue<uint32_t, 128>>(4, 50000);
+}
+
+//! Measures consumer throughput with 1-8 producer threads contending on the
+//! queue, compared to the mutex-based FixedSizeBlockingQueue used by default
+//! for EventLoop::mEvents.
+TEST(LockFreeMpscQueue, ContentionBenchmark) {
+  constexpr uint32_t kProducerCounts[] = {1, 2, 4, 8};
+  constexpr uint32_t kItemsPerProducer = 100000;
+
+  for (uint32_t producerCount : kProducerCounts) {
+    uint64_t blockingNs =
+        runContention<FixedSizeBlockingQueue<uint32_t, 128>>(
+            producerCount, kItemsPerProducer);
+    uint64_t lockFreeNs = runContention<LockFreeMpscQueue<uint32_t, 128>>(
+        producerCount, kItemsPerProducer);
+
+    uint64_t itemCount = producerCount * kItemsPerProducer;
+    LOGI("%" PRIu32 " producers: blocking queue %" PRIu64
+         " ns/item, lock-free queue %" PRIu64 " ns/item",
+         producerCount, blockingNs / itemCount, lockFreeNs / itemCount);
+  }
+}
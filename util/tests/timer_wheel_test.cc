@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "chre/platform/log.h"
+#include "chre/util/priority_queue.h"
+#include "chre/util/timer_wheel.h"
+
+using chre::Milliseconds;
+using chre::Nanoseconds;
+using chre::PriorityQueue;
+using chre::Seconds;
+using chre::TimerWheel;
+
+namespace {
+
+constexpr size_t kCapacity = 64;
+
+typedef TimerWheel<uint32_t, kCapacity> TestWheel;
+
+//! Removes all elements that expire at or before currentTime in expiration
+//! order, checking that the order matches the expected expiration times.
+void expireAndVerify(TestWheel &wheel, Nanoseconds currentTime,
+                     std::vector<Nanoseconds> *expired) {
+  while (!wheel.empty()) {
+    wheel.advance(currentTime);
+    size_t index = wheel.getNextIndex();
+    ASSERT_NE(index, TestWheel::kInvalidIndex);
+    Nanoseconds expirationTime = wheel.getExpirationTime(index);
+    if (expirationTime > currentTime) {
+      break;
+    }
+    if (!expired->empty()) {
+      EXPECT_FALSE(expirationTime < expired->back());
+    }
+    expired->push_back(expirationTime);
+    wheel.remove(index);
+  }
+}
+
+struct HeapTimer {
+  uint32_t handle;
+  Nanoseconds expirationTime;
+
+  bool operator>(const HeapTimer &other) const {
+    return (expirationTime > other.expirationTime);
+  }
+};
+
+}  // namespace
+
+TEST(TimerWheel, EmptyByDefault) {
+  TestWheel wheel;
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_EQ(wheel.size(), 0);
+  EXPECT_EQ(wheel.getNextIndex(), TestWheel::kInvalidIndex);
+}
+
+TEST(TimerWheel, InsertUntilFull) {
+  TestWheel wheel;
+  for (uint32_t i = 0; i < kCapacity; i++) {
+    size_t index = wheel.insert(i, Nanoseconds(Milliseconds(i + 1)));
+    ASSERT_NE(index, TestWheel::kInvalidIndex);
+    EXPECT_TRUE(wheel.isInUse(index));
+    EXPECT_EQ(wheel[index], i);
+  }
+  EXPECT_EQ(wheel.size(), kCapacity);
+  EXPECT_EQ(wheel.insert(0, Nanoseconds(0)), TestWheel::kInvalidIndex);
+
+  size_t index = wheel.getNextIndex();
+  EXPECT_EQ(wheel[index], 0);
+  wheel.remove(index);
+  EXPECT_FALSE(wheel.isInUse(index));
+  EXPECT_NE(wheel.insert(100, Nanoseconds(0)), TestWheel::kInvalidIndex);
+}
+
+TEST(TimerWheel, NextIndexIsEarliestWithinATick) {
+  TestWheel wheel;
+  wheel.insert(1, Nanoseconds(300));
+  wheel.insert(2, Nanoseconds(100));
+  wheel.insert(3, Nanoseconds(200));
+
+  EXPECT_EQ(wheel[wheel.getNextIndex()], 2);
+  wheel.remove(wheel.getNextIndex());
+  EXPECT_EQ(wheel[wheel.getNextIndex()], 3);
+  wheel.remove(wheel.getNextIndex());
+  EXPECT_EQ(wheel[wheel.getNextIndex()], 1);
+}
+
+TEST(TimerWheel, RescheduleKeepsIndex) {
+  TestWheel wheel;
+  size_t first = wheel.insert(1, Nanoseconds(Milliseconds(10)));
+  size_t second = wheel.insert(2, Nanoseconds(Milliseconds(20)));
+  EXPECT_EQ(wheel.getNextIndex(), first);
+
+  wheel.reschedule(first, Nanoseconds(Seconds(30)));
+  EXPECT_EQ(wheel.getNextIndex(), second);
+  EXPECT_EQ(wheel[first], 1);
+  EXPECT_EQ(wheel.getExpirationTime(first), Nanoseconds(Seconds(30)));
+}
+
+TEST(TimerWheel, AdvanceCascadesAcrossLevels) {
+  TestWheel wheel;
+  std::vector<Nanoseconds> expired;
+  wheel.insert(0, Nanoseconds(Milliseconds(5)));
+  wheel.insert(1, Nanoseconds(Milliseconds(500)));
+  wheel.insert(2, Nanoseconds(Seconds(30)));
+  wheel.insert(3, Nanoseconds(Seconds(600)));
+  // Beyond the range of the top level, so kept in the overflow list
+  wheel.insert(4, Nanoseconds(Seconds(24 * 60 * 60)));
+
+  expireAndVerify(wheel, Nanoseconds(Milliseconds(4)), &expired);
+  EXPECT_EQ(expired.size(), 0);
+  expireAndVerify(wheel, Nanoseconds(Seconds(1)), &expired);
+  EXPECT_EQ(expired.size(), 2);
+  expireAndVerify(wheel, Nanoseconds(Seconds(700)), &expired);
+  EXPECT_EQ(expired.size(), 4);
+  EXPECT_EQ(wheel[wheel.getNextIndex()], 4);
+  expireAndVerify(wheel, Nanoseconds(Seconds(24 * 60 * 60)), &expired);
+  EXPECT_EQ(expired.size(), 5);
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, RandomOperationsMatchSortedOrder) {
+  TestWheel wheel;
+  std::vector<size_t> indices;
+  std::vector<Nanoseconds> expired;
+  uint64_t currentTimeNs = 0;
+  srand(0xc4e);
+
+  for (int i = 0; i < 20000; i++) {
+    int op = rand() % 4;
+    if (op == 0 && wheel.size() < kCapacity) {
+      // Mix of short and very long durations
+      uint64_t durationNs = static_cast<uint64_t>(rand()) *
+                            ((rand() % 2) ? 1 : 100000);
+      size_t index = wheel.insert(static_cast<uint32_t>(i),
+                                  Nanoseconds(currentTimeNs + durationNs));
+      ASSERT_NE(index, TestWheel::kInvalidIndex);
+      indices.push_back(index);
+    } else if (op == 1 && !indices.empty()) {
+      size_t position = rand() % indices.size();
+      if (wheel.isInUse(indices[position])) {
+        wheel.remove(indices[position]);
+      }
+      indices.erase(indices.begin() + position);
+    } else if (op == 2 && !indices.empty()) {
+      size_t position = rand() % indices.size();
+      if (wheel.isInUse(indices[position])) {
+        wheel.reschedule(indices[position],
+                         Nanoseconds(currentTimeNs + rand()));
+      }
+    } else {
+      currentTimeNs += static_cast<uint64_t>(rand() % 1000) * 100000;
+      expired.clear();
+      expireAndVerify(wheel, Nanoseconds(currentTimeNs), &expired);
+
+      // Nothing that has expired may be left in the wheel, and the next
+      // element must be the earliest of all remaining ones
+      if (!wheel.empty()) {
+        Nanoseconds earliest = wheel.getExpirationTime(wheel.getNextIndex());
+        EXPECT_GT(earliest, Nanoseconds(currentTimeNs));
+        for (size_t index = 0; index < kCapacity; index++) {
+          if (wheel.isInUse(index)) {
+            EXPECT_FALSE(wheel.getExpirationTime(index) < earliest);
+          }
+        }
+      }
+    }
+  }
+}
+
+//! Compares a set/cancel workload on the TimerWheel with a PriorityQueue
+//! searched linearly by handle, which is how TimerPool tracks timers unless
+//! CHRE_TIMER_WHEEL_ENABLED is defined.
+TEST(TimerWheel, SetCancelBenchmark) {
+  constexpr size_t kActiveTimers = 48;
+  constexpr size_t kIterations = 200000;
+  srand(0x717e);
+
+  std::vector<uint64_t> durations;
+  for (size_t i = 0; i < kIterations; i++) {
+    durations.push_back((rand() % 10000) * chre::kOneMillisecondInNanoseconds);
+  }
+
+  auto heapStart = std::chrono::steady_clock::now();
+  {
+    PriorityQueue<HeapTimer, std::greater<HeapTimer>> heap;
+    uint32_t nextHandle = 0;
+    for (size_t i = 0; i < kIterations; i++) {
+      if (heap.size() == kActiveTimers) {
+        uint32_t handleToCancel = nextHandle - kActiveTimers / 2;
+        for (size_t j = 0; j < heap.size(); j++) {
+          if (heap[j].handle == handleToCancel) {
+            heap.remove(j);
+            break;
+          }
+        }
+        if (heap.size() == kActiveTimers) {
+          heap.pop();
+        }
+      }
+      heap.push(HeapTimer{nextHandle++, Nanoseconds(durations[i])});
+    }
+  }
+  auto heapEnd = std::chrono::steady_clock::now();
+
+  auto wheelStart = std::chrono::steady_clock::now();
+  {
+    TestWheel wheel;
+    std::vector<size_t> indexByHandle;
+    indexByHandle.reserve(kIterations);
+    uint32_t nextHandle = 0;
+    for (size_t i = 0; i < kIterations; i++) {
+      if (wheel.size() == kActiveTimers) {
+        size_t index = indexByHandle[nextHandle - kActiveTimers / 2];
+        if (wheel.isInUse(index) &&
+            wheel[index] == nextHandle - kActiveTimers / 2) {
+          wheel.remove(index);
+        } else {
+          wheel.remove(wheel.getNextIndex());
+        }
+      }
+      indexByHandle.push_back(
+          wheel.insert(nextHandle++, Nanoseconds(durations[i])));
+    }
+  }
+  auto wheelEnd = std::chrono::steady_clock::now();
+
+  uint64_t heapNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        heapEnd - heapStart)
+                        .count();
+  uint64_t wheelNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         wheelEnd - wheelStart)
+                         .count();
+  LOGI("%zu set/cancel pairs: heap %" PRIu64 " ns/op, timer wheel %" PRIu64
+       " ns/op",
+       kIterations, heapNs / kIterations, wheelNs / kIterations);
+}
@@ -17,6 +17,11 @@ COMMON_SRCS += util/nanoapp/debug.cc
 COMMON_SRCS += util/nanoapp/wifi.cc
 COMMON_SRCS += util/system/debug_dump.cc
 
+# Optional per-nanoapp event latency instrumentation.
+ifeq ($(CHRE_EVENT_LATENCY_STATS_ENABLED), true)
+COMMON_SRCS += util/system/latency_histogram.cc
+endif
+
 # GoogleTest Source Files ######################################################
 
 GOOGLETEST_SRCS += util/tests/array_queue_test.cc
@@ -25,11 +30,19 @@ GOOGLETEST_SRCS += util/tests/buffer_test.cc
 GOOGLETEST_SRCS += util/tests/debug_dump_test.cc
 GOOGLETEST_SRCS += util/tests/dynamic_vector_test.cc
 GOOGLETEST_SRCS += util/tests/fixed_size_vector_test.cc
+GOOGLETEST_SRCS += util/tests/flat_map_test.cc
 GOOGLETEST_SRCS += util/tests/heap_test.cc
+GOOGLETEST_SRCS += util/tests/lock_free_memory_pool_test.cc
+GOOGLETEST_SRCS += util/tests/lock_free_mpsc_queue_test.cc
 GOOGLETEST_SRCS += util/tests/lock_guard_test.cc
 GOOGLETEST_SRCS += util/tests/memory_pool_test.cc
 GOOGLETEST_SRCS += util/tests/optional_test.cc
 GOOGLETEST_SRCS += util/tests/priority_queue_test.cc
 GOOGLETEST_SRCS += util/tests/singleton_test.cc
 GOOGLETEST_SRCS += util/tests/time_test.cc
+GOOGLETEST_SRCS += util/tests/timer_wheel_test.cc
 GOOGLETEST_SRCS += util/tests/unique_ptr_test.cc
+
+ifeq ($(CHRE_EVENT_LATENCY_STATS_ENABLED), true)
+GOOGLETEST_SRCS += util/tests/latency_histogram_test.cc
+endif
@@ -9,3 +9,8 @@ CHRE_GNSS_SUPPORT_ENABLED = true
 CHRE_SENSORS_SUPPORT_ENABLED = true
 CHRE_WIFI_SUPPORT_ENABLED = true
 CHRE_WWAN_SUPPORT_ENABLED = true
+CHRE_SENSOR_DATA_DECIMATION_ENABLED = true
+CHRE_SENSOR_HISTORY_ENABLED = true
+CHRE_EVENT_LATENCY_STATS_ENABLED = true
+CHRE_TIMER_WHEEL_ENABLED = true
+CHRE_LOCK_FREE_LOG_BUFFER_ENABLED = true